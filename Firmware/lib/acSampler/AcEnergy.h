@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "AcRms.h"
+
+/*
+ * CT current, power and energy in integer units, and the cross-check of the CT energy against the
+ * S0 meter.
+ *
+ * The RMS of the CT signal (AcRmsWindow::rmsMilliCounts) is calibrated into milliamperes with a
+ * fixed gain after the no-current noise floor is removed in quadrature (noise and current add as
+ * squares). Power is that current at a nominal mains voltage times the phases carrying it and a
+ * power factor: there is no voltage measurement, so it is an estimate, but one per mains cycle,
+ * where the S0 meter gives one value per pulse. Energy is that power integrated over time.
+ *
+ *   const uint32_t mA = acCurrentMilliAmps(window.rmsMilliCounts, 3000, 97500);
+ *   const uint32_t w = acPowerW(mA, 230, 1, 100);
+ *   energyWattMs += (uint64_t)w * elapsedMs;  // acEnergyMilliWh(energyWattMs)
+ *
+ * acEnergyCheck() compares the CT and meter energy of a charging session. Below 'minMilliWh' on
+ * both it is Pending; then the two must agree within 'tolerancePercent' of the larger. A meter that
+ * stopped counting and a CT that slipped off the cable both show up as a Mismatch, as does a CT
+ * gain that was never calibrated (the published ratio gives the correction).
+ */
+
+enum class AcEnergyCheck : uint8_t {
+  Pending,   // Too little energy yet to compare
+  Agree,
+  Mismatch
+};
+
+// RMS current in mA from the RMS in 1/1000 ADC count; a reading at or below the noise floor is 0
+inline uint32_t acCurrentMilliAmps(uint32_t rmsMilliCounts, uint32_t noiseFloorMilliCounts, uint32_t microAmpsPerCount) {
+  const uint64_t rmsSquared = (uint64_t)rmsMilliCounts * rmsMilliCounts;
+  const uint64_t floorSquared = (uint64_t)noiseFloorMilliCounts * noiseFloorMilliCounts;
+  if (rmsSquared <= floorSquared) {
+    return 0;
+  }
+  const uint64_t milliCounts = acIsqrt64(rmsSquared - floorSquared);
+  return (uint32_t)((milliCounts * microAmpsPerCount + 500000) / 1000000);
+}
+
+inline uint32_t acPowerW(uint32_t currentMilliAmps, uint32_t mainsVolts, uint32_t phases, uint32_t powerFactorPercent) {
+  return (uint32_t)(((uint64_t)currentMilliAmps * mainsVolts * phases * powerFactorPercent + 50000) / 100000);
+}
+
+inline uint64_t acEnergyMilliWh(uint64_t energyWattMs) {
+  return energyWattMs / 3600;  // 1 mWh = 3600 W*ms
+}
+
+inline AcEnergyCheck acEnergyCheck(uint64_t ctMilliWh, uint64_t meterMilliWh, uint64_t minMilliWh, uint32_t tolerancePercent) {
+  const uint64_t larger = ctMilliWh > meterMilliWh ? ctMilliWh : meterMilliWh;
+  const uint64_t difference = ctMilliWh > meterMilliWh ? ctMilliWh - meterMilliWh : meterMilliWh - ctMilliWh;
+  if (larger < minMilliWh) {
+    return AcEnergyCheck::Pending;
+  }
+  return difference * 100 > larger * tolerancePercent ? AcEnergyCheck::Mismatch : AcEnergyCheck::Agree;
+}
+
+inline const char* acEnergyCheckName(AcEnergyCheck check) {
+  switch (check) {
+    case AcEnergyCheck::Agree:    return "agree";
+    case AcEnergyCheck::Mismatch: return "mismatch";
+    default:                      return "pending";
+  }
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Streaming RMS of the CT signal in integer arithmetic, over whole mains cycles.
+ *
+ * Samples (12-bit ADC counts at a fixed rate) are centred on a running DC estimate and cut into
+ * segments at positive-going zero crossings: after a dip below -hysteresis, and not sooner than a
+ * 70 Hz period after the last crossing, so noise does not cut them up. A segment that is one
+ * plausible mains period (40-70 Hz) is a cycle; its exact length comes from interpolating both
+ * crossings between samples. Every closed segment completes a window of the newest segments:
+ *
+ *  locked    whole cycles nearest windowMs (5 at 50 Hz, 6 at 60 Hz, detected from the average period),
+ *            so the RMS does not depend on where the window starts in the mains phase
+ *  unlocked  fixed 20 ms segments (no current, noise only or no plausible crossings), windowMs long
+ *
+ * The DC left in a window after centring is removed from its mean square, so the RMS is that of
+ * the AC component alone, as the Welford loop it replaces computed it. All sums are 64-bit; a
+ * sample costs a shift, a multiply and a few adds, and a window result a 64-bit square root.
+ *
+ *   AcRmsKernel kernel(1000, 100, 8);
+ *   AcRmsWindow window;
+ *   if (kernel.push(sample, &window)) { ... window.rmsMilliCounts ... } // every mains cycle once locked
+ */
+
+struct AcRmsWindow {
+  uint32_t rmsMilliCounts;   // RMS of the AC component, 1/1000 ADC count
+  int32_t meanMilliCounts;   // DC offset (bias), 1/1000 ADC count
+  uint32_t mainsCentiHz;     // Mains frequency measured over the window; 0 when not locked
+  uint16_t samples;
+  bool locked;               // Window is whole mains cycles
+};
+
+// floor(sqrt(value))
+inline uint32_t acIsqrt64(uint64_t value) {
+  uint64_t root = 0;
+  uint64_t bit = 1ULL << 62;
+  while (bit > value) {
+    bit >>= 2;
+  }
+  while (bit != 0) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)root;
+}
+
+// RMS of the AC component of 'count' raw samples from their sum and sum of squares, in 1/1000
+// ADC count. Exact integer variance; 'count' up to 1000 12-bit samples.
+inline uint32_t acRmsMilliCountsOfSums(uint64_t sum, uint64_t sumSquares, uint32_t count) {
+  if (count == 0) {
+    return 0;
+  }
+  const uint64_t scaledVariance = count * sumSquares - sum * sum;  // count^2 * variance, never negative
+  const uint32_t rmsQ8 = acIsqrt64((scaledVariance << 16) / ((uint64_t)count * count));
+  return (uint32_t)(((uint64_t)rmsQ8 * 1000 + 128) >> 8);
+}
+
+class AcRmsKernel {
+ public:
+  static constexpr uint8_t MAX_SEGMENTS = 8;      // Enough for windowMs = 100 at 70 Hz
+  static constexpr uint8_t DC_SHIFT = 10;         // Running DC estimate: time constant 1024 samples
+  static constexpr uint32_t UNLOCKED_SEGMENT_HZ = 50;
+
+  AcRmsKernel(uint32_t sampleRateHz, uint32_t windowMs, uint16_t hysteresisCounts)
+      : sampleRateHz_(sampleRateHz),
+        windowMs_(windowMs),
+        hysteresisQ8_((int32_t)hysteresisCounts << 8),
+        minPeriodQ8_(sampleRateHz * 256 / 70),
+        maxPeriodQ8_(sampleRateHz * 256 / 40),
+        unlockedSegmentSamples_((uint16_t)(sampleRateHz / UNLOCKED_SEGMENT_HZ)),
+        minCycleSamples_((uint16_t)(sampleRateHz / 70)),
+        maxCycleSamples_((uint16_t)(sampleRateHz / 40 + 2)) {
+    reset();
+  }
+
+  void reset() {
+    dcQ16_ = 0;
+    previousQ8_ = 0;
+    armed_ = false;
+    index_ = 0;
+    lastCrossingQ8_ = 0;
+    haveCrossing_ = false;
+    aligned_ = false;
+    openSum_ = 0;
+    openSumSquares_ = 0;
+    openSamples_ = 0;
+    head_ = 0;
+    count_ = 0;
+    averagePeriodQ8_ = 0;
+    mainsHz_ = 50;
+  }
+
+  // Adds one 12-bit sample. Returns true and fills 'window' when it closed a segment and enough
+  // segments for a window have been seen.
+  bool push(uint16_t sample, AcRmsWindow* window) {
+    const int32_t sampleQ16 = (int32_t)sample << 16;
+    if (index_ < (1U << DC_SHIFT)) {
+      dcQ16_ += (sampleQ16 - dcQ16_) / (int32_t)(index_ + 1);  // Mean of all samples until the filter is primed
+    } else {
+      dcQ16_ += (sampleQ16 - dcQ16_) >> DC_SHIFT;
+    }
+    const int32_t centredQ8 = (sampleQ16 - dcQ16_) >> 8;
+
+    bool completed = false;
+    if (centredQ8 < -hysteresisQ8_) {
+      armed_ = true;
+    } else if (armed_ && centredQ8 >= 0 && aligned_ && openSamples_ < minCycleSamples_) {
+      armed_ = false;  // Noise: too soon after the last boundary for a mains cycle
+    } else if (armed_ && centredQ8 >= 0) {
+      // Positive-going zero crossing between the previous sample and this one
+      armed_ = false;
+      const uint32_t crossingQ8 =
+          (index_ - 1) * 256 + (uint32_t)(((int64_t)-previousQ8_ << 8) / (centredQ8 - previousQ8_));
+      const uint32_t periodQ8 = crossingQ8 - lastCrossingQ8_;
+      const bool cycle = aligned_ && haveCrossing_ && periodQ8 >= minPeriodQ8_ && periodQ8 <= maxPeriodQ8_;
+      if (cycle) {
+        // Average period over ~8 cycles: crossing jitter from noise must not flip 50/60 Hz
+        averagePeriodQ8_ = averagePeriodQ8_ == 0 ? (int32_t)periodQ8
+                                                 : averagePeriodQ8_ + (((int32_t)periodQ8 - averagePeriodQ8_) >> 3);
+        mainsHz_ = (uint64_t)sampleRateHz_ * 256 * 100 / (uint32_t)averagePeriodQ8_ < 5500 ? 50 : 60;
+      }
+      if (openSamples_ > 0) {
+        completed = closeSegment(cycle, cycle ? periodQ8 : (uint32_t)openSamples_ * 256, window);
+      }
+      aligned_ = true;
+      haveCrossing_ = true;
+      lastCrossingQ8_ = crossingQ8;
+    } else if (openSamples_ >= (aligned_ ? maxCycleSamples_ : unlockedSegmentSamples_)) {
+      // No crossing where the next one was due: fixed segments until the signal locks again
+      completed = closeSegment(false, (uint32_t)openSamples_ * 256, window);
+      aligned_ = false;
+    }
+
+    openSum_ += centredQ8;
+    openSumSquares_ += (uint64_t)((int64_t)centredQ8 * centredQ8);
+    openSamples_++;
+    previousQ8_ = centredQ8;
+    index_++;
+    return completed;
+  }
+
+ private:
+  struct Segment {
+    int64_t sum;           // Centred samples, Q8 counts
+    uint64_t sumSquares;   // Q16 counts^2
+    uint32_t lengthQ8;     // Samples, Q8; fractional for a cycle
+    uint16_t samples;
+    bool cycle;
+  };
+
+  bool closeSegment(bool cycle, uint32_t segmentLengthQ8, AcRmsWindow* window) {
+    Segment& segment = segments_[head_];
+    segment.sum = openSum_;
+    segment.sumSquares = openSumSquares_;
+    segment.lengthQ8 = segmentLengthQ8;
+    segment.samples = openSamples_;
+    segment.cycle = cycle;
+    head_ = (uint8_t)((head_ + 1) % MAX_SEGMENTS);
+    if (count_ < MAX_SEGMENTS) {
+      count_++;
+    }
+    openSum_ = 0;
+    openSumSquares_ = 0;
+    openSamples_ = 0;
+
+    const uint32_t windowSegments = cycle ? (windowMs_ * mainsHz_ + 500) / 1000
+                                          : windowMs_ * UNLOCKED_SEGMENT_HZ / 1000;
+    if (windowSegments == 0 || windowSegments > count_ || window == nullptr) {
+      return false;
+    }
+    int64_t sum = 0;
+    uint64_t sumSquares = 0;
+    uint32_t lengthQ8 = 0;
+    uint32_t samples = 0;
+    bool locked = true;
+    for (uint32_t i = 1; i <= windowSegments; i++) {
+      const Segment& s = segments_[(head_ + MAX_SEGMENTS - i) % MAX_SEGMENTS];
+      sum += s.sum;
+      sumSquares += s.sumSquares;
+      lengthQ8 += s.lengthQ8;
+      samples += s.samples;
+      locked = locked && s.cycle;
+    }
+
+    const int64_t residualQ8 = sum * 256 / (int64_t)lengthQ8;
+    const int64_t meanSquareQ16 = (int64_t)(sumSquares * 256 / lengthQ8) - residualQ8 * residualQ8;
+    const uint32_t rmsQ8 = meanSquareQ16 > 0 ? acIsqrt64((uint64_t)meanSquareQ16) : 0;
+    window->rmsMilliCounts = (uint32_t)(((uint64_t)rmsQ8 * 1000 + 128) >> 8);
+    window->meanMilliCounts = (int32_t)(((int64_t)dcQ16_ * 1000 >> 16) + residualQ8 * 1000 / 256);
+    window->mainsCentiHz =
+        locked ? (uint32_t)(((uint64_t)windowSegments * sampleRateHz_ * 256 * 100 + lengthQ8 / 2) / lengthQ8) : 0;
+    window->samples = (uint16_t)samples;
+    window->locked = locked;
+    return true;
+  }
+
+  const uint32_t sampleRateHz_;
+  const uint32_t windowMs_;
+  const int32_t hysteresisQ8_;
+  const uint32_t minPeriodQ8_;
+  const uint32_t maxPeriodQ8_;
+  const uint16_t unlockedSegmentSamples_;
+  const uint16_t minCycleSamples_;
+  const uint16_t maxCycleSamples_;
+
+  int32_t dcQ16_;
+  int32_t previousQ8_;
+  bool armed_;
+  uint32_t index_;           // Samples pushed; crossing positions are index * 256 + fraction (wrap safe)
+  uint32_t lastCrossingQ8_;
+  bool haveCrossing_;
+  bool aligned_;             // The open segment started at a zero crossing
+  int64_t openSum_;
+  uint64_t openSumSquares_;
+  uint16_t openSamples_;
+  Segment segments_[MAX_SEGMENTS];
+  uint8_t head_;
+  uint8_t count_;
+  int32_t averagePeriodQ8_;
+  uint32_t mainsHz_;         // 50 or 60, from the average period
+};
@@ -0,0 +1,281 @@
+#include "AcSampler.h"
+#include "AcEnergy.h"
+#include "AcRms.h"
+#include "config.h"
+#include "globals.h"
+
+#include <driver/adc.h>
+#include <string.h>
+
+static_assert(CHARGING_AC_ADC_RATE_HZ % CHARGING_AC_SAMPLE_RATE_HZ == 0,
+              "CHARGING_AC_ADC_RATE_HZ must be a multiple of CHARGING_AC_SAMPLE_RATE_HZ");
+
+constexpr uint32_t AC_ADC_DECIMATION = CHARGING_AC_ADC_RATE_HZ / CHARGING_AC_SAMPLE_RATE_HZ;
+constexpr uint32_t AC_ADC_BYTES_PER_CONVERSION = sizeof(adc_digi_output_data_t);
+constexpr uint32_t AC_ADC_READ_BYTES = AC_SAMPLER_FRAME_SAMPLES * AC_ADC_DECIMATION * AC_ADC_BYTES_PER_CONVERSION; // One DMA interrupt: one frame
+constexpr uint32_t AC_ADC_STORE_BYTES = 10 * AC_ADC_READ_BYTES;                           // Driver ring buffer: 100 ms of conversions
+constexpr uint32_t AC_ADC_READ_TIMEOUT_MS = 100;
+constexpr UBaseType_t AC_SAMPLER_TASK_PRIORITY = 3;  // Above PulseInputTask: the DMA ring must be drained in time
+constexpr UBaseType_t AC_RMS_TASK_PRIORITY = 2;
+
+// ADC1 channel of GPIO32-39; -1 = not an ADC1 pin
+static int adc1Channel(int gpio) {
+  switch (gpio) {
+    case 36: return ADC1_CHANNEL_0;
+    case 37: return ADC1_CHANNEL_1;
+    case 38: return ADC1_CHANNEL_2;
+    case 39: return ADC1_CHANNEL_3;
+    case 32: return ADC1_CHANNEL_4;
+    case 33: return ADC1_CHANNEL_5;
+    case 34: return ADC1_CHANNEL_6;
+    case 35: return ADC1_CHANNEL_7;
+    default: return -1;
+  }
+}
+
+static portMUX_TYPE AcSamplerMux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t AcSamplerTaskHandle = nullptr;
+static TaskHandle_t AcRmsTaskHandle = nullptr;
+static int sAdcChannel = -1;
+
+// Frame double buffer. The reader fills one frame; a completed frame is handed over in
+// sReadyFrame and the RMS task works on sConsumingFrame. -1 = none.
+static uint16_t sFrames[2][AC_SAMPLER_FRAME_SAMPLES];
+static bool sFrameAfterGap[2];  // Samples were lost before this frame
+static int sReadyFrame = -1;
+static int sConsumingFrame = -1;
+
+static AcRmsKernel sRmsKernel(CHARGING_AC_SAMPLE_RATE_HZ, CHARGING_AC_WINDOW_MS, CHARGING_AC_ZERO_CROSS_HYSTERESIS);
+static AcSamplerReading sLatest = {};
+static uint64_t sEnergyWattMs = 0;
+static uint32_t sEnergyAtMs = 0;
+static bool sEnergyStarted = false;
+static uint32_t sLatestAtMs = 0;
+static bool sHasLatest = false;
+static AcSamplerStats sStats = {};
+
+/* ###################################################################################################
+ *               A D C   R E A D E R
+ * ###################################################################################################
+ */
+// Hands the full frame to the RMS task and returns the frame to fill next. 'afterGap' is true
+// if samples were lost before the frame; it is set for the next frame if this one is dropped.
+static int completeFrame(int filled, bool* afterGap) {
+  int next = 1 - filled;
+  bool handedOver = true;
+
+  portENTER_CRITICAL(&AcSamplerMux);
+  if (sConsumingFrame == next) {
+    // The RMS task still reads the other buffer: drop this frame and refill it
+    next = filled;
+    handedOver = false;
+    sStats.overruns++;
+  } else {
+    if (sReadyFrame == next) {
+      sStats.overruns++;  // Never picked up; replaced by the newer frame
+      *afterGap = true;
+    }
+    sFrameAfterGap[filled] = *afterGap;
+    sReadyFrame = filled;
+  }
+  portEXIT_CRITICAL(&AcSamplerMux);
+
+  *afterGap = !handedOver;
+  if (handedOver) {
+    xTaskNotifyGive(AcRmsTaskHandle);
+  }
+  return next;
+}
+
+static void AcSamplerTask(void* pvParameters) {
+  (void)pvParameters;
+  static uint8_t readBuffer[AC_ADC_READ_BYTES];
+  int frame = 0;
+  int fill = 0;
+  bool afterGap = true;
+  uint32_t accumulator = 0;
+  uint32_t accumulated = 0;
+
+  for (;;) {
+    uint32_t length = 0;
+    esp_err_t result = adc_digi_read_bytes(readBuffer, sizeof(readBuffer), &length, AC_ADC_READ_TIMEOUT_MS);
+    if (result == ESP_ERR_INVALID_STATE) {
+      // Ring buffer overflowed: the data is the newest, but there is a gap before it
+      portENTER_CRITICAL(&AcSamplerMux);
+      sStats.dmaOverflows++;
+      portEXIT_CRITICAL(&AcSamplerMux);
+      fill = 0;
+      afterGap = true;
+      accumulator = 0;
+      accumulated = 0;
+    } else if (result != ESP_OK) {
+      portENTER_CRITICAL(&AcSamplerMux);
+      sStats.readErrors++;
+      portEXIT_CRITICAL(&AcSamplerMux);
+      continue;
+    }
+
+    for (uint32_t offset = 0; offset + AC_ADC_BYTES_PER_CONVERSION <= length; offset += AC_ADC_BYTES_PER_CONVERSION) {
+      adc_digi_output_data_t conversion;
+      memcpy(&conversion, readBuffer + offset, AC_ADC_BYTES_PER_CONVERSION);
+      if (conversion.type1.channel != sAdcChannel) {
+        portENTER_CRITICAL(&AcSamplerMux);
+        sStats.channelErrors++;
+        portEXIT_CRITICAL(&AcSamplerMux);
+        continue;
+      }
+      accumulator += conversion.type1.data;
+      if (++accumulated < AC_ADC_DECIMATION) {
+        continue;
+      }
+      sFrames[frame][fill++] = (uint16_t)((accumulator + AC_ADC_DECIMATION / 2) / AC_ADC_DECIMATION);
+      accumulator = 0;
+      accumulated = 0;
+      if (fill == (int)AC_SAMPLER_FRAME_SAMPLES) {
+        frame = completeFrame(frame, &afterGap);
+        fill = 0;
+      }
+    }
+  }
+}
+
+/* ###################################################################################################
+ *               R M S
+ * ###################################################################################################
+ */
+static void AcRmsTask(void* pvParameters) {
+  (void)pvParameters;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    portENTER_CRITICAL(&AcSamplerMux);
+    int frame = sReadyFrame;
+    sReadyFrame = -1;
+    sConsumingFrame = frame;
+    portEXIT_CRITICAL(&AcSamplerMux);
+    if (frame < 0) {
+      continue;
+    }
+
+    if (sFrameAfterGap[frame]) {
+      sRmsKernel.reset();
+    }
+    AcRmsWindow window;
+    bool completed = false;
+    for (uint32_t i = 0; i < AC_SAMPLER_FRAME_SAMPLES; ++i) {
+      completed = sRmsKernel.push(sFrames[frame][i], &window) || completed;  // The newest window wins
+    }
+    uint32_t nowMs = millis();
+
+    // The power of the previous window held since the last frame, then that of the new window
+    uint32_t sinceLastFrameMs = nowMs - sEnergyAtMs;
+    if (sEnergyStarted && sinceLastFrameMs <= AC_SAMPLER_MAX_ENERGY_GAP_MS) {
+      sEnergyWattMs += (uint64_t)sLatest.powerW * sinceLastFrameMs;
+    }
+    sEnergyAtMs = nowMs;
+    sEnergyStarted = true;
+    uint32_t currentMilliAmps = 0;
+    uint32_t powerW = 0;
+    if (completed) {
+      currentMilliAmps = acCurrentMilliAmps(window.rmsMilliCounts, CHARGING_CT_NOISE_FLOOR_MILLICOUNTS,
+                                            CHARGING_CT_MICROAMPS_PER_COUNT);
+      powerW = acPowerW(currentMilliAmps, CHARGING_CT_MAINS_VOLTAGE, CHARGING_CT_PHASES,
+                        CHARGING_CT_POWER_FACTOR_PERCENT);
+    }
+
+    portENTER_CRITICAL(&AcSamplerMux);
+    sConsumingFrame = -1;
+    sStats.frames++;
+    sLatest.energyMilliWh = acEnergyMilliWh(sEnergyWattMs);
+    if (completed) {
+      sStats.windows++;
+      sStats.lockedWindows += window.locked ? 1 : 0;
+      sLatest.rmsMilliCounts = window.rmsMilliCounts;
+      sLatest.rmsCounts = (int)((window.rmsMilliCounts + 500) / 1000);
+      sLatest.meanCounts = (int)((window.meanMilliCounts + 500) / 1000);
+      sLatest.mainsCentiHz = window.mainsCentiHz;
+      sLatest.currentMilliAmps = currentMilliAmps;
+      sLatest.powerW = powerW;
+      sLatest.sequence = sStats.windows;
+      sLatestAtMs = nowMs;
+      sHasLatest = true;
+    }
+    portEXIT_CRITICAL(&AcSamplerMux);
+  }
+}
+
+/* ###################################################################################################
+ *               S T A R T   A N D   R E A D I N G S
+ * ###################################################################################################
+ */
+bool startAcSampler(int gpio) {
+  if (AcSamplerTaskHandle != nullptr) {
+    return true;
+  }
+  const int channel = adc1Channel(gpio);
+  if (channel < 0) {
+    return false;
+  }
+
+  adc_digi_init_config_t initConfig = {};
+  initConfig.max_store_buf_size = AC_ADC_STORE_BYTES;
+  initConfig.conv_num_each_intr = AC_ADC_READ_BYTES;
+  initConfig.adc1_chan_mask = 1UL << channel;
+  initConfig.adc2_chan_mask = 0;
+  if (adc_digi_initialize(&initConfig) != ESP_OK) {
+    return false;
+  }
+
+  adc_digi_pattern_config_t pattern = {};
+  pattern.atten = ADC_ATTEN_DB_11;  // ~0-3.1 V, the biased CT signal swings around 1.65 V
+  pattern.channel = (uint8_t)channel;
+  pattern.unit = 0;                 // ADC1
+  pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+
+  adc_digi_configuration_t config = {};
+  config.conv_limit_en = true;
+  config.conv_limit_num = 250;
+  config.pattern_num = 1;
+  config.adc_pattern = &pattern;
+  config.sample_freq_hz = CHARGING_AC_ADC_RATE_HZ;
+  config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+  if (adc_digi_controller_configure(&config) != ESP_OK || adc_digi_start() != ESP_OK) {
+    adc_digi_deinitialize();
+    return false;
+  }
+  sAdcChannel = channel;
+
+  xTaskCreate(AcRmsTask, "AcRms", AC_RMS_TASK_STACK_SIZE, nullptr, AC_RMS_TASK_PRIORITY, &AcRmsTaskHandle);
+  xTaskCreate(AcSamplerTask, "AcSampler", AC_SAMPLER_TASK_STACK_SIZE, nullptr, AC_SAMPLER_TASK_PRIORITY,
+              &AcSamplerTaskHandle);
+  return true;
+}
+
+bool acSamplerRunning() {
+  return AcSamplerTaskHandle != nullptr;
+}
+
+bool acSamplerLatest(AcSamplerReading* reading, uint32_t maxAgeMs) {
+  if (reading == nullptr) {
+    return false;
+  }
+  uint32_t nowMs = millis();
+
+  portENTER_CRITICAL(&AcSamplerMux);
+  bool hasLatest = sHasLatest;
+  *reading = sLatest;
+  reading->ageMs = nowMs - sLatestAtMs;
+  portEXIT_CRITICAL(&AcSamplerMux);
+
+  return hasLatest && reading->ageMs <= maxAgeMs;
+}
+
+void getAcSamplerStats(AcSamplerStats* stats) {
+  if (stats == nullptr) {
+    return;
+  }
+  portENTER_CRITICAL(&AcSamplerMux);
+  *stats = sStats;
+  portEXIT_CRITICAL(&AcSamplerMux);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Continuous AC current sampling for the charging session trigger.
+ *
+ * The ESP32 cannot run its ADC DMA slower than 20 kHz, so the sampler runs ADC1 in continuous
+ * mode at CHARGING_AC_ADC_RATE_HZ on the CT input and averages every
+ * CHARGING_AC_ADC_RATE_HZ / CHARGING_AC_SAMPLE_RATE_HZ conversions into one sample. The sample
+ * spacing comes from the ADC clock, not from task scheduling:
+ *
+ *  ADC DMA -> AcSampler task   decimates into frames of AC_SAMPLER_FRAME_SAMPLES samples;
+ *                              the two frame buffers alternate between it and the RMS task
+ *  AcRms task                  streams every sample through AcRmsKernel (AcRms.h), keeps the
+ *                              newest window (whole mains cycles, one per cycle) as the reading,
+ *                              calibrated into current and power (AcEnergy.h), and integrates that
+ *                              power into the CT energy counter frame by frame
+ *
+ * A frame the RMS task has not picked up before the next one completes is dropped and counted as
+ * an overrun. A DMA ring buffer overflow discards the frame being filled. Either way the kernel
+ * starts over, so no window spans a gap; the energy counter carries on with the last power over
+ * gaps up to AC_SAMPLER_MAX_ENERGY_GAP_MS and skips longer stalls. acSamplerLatest() never blocks, so loop() reads the
+ * current RMS in microseconds instead of sampling for CHARGING_AC_SAMPLE_COUNT ms.
+ */
+
+constexpr uint32_t AC_SAMPLER_FRAME_SAMPLES = 10; // One DMA interrupt's worth (10 ms at 1 kHz)
+constexpr uint32_t AC_SAMPLER_MAX_ENERGY_GAP_MS = 1000; // Longest time between frames the CT energy is integrated over
+
+struct AcSamplerReading {
+  int rmsCounts;           // RMS of the AC component, 12-bit ADC counts
+  uint32_t rmsMilliCounts; // Same, 1/1000 count
+  int meanCounts;          // DC offset (bias) over the window, 12-bit ADC counts
+  uint32_t mainsCentiHz;   // Mains frequency over the window; 0 = not locked to whole cycles (no current)
+  uint32_t currentMilliAmps; // RMS current, CHARGING_CT_* calibration
+  uint32_t powerW;         // Estimated power at CHARGING_CT_MAINS_VOLTAGE
+  uint64_t energyMilliWh;  // CT energy since the sampler started
+  uint32_t sequence;       // Windows completed since start; a new value means a new window
+  uint32_t ageMs;          // Time since the window completed
+};
+
+struct AcSamplerStats {
+  uint32_t frames;         // Frames streamed through the RMS kernel
+  uint32_t windows;        // RMS windows completed
+  uint32_t lockedWindows;  // ... of them whole mains cycles
+  uint32_t overruns;       // Completed frames dropped because the RMS task was still busy
+  uint32_t dmaOverflows;   // ADC ring buffer overflows; the frame being filled was discarded
+  uint32_t channelErrors;  // Conversions tagged with another channel (ignored)
+  uint32_t readErrors;     // adc_digi_read_bytes() timeouts and failures
+};
+
+// Configure ADC1 continuous mode for 'gpio' and start the reader and RMS tasks. Returns false
+// (and leaves the ADC alone) if 'gpio' is not an ADC1 pin or the driver refuses the configuration;
+// the caller should then sample with analogRead(). Calling it again after a success is a no-op.
+bool startAcSampler(int gpio);
+
+bool acSamplerRunning();
+
+// Copy the newest RMS window. Returns false if no window has completed yet or the newest is older
+// than 'maxAgeMs' (the sampler has stalled).
+bool acSamplerLatest(AcSamplerReading* reading, uint32_t maxAgeMs);
+
+void getAcSamplerStats(AcSamplerStats* stats);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Selection enums for the pulse input settings in config.h, kept apart from lib/pulsInput so the
+ * configuration does not depend on the pulse library.
+ */
+
+// Pulse counting backend (PULSE_COUNTER_BACKEND), see PulseCounterBackend.h
+enum PulseCounterBackendType : uint8_t {
+  PULSE_BACKEND_ISR = 0,
+  PULSE_BACKEND_PCNT,
+};
+
+// Smoothing of the published power (POWER_ESTIMATOR_MODE), see PowerEstimator.h
+enum PowerEstimatorMode : uint8_t {
+  POWER_MODE_SINGLE = 0,
+  POWER_MODE_PULSE_WINDOW,
+  POWER_MODE_TIME_WINDOW,
+  POWER_MODE_EWMA,
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Arduino.h>
+#include "PulseInputModes.h"
 
 constexpr char SKETCH_VERSION[] = "EV-charging ESP32 MQTT monitor interface - V4.4.1";
 /*
@@ -11,6 +12,7 @@ constexpr char SKETCH_VERSION[] = "EV-charging ESP32 MQTT monitor interface - V4
 - COUNT_NVS_NAMESPACE: Used specifically for storing the pulse counter and subtotal in the PulseInputTask.
 - CHARGE_NVS_NAMESPACE: Used for storing the current charging session state and snapshot in the ChargingSession module.
 - TESLA_PREF_NVS_NAMESPACE: Used for storing Tesla API related preferences such as GPIO pins and thresholds.
+- MQTT_NVS_NAMESPACE: Used for the hash of the Home Assistant discovery configurations last published by the MqttClient.
  * This separation allows for better organization and reduces the risk of accidentally overwriting unrelated data.
  * NOTE: NVS and data stored will not be cleared on OTA updates, so it is important to manage stored data carefully and 
  * consider versioning if the structure of stored data changes in future updates.
@@ -22,14 +24,73 @@ constexpr char SKETCH_VERSION[] = "EV-charging ESP32 MQTT monitor interface - V4
  */
 constexpr char CONFIG_NVS_NAMESPACE[] = "config"; // globals.cpp: Namespace for NVS storage
 constexpr char COUNT_NVS_NAMESPACE[] = "storage"; // PulseInputTask.cpp: Namespace for NVS storage of pulse counter and subtotal
+constexpr char PULSE_JOURNAL_PARTITION_LABEL[] = "pulsejrnl"; // PulseInputTask.cpp: raw flash partition (partitions.csv) for the pulse counter journal. Without it counters stay in COUNT_NVS_NAMESPACE
+constexpr uint32_t PULSE_NVS_SAVE_INTERVAL_MS = 60000; // PulseInputTask.cpp: periodic counter save. Soft and watchdog resets lose nothing in between (RTC shadow, PulseRtcShadow.h); a power cut without a direct-reset signal loses up to this interval
 constexpr char CHARGE_NVS_NAMESPACE[] = "charging"; // ChargingSession.cpp: Charge session state and snapshot storage
 constexpr char TESLA_PREF_NVS_NAMESPACE[] = "tesla"; // TeslaApi.cpp: GPIO and thresholds for pulse input (energy meter)
+constexpr char MQTT_NVS_NAMESPACE[] = "mqtt"; // MqttClient.cpp: hash of the discovery configurations on the broker
 
 constexpr int PULSE_INPUT_GPIO = 33; /* PULSE_INPUT_GPIO = 33
                                         Open-collector output requires an internal (or external) pull-up. 
                                         GPIO 33 is interrupt-capable, ADC1, and has internal pull-up support — perfect 
                                         for this. Configure as INPUT_PULLUP.*/
 constexpr int PULSE_INPUT_INTERRUPT_MODE = FALLING;
+constexpr PulseCounterBackendType PULSE_COUNTER_BACKEND = PULSE_BACKEND_ISR; // PULSE_BACKEND_ISR: one interrupt per pulse. PULSE_BACKEND_PCNT: hardware pulse counter
+                                                                            // polled by PulseInputTask, for fast meters or noisy wiring. See PulseCounterBackend.h.
+constexpr uint32_t PULSE_PCNT_POLL_MS = 250;             // PCNT backend: counter read interval
+constexpr uint16_t PULSE_PCNT_FILTER_APB_CYCLES = 1023;  // PCNT backend: glitch filter, pulses shorter than this many 80 MHz APB cycles are ignored (max 1023 = 12.8 us)
+constexpr uint32_t PULSE_MIN_INTERVAL_US = 2000;          // PCNT backend: edges this soon after the last timestamped edge are bounce and keep its time (2 ms is 180 kW at 10000 imp/kWh)
+constexpr uint32_t PULSE_RING_CAPACITY = 64; // Pulse timestamps buffered between PulseInputISR and PulseInputTask. Must be a power of two.
+constexpr uint32_t PULSE_BATCH_WINDOW_MS = 0; // 0 = count, snapshot and publish every pulse. > 0 = collect pulses for this many ms, then count them in one pass,
+                                             // derive power from the batch's first/last timestamps and emit one snapshot and one publish (high-rate meters).
+constexpr PowerEstimatorMode POWER_ESTIMATOR_MODE = POWER_MODE_SINGLE; // Smoothing of the published "Forbrug" power, see PowerEstimator.h. "Momentan" is always the last interval.
+                                                                      // POWER_MODE_SINGLE | POWER_MODE_PULSE_WINDOW | POWER_MODE_TIME_WINDOW | POWER_MODE_EWMA
+constexpr uint16_t POWER_WINDOW_PULSES = 8;      // POWER_MODE_PULSE_WINDOW: pulses averaged (at most POWER_HISTORY_CAPACITY - 1)
+constexpr uint32_t POWER_WINDOW_MS = 30000;      // POWER_MODE_TIME_WINDOW: time span averaged
+constexpr uint32_t POWER_EWMA_TAU_MS = 30000;    // POWER_MODE_EWMA: time constant
+constexpr float POWER_DECAY_PUBLISH_RATIO = 0.5f; // While no pulses arrive, publish the decayed power once it has fallen below this fraction of the published value
+constexpr uint32_t PULSE_DIAGNOSTICS_PUBLISH_INTERVAL_MS = 60000; // Interval for publishing the retained pulse diagnostics: latency histogram (<device>/log/latency/pulse)
+                                                                  // and PulseInputTask CPU cost (<device>/log/pulse/cpu), plus the MQTT outbound and inbound statistics. 0 disables publishing.
+
+// MQTT outbound, in priority lanes that mqttLoop() drains in this order: control, energy state slot, log, bulk.
+// Each ring lane is an arena of queued publishes (MqttRecordRing.h); a record takes its topic + payload + 10 bytes
+// rounded up to 8. Statistics per lane: <device>/log/mqtt/outbound
+constexpr uint32_t MQTT_CONTROL_LANE_BYTES = 1024;   // Availability (<device>/online) and set commands. Full: the new message is dropped
+constexpr uint32_t MQTT_LOG_LANE_BYTES = 6144;       // Logs and diagnostics. Full: the new message is dropped
+constexpr uint32_t MQTT_BULK_LANE_BYTES = 4096;      // Home Assistant discovery configurations (~5 fit)
+constexpr uint32_t MQTT_BULK_LANE_WAIT_MS = 2000;    // Bulk lane full: the producer waits this long for space before the message is dropped
+constexpr uint8_t MQTT_BULK_RECORDS_PER_LOOP = 1;    // Bulk records published per mqttLoop(), so a discovery burst never holds back the other lanes
+
+// Home Assistant discovery. The configurations are written once at boot from the entity table in MqttClient.cpp
+// (MqttDiscoveryJson.h) into a cache sized by that table, and hashed; they are republished (retained, bulk lane) only
+// when the hash differs from the one stored in MQTT_NVS_NAMESPACE, or when Home Assistant announces itself online on
+// MQTT_DISCOVERY_PREFIX + "status". A reconnect republishes nothing.
+
+// MQTT inbound: messages from the subscriptions (<device>/set, TeslaMate plugged_in) wait in one arena of the same
+// records (MqttRecordRing.h) until the loop task handles them. Statistics: <device>/log/mqtt/inbound
+constexpr uint32_t MQTT_RX_RING_BYTES = 2048;        // ~10 Home Assistant /set payloads, or one of MQTT_PAYLOAD_LEN - 1 bytes. Full: the new message is dropped
+
+// MQTT connect (MqttTransport.h). mqttLoop() takes a connect one non-blocking step per call: TCP handshake, CONNACK, online.
+// Statistics (attempts, failures, connect latency, outage): <device>/log/mqtt/connect
+constexpr uint32_t MQTT_TCP_CONNECT_TIMEOUT_MS = 5000;     // TCP handshake with the broker
+constexpr uint32_t MQTT_CONNACK_TIMEOUT_MS = 5000;         // Broker's answer to CONNECT
+constexpr uint32_t MQTT_RECONNECT_BACKOFF_MIN_MS = 1000;   // After a lost connection the first attempt is immediate; after the n-th failed attempt in a row
+constexpr uint32_t MQTT_RECONNECT_BACKOFF_MAX_MS = 60000;  // the next waits MIN * 2^(n-1), at most MAX, randomly shortened by up to half (jitter)
+
+// Energy history (store-and-forward while the broker is unreachable), published to <device>/history
+constexpr char MQTT_HISTORY_PARTITION_LABEL[] = "mqtthist"; // MqttClient.cpp: raw flash partition (partitions.csv) buffering samples while offline; 64 KB = 2048 samples. Without it nothing is buffered
+constexpr uint32_t MQTT_HISTORY_SAMPLE_INTERVAL_S = 300;  // A sample (time, Total, Forbrug) at every multiple of this on the wall clock (needs NTP time); 2048 samples = 7 days
+constexpr bool MQTT_HISTORY_DROP_OLDEST = true;           // Buffer full: overwrite the oldest 128 samples (true) or drop new samples (false)
+constexpr uint8_t MQTT_HISTORY_REPLAY_BATCH = 2;          // After reconnecting, buffered samples published per MQTT_HISTORY_REPLAY_INTERVAL_MS
+constexpr uint32_t MQTT_HISTORY_REPLAY_INTERVAL_MS = 100; // ... i.e. 20 samples/s by default
+constexpr uint32_t MQTT_STATE_MIN_INTERVAL_MS = 1000;  // The energy state is not queued: only the newest is kept and published at most this often
+constexpr uint32_t MQTT_STATE_SIGNIFICANT_POWER_W = 500; // ... or right away when "Forbrug" differs this much from the last published state
+
+// Worker pool (WorkerPool.h): Tesla/Google Sheets uploads, discovery and push-button publishes run as jobs on two
+// persistent workers instead of a task each. A full queue rejects the new job; its caller keeps the work pending.
+// Statistics (submitted/rejected/completed, peak queue, busy time per worker): <device>/log/worker
+constexpr uint8_t WORKER_NETWORK_QUEUE_LENGTH = 4; // Tesla Owner API and Google Sheets jobs, run one at a time
+constexpr uint8_t WORKER_MQTT_QUEUE_LENGTH = 8;    // Discovery and push-button publish jobs
 
 // Charging session trigger (analog input based)
 /*
@@ -39,18 +100,41 @@ constexpr int PULSE_INPUT_INTERRUPT_MODE = FALLING;
  * AC current sensing (SCT01-T10/50A):
  * The SCT01-T10/50A has a built-in burden resistor and outputs an AC voltage, so no external burden
  * resistor is needed. The signal still needs to be biased near VCC/2 (~1.65 V) before it is fed
- * into the ESP32 ADC. readAcRms() samples the pin CHARGING_AC_SAMPLE_COUNT times (one per ms),
- * removes the measured DC offset from that window, and returns the RMS amplitude as a 12-bit ADC count.
+ * into the ESP32 ADC. The AC sampler (lib/acSampler) runs ADC1 in continuous (DMA) mode at
+ * CHARGING_AC_ADC_RATE_HZ and averages the conversions down to CHARGING_AC_SAMPLE_RATE_HZ.
+ * An RMS task streams the samples through an integer RMS kernel (lib/acSampler/AcRms.h) that
+ * removes the DC offset and, once it detects 50 or 60 Hz, measures over the whole mains cycles
+ * nearest CHARGING_AC_WINDOW_MS, with a new value every cycle; loop() never waits for the ADC. If
+ * the sampler cannot run (e.g. a non-ADC1 pin), readAcRms() takes CHARGING_AC_SAMPLE_COUNT samples
+ * 1 ms apart with analogRead() instead.
  * CHARGING_ANALOG_THRESHOLD and CHARGING_ANALOG_HYSTERESIS are compared against this RMS value;
  * adjust them based on testing with your specific installation and charging current.
+ *
+ * The sampler also calibrates the RMS into amperes and power (CHARGING_CT_*, lib/acSampler/AcEnergy.h)
+ * and integrates it into a CT energy counter. During a charging session that energy is compared with
+ * the pulse energy of the S0 meter and both are published to <device>/log/charging/energy. Calibrate
+ * CHARGING_CT_MICROAMPS_PER_COUNT by multiplying it with the published meter/CT ratio after a session.
  */
 constexpr int CHARGING_ANALOG_GPIO = 34; // Set to ADC1-capable GPIO (GPIO32-39) to enable charging state machine.
-constexpr int CHARGING_AC_SAMPLE_COUNT = 100; // Samples per RMS measurement (1 ms each → 100 ms window ≈ 5 cycles @ 50 Hz)
+constexpr int CHARGING_AC_SAMPLE_COUNT = 100; // Samples per analogRead() RMS measurement when the AC sampler cannot run (1 ms each → 100 ms window ≈ 5 cycles @ 50 Hz)
+constexpr uint32_t CHARGING_AC_SAMPLE_RATE_HZ = 1000; // RMS samples per second (1 ms each, as readAcRms() samples)
+constexpr uint32_t CHARGING_AC_ADC_RATE_HZ = 20000; // ADC DMA conversions per second; 20 kHz is the ESP32 minimum, averaged down to CHARGING_AC_SAMPLE_RATE_HZ
+constexpr uint32_t CHARGING_AC_WINDOW_MS = 100; // RMS window: the whole mains cycles nearest this (5 @ 50 Hz, 6 @ 60 Hz), updated every cycle
+constexpr uint16_t CHARGING_AC_ZERO_CROSS_HYSTERESIS = 8; // ADC counts below the DC offset before a rising zero crossing counts; above the ADC noise
+constexpr uint32_t CHARGING_CT_MICROAMPS_PER_COUNT = 97500; // CT gain: µA per RMS ADC count. 97.5 mA matches the threshold tuning below (40 counts ~ 3.9 A); calibrate against the meter
+constexpr uint32_t CHARGING_CT_NOISE_FLOOR_MILLICOUNTS = 2000; // RMS the sampler reads with no current (1/1000 count); removed in quadrature so idle noise adds no energy
+constexpr uint32_t CHARGING_CT_MAINS_VOLTAGE = 230; // Nominal phase voltage; there is no voltage measurement
+constexpr uint32_t CHARGING_CT_PHASES = 1; // Phases carrying the measured current (3 for a balanced 3-phase charger with the CT on one phase)
+constexpr uint32_t CHARGING_CT_POWER_FACTOR_PERCENT = 100; // On-board chargers run at a power factor near 1
+constexpr uint32_t CHARGING_ENERGY_REPORT_INTERVAL_MS = 10000; // While charging: publish CT and meter energy of the session (<device>/log/charging/energy)
+constexpr uint32_t CHARGING_ENERGY_CHECK_MIN_WH = 200; // CT/meter cross-check starts when either has seen this much energy in the session
+constexpr uint32_t CHARGING_ENERGY_CHECK_TOLERANCE_PERCENT = 15; // ... and reports a mismatch (once per session) when they differ by more than this
 constexpr int CHARGING_ANALOG_THRESHOLD = 40; // Start value tuned for SCT01-T10/50A with charging start around 900 W (~3.9 A @ 230 V). Adjust on-site if needed.
 constexpr int CHARGING_ANALOG_HYSTERESIS = 12; // Hysteresis in RMS ADC counts; keeps start/stop stable while still detecting around-threshold charging transitions.
 constexpr uint32_t CHARGING_START_CONFIRM_SECONDS = 5; // Number of seconds the analog value must continuously indicate charging start before confirming session start
 constexpr uint32_t CHARGING_END_CONFIRM_SECONDS = 5; // Number of seconds the analog value must continuously indicate charging end before confirming session end
 constexpr uint32_t CHARGING_ANALOG_SAMPLE_INTERVAL_MS = 1000; // Interval in milliseconds between analog samples for charging detection
+constexpr uint32_t CHARGING_TESLA_DATA_RETRY_INTERVAL_MS = 60000; // Retry interval for a TeslaData row Google Sheets did not accept
 
 // Push-button GPIO assignments (-1 = disabled)
 constexpr int BUTTON_EV_CHARGING_TOGGLE_GPIO    = 14;  // GPIO for EV charging start/stop toggle button
@@ -12,9 +12,6 @@
 volatile UBaseType_t gNetworkTaskStackHighWater = 0;
 volatile UBaseType_t gWifiConnTaskStackHighWater = 0;
 volatile UBaseType_t gPulseInputTaskStackHighWater = 0;
-volatile UBaseType_t gTeslaTaskStackHighWater = 0;
-volatile UBaseType_t gConfigurationTaskStackHighWater = 0;
-volatile UBaseType_t gButtonPublishTaskStackHighWater = 0;
 volatile size_t gInitialFreeHeapSize = 0;
 
 // Initialize global variables for display update and smart charging status
@@ -25,21 +25,24 @@ void initializeGlobals( TaskParams_t* params );
 extern volatile UBaseType_t gNetworkTaskStackHighWater;
 extern volatile UBaseType_t gWifiConnTaskStackHighWater;
 extern volatile UBaseType_t gPulseInputTaskStackHighWater;
-extern volatile UBaseType_t gTeslaTaskStackHighWater; // TOBE REMOVED. Only used for testing ISR pulse counting with a task that generates pulses in a loop. Not needed for actual pulse counting from the energy meter, which is handled by an interrupt service routine (ISR) and the Pulse Input Task.
-extern volatile UBaseType_t gConfigurationTaskStackHighWater;
-extern volatile UBaseType_t gButtonPublishTaskStackHighWater;
 
 extern volatile size_t  gInitialFreeHeapSize;
 
 // Task stack sizes (in words)
 constexpr int NETWORK_TASK_STACK_SIZE = 3849; // Optimal size: 3742 stack size for the task
-constexpr int TESLA_TELEMETRY_TASK_STACK_SIZE = 8192; // Optimal size: 7880 stack size for the task
-constexpr int CONFIGURATION_TASK_STACK_SIZE = 4835; // Optimal size: 3724 stack size for the task. This task is used for publishing MQTT configurations, which can involve building large JSON payloads, so it may require more stack than typical tasks. It's a one-shot task that runs at startup and after OTA updates to publish the device configuration to MQTT, and then deletes itself. The stack size can be adjusted based on observed high water marks during testing to ensure it has enough stack for the largest expected configuration payloads without being excessively large.
 constexpr int WIFI_CONNECTION_TASK_STACK_SIZE = 2657; // Optimal size: 2517 stack size for the WiFi connection task. This task handles WiFi connectivity and MQTT communication, which can involve operations that require more stack, especially during MQTT reconnection attempts and publishing. The stack size can be adjusted based on observed high water marks during testing to ensure it has enough stack for these operations without being excessively large.
 constexpr int PULSE_INPUT_TASK_STACK_SIZE = 2642; // Optimal size:    8KB stack size for the task
-constexpr int BUTTON_PUBLISH_TASK_STACK_SIZE = 3048; // Optimal size: 2145 One-shot task stack size for MQTT publish triggered by button ISR queue.
+constexpr int AC_SAMPLER_TASK_STACK_SIZE = 2048; // ADC DMA reader: a 400-byte read buffer and the decimation; no library calls besides adc_digi_read_bytes().
+constexpr int AC_RMS_TASK_STACK_SIZE = 2048; // Streams each AC frame through the integer RMS kernel (no allocation).
+constexpr int CHARGING_SESSION_TASK_STACK_SIZE = 4096; // Charging state machine: NVS writes, TeslaData row (String) and MQTT log lines. The network calls run as worker jobs.
 // OledUpdateTaskStackSize is defined in oled_library.h since it's only used for the OLED update task, which is defined in that library.
 
+// Worker pool job stack budgets (in words). Each worker (WorkerPool.h) gets the largest budget of its lane's job
+// types as stack; the measured peak of each job type is reported in <device>/log/stack/<job>.
+constexpr int TESLA_TELEMETRY_JOB_STACK_BUDGET = 8192; // Optimal size: 7880. Tesla Owner API and Google Sheets HTTPS calls: TeslaLog uploads and the charging session's telemetry and TeslaData upload (network worker).
+constexpr int CONFIGURATION_JOB_STACK_BUDGET = 3072; // PROVISIONAL, not measured since the discovery JSON moved out (was 4835 while the task built it); set from the peak in <device>/log/stack/configuration. Queues the cached configurations (MqttDiscoveryJson.h) and stores their hash in NVS (MQTT worker).
+constexpr int BUTTON_PUBLISH_JOB_STACK_BUDGET = 3048; // Optimal size: 2145. MQTT set command for a push-button press (MQTT worker).
+
 // Global variables for display update
 extern bool gDisplayUpdateAvailable; // Flag to indicate if a display update is needed
 extern bool gSmartChargingActivated; // Flag to indicate if smart charging is activated. Set based on received MQTT messages, can be used to adjust display or logic accordingly.
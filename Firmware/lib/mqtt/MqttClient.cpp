@@ -1,14 +1,22 @@
 //#define DEBUG
 //#define HEADLESS_DEBUG
 //#define BOOT_DIAGNOSTICS_LOGGING // Enable logging of boot diagnostics (reset reason, boot count, uptime) to MQTT. Requires WiFi connection and may delay the first telemetry if the MQTT broker is not reachable at startup.
-#define STACK_WATERMARK
 
 #include <ArduinoJson.h>
+#include <Preferences.h>
 #include <PubSubClient.h>
 #include <WiFi.h>
+#include <errno.h>
+#include <esp_system.h>
 #include <time.h>
 
 #include "MqttMessage.h"
+#include "MqttDiscoveryJson.h"
+#include "MqttHistoryBuffer.h"
+#include "MqttRecordRing.h"
+#include "MqttSetCommand.h"
+#include "MqttStateJson.h"
+#include "MqttTransport.h"
 #include "MqttClient.h"
 #include "config.h"
 #include "oled_energy_display.h"
@@ -16,6 +24,8 @@
 #include "OtaService.h"
 #include "privateConfig.h"
 #include "PulseInputTask.h"
+#include "EnergyMath.h"
+#include "WorkerPool.h"
 
 
 #define RETAINED true       // Used in MQTT publications. Can be changed during development and bugfixing.
@@ -23,80 +33,212 @@
 static String mqttDeviceNameWithMac;
 static String mqttClientWithMac;
 
-static WiFiClient wifiClient;
-static PubSubClient mqttClient(wifiClient);
+// Topic registry (MqttTopicId in MqttClient.h), same order as the enum
+struct MqttTopicDefinition {
+  bool discovery;     // homeassistant/<device>/ev-e-monitor/... instead of ev-e-monitor/<device>/...
+  const char* suffix;
+  MqttLane lane;
+};
+static const MqttTopicDefinition mqttTopicDefinitions[MQTT_TOPIC_COUNT] = {
+  {true,  MQTT_SUFFIX_STATE,            MQTT_LANE_CONTROL}, // Normally published from the state slot
+  {true,  MQTT_SUFFIX_BUTTON,           MQTT_LANE_CONTROL},
+  {false, MQTT_ONLINE,                  MQTT_LANE_CONTROL},
+  {false, MQTT_SUFFIX_SET,              MQTT_LANE_CONTROL},
+  {false, MQTT_SKETCH_VERSION,          MQTT_LANE_LOG},
+  {false, MQTT_LOG_SUFFIX,              MQTT_LANE_LOG},
+  {false, MQTT_LOG_STATUS_SUFFIX,       MQTT_LANE_LOG},
+  {false, MQTT_LOG_EMAIL_SUFFIX,        MQTT_LANE_LOG},
+  {false, "/log/pulse/cpu",             MQTT_LANE_LOG},
+  {false, "/log/pulse/overflow",        MQTT_LANE_LOG},
+  {false, "/log/latency/pulse",         MQTT_LANE_LOG},
+  {false, "/log/mqtt/outbound",         MQTT_LANE_LOG},
+  {false, "/log/mqtt/inbound",          MQTT_LANE_LOG},
+  {false, "/log/mqtt/connect",          MQTT_LANE_LOG},
+  {false, "/log/charging/energy",       MQTT_LANE_LOG},
+  {false, "/log/worker",                MQTT_LANE_LOG},
+  {false, "/log/stack/loop",            MQTT_LANE_LOG},
+  {false, "/log/stack/network",         MQTT_LANE_LOG},
+  {false, "/log/stack/wifiConnection",  MQTT_LANE_LOG},
+  {false, "/log/stack/pulseInput",      MQTT_LANE_LOG},
+  {false, "/log/stack/teslaTelemetry",  MQTT_LANE_LOG},
+  {false, "/log/stack/configuration",   MQTT_LANE_LOG},
+  {false, "/log/stack/buttonPublish",   MQTT_LANE_LOG},
+  {false, MQTT_RESET_REASON_SUFFIX,     MQTT_LANE_LOG},
+  {false, MQTT_LAST_BOOT_TIME_SUFFIX,   MQTT_LANE_LOG},
+  {false, "/history",                   MQTT_LANE_LOG},     // Normally published by replayMqttHistory()
+};
+static char mqttTopics[MQTT_TOPIC_COUNT][MQTT_TOPIC_LEN] = {};
+
+// Energy state payload, keys in publish order
+typedef MqttStateJson<MQTT_SENSOR_POWER_ENTITYNAME,
+                      MQTT_SENSOR_INSTANT_POWER_ENTITYNAME,
+                      MQTT_NUMBER_ENERGY_ENTITYNAME,
+                      MQTT_SENSOR_ENERGY_ENTITYNAME> EnergyStateJson;
+static_assert(EnergyStateJson::MAX_LENGTH < MQTT_STATE_PAYLOAD_LEN, "MQTT_STATE_PAYLOAD_LEN too small for the energy state");
+
+static MqttTransport mqttTransport;
+static PubSubClient mqttClient(mqttTransport);
+
+// Connect state machine, advanced by advanceMqttConnect() from mqttLoop()
+enum MqttConnectState : uint8_t {
+  MQTT_CONNECT_WAIT = 0,      // Disconnected, next attempt at mqttNextAttemptMs
+  MQTT_CONNECT_TCP,           // TCP handshake in progress
+  MQTT_CONNECT_CONNACK,       // CONNECT sent, waiting for the broker's CONNACK
+  MQTT_CONNECT_ONLINE
+};
+struct MqttConnectStats {
+  uint32_t attempts;
+  uint32_t connects;
+  uint32_t tcpFailures;       // Refused, unreachable, no socket
+  uint32_t connackFailures;   // Refused by the broker (bad credentials, ...) or closed before the CONNACK
+  uint32_t timeouts;          // MQTT_TCP_CONNECT_TIMEOUT_MS or MQTT_CONNACK_TIMEOUT_MS expired
+  int lastError;              // errno, or the CONNACK return code
+  uint32_t lastLatencyMs;     // Attempt start to CONNACK
+  uint32_t maxLatencyMs;
+  uint64_t totalLatencyMs;
+  uint32_t lastBackoffMs;
+  uint32_t lastOutageMs;      // Disconnected (or booted) to online
+};
+static MqttConnectState mqttConnectState = MQTT_CONNECT_WAIT;
+static uint32_t mqttAttemptStartMs = 0;
+static uint32_t mqttConnackStartMs = 0;
+static uint32_t mqttNextAttemptMs = 0;
+static uint32_t mqttOfflineSinceMs = 0;
+static uint32_t mqttFailuresInRow = 0;
+static MqttConnectStats mqttConnectStats = {};
+
+// The session may be used: connected and the broker's CONNACK seen
+static bool mqttSessionOnline() {
+  return mqttConnectState == MQTT_CONNECT_ONLINE && mqttClient.connected();
+}
+
+// Outbound lanes (MqttLane in MqttClient.h)
+static MqttRecordRing<MQTT_CONTROL_LANE_BYTES> mqttControlLane;
+static MqttRecordRing<MQTT_LOG_LANE_BYTES> mqttLogLane;
+static MqttRecordRing<MQTT_BULK_LANE_BYTES> mqttBulkLane;
+static volatile uint32_t mqttBulkLaneWaits = 0; // Producers that had to wait for bulk space
+
+// Inbound messages, from mqttCallback() (network task) to mqttProcessRxQueue() (loop task)
+static MqttRecordRing<MQTT_RX_RING_BYTES> mqttRxRing;
+static volatile uint32_t mqttRxTruncated = 0;   // Payloads cut to MQTT_PAYLOAD_LEN - 1 bytes
+
+// Energy samples taken while the broker is unreachable; network task only
+static MqttHistoryBuffer mqttHistory;
+static bool mqttHistoryAvailable = false;
+
+// Latest energy state, published between the control and log lanes (see publishMqttStateSlot())
+struct MqttStateSlot {
+  char payload[MQTT_STATE_PAYLOAD_LEN];
+  uint16_t payloadLength;
+  uint32_t powerW;
+  uint32_t sequence;          // Incremented by every snapshot stored
+  bool pending;               // Stored snapshot not published yet
+  bool significant;           // Power moved MQTT_STATE_SIGNIFICANT_POWER_W since the last publish
+  bool published;             // A state has been published since boot
+  uint32_t publishedPowerW;
+  uint32_t publishedMs;
+  uint32_t stored;
+  uint32_t coalesced;         // Snapshots replaced before they were published
+};
+static MqttStateSlot mqttStateSlot = {};
+static portMUX_TYPE mqttStateSlotMux = portMUX_INITIALIZER_UNLOCKED;
+static void publishMqttStateSlot();
+static void replayMqttHistory();
+
+template <uint32_t Capacity>
+static void publishMqttLane(MqttRecordRing<Capacity>& lane, uint32_t maxRecords) {
+  typename MqttRecordRing<Capacity>::Record msg;
+  for (uint32_t published = 0; published < maxRecords && lane.peek(&msg); published++) {
 
-static QueueHandle_t mqttQueue = nullptr;
-static QueueHandle_t mqttRxQueue = nullptr;
+                                          #ifdef DEBUG
+                                          Serial.println("MqttClient: Publishing to topic: " + String(msg.topic) + " payload: " + String(msg.payload) + " retain: " + String(msg.retain) );
+                                          #endif
+
+    mqttClient.publish(msg.topic, reinterpret_cast<const uint8_t*>(msg.payload), msg.payloadLength, msg.retain);
+    lane.release();
+  }
+}
+static volatile bool mqttOutboundReady = false;
 static volatile bool mqttPaused = false;
 static TaskParams_t* mqttParams = nullptr;
 static char bootTimestamp[32] = {0};
-static TaskHandle_t mqttPublishConfigTaskHandle = nullptr;
+static volatile bool mqttPublishConfigJobQueued = false; // Until the discovery job has run
 
-static bool tryParseJsonBool(const JsonVariantConst& value, bool& outValue) {
-  if (value.is<bool>()) {
-    outValue = value.as<bool>();
-    return true;
-  }
+/* ###################################################################################################
+ *                  H O M E   A S S I S T A N T   D I S C O V E R Y   C A C H E
+ * ###################################################################################################
+ *  The discovery configurations depend only on the device name, so buildMqttDiscoveryCache() writes
+ *  them once at boot from mqttDiscoveryEntities (MqttDiscoveryJson.h) into mqttDiscoveryArena and
+ *  hashes all topics and payloads (FNV-1a). The hash of the set last queued in full is kept in NVS.
+ *  After a reconnect the retained configurations are still on the broker, so the publish job is only
+ *  queued when the hashes differ (new firmware changed a payload, or the last publish did not
+ *  complete) or when Home Assistant comes online on MQTT_DISCOVERY_STATUS_TOPIC. A retained birth
+ *  message arrives again with every subscribe, so only a change to "online" counts; after a boot that
+ *  is the first one seen.
+ *  A new entity is one row in mqttDiscoveryEntities; the arena and the packet buffer check follow.
+ */
+constexpr char MQTT_TOTAL_COMMAND_RANGE[] = "\"max\":99999.99,\"min\":0,\"step\":0.01";
+constexpr size_t MQTT_DEVICE_NAME_LENGTH = sizeof(MQTT_DEVICE_NAME) - 1 + 12; // + MAC in hex
+
+static constexpr MqttDiscoveryEntity mqttDiscoveryEntities[] = {
+  // component            objectId                      name                                  device class             unit   value_template filter   settable
+  {MQTT_SENSOR_COMPONENT, MQTT_ENERGY_DEVICECLASS,      MQTT_SENSOR_ENERGY_ENTITYNAME,        MQTT_ENERGY_DEVICECLASS, "kWh", MQTT_DISCOVERY_ROUND_2, nullptr},
+  {MQTT_SENSOR_COMPONENT, MQTT_POWER_DEVICECLASS,       MQTT_SENSOR_POWER_ENTITYNAME,         MQTT_POWER_DEVICECLASS,  "kW",  MQTT_DISCOVERY_RAW,     nullptr},
+  {MQTT_SENSOR_COMPONENT, MQTT_INSTANT_POWER_OBJECT_ID, MQTT_SENSOR_INSTANT_POWER_ENTITYNAME, MQTT_POWER_DEVICECLASS,  "kW",  MQTT_DISCOVERY_RAW,     nullptr},
+  {MQTT_NUMBER_COMPONENT, MQTT_ENERGY_DEVICECLASS,      MQTT_NUMBER_ENERGY_ENTITYNAME,        MQTT_ENERGY_DEVICECLASS, "kWh", MQTT_DISCOVERY_ROUND_2, MQTT_TOTAL_COMMAND_RANGE},
+};
+typedef MqttDiscoveryTable<MQTT_DISCOVERY_ENTITY_COUNT(mqttDiscoveryEntities), mqttDiscoveryEntities,
+                           MQTT_DISCOVERY_PREFIX, MQTT_DEVICE_NAME_LENGTH> MqttDiscoveryConfigTable;
+// PUBLISH header (5) + topic length (2) + topic + payload must fit PubSubClient's buffer
+static_assert(7 + MqttDiscoveryConfigTable::MAX_TOPIC_LENGTH + MqttDiscoveryConfigTable::MAX_PAYLOAD_LENGTH <= MQTT_PACKET_BUFFER_SIZE,
+              "MQTT_PACKET_BUFFER_SIZE too small for the discovery configurations");
+static_assert(MqttDiscoveryConfigTable::MAX_TOPIC_LENGTH < MQTT_TOPIC_LEN, "MQTT_TOPIC_LEN too small for the discovery topics");
+static_assert(MqttDiscoveryJsonDetail::jsonSafe(MQTT_HA_CARD_NAME), "MQTT_HA_CARD_NAME must not need JSON escaping");
+
+struct MqttDiscoveryConfig {
+  const char* topic;
+  const char* payload;
+};
 
-  const char* text = value.as<const char*>();
-  if (text == nullptr) {
-    return false;
-  }
+enum MqttHomeAssistantStatus : uint8_t { HA_STATUS_UNKNOWN, HA_STATUS_OFFLINE, HA_STATUS_ONLINE };
 
-  if (strcmp(text, "true") == 0 || strcmp(text, "True") == 0 ||
-      strcmp(text, "1") == 0 || strcmp(text, "on") == 0 || strcmp(text, "ON") == 0) {
-    outValue = true;
-    return true;
-  }
+static char mqttDiscoveryArena[MqttDiscoveryConfigTable::TOTAL_LENGTH];
+static MqttDiscoveryConfig mqttDiscoveryConfigs[MqttDiscoveryConfigTable::COUNT];
+static uint32_t mqttDiscoveryHash = 0;          // Of the cache
+static uint32_t mqttDiscoveryStoredHash = 0;    // Of the configurations on the broker (NVS)
+static volatile bool mqttDiscoveryRequested = false; // Set by the network and loop tasks, acted on by mqttLoop()
+static MqttHomeAssistantStatus mqttHomeAssistantStatus = HA_STATUS_UNKNOWN;
 
-  if (strcmp(text, "false") == 0 || strcmp(text, "False") == 0 ||
-      strcmp(text, "0") == 0 || strcmp(text, "off") == 0 || strcmp(text, "OFF") == 0) {
-    outValue = false;
-    return true;
+static uint32_t hashMqttDiscovery(uint32_t hash, const char* text, size_t length) {
+  for (size_t i = 0; i <= length; ++i) { // The NUL separates topic and payload
+    hash = (hash ^ (uint8_t)text[i]) * 16777619u;
   }
-
-  return false;
+  return hash;
 }
 
-struct MqttRxMessage {
-  char topic[MQTT_TOPIC_LEN];
-  char payload[MQTT_PAYLOAD_LEN];
-  uint16_t length;
-};
+static void buildMqttDiscoveryCache();
 
-static void mqttPublishConfigurationsTask(void* parameter) {
-  (void)parameter;
+// WORKER_JOB_DISCOVERY_PUBLISH, on the MQTT worker
+static void mqttPublishConfigurationsJob(const void* payload) {
+  (void)payload;
 
   publishMqttConfigurations();
-
-  #ifdef STACK_WATERMARK
-  gConfigurationTaskStackHighWater = uxTaskGetStackHighWaterMark(nullptr);
-  #endif
-
-  mqttPublishConfigTaskHandle = nullptr;
-  vTaskDelete(nullptr);
+  mqttPublishConfigJobQueued = false;
 }
 
-static bool mqttTriggerConfigurationPublishTask() {
+static bool mqttTriggerConfigurationPublishJob() {
   if (isOtaInProgress()) {
     return false;
   }
 
-  if (mqttPublishConfigTaskHandle != nullptr) {
+  if (mqttPublishConfigJobQueued) {
     return true;
   }
 
-  BaseType_t created = xTaskCreate(
-      mqttPublishConfigurationsTask,
-      "mqtt_cfg_pub",
-      CONFIGURATION_TASK_STACK_SIZE,
-      nullptr,
-      1,
-      &mqttPublishConfigTaskHandle);
-
-  if (created != pdPASS) {
-    mqttPublishConfigTaskHandle = nullptr;
+  mqttPublishConfigJobQueued = true;
+  const uint8_t noPayload = 0;
+  if (!submitWorkerJob(WORKER_JOB_DISCOVERY_PUBLISH, mqttPublishConfigurationsJob, noPayload)) {
+    mqttPublishConfigJobQueued = false;
     return false;
   }
 
@@ -138,79 +280,202 @@ static void formatLogTimestamp(char* buffer, size_t bufferSize) {
   * A clean, idiomatic ESP32 + FreeRTOS module layout that keeps OTA + MQTT in one network task, 
   * while staying Arduino-friendly.
   * ###################################################################################################
-  *  
+  *  Each mqttLoop() advances the connect by what is ready, without waiting on the socket, so
+  *  otaHandle() and processPushButtonCommands() keep their 10 ms tick while the broker is slow or
+  *  away: WAIT (backoff) -> TCP (MqttTransport::pollConnect) -> CONNACK (pollConnack) -> ONLINE.
+  *  A lost connection is retried at once; failed attempts back off exponentially with jitter, so a
+  *  restarted broker is not hit by every client at the same moment.
   */  
 
-static void reconnect(TaskParams_t* params) {
-  // Try to connect only once per call to avoid blocking
-  if (!mqttClient.connected()) {
-    // Throttle connection attempts to prevent watchdog issues
-    static unsigned long lastAttempt = 0;
-    unsigned long now = millis();
-    if (now - lastAttempt < 5000) {  // Wait at least 5 seconds between attempts
-      return;
-    }
-    lastAttempt = now;
-    
-    String will = String(MQTT_PREFIX) + mqttDeviceNameWithMac + MQTT_ONLINE;
+static void scheduleMqttReconnect(uint32_t nowMs) {
+  uint32_t backoffMs = MQTT_RECONNECT_BACKOFF_MAX_MS;
+  if (mqttFailuresInRow < 32 && (MQTT_RECONNECT_BACKOFF_MAX_MS >> (mqttFailuresInRow - 1)) >= MQTT_RECONNECT_BACKOFF_MIN_MS) {
+    backoffMs = MQTT_RECONNECT_BACKOFF_MIN_MS << (mqttFailuresInRow - 1);
+  }
+  backoffMs -= esp_random() % (backoffMs / 2 + 1);
+  mqttConnectStats.lastBackoffMs = backoffMs;
+  mqttNextAttemptMs = nowMs + backoffMs;
+}
 
-                                                            #ifdef HEADLESS_DEBUG
-                                                              OledEnergyDisplay::showMonitorLine("MQT try rc:" + String(mqttClient.state()));
-                                                            #endif
+static void failMqttConnect(uint32_t* counter, int error, const char* stage) {
+  uint32_t nowMs = millis();
+  (*counter)++;
+  mqttConnectStats.lastError = error;
+  mqttFailuresInRow++;
+  mqttClient.disconnect();  // Also stops the transport and resets PubSubClient's state
+  mqttConnectState = MQTT_CONNECT_WAIT;
+  scheduleMqttReconnect(nowMs);
+  gMqttConnected = false;
+  OledEnergyDisplay::showMonitorLine("MQT fail " + String(stage) + ":" + String(error));
 
-                                                            #ifdef DEBUG
-                                                              Serial.print("MqttClient:  rc= " + String(mqttClient.state()) + " Attempting MQTT connection...");
-                                                            #endif
+                                                              #ifdef DEBUG
+                                                              Serial.println("MqttClient: MQTT connect failed in " + String(stage) + ", error " + String(error) +
+                                                                             ", retrying in " + String(mqttConnectStats.lastBackoffMs) + " ms");
+                                                              #endif
+}
 
-    // Yield to watchdog before blocking connect call
-    vTaskDelay(pdMS_TO_TICKS(10));
-    
+static void publishMqttConnectStats() {
+  char logMsg[256] = {0};
+  snprintf(logMsg,
+           sizeof(logMsg),
+           "attempts:%lu connects:%lu tcp_failures:%lu connack_failures:%lu timeouts:%lu last_error:%d "
+           "latency_ms:%lu avg_latency_ms:%lu max_latency_ms:%lu last_backoff_ms:%lu outage_ms:%lu",
+           (unsigned long)mqttConnectStats.attempts,
+           (unsigned long)mqttConnectStats.connects,
+           (unsigned long)mqttConnectStats.tcpFailures,
+           (unsigned long)mqttConnectStats.connackFailures,
+           (unsigned long)mqttConnectStats.timeouts,
+           mqttConnectStats.lastError,
+           (unsigned long)mqttConnectStats.lastLatencyMs,
+           (unsigned long)(mqttConnectStats.totalLatencyMs / mqttConnectStats.connects),
+           (unsigned long)mqttConnectStats.maxLatencyMs,
+           (unsigned long)mqttConnectStats.lastBackoffMs,
+           (unsigned long)mqttConnectStats.lastOutageMs);
+  publishMqttLog(MQTT_TOPIC_LOG_MQTT_CONNECT, logMsg, RETAINED);
+}
 
-    if (mqttClient.connect( mqttClientWithMac.c_str(),
-                            params->mqttUsername, 
-                            params->mqttPassword,
-                            will.c_str(),
-                            1,
-                            RETAINED, "False")) 
-    {
+static void onMqttConnected(TaskParams_t* params) {
+  gMqttConnected = true;
 
-      gMqttConnected = true;
+  // Once connected, publish will message and 
+  mqttEnqueuePublish(MQTT_TOPIC_ONLINE, "True", RETAINED);
 
-      // Once connected, publish will message and 
-      mqttEnqueuePublish(will.c_str(), "True", RETAINED);
+  publish_sketch_version( params);
 
-      publish_sketch_version( params);
+  if (mqttDiscoveryHash != mqttDiscoveryStoredHash) {
+    mqttDiscoveryRequested = true; // mqttLoop() queues the publish job
+  }
 
-      mqttTriggerConfigurationPublishTask();
+  // The broker keeps the last state retained, but one stored while offline has not gone out yet
+  uint32_t powerW = 0;
+  uint32_t instantPowerW = 0;
+  uint64_t energyMilliWh = 0;
+  uint64_t subtotalMilliWh = 0;
+  if (getLatestEnergySnapshot(&powerW, &energyMilliWh, &subtotalMilliWh, &instantPowerW)) {
+    publishMqttEnergy(powerW, instantPowerW, energyMilliWh, subtotalMilliWh);
+  }
 
-      /*************************************************************************************
-       *************************************************************************************
-       *************************************************************************************
-       * Subscriptions to topics for receiving set commands are done here
-       *************************************************************************************
-       *************************************************************************************
-       *************************************************************************************/
+  publishMqttConnectStats();
 
-      String topicString = String(MQTT_PREFIX) + mqttDeviceNameWithMac + MQTT_SUFFIX_SET;
-      mqttClient.subscribe(topicString.c_str(), 1);
-      mqttClient.subscribe(MQTT_TESLAMATE_PLUGGED_IN_TOPIC, 1);
-      OledEnergyDisplay::showMonitorLine("MQT connected");
+  if (mqttHistoryAvailable && mqttHistory.pending() > 0) {
+    char logMsg[96] = {0};
+    snprintf(logMsg, sizeof(logMsg), "Replaying %lu energy samples buffered while offline", (unsigned long)mqttHistory.pending());
+    publishMqttLog(MQTT_TOPIC_LOG, logMsg, RETAINED);
+  }
 
-                                                              #ifdef DEBUG
-                                                              Serial.println("MqttClient: MQTT connected");
-                                                              #endif
+  /*************************************************************************************
+   *************************************************************************************
+   *************************************************************************************
+   * Subscriptions to topics for receiving set commands are done here
+   *************************************************************************************
+   *************************************************************************************
+   *************************************************************************************/
 
-    } else {
-      gMqttConnected = false;
-      OledEnergyDisplay::showMonitorLine("MQT fail rc:" + String(mqttClient.state()));
+  mqttClient.subscribe(mqttTopic(MQTT_TOPIC_SET), 1);
+  mqttClient.subscribe(MQTT_TESLAMATE_PLUGGED_IN_TOPIC, 1);
+  mqttClient.subscribe(MQTT_DISCOVERY_STATUS_TOPIC, 1);
+  OledEnergyDisplay::showMonitorLine("MQT connected");
 
-                                                              #ifdef DEBUG
-                                                              Serial.print("MqttClient: MQTT failed, rc=");
-                                                              Serial.print(mqttClient.state());
-                                                              Serial.println(" retrying...");
-                                                              #endif
+                                                          #ifdef DEBUG
+                                                          Serial.println("MqttClient: MQTT connected in " + String(mqttConnectStats.lastLatencyMs) + " ms");
+                                                          #endif
+}
+
+// Returns true while the session is online
+static bool advanceMqttConnect(TaskParams_t* params) {
+  uint32_t nowMs = millis();
+
+  if (mqttConnectState == MQTT_CONNECT_ONLINE) {
+    if (mqttClient.connected()) {
+      return true;
     }
+    // Lost: retry at once, back off only if that fails
+    gMqttConnected = false;
+    mqttClient.disconnect();
+    mqttConnectState = MQTT_CONNECT_WAIT;
+    mqttNextAttemptMs = nowMs;
+    mqttOfflineSinceMs = nowMs;
+
+                                                            #ifdef DEBUG
+                                                            Serial.println("MqttClient: MQTT connection lost, rc=" + String(mqttClient.state()));
+                                                            #endif
   }
+
+  if (mqttConnectState == MQTT_CONNECT_WAIT) {
+    if ((int32_t)(nowMs - mqttNextAttemptMs) < 0) {
+      return false;
+    }
+    if (WiFi.status() != WL_CONNECTED || WiFi.localIP() == IPAddress(0, 0, 0, 0)) {
+      return false;  // Do not attempt MQTT reconnect while WiFi is down or DHCP is not yet complete
+    }
+
+                                                            #ifdef HEADLESS_DEBUG
+                                                              OledEnergyDisplay::showMonitorLine("MQT try rc:" + String(mqttClient.state()));
+                                                            #endif
+
+                                                            #ifdef DEBUG
+                                                              Serial.println("MqttClient:  rc= " + String(mqttClient.state()) + " Attempting MQTT connection...");
+                                                            #endif
+
+    mqttConnectStats.attempts++;
+    mqttAttemptStartMs = nowMs;
+    if (!mqttTransport.beginConnect(params->mqttBrokerIP, params->mqttBrokerPort)) {
+      failMqttConnect(&mqttConnectStats.tcpFailures, mqttTransport.lastError(), "tcp");
+      return false;
+    }
+    mqttConnectState = MQTT_CONNECT_TCP;
+  }
+
+  if (mqttConnectState == MQTT_CONNECT_TCP) {
+    MqttTransport::Poll poll = mqttTransport.pollConnect();
+    if (poll == MqttTransport::POLL_PENDING) {
+      if (nowMs - mqttAttemptStartMs >= MQTT_TCP_CONNECT_TIMEOUT_MS) {
+        failMqttConnect(&mqttConnectStats.timeouts, ETIMEDOUT, "tcp");
+      }
+      return false;
+    }
+    if (poll == MqttTransport::POLL_FAILED) {
+      failMqttConnect(&mqttConnectStats.tcpFailures, mqttTransport.lastError(), "tcp");
+      return false;
+    }
+    // Writes CONNECT; the transport answers with a synthetic CONNACK, so this does not wait
+    if (!mqttClient.connect( mqttClientWithMac.c_str(),
+                             params->mqttUsername, 
+                             params->mqttPassword,
+                             mqttTopic(MQTT_TOPIC_ONLINE),
+                             1,
+                             RETAINED, "False")) {
+      failMqttConnect(&mqttConnectStats.tcpFailures, mqttClient.state(), "tcp");
+      return false;
+    }
+    mqttConnectState = MQTT_CONNECT_CONNACK;
+    mqttConnackStartMs = nowMs;
+  }
+
+  if (mqttConnectState == MQTT_CONNECT_CONNACK) {
+    MqttTransport::Poll poll = mqttTransport.pollConnack();
+    if (poll == MqttTransport::POLL_PENDING) {
+      if (nowMs - mqttConnackStartMs >= MQTT_CONNACK_TIMEOUT_MS) {
+        failMqttConnect(&mqttConnectStats.timeouts, ETIMEDOUT, "ack");
+      }
+      return false;
+    }
+    if (poll == MqttTransport::POLL_FAILED) {
+      failMqttConnect(&mqttConnectStats.connackFailures, mqttTransport.lastError(), "ack");
+      return false;
+    }
+
+    uint32_t latencyMs = nowMs - mqttAttemptStartMs;
+    mqttConnectStats.connects++;
+    mqttConnectStats.lastLatencyMs = latencyMs;
+    mqttConnectStats.maxLatencyMs = max(mqttConnectStats.maxLatencyMs, latencyMs);
+    mqttConnectStats.totalLatencyMs += latencyMs;
+    mqttConnectStats.lastOutageMs = nowMs - mqttOfflineSinceMs;
+    mqttFailuresInRow = 0;
+    mqttConnectState = MQTT_CONNECT_ONLINE;
+    onMqttConnected(params);
+  }
+  return mqttConnectState == MQTT_CONNECT_ONLINE;
 }
 
 /* ###################################################################################################
@@ -221,6 +486,7 @@ void mqttInit(TaskParams_t* params) {
   mqttParams = params;
   
   initializeMQTTGlobals();
+  buildMqttDiscoveryCache();
   OledEnergyDisplay::showMonitorLine("MQT IP:" + String(params->mqttBrokerIP));
   OledEnergyDisplay::showMonitorLine("MQT port: " + String(params->mqttBrokerPort));
 
@@ -229,30 +495,18 @@ void mqttInit(TaskParams_t* params) {
                                                           #endif
 
   mqttClient.setServer(params->mqttBrokerIP, params->mqttBrokerPort); 
-  mqttClient.setSocketTimeout(3);  // Set 3 second timeout to prevent watchdog triggers
+  mqttClient.setSocketTimeout(3);  // Bounds reading a partly received packet in loop(); connects never wait on it (MqttTransport)
   mqttClient.setCallback(mqttCallback);
+  mqttClient.setBufferSize(MQTT_PACKET_BUFFER_SIZE); // Once, before the first connect
 
 
-  mqttQueue = xQueueCreate(10, sizeof(MqttMessage));
-  if (!mqttQueue) {
-    OledEnergyDisplay::showMonitorLine("MQT q fail");
-  }
-
-                                                          #ifdef DEBUG
-                                                          if (!mqttQueue) {
-                                                            Serial.println("MqttClient: MQTT queue creation failed!: MQTT broker IP: " + String(params->mqttBrokerIP) + ", port: " + String(params->mqttBrokerPort) );
-                                                          }
-                                                          #endif
+  mqttOutboundReady = true; // Static arenas (also mqttRxRing), nothing to allocate
+  mqttOfflineSinceMs = millis();
 
-  mqttRxQueue = xQueueCreate(6, sizeof(MqttRxMessage));
-  if (!mqttRxQueue) {
-    OledEnergyDisplay::showMonitorLine("MQT RX q fail");
-  }
+  mqttHistoryAvailable = mqttHistory.begin(MQTT_HISTORY_PARTITION_LABEL, MQTT_HISTORY_DROP_OLDEST);
 
                                                           #ifdef DEBUG
-                                                          if (!mqttRxQueue) {
-                                                            Serial.println("MqttClient: MQTT RX queue creation failed!: MQTT broker IP: " + String(params->mqttBrokerIP) + ", port: " + String(params->mqttBrokerPort) );
-                                                          }
+                                                          Serial.println("MqttClient: history buffer " + String(mqttHistoryAvailable ? "open, " + String(mqttHistory.pending()) + " samples pending" : "unavailable (no partition)"));
                                                           #endif
 
 }
@@ -261,72 +515,158 @@ void mqttInit(TaskParams_t* params) {
  *                  M Q T T   E N Q U E U E   P U B L I S H
  * ###################################################################################################
  */
-bool mqttEnqueuePublish(const char* topic, const char* payload, bool retain) {
-  if (!mqttQueue || isOtaInProgress()) return false;
-
-  MqttMessage msg{};
-  strncpy(msg.topic, topic, MQTT_TOPIC_LEN - 1);
-  strncpy(msg.payload, payload, MQTT_PAYLOAD_LEN - 1);
-  msg.retain = retain;
-
-  return xQueueSend(mqttQueue, &msg, 0) == pdTRUE;
+bool mqttEnqueuePublish(const char* topic, const char* payload, bool retain, MqttLane lane) {
+  if (!mqttOutboundReady || !topic || topic[0] == '\0' || !payload || isOtaInProgress()) return false;
+
+  size_t topicLength = strnlen(topic, MQTT_TOPIC_LEN - 1);
+  size_t payloadLength = strnlen(payload, MQTT_PAYLOAD_LEN - 1);
+  switch (lane) {
+    case MQTT_LANE_CONTROL:
+      return mqttControlLane.push(topic, topicLength, payload, payloadLength, retain);
+    case MQTT_LANE_BULK:
+      // Only the discovery task produces bulk messages; it may wait for the network task to drain
+      if (!mqttBulkLane.canReserve(topicLength, payloadLength)) {
+        mqttBulkLaneWaits = mqttBulkLaneWaits + 1;
+        uint32_t waitStartMs = millis();
+        while (!mqttBulkLane.canReserve(topicLength, payloadLength) && millis() - waitStartMs < MQTT_BULK_LANE_WAIT_MS) {
+          vTaskDelay(pdMS_TO_TICKS(10));
+        }
+      }
+      return mqttBulkLane.push(topic, topicLength, payload, payloadLength, retain);
+    default:
+      return mqttLogLane.push(topic, topicLength, payload, payloadLength, retain);
+  }
 }
 
-bool publishMqttLog(const char* topicSuffix, const char* message, bool retain) {
-  if (!topicSuffix || !message || !mqttQueue) {
+bool mqttEnqueuePublish(MqttTopicId topicId, const char* payload, bool retain) {
+  if (topicId >= MQTT_TOPIC_COUNT) {
     return false;
   }
+  return mqttEnqueuePublish(mqttTopic(topicId), payload, retain, mqttTopicDefinitions[topicId].lane);
+}
 
-  String topic = String(MQTT_PREFIX) + mqttDeviceNameWithMac;
-  if (topicSuffix[0] == '/') {
-    topic += topicSuffix;
-  } else {
-    topic += "/";
-    topic += topicSuffix;
+const char* mqttTopic(MqttTopicId topicId) {
+  return topicId < MQTT_TOPIC_COUNT ? mqttTopics[topicId] : "";
+}
+
+template <uint32_t Capacity>
+static int formatMqttLaneStats(char* buffer, size_t bufferSize, const char* name,
+                               const typename MqttRecordRing<Capacity>::Stats& stats) {
+  return snprintf(buffer, bufferSize, "%s:%lu/%lu/%lu/%lu/%lu ",
+                  name,
+                  (unsigned long)stats.enqueued,
+                  (unsigned long)stats.dropped,
+                  (unsigned long)stats.published,
+                  (unsigned long)stats.peakUsedBytes,
+                  (unsigned long)Capacity);
+}
+
+bool publishMqttOutboundStats() {
+  static uint32_t lastEnqueued = 0;
+  static uint32_t lastDropped = 0;
+  static uint32_t lastStored = 0;
+
+  MqttRecordRing<MQTT_CONTROL_LANE_BYTES>::Stats control = mqttControlLane.stats();
+  MqttRecordRing<MQTT_LOG_LANE_BYTES>::Stats log = mqttLogLane.stats();
+  MqttRecordRing<MQTT_BULK_LANE_BYTES>::Stats bulk = mqttBulkLane.stats();
+  portENTER_CRITICAL(&mqttStateSlotMux);
+  uint32_t statesStored = mqttStateSlot.stored;
+  uint32_t statesCoalesced = mqttStateSlot.coalesced;
+  portEXIT_CRITICAL(&mqttStateSlotMux);
+
+  uint32_t enqueued = control.enqueued + log.enqueued + bulk.enqueued;
+  uint32_t dropped = control.dropped + log.dropped + bulk.dropped;
+  if (enqueued == lastEnqueued && dropped == lastDropped && statesStored == lastStored) {
+    return false; // Nothing queued since the last report
   }
+  lastEnqueued = enqueued;
+  lastDropped = dropped;
+  lastStored = statesStored;
+
+  // Ring lanes as name:enqueued/dropped/published/peak_bytes/capacity_bytes
+  char logMsg[320] = {0};
+  size_t length = 0;
+  length += formatMqttLaneStats<MQTT_CONTROL_LANE_BYTES>(logMsg + length, sizeof(logMsg) - length, "control", control);
+  length += snprintf(logMsg + length, sizeof(logMsg) - length, "state:%lu/%lu ",
+                     (unsigned long)statesStored, (unsigned long)statesCoalesced);
+  length += formatMqttLaneStats<MQTT_LOG_LANE_BYTES>(logMsg + length, sizeof(logMsg) - length, "log", log);
+  length += formatMqttLaneStats<MQTT_BULK_LANE_BYTES>(logMsg + length, sizeof(logMsg) - length, "bulk", bulk);
+  snprintf(logMsg + length,
+           sizeof(logMsg) - length,
+           "bulk_waits:%lu history:%lu/%lu copied_bytes:%llu free_heap:%lu",
+           (unsigned long)mqttBulkLaneWaits,
+           (unsigned long)(mqttHistoryAvailable ? mqttHistory.pending() : 0),
+           (unsigned long)(mqttHistoryAvailable ? mqttHistory.dropped() : 0),
+           (unsigned long long)(control.copiedBytes + log.copiedBytes + bulk.copiedBytes),
+           (unsigned long)esp_get_free_heap_size());
+  return publishMqttLog(MQTT_TOPIC_LOG_MQTT_OUTBOUND, logMsg, RETAINED);
+}
 
+static bool publishMqttLogTo(const char* topic, const char* message, bool retain) {
   char timestamp[32] = {0};
   formatLogTimestamp(timestamp, sizeof(timestamp));
 
   char payload[MQTT_PAYLOAD_LEN] = {0};
   snprintf(payload, sizeof(payload), "%s - %s", timestamp, message);
 
-  return mqttEnqueuePublish(topic.c_str(), payload, retain);
+  return mqttEnqueuePublish(topic, payload, retain);
+}
+
+bool publishMqttLog(MqttTopicId topicId, const char* message, bool retain) {
+  if (!message || !mqttOutboundReady) {
+    return false;
+  }
+  return publishMqttLogTo(mqttTopic(topicId), message, retain);
+}
+
+bool publishMqttLog(const char* topicSuffix, const char* message, bool retain) {
+  if (!topicSuffix || !message || !mqttOutboundReady) {
+    return false;
+  }
+
+  // Interned: a suffix with a registry entry uses the prebuilt topic
+  const char* suffix = topicSuffix[0] == '/' ? topicSuffix + 1 : topicSuffix;
+  for (uint8_t id = 0; id < MQTT_TOPIC_COUNT; id++) {
+    if (!mqttTopicDefinitions[id].discovery && strcmp(mqttTopicDefinitions[id].suffix + 1, suffix) == 0) {
+      return publishMqttLogTo(mqttTopics[id], message, retain);
+    }
+  }
+
+  char topic[MQTT_TOPIC_LEN] = {0};
+  snprintf(topic, sizeof(topic), "%s%s/%s", MQTT_PREFIX, mqttDeviceNameWithMac.c_str(), suffix);
+  return publishMqttLogTo(topic, message, retain);
 }
 
 bool publishMqttLogStatus(const char* message, bool retain) {
-  return publishMqttLog(MQTT_LOG_STATUS_SUFFIX, message, retain);
+  return publishMqttLog(MQTT_TOPIC_LOG_STATUS, message, retain);
 }
 
 bool publishMqttLogEmail(const char* message, bool retain) {
-  return publishMqttLog(MQTT_LOG_EMAIL_SUFFIX, message, retain);
+  return publishMqttLog(MQTT_TOPIC_LOG_EMAIL, message, retain);
 }
 
 bool publishMqttSetCommand(const char* jsonPayload, bool retain) {
-  if (!jsonPayload || !mqttQueue || mqttDeviceNameWithMac.length() == 0) {
+  if (!jsonPayload || !mqttOutboundReady || mqttDeviceNameWithMac.length() == 0) {
     return false;
   }
-  String topic = String(MQTT_DISCOVERY_PREFIX) + mqttDeviceNameWithMac + "/" + MQTT_PREFIX + MQTT_SUFFIX_BUTTON;
-  return mqttEnqueuePublish(topic.c_str(), jsonPayload, retain);
+  return mqttEnqueuePublish(MQTT_TOPIC_BUTTON, jsonPayload, retain);
 }
 
                                                             #ifdef BOOT_DIAGNOSTICS_LOGGING
                                                             bool publishMqttResetReason(const char* message, bool retain) {
-                                                              if (!message || !mqttQueue) {
+                                                              if (!message || !mqttOutboundReady) {
                                                                 return false;
                                                               }
 
-                                                              String topic = String(MQTT_PREFIX) + mqttDeviceNameWithMac + MQTT_RESET_REASON_SUFFIX;
-                                                              return mqttEnqueuePublish(topic.c_str(), message, retain);
+                                                              return mqttEnqueuePublish(MQTT_TOPIC_RESET_REASON, message, retain);
                                                             }
 
                                                             bool publishMqttBootTime(const char* message, bool retain) {
-                                                              if (!message || !mqttQueue) {
+                                                              if (!message || !mqttOutboundReady) {
                                                                 return false;
                                                               }
 
-                                                              String topic = String(MQTT_PREFIX) + mqttDeviceNameWithMac + MQTT_LAST_BOOT_TIME_SUFFIX;
-                                                              return mqttEnqueuePublish(topic.c_str(), message, retain);
+                                                              return mqttEnqueuePublish(MQTT_TOPIC_LAST_BOOT_TIME, message, retain);
                                                             }
                                                             #endif
 
@@ -338,26 +678,171 @@ void mqttLoop(TaskParams_t* params) {
   if (mqttPaused) {
     return;  // Skip all MQTT operations when paused
   }
+
+  mqttHistoryTick(time(nullptr)); // Also while offline: that is what the buffer is for
   
-  if (!mqttClient.connected()) {
-    if (WiFi.status() != WL_CONNECTED || WiFi.localIP() == IPAddress(0, 0, 0, 0)) {
-      return;  // Do not attempt MQTT reconnect while WiFi is down or DHCP is not yet complete
-    }
-    reconnect(params);
+  if (!advanceMqttConnect(params)) {
+    return;  // Keep the lanes queued until the broker is back; full lanes drop per their policy
   }
 
   mqttClient.loop();
 
-  // Process outgoing messages
-  MqttMessage msg;
-  while (xQueueReceive(mqttQueue, &msg, 0) == pdTRUE) {
+  if (mqttDiscoveryRequested && !mqttPublishConfigJobQueued && mqttTriggerConfigurationPublishJob()) {
+    mqttDiscoveryRequested = false; // A request while the job is queued or running waits for it to finish
+  }
+
+  // Process outgoing messages by lane priority, published straight from the rings
+  publishMqttLane(mqttControlLane, UINT32_MAX);
+  publishMqttStateSlot();
+  publishMqttLane(mqttLogLane, UINT32_MAX);
+  replayMqttHistory();
+  publishMqttLane(mqttBulkLane, MQTT_BULK_RECORDS_PER_LOOP);
+}
+
+/* ###################################################################################################
+ *                  E N E R G Y   H I S T O R Y
+ * ###################################################################################################
+ *  A sample of Total and Forbrug is taken at every MQTT_HISTORY_SAMPLE_INTERVAL_S boundary of the
+ *  wall clock and published, not retained, to <device>/history as {"ts":<unix>,"Total":..,"Forbrug":..}.
+ *  While the broker is unreachable (or older samples are still waiting) samples go to the flash
+ *  buffer instead (MqttHistoryBuffer.h). After reconnecting they are replayed oldest first,
+ *  MQTT_HISTORY_REPLAY_BATCH every MQTT_HISTORY_REPLAY_INTERVAL_MS, so Home Assistant can backfill
+ *  the gap (Software/homeAssistant/config/automations_energy_history.yaml).
+ *  Without NTP time no samples are taken.
+ */
+static constexpr uint32_t MIN_VALID_UNIX_TIME = 1704067200; // 2024-01-01: the clock reads 1970 until NTP has synced
+
+static bool publishMqttHistorySample(const MqttHistorySample& sample) {
+  char payload[128];
+  int length = snprintf(payload, sizeof(payload), "{\"ts\":%lu,\"%s\":%llu.%03u,\"%s\":%lu.%03u}",
+                        (unsigned long)sample.timestamp,
+                        MQTT_NUMBER_ENERGY_ENTITYNAME,
+                        (unsigned long long)(sample.energyMilliWh / 1000000),
+                        (unsigned)(sample.energyMilliWh / 1000 % 1000),
+                        MQTT_SENSOR_POWER_ENTITYNAME,
+                        (unsigned long)(sample.powerW / 1000),
+                        (unsigned)(sample.powerW % 1000));
+  return mqttClient.publish(mqttTopic(MQTT_TOPIC_HISTORY), reinterpret_cast<const uint8_t*>(payload), (unsigned int)length, false);
+}
+
+void mqttHistoryTick(time_t now) {
+  static uint32_t lastBoundary = 0;
+
+  if (now < (time_t)MIN_VALID_UNIX_TIME) {
+    return; // Clock not set yet
+  }
+  uint32_t boundary = (uint32_t)now - (uint32_t)now % MQTT_HISTORY_SAMPLE_INTERVAL_S;
+  if (boundary == lastBoundary) {
+    return;
+  }
+  bool first = lastBoundary == 0;
+  lastBoundary = boundary;
+  if (first) {
+    return; // Joined mid-interval: wait for the next boundary
+  }
+
+  MqttHistorySample sample = {boundary, 0, 0};
+  uint64_t subtotalMilliWh = 0;
+  if (!getLatestEnergySnapshot(&sample.powerW, &sample.energyMilliWh, &subtotalMilliWh, nullptr)) {
+    return;
+  }
+  bool queued = mqttHistoryAvailable && mqttHistory.pending() > 0;
+  if (!queued && mqttSessionOnline() && publishMqttHistorySample(sample)) {
+    return;
+  }
+  if (mqttHistoryAvailable) {
+    mqttHistory.append(sample);
+  }
+}
+
+static void replayMqttHistory() {
+  static uint32_t lastReplayMs = 0;
+
+  if (!mqttHistoryAvailable || mqttHistory.pending() == 0 || millis() - lastReplayMs < MQTT_HISTORY_REPLAY_INTERVAL_MS) {
+    return;
+  }
+  lastReplayMs = millis();
+
+  MqttHistorySample sample;
+  for (uint8_t i = 0; i < MQTT_HISTORY_REPLAY_BATCH && mqttHistory.peek(&sample); i++) {
+    if (!publishMqttHistorySample(sample)) {
+      return; // Retried at the next interval
+    }
+    mqttHistory.markReplayed();
+  }
+}
+
+/* ###################################################################################################
+ *                  P U B L I S H   S T A T E   S L O T
+ * ###################################################################################################
+ *  The energy state bypasses the FIFO lanes. publishMqttEnergy() overwrites one slot with the newest
+ *  payload; here it is published right after the control lane, at most every MQTT_STATE_MIN_INTERVAL_MS,
+ *  or right away when power moved MQTT_STATE_SIGNIFICANT_POWER_W. Snapshots stored in between
+ *  replace each other, so a slow broker gets fewer, never stale, states and the log lane is not
+ *  crowded out. A failed publish leaves the slot pending for the next loop.
+ */
+static void publishMqttStateSlot() {
+  char payload[MQTT_STATE_PAYLOAD_LEN];
+  uint16_t payloadLength = 0;
+  uint32_t powerW = 0;
+  uint32_t sequence = 0;
+  uint32_t nowMs = millis();
+
+  portENTER_CRITICAL(&mqttStateSlotMux);
+  bool due = mqttStateSlot.pending &&
+             (mqttStateSlot.significant || !mqttStateSlot.published ||
+              nowMs - mqttStateSlot.publishedMs >= MQTT_STATE_MIN_INTERVAL_MS);
+  if (due) {
+    payloadLength = mqttStateSlot.payloadLength;
+    memcpy(payload, mqttStateSlot.payload, payloadLength + 1);
+    powerW = mqttStateSlot.powerW;
+    sequence = mqttStateSlot.sequence;
+  }
+  portEXIT_CRITICAL(&mqttStateSlotMux);
+
+  if (!due || !mqttSessionOnline()) {
+    return;
+  }
 
                                           #ifdef DEBUG
-                                          Serial.println("MqttClient: Publishing to topic: " + String(msg.topic) + " payload: " + String(msg.payload) + " retain: " + String(msg.retain) );
+                                          Serial.println("MqttClient: Publishing state: " + String(payload));
                                           #endif
 
-    mqttClient.publish(msg.topic, msg.payload, msg.retain);
+  if (!mqttClient.publish(mqttTopic(MQTT_TOPIC_STATE), reinterpret_cast<const uint8_t*>(payload), payloadLength, RETAINED)) {
+    return;
+  }
+
+  portENTER_CRITICAL(&mqttStateSlotMux);
+  mqttStateSlot.published = true;
+  mqttStateSlot.publishedPowerW = powerW;
+  mqttStateSlot.publishedMs = nowMs;
+  if (mqttStateSlot.sequence == sequence) {
+    mqttStateSlot.pending = false; // Otherwise a newer snapshot arrived while publishing
+    mqttStateSlot.significant = false;
+  }
+  portEXIT_CRITICAL(&mqttStateSlotMux);
+}
+
+static bool storeMqttState(const char* payload, size_t payloadLength, uint32_t powerW) {
+  if (payloadLength >= MQTT_STATE_PAYLOAD_LEN) {
+    return false;
   }
+  portENTER_CRITICAL(&mqttStateSlotMux);
+  if (mqttStateSlot.pending) {
+    mqttStateSlot.coalesced++;
+  }
+  memcpy(mqttStateSlot.payload, payload, payloadLength);
+  mqttStateSlot.payload[payloadLength] = '\0';
+  mqttStateSlot.payloadLength = (uint16_t)payloadLength;
+  mqttStateSlot.powerW = powerW;
+  mqttStateSlot.sequence++;
+  mqttStateSlot.stored++;
+  mqttStateSlot.pending = true;
+  uint32_t change = powerW > mqttStateSlot.publishedPowerW ? powerW - mqttStateSlot.publishedPowerW
+                                                           : mqttStateSlot.publishedPowerW - powerW;
+  mqttStateSlot.significant = mqttStateSlot.significant || change >= MQTT_STATE_SIGNIFICANT_POWER_W;
+  portEXIT_CRITICAL(&mqttStateSlotMux);
+  return true;
 }
 
 /* ###################################################################################################
@@ -365,7 +850,7 @@ void mqttLoop(TaskParams_t* params) {
  * ###################################################################################################
  */
 bool mqttIsConnected() {
-  return mqttClient.connected();
+  return mqttSessionOnline();
 }
 
 /* ###################################################################################################
@@ -384,7 +869,6 @@ void publish_sketch_version(TaskParams_t* params)   // Publish only once at ever
   IPAddress ip = WiFi.localIP();
   char timestamp[32] = {0};
   formatLogTimestamp(timestamp, sizeof(timestamp));
-  String versionTopic = String(MQTT_PREFIX) + mqttDeviceNameWithMac + MQTT_SKETCH_VERSION;
   String versionMessage = String(params->sketchVersion + String("\nConnected to SSID: \'") +\
                                   String(params->wifiSSID) + String("\' at: ") +\
                                   String(ip[0]) + String(".") +\
@@ -396,7 +880,7 @@ void publish_sketch_version(TaskParams_t* params)   // Publish only once at ever
                                   String(params->mqttBrokerIP) + String(":") + String(params->mqttBrokerPort) +\
                                   String("\nBooted at: ") + String(bootTimestamp));
 
-  mqttEnqueuePublish(versionTopic.c_str(), versionMessage.c_str(), RETAINED);
+  mqttEnqueuePublish(MQTT_TOPIC_SKETCH_VERSION, versionMessage.c_str(), RETAINED);
 }
 
 /* ###################################################################################################
@@ -422,6 +906,16 @@ void initializeMQTTGlobals()
   if (mqttClientWithMac.length() > 23) {
     mqttClientWithMac = mqttClientWithMac.substring(0, 23);
   }
+
+  // Topic registry: every fixed topic once, so publishers never build one again
+  for (uint8_t id = 0; id < MQTT_TOPIC_COUNT; id++) {
+    const MqttTopicDefinition& definition = mqttTopicDefinitions[id];
+    if (definition.discovery) {
+      snprintf(mqttTopics[id], MQTT_TOPIC_LEN, "%s%s/%s%s", MQTT_DISCOVERY_PREFIX, mqttDeviceNameWithMac.c_str(), MQTT_PREFIX, definition.suffix);
+    } else {
+      snprintf(mqttTopics[id], MQTT_TOPIC_LEN, "%s%s%s", MQTT_PREFIX, mqttDeviceNameWithMac.c_str(), definition.suffix);
+    }
+  }
 }
 
 /* ###################################################################################################
@@ -430,137 +924,183 @@ void initializeMQTTGlobals()
  *  This function is called, when a subscribed topic receives a message.
  */
 void mqttCallback(char* topic, byte* payload, unsigned int length) {
-  if (!mqttRxQueue || !topic || !payload || length == 0) {
+  if (!topic || !payload || length == 0) {
     return;
   }
 
-  MqttRxMessage msg{};
-  strncpy(msg.topic, topic, MQTT_TOPIC_LEN - 1);
-
   if (length >= MQTT_PAYLOAD_LEN) {
     length = MQTT_PAYLOAD_LEN - 1;
+    mqttRxTruncated++;
   }
-  memcpy(msg.payload, payload, length);
-  msg.payload[length] = '\0';
-  msg.length = static_cast<uint16_t>(length);
+  // Copied once into the ring; dropped and counted when mqttProcessRxQueue() has fallen behind
+  mqttRxRing.push(topic, strnlen(topic, MQTT_TOPIC_LEN - 1), reinterpret_cast<const char*>(payload), length, false);
+}
+
+/* ###################################################################################################
+ *                  S E T   C O M M A N D S
+ * ###################################################################################################
+ *  One handler per JSON key accepted on <device>/set. To add a command, add a handler and a row to
+ *  mqttSetCommands; MqttSetTable (MqttSetCommand.h) builds the key lookup at compile time.
+ */
+static void onSetEnergyTotal(const MqttSetValue& value) {
+  double newEnergyValue = value.asDouble();
+                                                                    #ifdef HEADLESS_DEBUG
+                                                                      OledEnergyDisplay::showMonitorLine("Set kWh: " + String(newEnergyValue, 2));
+                                                                    #endif
+
+                                                                    #ifdef DEBUG
+                                                                    Serial.print("MqttClient: Setting new energy value to: ");
+                                                                    Serial.println(newEnergyValue);
+                                                                    #endif
 
-  xQueueSend(mqttRxQueue, &msg, 0);
+  if (mqttParams != nullptr) {
+    uint64_t newEnergyMilliWh = newEnergyValue > 0.0 ? (uint64_t)(newEnergyValue * (double)MILLI_WH_PER_KWH + 0.5) : 0;
+    setPulseCounterFromMqtt(milliWhToPulses(newEnergyMilliWh, mqttParams->pulse_per_kWh));
+  }
 }
 
-void mqttProcessRxQueue() {
-  if (!mqttRxQueue) {
-    return;
+static void onSetSubtotalReset(const MqttSetValue& value) {
+  bool reset = false;
+  if (value.toBool(reset) && reset) {
+    requestSubtotalReset();
   }
+}
 
-  MqttRxMessage msg;
-  while (xQueueReceive(mqttRxQueue, &msg, 0) == pdTRUE) {
-    JsonDocument doc;
-    String topicString = String(msg.topic);
+static void onSetSmartCharging(const MqttSetValue& value) {
+  bool activated = false;
+  if (value.toBool(activated)) {
+    gSmartChargingActivated = activated;
+    gDisplayUpdateAvailable = true; // Trigger display update
+  } else {
+    OledEnergyDisplay::showMonitorLine("smartChg invalid");
+  }
+}
+
+static void onSetChargingStartTime(const MqttSetValue& value) {
+  if (value.asText()) {
+    strncpy(gChargingStartTime, value.asText(), sizeof(gChargingStartTime) - 1);
+    gChargingStartTime[sizeof(gChargingStartTime) - 1] = '\0'; // Ensure null-termination
+    gDisplayUpdateAvailable = true; // Trigger display update
+  }
+}
+
+static void onSetMaxEnergyPrice(const MqttSetValue& value) {
+  gEnergyPriceRef = value.asFloat();
+  gDisplayUpdateAvailable = true; // Trigger display update
+}
+
+static void onSetEnergyPriceLimit(const MqttSetValue& value) {
+  gEnergyPriceLimit = value.asFloat();
+  gDisplayUpdateAvailable = true; // Trigger display update
+}
+
+static void onSetReset(const MqttSetValue& value) {
+  if (value.textEquals("soft")) {
+    requestReset(RESET_SOFT);
+  } else if (value.textEquals("hard")) {
+    requestReset(RESET_HARD);
+  }
+}
+
+static constexpr MqttSetCommand mqttSetCommands[] = {
+  {MQTT_NUMBER_ENERGY_ENTITYNAME, onSetEnergyTotal},
+  {MQTT_SENSOR_ENERGY_ENTITYNAME, onSetSubtotalReset},
+  {MQTT_SMART_CHG,                onSetSmartCharging},
+  {MQTT_CHG_START_TIME,           onSetChargingStartTime},
+  {MQTT_MAX_E_PRICE,              onSetMaxEnergyPrice},
+  {MQTT_E_PRICE_LIMIT,            onSetEnergyPriceLimit},
+  {MQTT_RESET_CMD,                onSetReset},
+};
+typedef MqttSetTable<MQTT_SET_COMMAND_COUNT(mqttSetCommands), mqttSetCommands> MqttSetCommandTable;
+
+// MQTT_PREFIX + <anything> + MQTT_SUFFIX_SET
+static bool isSetTopic(const char* topic) {
+  const size_t prefixLength = sizeof(MQTT_PREFIX) - 1;
+  const size_t suffixLength = sizeof(MQTT_SUFFIX_SET) - 1;
+  const size_t topicLength = strlen(topic);
+  return topicLength >= prefixLength + suffixLength && strncmp(topic, MQTT_PREFIX, prefixLength) == 0 &&
+         strcmp(topic + topicLength - suffixLength, MQTT_SUFFIX_SET) == 0;
+}
+
+static void handleMqttRxMessage(const MqttRecordRing<MQTT_RX_RING_BYTES>::Record& msg) {
 
                                                                     #ifdef HEADLESS_DEBUG
-                                                                      OledEnergyDisplay::showMonitorLine("RX: " + topicString);
+                                                                      OledEnergyDisplay::showMonitorLine("RX: " + String(msg.topic));
                                                                     #endif
 
                                                                     #ifdef DEBUG
                                                                     Serial.print("MqttClient: Message arrived [");
-                                                                    Serial.print(topicString);
+                                                                    Serial.print(msg.topic);
                                                                     Serial.print("] Payload: ");
                                                                     Serial.println(msg.payload);
                                                                     #endif
 
-    if (topicString == MQTT_TESLAMATE_PLUGGED_IN_TOPIC) {
-      const bool isTrueText = (strcmp(msg.payload, "true") == 0 || strcmp(msg.payload, "True") == 0);
-      if (isTrueText) {
-        OledTouchWake::armDisplayOnTimer();
-        if (!OledEnergyDisplay::isOn()) {
-          OledEnergyDisplay::turnOn();
-        }
-        OledEnergyDisplay::setMode(OledEnergyDisplay::Mode::Energy);
+  if (strcmp(msg.topic, MQTT_TESLAMATE_PLUGGED_IN_TOPIC) == 0) {
+    const bool isTrueText = (strcmp(msg.payload, "true") == 0 || strcmp(msg.payload, "True") == 0);
+    if (isTrueText) {
+      OledTouchWake::armDisplayOnTimer();
+      if (!OledEnergyDisplay::isOn()) {
+        OledEnergyDisplay::turnOn();
       }
-      continue;
+      OledEnergyDisplay::setMode(OledEnergyDisplay::Mode::Energy);
     }
+    return;
+  }
+
+  if (strcmp(msg.topic, MQTT_DISCOVERY_STATUS_TOPIC) == 0) {
+    const MqttHomeAssistantStatus status = strcmp(msg.payload, "online") == 0 ? HA_STATUS_ONLINE : HA_STATUS_OFFLINE;
+    if (status == HA_STATUS_ONLINE && mqttHomeAssistantStatus != HA_STATUS_ONLINE) {
+      mqttDiscoveryRequested = true; // Home Assistant (re)started: it may have lost the retained configurations
+    }
+    mqttHomeAssistantStatus = status;
+    return;
+  }
 
-    if (topicString.startsWith(MQTT_PREFIX) && topicString.endsWith(MQTT_SUFFIX_SET)) {
-      DeserializationError error = deserializeJson(doc, msg.payload, msg.length);
-      if (error) {
-        OledEnergyDisplay::showMonitorLine("JSON fail: " + String(error.c_str()));
+  if (isSetTopic(msg.topic)) {
+    MqttSetError error = MqttSetCommandTable::dispatch(msg.payload, msg.payloadLength);
+    if (error) {
+      OledEnergyDisplay::showMonitorLine("JSON fail: " + String(error.c_str()));
                                                                     #ifdef DEBUG
                                                                     Serial.print("MqttClient: JSON deserialization failed: ");
                                                                     Serial.println(error.c_str());
                                                                     #endif
-        continue;
-      }
-
-      for (JsonPair kv : doc.as<JsonObject>()) {
-        const char* key = kv.key().c_str();
-        const char* valueText = kv.value().as<const char*>();
-
-                                                                    #ifdef HEADLESS_DEBUG
-                                                                      OledEnergyDisplay::showMonitorLine("Cmd: " + String(key ? key : "?"));
-                                                                      OledEnergyDisplay::showMonitorLine("Val: " + String(valueText ? valueText : "(n/t)"));
-                                                                    #endif
-
-                                                                    #ifdef DEBUG
-                                                                    Serial.print("MqttClient: Processing command - Key: ");
-                                                                    Serial.print(key ? key : "(null)");
-                                                                    Serial.print(", Value: ");
-                                                                    Serial.println(valueText ? valueText : "(non-text)");
-                                                                    #endif
-
-        bool parsedBoolValue = false;
-        const bool hasBoolValue = tryParseJsonBool(kv.value(), parsedBoolValue);
-        bool isTrueText = hasBoolValue ? parsedBoolValue : false;
+    }
+  }
+}
 
-        if (strcmp(key, MQTT_NUMBER_ENERGY_ENTITYNAME) == 0) {
-          float newEnergyValue = kv.value().as<float>();
-                                                                    #ifdef HEADLESS_DEBUG
-                                                                      OledEnergyDisplay::showMonitorLine("Set kWh: " + String(newEnergyValue, 2));
-                                                                    #endif
+void mqttProcessRxQueue() {
+  // Handled in place; the record is released only afterwards, so the callback cannot overwrite it
+  MqttRecordRing<MQTT_RX_RING_BYTES>::Record msg;
+  while (mqttRxRing.peek(&msg)) {
+    handleMqttRxMessage(msg);
+    mqttRxRing.release();
+  }
+}
 
-                                                                    #ifdef DEBUG
-                                                                    Serial.print("MqttClient: Setting new energy value to: ");
-                                                                    Serial.println(newEnergyValue);
-                                                                    #endif
+bool publishMqttInboundStats() {
+  static uint32_t lastReceived = 0;
+  static uint32_t lastDropped = 0;
+  static uint32_t lastProcessed = 0;
 
-          if (mqttParams != nullptr) {
-            uint32_t newPulseCounter = (uint32_t)(newEnergyValue * mqttParams->pulse_per_kWh + 0.5f);
-            setPulseCounterFromMqtt(newPulseCounter);
-          }
-        } else if (strcmp(key, MQTT_SENSOR_ENERGY_ENTITYNAME) == 0) {
-          if (isTrueText) {
-            requestSubtotalReset();
-          }
-        } else if (strcmp(key, MQTT_SMART_CHG) == 0) {
-          if (hasBoolValue) {
-            gSmartChargingActivated = parsedBoolValue;
-            gDisplayUpdateAvailable = true; // Trigger display update
-          } else {
-            OledEnergyDisplay::showMonitorLine("smartChg invalid");
-          }
-        } else if (strcmp(key, MQTT_CHG_START_TIME) == 0) {
-          if (valueText) {
-            strncpy(gChargingStartTime, valueText, sizeof(gChargingStartTime) - 1);
-            gChargingStartTime[sizeof(gChargingStartTime) - 1] = '\0'; // Ensure null-termination
-            gDisplayUpdateAvailable = true; // Trigger display update
-          }
-        } else if (strcmp(key, MQTT_MAX_E_PRICE) == 0) {
-          gEnergyPriceRef = kv.value().as<float>();
-          gDisplayUpdateAvailable = true; // Trigger display update
-        } else if (strcmp(key, MQTT_E_PRICE_LIMIT) == 0) {
-          gEnergyPriceLimit = kv.value().as<float>();
-          gDisplayUpdateAvailable = true; // Trigger display update
-        } else if (strcmp(key, MQTT_RESET_CMD) == 0) {
-          if (valueText) {
-            if (strcmp(valueText, "soft") == 0) {
-              requestReset(RESET_SOFT);
-            } else if (strcmp(valueText, "hard") == 0) {
-              requestReset(RESET_HARD);
-            }
-          }
-        }
-      }
-    }
+  MqttRecordRing<MQTT_RX_RING_BYTES>::Stats rx = mqttRxRing.stats();
+  if (rx.enqueued == lastReceived && rx.dropped == lastDropped && rx.published == lastProcessed) {
+    return false; // Nothing received or handled since the last report
   }
+  lastReceived = rx.enqueued;
+  lastDropped = rx.dropped;
+  lastProcessed = rx.published;
+
+  char logMsg[160] = {0};
+  snprintf(logMsg,
+           sizeof(logMsg),
+           "received:%lu dropped:%lu truncated:%lu processed:%lu peak_bytes:%lu capacity_bytes:%lu",
+           (unsigned long)rx.enqueued,
+           (unsigned long)rx.dropped,
+           (unsigned long)mqttRxTruncated,
+           (unsigned long)rx.published,
+           (unsigned long)rx.peakUsedBytes,
+           (unsigned long)MQTT_RX_RING_BYTES);
+  return publishMqttLog(MQTT_TOPIC_LOG_MQTT_INBOUND, logMsg, RETAINED);
 }
 
 /* ###################################################################################################
@@ -588,59 +1128,43 @@ void mqttResume() {
 
 /*
  * ###################################################################################################
- *              P U B L I S H   M Q T T   E N E R G Y   C O N F I G U R A T I O N
+ *                       B U I L D   M Q T T   D I S C O V E R Y   C A C H E
  * ###################################################################################################
- * 
- * component can take the values: "sensor" or "number"
- * device_class can take the values "energy" or "power"
 */
-void publishMqttEnergyConfigJson( String component, String entityName, String unitOfMeasurement, String deviceClass)
-{
-  char payload[1024];
-  JsonDocument doc;
-
-  if ( component == MQTT_NUMBER_COMPONENT & deviceClass == MQTT_ENERGY_DEVICECLASS)
-  {
-    doc["command_topic"] = String(MQTT_PREFIX) + mqttDeviceNameWithMac + MQTT_SUFFIX_SET;
-    doc["command_template"] = String("{\"" + entityName + "\": {{ value }} }");
-    doc["max"] = 99999.99;
-    doc["min"] = 0.0;
-    doc["step"] = 0.01;
+static void buildMqttDiscoveryCache() {
+  const MqttDiscoveryDevice device = {
+    mqttDeviceNameWithMac.c_str(),
+    MQTT_HA_CARD_NAME,
+    mqttTopic(MQTT_TOPIC_STATE),
+    mqttTopic(MQTT_TOPIC_ONLINE),
+    mqttTopic(MQTT_TOPIC_SET),
+  };
+
+  char* p = mqttDiscoveryArena;
+  mqttDiscoveryHash = 2166136261u;
+  for (size_t i = 0; i < MqttDiscoveryConfigTable::COUNT; ++i) {
+    size_t topicLength = MqttDiscoveryConfigTable::writeTopic(p, i, device.name);
+    mqttDiscoveryConfigs[i].topic = p;
+    mqttDiscoveryHash = hashMqttDiscovery(mqttDiscoveryHash, p, topicLength);
+    p += topicLength + 1;
+
+    size_t payloadLength = MqttDiscoveryConfigTable::writePayload(p, i, device);
+    mqttDiscoveryConfigs[i].payload = p;
+    mqttDiscoveryHash = hashMqttDiscovery(mqttDiscoveryHash, p, payloadLength);
+    p += payloadLength + 1;
   }
-  doc["name"] = entityName;
-  doc["state_topic"] = String(MQTT_DISCOVERY_PREFIX) + mqttDeviceNameWithMac + "/" + MQTT_PREFIX + MQTT_SUFFIX_STATE;
-  doc["availability_topic"] = String(MQTT_PREFIX) + mqttDeviceNameWithMac + MQTT_ONLINE;
-  doc["payload_available"] = "True";
-  doc["payload_not_available"] = "False";
-  doc["device_class"] = deviceClass;
-  doc["unit_of_measurement"] = unitOfMeasurement;
-  doc["unique_id"] = String(entityName + "_" + mqttDeviceNameWithMac);
-  doc["qos"] = 0;
-
-  if ( component == MQTT_SENSOR_COMPONENT & deviceClass == MQTT_POWER_DEVICECLASS)
-    doc["value_template"] = String("{{ value_json." + entityName + "}}");
-  else 
-    doc["value_template"] = String("{{ value_json." + entityName + " | round(2)}}");
-
-  // Suggested by GPT-5.2
-  /* 
-  JsonObject device = doc.createNestedObject("device");
-  JsonArray identifiers = device.createNestedArray("identifiers");
-  identifiers.add(String("meter_0"));
-  device["name"] = String("Energi - EV ESP32 Monitor");
 
-  Previously used code for device object
-  */
-  JsonObject device = doc["device"].to<JsonObject>();
-
-  device["identifiers"][0] = String(mqttDeviceNameWithMac);
-  device["name"] = String(MQTT_HA_CARD_NAME);
-
-  serializeJson(doc, payload, sizeof(payload));
-  String energyTopic = String(MQTT_DISCOVERY_PREFIX) + component + "/" + mqttDeviceNameWithMac + "/" + deviceClass + "/config";
-
-  mqttEnqueuePublish(energyTopic.c_str(), payload, RETAINED);
+  Preferences pref;
+  pref.begin(MQTT_NVS_NAMESPACE, true);
+  mqttDiscoveryStoredHash = pref.getUInt("disc_hash", 0);
+  pref.end();
 
+                                                          #ifdef DEBUG
+                                                          Serial.printf("MqttClient: %u discovery configurations cached, %u of %u bytes, hash %08lx, stored %08lx\n",
+                                                                        (unsigned)MqttDiscoveryConfigTable::COUNT, (unsigned)(p - mqttDiscoveryArena),
+                                                                        (unsigned)sizeof(mqttDiscoveryArena),
+                                                                        (unsigned long)mqttDiscoveryHash, (unsigned long)mqttDiscoveryStoredHash);
+                                                          #endif
 }
 
 /*
@@ -649,45 +1173,59 @@ void publishMqttEnergyConfigJson( String component, String entityName, String un
  * ###################################################################################################
 */
 void publishMqttConfigurations() {
+  const uint32_t hash = mqttDiscoveryHash;
+  bool queued = true;
+  for (size_t i = 0; i < MqttDiscoveryConfigTable::COUNT; ++i) {
+    queued &= mqttEnqueuePublish(mqttDiscoveryConfigs[i].topic, mqttDiscoveryConfigs[i].payload, RETAINED, MQTT_LANE_BULK);
+  }
 
-  publishMqttEnergyConfigJson(MQTT_SENSOR_COMPONENT, MQTT_SENSOR_ENERGY_ENTITYNAME, "kWh", MQTT_ENERGY_DEVICECLASS);
-  publishMqttEnergyConfigJson(MQTT_SENSOR_COMPONENT, MQTT_SENSOR_POWER_ENTITYNAME, "kW", MQTT_POWER_DEVICECLASS);
-  publishMqttEnergyConfigJson(MQTT_NUMBER_COMPONENT, MQTT_NUMBER_ENERGY_ENTITYNAME, "kWh", MQTT_ENERGY_DEVICECLASS);
-
-  float powerW = 0.0f;
-  float energyKwh = 0.0f;
-  float subtotalKwh = 0.0f;
-  if (getLatestEnergySnapshot(&powerW, &energyKwh, &subtotalKwh)) {
-    publishMqttEnergy(powerW, energyKwh, subtotalKwh);
+  // Queued records survive a lost connection, so the broker will have them
+  if (queued && hash != mqttDiscoveryStoredHash) {
+    Preferences pref;
+    pref.begin(MQTT_NVS_NAMESPACE, false);
+    pref.putUInt("disc_hash", hash);
+    pref.end();
+    mqttDiscoveryStoredHash = hash;
   }
 
+  char logMsg[96] = {0};
+  snprintf(logMsg, sizeof(logMsg), "Discovery: %u configurations %s, hash %08lx",
+           (unsigned)MqttDiscoveryConfigTable::COUNT, queued ? "published" : "not all queued", (unsigned long)hash);
+  publishMqttLog(MQTT_TOPIC_LOG, logMsg, RETAINED);
 }
 
 /* ###################################################################################################
  *                  P U B L I S H   M Q T T   E N E R G Y
  * ###################################################################################################
 */
-void publishMqttEnergy(float powerW, float pulseCounter, float subtotalPulseCounter)
+bool publishMqttEnergy(uint32_t powerW, uint32_t instantPowerW, uint64_t energyMilliWh, uint64_t subtotalMilliWh)
 {
   if (isOtaInProgress()) {
-    return; // Skip energy publish and display update trigger during OTA
+    return false; // Skip energy publish and display update trigger during OTA
   }
 
   gDisplayUpdateAvailable = true;
 
-  if (!mqttClient.connected()) {
-    return; // Exit if MQTT is not connected
+  // Stored even while MQTT is disconnected: the newest state goes out first after reconnecting
+  // Fixed-point values become kW / kWh here, the units announced in discovery
+  const double values[EnergyStateJson::KEY_COUNT] = {
+    wattsToKw(powerW),
+    wattsToKw(instantPowerW),
+    milliWhToKwh(energyMilliWh),
+    milliWhToKwh(subtotalMilliWh),
+  };
+
+  char payload[MQTT_STATE_PAYLOAD_LEN];
+  if (EnergyStateJson::fits(values)) {
+    return storeMqttState(payload, EnergyStateJson::write(payload, values), powerW);
   }
-  
-  char payload[256];
-  JsonDocument doc;
-
-  doc[MQTT_SENSOR_POWER_ENTITYNAME] = powerW;
-  doc[MQTT_NUMBER_ENERGY_ENTITYNAME] = (float)pulseCounter;
-  doc[MQTT_SENSOR_ENERGY_ENTITYNAME] = (float)subtotalPulseCounter;
 
-  serializeJson(doc, payload, sizeof(payload));
-  String energyTopic = String(MQTT_DISCOVERY_PREFIX) + mqttDeviceNameWithMac + "/" + MQTT_PREFIX + MQTT_SUFFIX_STATE;
+  // Exponent range (>= 1e7 kWh): ArduinoJson formats it
+  JsonDocument doc;
+  doc[MQTT_SENSOR_POWER_ENTITYNAME] = values[0];
+  doc[MQTT_SENSOR_INSTANT_POWER_ENTITYNAME] = values[1];
+  doc[MQTT_NUMBER_ENERGY_ENTITYNAME] = values[2];
+  doc[MQTT_SENSOR_ENERGY_ENTITYNAME] = values[3];
 
-  mqttEnqueuePublish(energyTopic.c_str(), payload, RETAINED);
+  return storeMqttState(payload, serializeJson(doc, payload, sizeof(payload)), powerW);
 } 
\ No newline at end of file
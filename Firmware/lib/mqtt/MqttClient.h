@@ -16,6 +16,8 @@ constexpr char MQTT_LOG_STATUS_SUFFIX[]         = "/log/status";        // MQTT
 constexpr char MQTT_LOG_EMAIL_SUFFIX[]          = "/log/email";         // MQTT topic suffix for email-routed logs. Include leading '/'
 constexpr char MQTT_SENSOR_ENERGY_ENTITYNAME[]  = "Subtotal";           // name dislayed in HA device. No special chars, no spaces
 constexpr char MQTT_SENSOR_POWER_ENTITYNAME[]   = "Forbrug";            // name dislayed in HA device. No special chars, no spaces
+constexpr char MQTT_SENSOR_INSTANT_POWER_ENTITYNAME[] = "Momentan";     // name dislayed in HA device. No special chars, no spaces. Power from the last pulse interval only
+constexpr char MQTT_INSTANT_POWER_OBJECT_ID[]   = "power_instant";      // Discovery object id for the instantaneous power sensor ("power" is taken by Forbrug)
 constexpr char MQTT_NUMBER_ENERGY_ENTITYNAME[]  = "Total";              // name dislayed in HA device. No special chars, no spaces
 constexpr char MQTT_SMART_CHG[]                 = "smartChg";           // JSON key for smart charging activation command
 constexpr char MQTT_CHG_START_TIME[]            = "chgStartTime";       // JSON key for charging start time
@@ -26,10 +28,8 @@ constexpr char MQTT_RESET_CMD[]                 = "reset";               // JSON
 constexpr char MQTT_DISCOVERY_PREFIX[]          = "homeassistant/";     // include tailing '/' in discovery prefix!
 constexpr char MQTT_SUFFIX_STATE[]              = "state";              // MQTT topic suffix for state messages. OBS no leading '/'
 
-                                                                        #ifdef BOOT_DIAGNOSTICS_LOGGING
-                                                                        constexpr char MQTT_RESET_REASON_SUFFIX[]       = "/reset_reason";      // MQTT topic suffix for last reset reason (retained). Include leading '/'
-                                                                        constexpr char MQTT_LAST_BOOT_TIME_SUFFIX[]     = "/last_boot_time";    // MQTT topic suffix for last boot time (retained). Include leading '/'
-                                                                        #endif
+constexpr char MQTT_RESET_REASON_SUFFIX[]       = "/reset_reason";      // MQTT topic suffix for last reset reason (retained, BOOT_DIAGNOSTICS_LOGGING). Include leading '/'
+constexpr char MQTT_LAST_BOOT_TIME_SUFFIX[]     = "/last_boot_time";    // MQTT topic suffix for last boot time (retained, BOOT_DIAGNOSTICS_LOGGING). Include leading '/'
 
 /*  MQTT publication definitions
  *  These definitions are used when publishing MQTT messages.
@@ -39,6 +39,7 @@ const bool    RETAINED                      = true;                 // MQTT reta
 constexpr char MQTT_SUFFIX_SET[]            = "/set";               // MQTT topic suffix for set commands. Include leading '/'  
 constexpr char MQTT_SUFFIX_BUTTON[]         = "button";            // MQTT topic suffix for button commands. Include leading '/'
 constexpr char MQTT_TESLAMATE_PLUGGED_IN_TOPIC[] = "teslamate/cars/1/plugged_in"; // TeslaMate topic for plugged-in state
+constexpr char MQTT_DISCOVERY_STATUS_TOPIC[] = "homeassistant/status"; // Home Assistant birth and last will ("online" / "offline"). Same prefix as MQTT_DISCOVERY_PREFIX
 
 
 
@@ -51,6 +52,55 @@ constexpr char MQTT_NUMBER_COMPONENT[]      = "number";
 constexpr char MQTT_ENERGY_DEVICECLASS[]    = "energy";
 constexpr char MQTT_POWER_DEVICECLASS[]     = "power";
 
+/*  Topic registry
+ *  Every topic the device publishes or subscribes to under its own name, built once in
+ *  initializeMQTTGlobals() into fixed buffers and referred to by id, so publishing does no String
+ *  or heap work. MqttClient.cpp holds the suffix of each id (same order).
+ *  Device topics:    MQTT_PREFIX + <device> + suffix                          (ev-e-monitor/<device>/log/status)
+ *  Discovery topics: MQTT_DISCOVERY_PREFIX + <device> + "/" + MQTT_PREFIX + suffix (homeassistant/<device>/ev-e-monitor/state)
+*/
+enum MqttTopicId : uint8_t {
+  MQTT_TOPIC_STATE = 0,             // Discovery: energy state JSON
+  MQTT_TOPIC_BUTTON,                // Discovery: set commands from the push-buttons
+  MQTT_TOPIC_ONLINE,
+  MQTT_TOPIC_SET,
+  MQTT_TOPIC_SKETCH_VERSION,
+  MQTT_TOPIC_LOG,
+  MQTT_TOPIC_LOG_STATUS,
+  MQTT_TOPIC_LOG_EMAIL,
+  MQTT_TOPIC_LOG_PULSE_CPU,
+  MQTT_TOPIC_LOG_PULSE_OVERFLOW,
+  MQTT_TOPIC_LOG_LATENCY_PULSE,
+  MQTT_TOPIC_LOG_MQTT_OUTBOUND,
+  MQTT_TOPIC_LOG_MQTT_INBOUND,
+  MQTT_TOPIC_LOG_MQTT_CONNECT,
+  MQTT_TOPIC_LOG_CHARGING_ENERGY,   // CT and meter energy of the charging session
+  MQTT_TOPIC_LOG_WORKER,            // Worker pool jobs per lane (WorkerPool.h)
+  MQTT_TOPIC_LOG_STACK_LOOP,
+  MQTT_TOPIC_LOG_STACK_NETWORK,
+  MQTT_TOPIC_LOG_STACK_WIFI_CONNECTION,
+  MQTT_TOPIC_LOG_STACK_PULSE_INPUT,
+  MQTT_TOPIC_LOG_STACK_TESLA_TELEMETRY,
+  MQTT_TOPIC_LOG_STACK_CONFIGURATION,
+  MQTT_TOPIC_LOG_STACK_BUTTON_PUBLISH,
+  MQTT_TOPIC_RESET_REASON,          // BOOT_DIAGNOSTICS_LOGGING
+  MQTT_TOPIC_LAST_BOOT_TIME,        // BOOT_DIAGNOSTICS_LOGGING
+  MQTT_TOPIC_HISTORY,               // Energy samples, live or replayed after an outage
+  MQTT_TOPIC_COUNT
+};
+
+/*
+ * Outbound priority lanes (see config.h). mqttLoop() publishes the control lane, then the energy
+ * state slot (publishMqttEnergy()), then the log lane and finally MQTT_BULK_RECORDS_PER_LOOP
+ * records of the bulk lane.
+*/
+enum MqttLane : uint8_t {
+  MQTT_LANE_CONTROL = 0,            // Availability, set commands
+  MQTT_LANE_LOG,                    // Logs and diagnostics
+  MQTT_LANE_BULK,                   // Discovery configurations
+  MQTT_LANE_COUNT
+};
+
 /*
  * ##################################################################################################
  * ##################################################################################################
@@ -63,17 +113,23 @@ constexpr char MQTT_POWER_DEVICECLASS[]     = "power";
 
 void publish_sketch_version(TaskParams_t* params);
 void initializeMQTTGlobals();
-bool mqttEnqueuePublish(const char* topic, const char* payload, bool retain);
+bool mqttEnqueuePublish(const char* topic, const char* payload, bool retain, MqttLane lane = MQTT_LANE_LOG);
+bool mqttEnqueuePublish(MqttTopicId topicId, const char* payload, bool retain); // Lane from the topic registry
+const char* mqttTopic(MqttTopicId topicId); // "" until initializeMQTTGlobals() has run
+bool publishMqttOutboundStats(); // Publish retained to <device>/log/mqtt/outbound (per lane) when messages were queued since the last report
+bool publishMqttInboundStats();  // Publish retained to <device>/log/mqtt/inbound (RX ring) when messages were received or handled since the last report
 void mqttInit( TaskParams_t* params );
 void mqttLoop( TaskParams_t* params );
+void mqttHistoryTick(time_t now); // Called by mqttLoop() with time(nullptr): samples at every MQTT_HISTORY_SAMPLE_INTERVAL_S boundary
 void mqttProcessRxQueue();
 void mqttCallback(char*, byte*, unsigned int);
 void mqttPause();
 void mqttResume();
 
-void publishMqttConfigurations();
-void publishMqttEnergy(float, float, float);
-bool publishMqttLog(const char* topicSuffix, const char* message, bool retain = false);
+void publishMqttConfigurations(); // Queue the cached discovery configurations (blocks while the bulk lane is full) and store their hash in NVS
+bool publishMqttEnergy(uint32_t, uint32_t, uint64_t, uint64_t); // powerW (smoothed), instantPowerW, energyMilliWh, subtotalMilliWh. true when stored in the state slot, which mqttLoop() publishes at most every MQTT_STATE_MIN_INTERVAL_MS
+bool publishMqttLog(const char* topicSuffix, const char* message, bool retain = false); // Registry topic when the suffix is one, else built on the stack
+bool publishMqttLog(MqttTopicId topicId, const char* message, bool retain = false);
 bool publishMqttLogStatus(const char* message, bool retain = false);
 bool publishMqttLogEmail(const char* message, bool retain = false);
 bool publishMqttSetCommand(const char* jsonPayload, bool retain = false);
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "MqttMessage.h"
+
+/*
+ * Home Assistant discovery configurations from a table, without JsonDocument or String.
+ *
+ * Each entity is one constexpr MqttDiscoveryEntity row. Its payload is written from string
+ * fragments that stay in flash, with the device name and the device's state, availability and
+ * command topics spliced in at run time:
+ *
+ *   static constexpr MqttDiscoveryEntity entities[] = {
+ *     {MQTT_SENSOR_COMPONENT, "energy", "Subtotal", MQTT_ENERGY_DEVICECLASS, "kWh", MQTT_DISCOVERY_ROUND_2, nullptr},
+ *   };
+ *   typedef MqttDiscoveryTable<MQTT_DISCOVERY_ENTITY_COUNT(entities), entities, MQTT_DISCOVERY_PREFIX, DEVICE_NAME_LENGTH> Table;
+ *   Table::writePayload(out, 0, device); // out holds at least Table::MAX_PAYLOAD_LENGTH + 1 bytes
+ *
+ * The longest topic and payload and the bytes of all of them together are compile-time constants,
+ * so buffers are sized (and checked by static_assert) from the table. The output is byte-identical to
+ * ArduinoJson 7's serializeJson() of the JsonDocument the discovery code used to build, keys in the
+ * same order. Table text other than commandRange is not escaped: static_assert rejects '"', '\' and
+ * control characters in it.
+ */
+
+#define MQTT_DISCOVERY_ENTITY_COUNT(table) (sizeof(table) / sizeof((table)[0]))
+
+constexpr char MQTT_DISCOVERY_ROUND_2[] = " | round(2)"; // value_template filter: two decimals
+constexpr char MQTT_DISCOVERY_RAW[] = "";                // value_template filter: value as published
+
+struct MqttDiscoveryEntity {
+  const char* component;   // "sensor" or "number"
+  const char* objectId;    // <prefix><component>/<device>/<objectId>/config
+  const char* name;        // Entity name, also its key in the energy state JSON
+  const char* deviceClass;
+  const char* unit;
+  const char* filter;      // Appended to value_json.<name> in value_template
+  const char* commandRange; // JSON members "max":..,"min":..,"step":.. of a settable number (command_topic); nullptr = read only
+};
+
+// What varies per device, spliced into every payload
+struct MqttDiscoveryDevice {
+  const char* name;              // <device>
+  const char* cardName;          // Device name shown in Home Assistant
+  const char* stateTopic;
+  const char* availabilityTopic; // Payloads "True" / "False"
+  const char* commandTopic;      // Settable entities
+};
+
+namespace MqttDiscoveryJsonDetail {
+
+constexpr char CONFIG_SUFFIX[] = "/config";
+
+constexpr char COMMAND_TOPIC[] = "{\"command_topic\":\"";
+constexpr char COMMAND_TEMPLATE[] = "\",\"command_template\":\"{\\\"";
+constexpr char COMMAND_TEMPLATE_END[] = "\\\": {{ value }} }\",";
+constexpr char NAME_OPEN[] = "{\"name\":\"";
+constexpr char NAME_AFTER_COMMAND[] = ",\"name\":\"";
+constexpr char STATE_TOPIC[] = "\",\"state_topic\":\"";
+constexpr char AVAILABILITY_TOPIC[] = "\",\"availability_topic\":\"";
+constexpr char DEVICE_CLASS[] = "\",\"payload_available\":\"True\",\"payload_not_available\":\"False\",\"device_class\":\"";
+constexpr char UNIT[] = "\",\"unit_of_measurement\":\"";
+constexpr char UNIQUE_ID[] = "\",\"unique_id\":\"";
+constexpr char VALUE_TEMPLATE[] = "\",\"qos\":0,\"value_template\":\"{{ value_json.";
+constexpr char IDENTIFIERS[] = "}}\",\"device\":{\"identifiers\":[\"";
+constexpr char CARD_NAME[] = "\"],\"name\":\"";
+constexpr char CLOSE[] = "\"}}";
+
+constexpr size_t TOPIC_MAX = MQTT_TOPIC_LEN - 1;
+constexpr size_t CARD_NAME_MAX = 63;
+
+constexpr size_t length(const char* text) {
+  return text == nullptr || *text == '\0' ? 0 : 1 + length(text + 1);
+}
+
+constexpr bool jsonSafe(const char* text) {
+  return text == nullptr || *text == '\0' ||
+         (*text != '"' && *text != '\\' && (uint8_t)*text >= 0x20 && jsonSafe(text + 1));
+}
+
+constexpr bool jsonSafe(const MqttDiscoveryEntity& entity) {
+  return jsonSafe(entity.component) && jsonSafe(entity.objectId) && jsonSafe(entity.name) &&
+         jsonSafe(entity.deviceClass) && jsonSafe(entity.unit) && jsonSafe(entity.filter); // commandRange is JSON
+}
+
+constexpr size_t topicLength(const MqttDiscoveryEntity& entity, const char* prefix, size_t deviceLength) {
+  return length(prefix) + length(entity.component) + 1 + deviceLength + 1 + length(entity.objectId) +
+         length(CONFIG_SUFFIX);
+}
+
+// Longest payload: every spliced topic TOPIC_MAX, the device name deviceLength
+constexpr size_t payloadLength(const MqttDiscoveryEntity& entity, size_t deviceLength) {
+  return (entity.commandRange == nullptr
+              ? length(NAME_OPEN)
+              : length(COMMAND_TOPIC) + TOPIC_MAX + length(COMMAND_TEMPLATE) + length(entity.name) +
+                    length(COMMAND_TEMPLATE_END) + length(entity.commandRange) + length(NAME_AFTER_COMMAND)) +
+         length(entity.name) + length(STATE_TOPIC) + TOPIC_MAX + length(AVAILABILITY_TOPIC) + TOPIC_MAX +
+         length(DEVICE_CLASS) + length(entity.deviceClass) + length(UNIT) + length(entity.unit) + length(UNIQUE_ID) +
+         length(entity.name) + 1 + deviceLength + length(VALUE_TEMPLATE) + length(entity.name) + length(entity.filter) +
+         length(IDENTIFIERS) + deviceLength + length(CARD_NAME) + CARD_NAME_MAX + length(CLOSE);
+}
+
+template <size_t N>
+constexpr bool allJsonSafe(const MqttDiscoveryEntity (&entities)[N], size_t i = 0) {
+  return i == N || (jsonSafe(entities[i]) && allJsonSafe(entities, i + 1));
+}
+
+template <size_t N>
+constexpr size_t maxTopicLength(const MqttDiscoveryEntity (&entities)[N], const char* prefix, size_t deviceLength,
+                                size_t i = 0) {
+  return i == N ? 0
+                : (topicLength(entities[i], prefix, deviceLength) > maxTopicLength(entities, prefix, deviceLength, i + 1)
+                       ? topicLength(entities[i], prefix, deviceLength)
+                       : maxTopicLength(entities, prefix, deviceLength, i + 1));
+}
+
+template <size_t N>
+constexpr size_t maxPayloadLength(const MqttDiscoveryEntity (&entities)[N], size_t deviceLength, size_t i = 0) {
+  return i == N ? 0
+                : (payloadLength(entities[i], deviceLength) > maxPayloadLength(entities, deviceLength, i + 1)
+                       ? payloadLength(entities[i], deviceLength)
+                       : maxPayloadLength(entities, deviceLength, i + 1));
+}
+
+// Topics and payloads of all entities, each NUL-terminated
+template <size_t N>
+constexpr size_t totalLength(const MqttDiscoveryEntity (&entities)[N], const char* prefix, size_t deviceLength,
+                             size_t i = 0) {
+  return i == N ? 0
+                : topicLength(entities[i], prefix, deviceLength) + 1 + payloadLength(entities[i], deviceLength) + 1 +
+                      totalLength(entities, prefix, deviceLength, i + 1);
+}
+
+// Copies at most maxLength characters of text; returns the new end
+inline char* append(char* out, const char* text, size_t maxLength) {
+  size_t textLength = text == nullptr ? 0 : strnlen(text, maxLength);
+  memcpy(out, text, textLength);
+  return out + textLength;
+}
+
+template <size_t Size>
+inline char* append(char* out, const char (&fragment)[Size]) {
+  memcpy(out, fragment, Size - 1);
+  return out + Size - 1;
+}
+
+}  // namespace MqttDiscoveryJsonDetail
+
+// Prefix: discovery prefix with its trailing '/'. MaxDeviceLength: longest device name; a longer one is cut to it
+template <size_t N, const MqttDiscoveryEntity (&Entities)[N], const char* Prefix, size_t MaxDeviceLength>
+class MqttDiscoveryTable {
+  static_assert(N > 0, "MqttDiscoveryTable needs at least one entity");
+  static_assert(MqttDiscoveryJsonDetail::allJsonSafe(Entities), "Discovery table text must not need JSON escaping");
+
+ public:
+  static constexpr size_t COUNT = N;
+  static constexpr size_t MAX_TOPIC_LENGTH = MqttDiscoveryJsonDetail::maxTopicLength(Entities, Prefix, MaxDeviceLength);
+  static constexpr size_t MAX_PAYLOAD_LENGTH = MqttDiscoveryJsonDetail::maxPayloadLength(Entities, MaxDeviceLength);
+  static constexpr size_t TOTAL_LENGTH = MqttDiscoveryJsonDetail::totalLength(Entities, Prefix, MaxDeviceLength);
+
+  // Writes <Prefix><component>/<device>/<objectId>/config and a NUL into 'out'
+  // (MAX_TOPIC_LENGTH + 1 bytes) and returns its length.
+  static size_t writeTopic(char* out, size_t index, const char* deviceName) {
+    using namespace MqttDiscoveryJsonDetail;
+    const MqttDiscoveryEntity& entity = Entities[index];
+    char* p = append(out, Prefix, SIZE_MAX);
+    p = append(p, entity.component, SIZE_MAX);
+    *p++ = '/';
+    p = append(p, deviceName, MaxDeviceLength);
+    *p++ = '/';
+    p = append(p, entity.objectId, SIZE_MAX);
+    p = append(p, CONFIG_SUFFIX);
+    *p = '\0';
+    return (size_t)(p - out);
+  }
+
+  // Writes the configuration payload and a NUL into 'out' (MAX_PAYLOAD_LENGTH + 1 bytes) and
+  // returns its length.
+  static size_t writePayload(char* out, size_t index, const MqttDiscoveryDevice& device) {
+    using namespace MqttDiscoveryJsonDetail;
+    const MqttDiscoveryEntity& entity = Entities[index];
+    char* p = out;
+    if (entity.commandRange != nullptr) {
+      p = append(p, COMMAND_TOPIC);
+      p = append(p, device.commandTopic, TOPIC_MAX);
+      p = append(p, COMMAND_TEMPLATE);
+      p = append(p, entity.name, SIZE_MAX);
+      p = append(p, COMMAND_TEMPLATE_END);
+      p = append(p, entity.commandRange, SIZE_MAX);
+      p = append(p, NAME_AFTER_COMMAND);
+    } else {
+      p = append(p, NAME_OPEN);
+    }
+    p = append(p, entity.name, SIZE_MAX);
+    p = append(p, STATE_TOPIC);
+    p = append(p, device.stateTopic, TOPIC_MAX);
+    p = append(p, AVAILABILITY_TOPIC);
+    p = append(p, device.availabilityTopic, TOPIC_MAX);
+    p = append(p, DEVICE_CLASS);
+    p = append(p, entity.deviceClass, SIZE_MAX);
+    p = append(p, UNIT);
+    p = append(p, entity.unit, SIZE_MAX);
+    p = append(p, UNIQUE_ID);
+    p = append(p, entity.name, SIZE_MAX);
+    *p++ = '_';
+    p = append(p, device.name, MaxDeviceLength);
+    p = append(p, VALUE_TEMPLATE);
+    p = append(p, entity.name, SIZE_MAX);
+    p = append(p, entity.filter, SIZE_MAX);
+    p = append(p, IDENTIFIERS);
+    p = append(p, device.name, MaxDeviceLength);
+    p = append(p, CARD_NAME);
+    p = append(p, device.cardName, CARD_NAME_MAX);
+    p = append(p, CLOSE);
+    *p = '\0';
+    return (size_t)(p - out);
+  }
+};
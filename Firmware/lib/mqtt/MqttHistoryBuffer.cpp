@@ -0,0 +1,248 @@
+#include "MqttHistoryBuffer.h"
+
+#include <string.h>
+
+namespace {
+constexpr uint32_t SECTOR_SIZE = SPI_FLASH_SEC_SIZE;
+
+constexpr uint8_t RECORD_MAGIC = 0xB5;
+constexpr uint8_t STATE_PENDING = 0xFF;     // As programmed
+constexpr uint8_t STATE_REPLAYED = 0x00;    // Cleared in place after the sample was published
+
+/*
+ * Record layout (little endian, erased flash reads 0xFF):
+ *
+ *   0      magic        RECORD_MAGIC
+ *   1      state        STATE_PENDING | STATE_REPLAYED (not covered by the CRC)
+ *   2..3   reserved     0xFFFF
+ *   4..7   sequence
+ *   8..11  timestamp    Unix time, seconds
+ *   12..15 power        W
+ *   16..23 energy       mWh
+ *   24..27 reserved     0xFFFFFFFF
+ *   28..31 CRC-32 of bytes 4..27
+ */
+constexpr size_t CRC_OFFSET = 28;
+
+uint32_t crc32(const uint8_t* data, size_t size) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < size; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0U - (crc & 1U)));
+    }
+  }
+  return ~crc;
+}
+
+void put32(uint8_t* p, uint32_t value) {
+  for (uint8_t i = 0; i < 4; i++) {
+    p[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+uint32_t get32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool isErased(const uint8_t* data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    if (data[i] != 0xFF) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+/* ###################################################################################################
+ *               R E C O V E R Y
+ * ###################################################################################################
+ */
+bool MqttHistoryBuffer::begin(const char* label, bool dropOldest) {
+  partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  sectorCount_ = partition_ ? partition_->size / SECTOR_SIZE : 0;
+  if (sectorCount_ < 2) {
+    partition_ = nullptr;
+    return false;
+  }
+  dropOldest_ = dropOldest;
+  sequence_ = 0;
+  pending_ = 0;
+  dropped_ = 0;
+  writeSector_ = sectorCount_ - 1; // Empty: the first append starts sector 0
+  writeSlot_ = SLOTS_PER_SECTOR;
+  readSector_ = 0;
+  readSlot_ = 0;
+
+  // The sector being written is the one whose first record has the highest sequence
+  bool found = false;
+  uint32_t sequence = 0;
+  for (uint32_t sector = 0; sector < sectorCount_; sector++) {
+    RecordStatus status = readRecord(sector, 0, nullptr, &sequence);
+    if ((status == RECORD_PENDING || status == RECORD_REPLAYED) &&
+        (!found || (int32_t)(sequence - sequence_) > 0)) {
+      found = true;
+      writeSector_ = sector;
+      sequence_ = sequence;
+    }
+  }
+  if (!found) {
+    return true;
+  }
+
+  // Append after the last programmed slot; torn records are skipped when reading
+  for (writeSlot_ = 0; writeSlot_ < SLOTS_PER_SECTOR; writeSlot_++) {
+    RecordStatus status = readRecord(writeSector_, writeSlot_, nullptr, &sequence);
+    if (status == RECORD_ERASED) {
+      break;
+    }
+    if (status != RECORD_INVALID && (int32_t)(sequence - sequence_) > 0) {
+      sequence_ = sequence;
+    }
+  }
+
+  // Replay marks are written in order, so the pending records run from the oldest one to the end
+  bool readFound = false;
+  for (uint32_t i = 1; i <= sectorCount_; i++) {
+    uint32_t sector = (writeSector_ + i) % sectorCount_;
+    uint32_t slots = sector == writeSector_ ? writeSlot_ : SLOTS_PER_SECTOR;
+    for (uint32_t slot = 0; slot < slots; slot++) {
+      if (readRecord(sector, slot, nullptr, &sequence) != RECORD_PENDING) {
+        continue;
+      }
+      if (!readFound) {
+        readFound = true;
+        readSector_ = sector;
+        readSlot_ = slot;
+      }
+      pending_++;
+    }
+  }
+  if (!readFound) {
+    readSector_ = writeSector_;
+    readSlot_ = writeSlot_;
+  }
+  return true;
+}
+
+MqttHistoryBuffer::RecordStatus MqttHistoryBuffer::readRecord(uint32_t sector, uint32_t slot, MqttHistorySample* sample, uint32_t* sequence) {
+  uint8_t record[RECORD_SIZE];
+  if (esp_partition_read(partition_, sector * SECTOR_SIZE + slot * RECORD_SIZE, record, RECORD_SIZE) != ESP_OK) {
+    return RECORD_INVALID;
+  }
+  if (isErased(record, RECORD_SIZE)) {
+    return RECORD_ERASED;
+  }
+  if (record[0] != RECORD_MAGIC || get32(record + CRC_OFFSET) != crc32(record + 4, CRC_OFFSET - 4)) {
+    return RECORD_INVALID;
+  }
+  *sequence = get32(record + 4);
+  if (sample != nullptr) {
+    sample->timestamp = get32(record + 8);
+    sample->powerW = get32(record + 12);
+    sample->energyMilliWh = (uint64_t)get32(record + 16) | ((uint64_t)get32(record + 20) << 32);
+  }
+  return record[1] == STATE_PENDING ? RECORD_PENDING : RECORD_REPLAYED;
+}
+
+/* ###################################################################################################
+ *               A P P E N D
+ * ###################################################################################################
+ */
+bool MqttHistoryBuffer::append(const MqttHistorySample& sample) {
+  if (partition_ == nullptr) {
+    return false;
+  }
+
+  if (writeSlot_ >= SLOTS_PER_SECTOR) {
+    uint32_t next = (writeSector_ + 1) % sectorCount_;
+    if (pending_ > 0 && readSector_ == next) {
+      // Full: the next sector still holds the oldest pending samples
+      if (!dropOldest_) {
+        dropped_++;
+        return false;
+      }
+      uint32_t sequence = 0;
+      for (uint32_t slot = readSlot_; slot < SLOTS_PER_SECTOR && pending_ > 0; slot++) {
+        if (readRecord(next, slot, nullptr, &sequence) == RECORD_PENDING) {
+          pending_--;
+          dropped_++;
+        }
+      }
+      readSector_ = (next + 1) % sectorCount_;
+      readSlot_ = 0;
+    }
+    if (!startSector(next)) {
+      dropped_++;
+      return false;
+    }
+  }
+
+  uint8_t record[RECORD_SIZE];
+  memset(record, 0xFF, sizeof(record));
+  record[0] = RECORD_MAGIC;
+  record[1] = STATE_PENDING;
+  put32(record + 4, sequence_ + 1);
+  put32(record + 8, sample.timestamp);
+  put32(record + 12, sample.powerW);
+  put32(record + 16, (uint32_t)sample.energyMilliWh);
+  put32(record + 20, (uint32_t)(sample.energyMilliWh >> 32));
+  put32(record + CRC_OFFSET, crc32(record + 4, CRC_OFFSET - 4));
+
+  uint32_t slot = writeSlot_++;
+  if (esp_partition_write(partition_, writeSector_ * SECTOR_SIZE + slot * RECORD_SIZE, record, RECORD_SIZE) != ESP_OK) {
+    dropped_++;
+    return false; // The slot is skipped; readers see it as torn
+  }
+  sequence_++;
+  if (pending_ == 0) {
+    readSector_ = writeSector_;
+    readSlot_ = slot;
+  }
+  pending_++;
+  return true;
+}
+
+bool MqttHistoryBuffer::startSector(uint32_t sector) {
+  if (esp_partition_erase_range(partition_, sector * SECTOR_SIZE, SECTOR_SIZE) != ESP_OK) {
+    return false;
+  }
+  writeSector_ = sector;
+  writeSlot_ = 0;
+  return true;
+}
+
+/* ###################################################################################################
+ *               R E P L A Y
+ * ###################################################################################################
+ */
+bool MqttHistoryBuffer::peek(MqttHistorySample* sample) {
+  uint32_t sequence = 0;
+  while (pending_ > 0) {
+    if (readSlot_ >= SLOTS_PER_SECTOR) {
+      readSector_ = (readSector_ + 1) % sectorCount_;
+      readSlot_ = 0;
+    }
+    if (readSector_ == writeSector_ && readSlot_ >= writeSlot_) {
+      pending_ = 0; // Caught up with the writer: the rest were torn records
+      break;
+    }
+    if (readRecord(readSector_, readSlot_, sample, &sequence) == RECORD_PENDING) {
+      return true;
+    }
+    readSlot_++;
+  }
+  return false;
+}
+
+bool MqttHistoryBuffer::markReplayed() {
+  if (pending_ == 0) {
+    return false;
+  }
+  const uint8_t replayed = STATE_REPLAYED;
+  bool written = esp_partition_write(partition_, readSector_ * SECTOR_SIZE + readSlot_ * RECORD_SIZE + 1, &replayed, 1) == ESP_OK;
+  readSlot_++;
+  pending_--;
+  return written;
+}
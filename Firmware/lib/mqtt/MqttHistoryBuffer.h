@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_partition.h>
+
+/*
+ * Store-and-forward buffer for energy samples in a raw flash partition ("mqtthist" in
+ * partitions.csv).
+ *
+ * Samples taken while the broker is unreachable are appended as 32-byte records, each with a
+ * sequence number and a CRC-32, to a ring of 4 KB sectors. After reconnecting, MqttClient replays
+ * them oldest first and marks each one replayed by clearing its state byte in place (NOR flash can
+ * clear bits without an erase), so a reboot in the middle of a replay neither loses nor repeats
+ * samples. A sector is erased only when the writer wraps into it.
+ *
+ * When the ring is full, dropOldest selects the policy: erase the oldest sector (its pending
+ * samples are counted as dropped) or refuse the new sample.
+ *
+ * Not thread safe; the MQTT network task owns it.
+ */
+
+struct MqttHistorySample {
+  uint32_t timestamp;     // Unix time, seconds
+  uint32_t powerW;
+  uint64_t energyMilliWh;
+};
+
+class MqttHistoryBuffer {
+ public:
+  // Opens the data partition 'label' and finds the pending samples. Returns false when the
+  // partition does not exist (old partition table after an OTA-only update).
+  bool begin(const char* label, bool dropOldest);
+
+  bool available() const { return partition_ != nullptr; }
+
+  // Returns false when the sample was dropped (buffer full and !dropOldest, or a flash error).
+  bool append(const MqttHistorySample& sample);
+
+  // Oldest sample not replayed yet. Stays the same until markReplayed().
+  bool peek(MqttHistorySample* sample);
+  // Moves on to the next sample. Returns false when the mark could not be written: the sample is
+  // replayed once more after a reboot.
+  bool markReplayed();
+
+  uint32_t pending() const { return pending_; }
+  uint32_t capacity() const { return sectorCount_ * SLOTS_PER_SECTOR; }
+  uint32_t dropped() const { return dropped_; } // Since begin()
+
+  static constexpr uint32_t RECORD_SIZE = 32;
+  static constexpr uint32_t SLOTS_PER_SECTOR = SPI_FLASH_SEC_SIZE / RECORD_SIZE;
+
+ private:
+  enum RecordStatus : uint8_t { RECORD_ERASED, RECORD_PENDING, RECORD_REPLAYED, RECORD_INVALID };
+
+  RecordStatus readRecord(uint32_t sector, uint32_t slot, MqttHistorySample* sample, uint32_t* sequence);
+  bool startSector(uint32_t sector);
+
+  const esp_partition_t* partition_ = nullptr;
+  bool dropOldest_ = true;
+  uint32_t sectorCount_ = 0;
+  uint32_t writeSector_ = 0;
+  uint32_t writeSlot_ = 0;                   // SLOTS_PER_SECTOR = next append starts a new sector
+  uint32_t readSector_ = 0;
+  uint32_t readSlot_ = 0;
+  uint32_t sequence_ = 0;                    // Sequence of the last record written or recovered
+  uint32_t pending_ = 0;
+  uint32_t dropped_ = 0;
+};
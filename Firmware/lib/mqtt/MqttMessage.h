@@ -1,10 +1,6 @@
 #pragma once
 
-#define MQTT_TOPIC_LEN   64
-#define MQTT_PAYLOAD_LEN 1024
-
-struct MqttMessage {
-  char topic[MQTT_TOPIC_LEN];
-  char payload[MQTT_PAYLOAD_LEN];
-  bool retain;
-};
+#define MQTT_TOPIC_LEN   80   // Longest topic + 1; longer topics are truncated. homeassistant/sensor/<device>/power_instant/config is 66
+#define MQTT_PAYLOAD_LEN 1024 // Longest payload + 1; longer payloads are truncated
+#define MQTT_PACKET_BUFFER_SIZE (5 + 2 + MQTT_TOPIC_LEN + MQTT_PAYLOAD_LEN) // PubSubClient's buffer (setBufferSize() in mqttInit()), one PUBLISH of the longest topic and payload
+#define MQTT_STATE_PAYLOAD_LEN 256 // Energy state slot (MqttClient.cpp); the state JSON is ~70 bytes
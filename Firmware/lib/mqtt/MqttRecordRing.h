@@ -0,0 +1,211 @@
+#pragma once
+
+#include <Arduino.h>
+#include <string.h>
+
+/*
+ * MQTT messages as variable-length records in one fixed byte arena: the outbound lanes and the
+ * inbound (RX) ring.
+ *
+ * A record is an 8-byte header followed by the NUL-terminated topic and payload, padded to 8
+ * bytes, so a 90-byte energy state costs ~170 bytes of the arena instead of a full
+ * topic[64] + payload[1024] slot. Records are stored in order; one that does not fit before the
+ * end of the arena is preceded by a pad record and starts again at offset 0.
+ *
+ * Any task may produce: reserve() claims the space under the ring's spinlock and returns a
+ * handle, the caller writes topic and payload in place, and commit() hands the record to the
+ * consumer. The single consumer peeks the oldest committed record, uses it straight from the arena
+ * and release()s it. A producer copies each message exactly once; nothing is copied on the way out.
+ *
+ * Outbound, the producers are the publishing tasks and the consumer is the MQTT network task,
+ * which publishes each record from the arena. Inbound, mqttCallback() produces each received
+ * message and the loop task handles it in place before releasing it (retain is unused there).
+ *
+ * When the arena is full the message is dropped and counted, like the old queue's failed
+ * xQueueSend(). The arena is static, so the ring uses no heap.
+ */
+template <uint32_t Capacity>
+class MqttRecordRing {
+  static_assert(Capacity >= 64 && Capacity % 8 == 0 && Capacity <= 0x8000, "MqttRecordRing capacity must be a multiple of 8 up to 32 KB");
+
+ public:
+  struct Slot {
+    uint32_t handle;
+    char* topic;   // topicLength + 1 bytes
+    char* payload; // payloadLength + 1 bytes
+  };
+
+  struct Record {
+    const char* topic;
+    const char* payload; // NUL-terminated
+    uint16_t payloadLength;
+    bool retain;
+  };
+
+  struct Stats {
+    uint32_t enqueued;
+    uint32_t dropped;       // Arena full
+    uint64_t copiedBytes;   // Topic and payload bytes written by producers
+    uint32_t published;     // Records released by the consumer
+    uint32_t usedBytes;
+    uint32_t peakUsedBytes;
+  };
+
+  // Producer side. Returns false when the arena cannot hold the record.
+  bool reserve(size_t topicLength, size_t payloadLength, bool retain, Slot* slot) {
+    uint32_t size = recordSize(topicLength, payloadLength);
+    bool reserved = false;
+    portENTER_CRITICAL(&mux_);
+    if (used_ == 0) {
+      head_ = tail_ = 0; // Empty: restart at the front so large records do not need a pad
+    }
+    if (size <= Capacity) {
+      if (head_ + size > Capacity && Capacity - head_ + size <= Capacity - used_) {
+        header(head_)->size = (uint16_t)(Capacity - head_); // Pad to the end of the arena
+        header(head_)->state = STATE_PAD;
+        used_ += Capacity - head_;
+        head_ = 0;
+      }
+      if (head_ + size <= Capacity && size <= Capacity - used_) {
+        slot->handle = head_;
+        Header* h = header(head_);
+        h->size = (uint16_t)size;
+        h->state = STATE_RESERVED;
+        h->retain = retain ? 1 : 0;
+        h->topicLength = (uint16_t)topicLength;
+        h->payloadLength = (uint16_t)payloadLength;
+        head_ = (head_ + size) % Capacity;
+        used_ += size;
+        reserved = true;
+      }
+    }
+    if (reserved) {
+      stats_.enqueued++;
+      stats_.copiedBytes += topicLength + payloadLength;
+      if (used_ > stats_.peakUsedBytes) {
+        stats_.peakUsedBytes = used_;
+      }
+    } else {
+      stats_.dropped++;
+    }
+    portEXIT_CRITICAL(&mux_);
+
+    if (reserved) {
+      slot->topic = reinterpret_cast<char*>(arena_ + slot->handle + sizeof(Header));
+      slot->payload = slot->topic + topicLength + 1;
+    }
+    return reserved;
+  }
+
+  // True when reserve() would succeed now. Lets a producer that may block wait for space
+  // without counting every attempt as a drop.
+  bool canReserve(size_t topicLength, size_t payloadLength) {
+    uint32_t size = recordSize(topicLength, payloadLength);
+    portENTER_CRITICAL(&mux_);
+    bool fits = size <= Capacity &&
+                (used_ == 0 ||
+                 (head_ + size <= Capacity ? size <= Capacity - used_ : Capacity - head_ + size <= Capacity - used_));
+    portEXIT_CRITICAL(&mux_);
+    return fits;
+  }
+
+  void commit(uint32_t handle) {
+    portENTER_CRITICAL(&mux_);
+    header(handle)->state = STATE_COMMITTED;
+    portEXIT_CRITICAL(&mux_);
+  }
+
+  // Commit a payload written in place that came out shorter than reserved (serialized with only
+  // an upper bound known). The unused bytes stay in the record until it is released.
+  void commit(uint32_t handle, size_t payloadLength) {
+    portENTER_CRITICAL(&mux_);
+    Header* h = header(handle);
+    if (payloadLength < h->payloadLength) {
+      stats_.copiedBytes -= h->payloadLength - payloadLength;
+      h->payloadLength = (uint16_t)payloadLength;
+    }
+    h->state = STATE_COMMITTED;
+    portEXIT_CRITICAL(&mux_);
+  }
+
+  // Convenience: reserve, copy and commit.
+  bool push(const char* topic, size_t topicLength, const char* payload, size_t payloadLength, bool retain) {
+    Slot slot;
+    if (!reserve(topicLength, payloadLength, retain, &slot)) {
+      return false;
+    }
+    memcpy(slot.topic, topic, topicLength);
+    slot.topic[topicLength] = '\0';
+    memcpy(slot.payload, payload, payloadLength);
+    slot.payload[payloadLength] = '\0';
+    commit(slot.handle);
+    return true;
+  }
+
+  // Consumer side. The record stays valid until release(). Returns false when the oldest record
+  // is not committed yet or the ring is empty.
+  bool peek(Record* record) {
+    bool available = false;
+    portENTER_CRITICAL(&mux_);
+    while (used_ > 0 && header(tail_)->state == STATE_PAD) {
+      used_ -= header(tail_)->size;
+      tail_ = 0;
+    }
+    if (used_ > 0 && header(tail_)->state == STATE_COMMITTED) {
+      const Header* h = header(tail_);
+      record->topic = reinterpret_cast<const char*>(arena_ + tail_ + sizeof(Header));
+      record->payload = record->topic + h->topicLength + 1;
+      record->payloadLength = h->payloadLength;
+      record->retain = h->retain != 0;
+      available = true;
+    }
+    portEXIT_CRITICAL(&mux_);
+    return available;
+  }
+
+  void release() {
+    portENTER_CRITICAL(&mux_);
+    uint32_t size = header(tail_)->size;
+    used_ -= size;
+    tail_ = (tail_ + size) % Capacity;
+    stats_.published++;
+    portEXIT_CRITICAL(&mux_);
+  }
+
+  Stats stats() {
+    portENTER_CRITICAL(&mux_);
+    Stats stats = stats_;
+    stats.usedBytes = used_;
+    portEXIT_CRITICAL(&mux_);
+    return stats;
+  }
+
+  static constexpr uint32_t capacity() { return Capacity; }
+
+  static constexpr uint32_t recordSize(size_t topicLength, size_t payloadLength) {
+    return (uint32_t)((sizeof(Header) + topicLength + 1 + payloadLength + 1 + 7) & ~(size_t)7);
+  }
+
+ private:
+  static constexpr uint8_t STATE_RESERVED = 1;
+  static constexpr uint8_t STATE_COMMITTED = 2;
+  static constexpr uint8_t STATE_PAD = 3;
+
+  struct Header {
+    uint16_t size; // Whole record, header and padding included
+    uint8_t state;
+    uint8_t retain;
+    uint16_t topicLength;
+    uint16_t payloadLength;
+  };
+  static_assert(sizeof(Header) == 8, "MqttRecordRing header must be 8 bytes");
+
+  Header* header(uint32_t offset) { return reinterpret_cast<Header*>(arena_ + offset); }
+
+  alignas(8) uint8_t arena_[Capacity] = {};
+  uint32_t head_ = 0; // Next record is written here
+  uint32_t tail_ = 0; // Oldest record
+  uint32_t used_ = 0; // Bytes between tail and head, pads included
+  Stats stats_ = {};
+  portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+};
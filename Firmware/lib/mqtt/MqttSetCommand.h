@@ -0,0 +1,688 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Allocation-free dispatcher for the JSON object received on <device>/set, such as
+ * {"smartChg":true,"chgStartTime":"02:00","currEPrice":1.02,"ePriceLimit":1.5,"maxEPrice":1.25}.
+ *
+ * MqttSetParser walks the payload once, without a JsonDocument: each key is hashed while it is
+ * unescaped into a fixed buffer, each scalar value is decoded into an MqttSetValue (text into a
+ * fixed buffer, numbers by the decimal parser below) and nested objects and arrays are skipped.
+ * MqttSetTable finds the handler for a key through a perfect hash computed at compile time from a
+ * table of MqttSetCommand rows and confirms it with one strcmp(). Keys without a row are ignored,
+ * so adding a command is adding a row:
+ *
+ *   static void onSmartCharging(const MqttSetValue& value) { ... }
+ *   static constexpr MqttSetCommand mqttSetCommands[] = {{MQTT_SMART_CHG, onSmartCharging}, ...};
+ *   MqttSetTable<MQTT_SET_COMMAND_COUNT(mqttSetCommands), mqttSetCommands>::dispatch(payload, length);
+ *
+ * Like deserializeJson(), a payload is accepted or rejected as a whole: dispatch() checks all of it
+ * before it runs the first handler. The grammar is strict JSON (RFC 8259); the error names are
+ * ArduinoJson's. Differences to iterating a JsonDocument: a key given twice runs its handler twice,
+ * and text values longer than MQTT_SET_TEXT_LEN - 1 bytes reach the handler truncated (textLength
+ * still tells the full length).
+ */
+
+#define MQTT_SET_KEY_LEN   32   // Longest command key + 1; longer keys cannot match a command
+#define MQTT_SET_TEXT_LEN  64   // Longest text value passed on untruncated + 1
+#define MQTT_SET_MAX_DEPTH 10   // Nesting limit, ArduinoJson's default ARDUINOJSON_DEFAULT_NESTING_LIMIT; at most 16
+
+#define MQTT_SET_COMMAND_COUNT(table) (sizeof(table) / sizeof((table)[0]))
+
+struct MqttSetError {
+  enum Code : uint8_t { Ok, EmptyInput, IncompleteInput, InvalidInput, TooDeep };
+
+  MqttSetError(Code code = Ok) : code_(code) {}
+  explicit operator bool() const { return code_ != Ok; }
+  Code code() const { return code_; }
+  const char* c_str() const {
+    static const char* const names[] = {"Ok", "EmptyInput", "IncompleteInput", "InvalidInput", "TooDeep"};
+    return names[code_];
+  }
+
+ private:
+  Code code_;
+};
+
+namespace MqttSetCommandDetail {
+
+// Exact powers of ten: a mantissa below 2^53 scaled by one of them is correctly rounded, as by strtod()
+constexpr double EXACT_POWERS_OF_TEN[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                          1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+constexpr double BINARY_POWERS_OF_TEN[] = {1e1, 1e2, 1e4, 1e8, 1e16, 1e32, 1e64, 1e128, 1e256};
+constexpr uint64_t MANTISSA_LIMIT = 1000000000000000000ULL; // Digits beyond 18 only scale the exponent
+constexpr int EXPONENT_LIMIT = 400;                          // Beyond this every mantissa is 0 or infinite
+
+inline bool isDigit(int c) {
+  return c >= '0' && c <= '9';
+}
+
+inline double scale(uint64_t mantissa, int exponent) {
+  double value = (double)mantissa;
+  if (mantissa == 0) {
+    return value;
+  }
+  if (exponent >= -22 && exponent <= 22 && mantissa <= (1ULL << 53)) {
+    return exponent >= 0 ? value * EXACT_POWERS_OF_TEN[exponent] : value / EXACT_POWERS_OF_TEN[-exponent];
+  }
+  if (exponent > EXPONENT_LIMIT) {
+    exponent = EXPONENT_LIMIT;
+  } else if (exponent < -EXPONENT_LIMIT) {
+    exponent = -EXPONENT_LIMIT;
+  }
+  uint32_t magnitude = (uint32_t)(exponent < 0 ? -exponent : exponent);
+  for (uint8_t bit = 0; magnitude != 0; bit++, magnitude >>= 1) {
+    if (magnitude & 1) {
+      value = exponent < 0 ? value / BINARY_POWERS_OF_TEN[bit] : value * BINARY_POWERS_OF_TEN[bit];
+    }
+  }
+  return value;
+}
+
+// One JSON number starting at 'p'. On success '*next' is the first byte after it; running into
+// 'end' in the middle of the number (after '-', '.' or 'e') is IncompleteInput.
+inline MqttSetError::Code parseNumber(const char* p, const char* end, const char** next, double* out) {
+  const bool negative = p < end && *p == '-';
+  p += negative ? 1 : 0;
+  if (p >= end) {
+    return MqttSetError::IncompleteInput;
+  }
+  if (!isDigit(*p)) {
+    return MqttSetError::InvalidInput;
+  }
+
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  if (*p == '0') {
+    p++; // No leading zeros: "01" ends the number after the 0 and fails at the 1
+  } else {
+    for (; p < end && isDigit(*p); p++) {
+      if (mantissa < MANTISSA_LIMIT) {
+        mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+      } else {
+        exponent++;
+      }
+    }
+  }
+  if (p < end && *p == '.') {
+    p++;
+    if (p >= end) {
+      return MqttSetError::IncompleteInput;
+    }
+    if (!isDigit(*p)) {
+      return MqttSetError::InvalidInput;
+    }
+    for (; p < end && isDigit(*p); p++) {
+      if (mantissa < MANTISSA_LIMIT) {
+        mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        exponent--;
+      }
+    }
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    const bool negativeExponent = p < end && *p == '-';
+    p += (p < end && (*p == '-' || *p == '+')) ? 1 : 0;
+    if (p >= end) {
+      return MqttSetError::IncompleteInput;
+    }
+    if (!isDigit(*p)) {
+      return MqttSetError::InvalidInput;
+    }
+    int written = 0;
+    for (; p < end && isDigit(*p); p++) {
+      if (written <= EXPONENT_LIMIT * 10) {
+        written = written * 10 + (*p - '0');
+      }
+    }
+    exponent += negativeExponent ? -written : written;
+  }
+
+  const double magnitude = scale(mantissa, exponent);
+  *out = negative ? -magnitude : magnitude;
+  *next = p;
+  return MqttSetError::Ok;
+}
+
+// FNV-1a, started from a state derived from the seed. constexpr (C++11) so the table below can
+// search for a seed at compile time; MqttSetParser computes the same hash byte by byte.
+constexpr uint32_t FNV_PRIME = 16777619u;
+
+constexpr uint32_t hashStart(uint32_t seed) {
+  return 2166136261u ^ (seed * 0x9E3779B9u);
+}
+
+constexpr uint32_t hashStep(uint32_t hash, uint8_t byte) {
+  return (hash ^ byte) * FNV_PRIME;
+}
+
+constexpr uint32_t hashOf(const char* key, uint32_t hash) {
+  return *key == '\0' ? hash : hashOf(key + 1, hashStep(hash, (uint8_t)*key));
+}
+
+constexpr size_t slotOf(uint32_t hash, size_t slotCount) {
+  return (hash ^ (hash >> 16)) & (slotCount - 1);
+}
+
+constexpr size_t keyLength(const char* key) {
+  return *key == '\0' ? 0 : 1 + keyLength(key + 1);
+}
+
+// Power of two with at least twice as many slots as keys, so a collision-free seed is found quickly
+constexpr size_t slotCountFor(size_t keys, size_t slots = 1) {
+  return slots >= 2 * keys ? slots : slotCountFor(keys, slots * 2);
+}
+
+template <size_t... I>
+struct Indices {};
+
+template <size_t N, size_t... I>
+struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+
+template <size_t... I>
+struct MakeIndices<0, I...> {
+  typedef Indices<I...> type;
+};
+
+}  // namespace MqttSetCommandDetail
+
+/*
+ * One scalar value of the /set object, valid for the duration of the handler call. The as...()
+ * conversions give what the JsonVariant conversions of the JsonDocument code did.
+ */
+struct MqttSetValue {
+  enum Type : uint8_t { Null, Boolean, Number, Text, Compound };
+
+  Type type = Null;
+  bool boolean = false;
+  double number = 0;
+  const char* text = nullptr; // NUL-terminated, Text only
+  size_t textLength = 0;      // Length before truncation to MQTT_SET_TEXT_LEN - 1
+
+  // as<double>(): the number, true/false as 1/0, a text holding a number, else 0
+  double asDouble() const {
+    switch (type) {
+      case Number:
+        return number;
+      case Boolean:
+        return boolean ? 1 : 0;
+      case Text: {
+        // Like ArduinoJson's parseNumber(), which also takes a '+' and leading zeros in a text
+        const char* p = text;
+        const char* end = text + strlen(text);
+        const bool negative = p < end && *p == '-';
+        p += (p < end && (*p == '-' || *p == '+')) ? 1 : 0;
+        while (end - p >= 2 && p[0] == '0' && MqttSetCommandDetail::isDigit(p[1])) {
+          p++;
+        }
+        const char* next = nullptr;
+        double parsed = 0;
+        if (textLength >= MQTT_SET_TEXT_LEN || p == end || *p == '-' ||
+            MqttSetCommandDetail::parseNumber(p, end, &next, &parsed) != MqttSetError::Ok || next != end) {
+          return 0;
+        }
+        return negative ? -parsed : parsed;
+      }
+      default:
+        return 0;
+    }
+  }
+
+  float asFloat() const { return (float)asDouble(); }
+
+  // as<const char*>(): nullptr unless the value is text
+  const char* asText() const { return type == Text ? text : nullptr; }
+
+  bool textEquals(const char* expected) const {
+    return type == Text && textLength == strlen(expected) && strcmp(text, expected) == 0;
+  }
+
+  // A JSON boolean, or one of the texts Home Assistant templates produce for one
+  bool toBool(bool& out) const {
+    if (type == Boolean) {
+      out = boolean;
+      return true;
+    }
+    if (textEquals("true") || textEquals("True") || textEquals("1") || textEquals("on") || textEquals("ON")) {
+      out = true;
+      return true;
+    }
+    if (textEquals("false") || textEquals("False") || textEquals("0") || textEquals("off") || textEquals("OFF")) {
+      out = false;
+      return true;
+    }
+    return false;
+  }
+};
+
+struct MqttSetCommand {
+  const char* key;
+  void (*handler)(const MqttSetValue& value);
+};
+
+namespace MqttSetCommandDetail {
+
+constexpr uint8_t NO_COMMAND = 0xFF;
+constexpr uint32_t SEED_LIMIT = 256;
+
+template <size_t N>
+constexpr size_t slotOfKey(const MqttSetCommand (&commands)[N], size_t index, uint32_t seed) {
+  return slotOf(hashOf(commands[index].key, hashStart(seed)), slotCountFor(N));
+}
+
+template <size_t N>
+constexpr bool collidesAfter(const MqttSetCommand (&commands)[N], size_t index, size_t other, uint32_t seed) {
+  return other < N &&
+         (slotOfKey(commands, index, seed) == slotOfKey(commands, other, seed) || collidesAfter(commands, index, other + 1, seed));
+}
+
+template <size_t N>
+constexpr bool collides(const MqttSetCommand (&commands)[N], size_t index, uint32_t seed) {
+  return index < N && (collidesAfter(commands, index, index + 1, seed) || collides(commands, index + 1, seed));
+}
+
+template <size_t N>
+constexpr uint32_t findSeed(const MqttSetCommand (&commands)[N], uint32_t seed = 0) {
+  return seed >= SEED_LIMIT || !collides(commands, 0, seed) ? seed : findSeed(commands, seed + 1);
+}
+
+template <size_t N>
+constexpr bool keysFit(const MqttSetCommand (&commands)[N], size_t index = 0) {
+  return index >= N || (keyLength(commands[index].key) < MQTT_SET_KEY_LEN && keysFit(commands, index + 1));
+}
+
+template <size_t N>
+constexpr uint8_t ownerOf(const MqttSetCommand (&commands)[N], uint32_t seed, size_t slot, size_t index = 0) {
+  return index >= N ? NO_COMMAND
+         : slotOfKey(commands, index, seed) == slot ? (uint8_t)index
+                                                    : ownerOf(commands, seed, slot, index + 1);
+}
+
+}  // namespace MqttSetCommandDetail
+
+/*
+ * Streaming parser for one flat JSON object. parse() calls
+ *   visitor(uint32_t keyHash, const char* key, size_t keyLength, const MqttSetValue& value)
+ * once per member, in payload order, with the key hashed from 'seed' (see hashOf() above) and
+ * truncated to MQTT_SET_KEY_LEN - 1 bytes. A payload that is valid JSON but not an object is
+ * accepted without a call. Keeps no state between calls and never reads past 'length' or a NUL.
+ */
+class MqttSetParser {
+ public:
+  template <typename Visitor>
+  MqttSetError parse(const char* json, size_t length, uint32_t seed, Visitor visitor) {
+    p_ = json;
+    end_ = json + length;
+    if (json != nullptr) {
+      for (const char* nul = json; nul < end_; nul++) {
+        if (*nul == '\0') {
+          end_ = nul; // deserializeJson() stops at a NUL too
+          break;
+        }
+      }
+    }
+    skipSpace();
+    if (p_ >= end_) {
+      return MqttSetError::EmptyInput;
+    }
+    if (*p_ != '{') {
+      MqttSetValue value;
+      return readValue(value, 0);
+    }
+
+    p_++;
+    skipSpace();
+    if (p_ < end_ && *p_ == '}') {
+      return MqttSetError::Ok;
+    }
+    for (;;) {
+      skipSpace();
+      if (p_ >= end_) {
+        return MqttSetError::IncompleteInput;
+      }
+      if (*p_ != '"') {
+        return MqttSetError::InvalidInput;
+      }
+      size_t keyLength = 0;
+      uint32_t keyHash = MqttSetCommandDetail::hashStart(seed);
+      MqttSetError::Code code = readString(key_, sizeof(key_), &keyLength, &keyHash);
+      if (code != MqttSetError::Ok) {
+        return code;
+      }
+      skipSpace();
+      if (p_ >= end_) {
+        return MqttSetError::IncompleteInput;
+      }
+      if (*p_ != ':') {
+        return MqttSetError::InvalidInput;
+      }
+      p_++;
+
+      MqttSetValue value;
+      code = readValue(value, 1);
+      if (code != MqttSetError::Ok) {
+        return code;
+      }
+      visitor(keyHash, key_, keyLength, value);
+
+      skipSpace();
+      if (p_ >= end_) {
+        return MqttSetError::IncompleteInput;
+      }
+      if (*p_ == '}') {
+        return MqttSetError::Ok;
+      }
+      if (*p_ != ',') {
+        return MqttSetError::InvalidInput;
+      }
+      p_++;
+    }
+  }
+
+ private:
+  const char* p_ = nullptr;
+  const char* end_ = nullptr;
+  char key_[MQTT_SET_KEY_LEN];
+  char text_[MQTT_SET_TEXT_LEN];
+
+  void skipSpace() {
+    while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) {
+      p_++;
+    }
+  }
+
+  static void append(char* out, size_t size, size_t* length, uint32_t* hash, uint8_t byte) {
+    if (hash != nullptr) {
+      *hash = MqttSetCommandDetail::hashStep(*hash, byte);
+    }
+    if (out != nullptr && *length < size - 1) {
+      out[*length] = (char)byte;
+    }
+    (*length)++;
+  }
+
+  MqttSetError::Code readHex4(uint32_t* out) {
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < 4; i++, p_++) {
+      if (p_ >= end_) {
+        return MqttSetError::IncompleteInput;
+      }
+      const char c = *p_;
+      const uint32_t digit = (c >= '0' && c <= '9') ? (uint32_t)(c - '0')
+                             : (c >= 'a' && c <= 'f') ? (uint32_t)(c - 'a' + 10)
+                             : (c >= 'A' && c <= 'F') ? (uint32_t)(c - 'A' + 10)
+                                                      : 16;
+      if (digit > 15) {
+        return MqttSetError::InvalidInput;
+      }
+      value = value << 4 | digit;
+    }
+    *out = value;
+    return MqttSetError::Ok;
+  }
+
+  // \uXXXX at p_ (after the backslash and 'u'), with a following low surrogate, as UTF-8
+  MqttSetError::Code readUnicode(char* out, size_t size, size_t* length, uint32_t* hash) {
+    uint32_t codepoint = 0;
+    MqttSetError::Code code = readHex4(&codepoint);
+    if (code != MqttSetError::Ok) {
+      return code;
+    }
+    if (codepoint >= 0xD800 && codepoint < 0xDC00 && end_ - p_ >= 2 && p_[0] == '\\' && p_[1] == 'u') {
+      const char* lowStart = p_;
+      p_ += 2;
+      uint32_t low = 0;
+      code = readHex4(&low);
+      if (code != MqttSetError::Ok) {
+        return code;
+      }
+      if (low >= 0xDC00 && low < 0xE000) {
+        codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+      } else {
+        p_ = lowStart; // Not a pair: the second escape stands on its own
+      }
+    }
+    if (codepoint < 0x80) {
+      append(out, size, length, hash, (uint8_t)codepoint);
+    } else if (codepoint < 0x800) {
+      append(out, size, length, hash, (uint8_t)(0xC0 | codepoint >> 6));
+      append(out, size, length, hash, (uint8_t)(0x80 | (codepoint & 0x3F)));
+    } else if (codepoint < 0x10000) {
+      append(out, size, length, hash, (uint8_t)(0xE0 | codepoint >> 12));
+      append(out, size, length, hash, (uint8_t)(0x80 | ((codepoint >> 6) & 0x3F)));
+      append(out, size, length, hash, (uint8_t)(0x80 | (codepoint & 0x3F)));
+    } else {
+      append(out, size, length, hash, (uint8_t)(0xF0 | codepoint >> 18));
+      append(out, size, length, hash, (uint8_t)(0x80 | ((codepoint >> 12) & 0x3F)));
+      append(out, size, length, hash, (uint8_t)(0x80 | ((codepoint >> 6) & 0x3F)));
+      append(out, size, length, hash, (uint8_t)(0x80 | (codepoint & 0x3F)));
+    }
+    return MqttSetError::Ok;
+  }
+
+  // String at p_ (on the opening quote) into 'out' (may be nullptr to skip), NUL-terminated
+  MqttSetError::Code readString(char* out, size_t size, size_t* length, uint32_t* hash) {
+    p_++;
+    for (;;) {
+      if (p_ >= end_) {
+        return MqttSetError::IncompleteInput;
+      }
+      const char c = *p_++;
+      if (c == '"') {
+        break;
+      }
+      if (c != '\\') {
+        append(out, size, length, hash, (uint8_t)c);
+        continue;
+      }
+      if (p_ >= end_) {
+        return MqttSetError::IncompleteInput;
+      }
+      const char escaped = *p_++;
+      switch (escaped) {
+        case '"':
+        case '\\':
+        case '/':
+          append(out, size, length, hash, (uint8_t)escaped);
+          break;
+        case 'b':
+          append(out, size, length, hash, '\b');
+          break;
+        case 'f':
+          append(out, size, length, hash, '\f');
+          break;
+        case 'n':
+          append(out, size, length, hash, '\n');
+          break;
+        case 'r':
+          append(out, size, length, hash, '\r');
+          break;
+        case 't':
+          append(out, size, length, hash, '\t');
+          break;
+        case 'u': {
+          const MqttSetError::Code code = readUnicode(out, size, length, hash);
+          if (code != MqttSetError::Ok) {
+            return code;
+          }
+          break;
+        }
+        default:
+          return MqttSetError::InvalidInput;
+      }
+    }
+    if (out != nullptr) {
+      out[*length < size - 1 ? *length : size - 1] = '\0';
+    }
+    return MqttSetError::Ok;
+  }
+
+  MqttSetError::Code readLiteral(const char* word) {
+    for (; *word != '\0'; word++, p_++) {
+      if (p_ >= end_) {
+        return MqttSetError::IncompleteInput;
+      }
+      if (*p_ != *word) {
+        return MqttSetError::InvalidInput;
+      }
+    }
+    return MqttSetError::Ok;
+  }
+
+  // Nested object or array at p_, skipped without recursion. 'depth' counts the enclosing levels;
+  // a bit per level remembers whether it closes with '}' or ']'.
+  MqttSetError::Code skipCompound(uint8_t depth) {
+    enum Expect : uint8_t { FIRST, KEY, VALUE, SEPARATOR };
+    uint16_t closesWithBrace = 0;
+    uint8_t level = 0;
+    Expect expect = VALUE;
+    for (;;) {
+      skipSpace();
+      if (p_ >= end_) {
+        return MqttSetError::IncompleteInput;
+      }
+      const char c = *p_;
+      const bool inObject = level > 0 && ((closesWithBrace >> (level - 1)) & 1) != 0;
+      if ((expect == FIRST || expect == SEPARATOR) && c == (inObject ? '}' : ']')) {
+        p_++;
+        if (--level == 0) {
+          return MqttSetError::Ok;
+        }
+        expect = SEPARATOR;
+        continue;
+      }
+      if (expect == SEPARATOR) {
+        if (c != ',') {
+          return MqttSetError::InvalidInput;
+        }
+        p_++;
+        expect = inObject ? KEY : VALUE;
+        continue;
+      }
+      if (expect == KEY || (expect == FIRST && inObject)) {
+        if (c != '"') {
+          return MqttSetError::InvalidInput;
+        }
+        size_t ignored = 0;
+        const MqttSetError::Code code = readString(nullptr, 0, &ignored, nullptr);
+        if (code != MqttSetError::Ok) {
+          return code;
+        }
+        skipSpace();
+        if (p_ >= end_) {
+          return MqttSetError::IncompleteInput;
+        }
+        if (*p_ != ':') {
+          return MqttSetError::InvalidInput;
+        }
+        p_++;
+        expect = VALUE;
+        continue;
+      }
+      if (c == '{' || c == '[') {
+        if (depth + level >= MQTT_SET_MAX_DEPTH) {
+          return MqttSetError::TooDeep;
+        }
+        closesWithBrace = (uint16_t)((closesWithBrace & ~(1u << level)) | (c == '{' ? 1u << level : 0u));
+        level++;
+        p_++;
+        expect = FIRST;
+        continue;
+      }
+      MqttSetValue scalar;
+      const MqttSetError::Code code = readScalar(scalar);
+      if (code != MqttSetError::Ok) {
+        return code;
+      }
+      expect = SEPARATOR;
+    }
+  }
+
+  MqttSetError::Code readScalar(MqttSetValue& value) {
+    const char c = *p_;
+    if (c == '"') {
+      value.type = MqttSetValue::Text;
+      value.text = text_;
+      return readString(text_, sizeof(text_), &value.textLength, nullptr);
+    }
+    if (c == 't' || c == 'f') {
+      value.type = MqttSetValue::Boolean;
+      value.boolean = c == 't';
+      return readLiteral(c == 't' ? "true" : "false");
+    }
+    if (c == 'n') {
+      value.type = MqttSetValue::Null;
+      return readLiteral("null");
+    }
+    if (c == '-' || MqttSetCommandDetail::isDigit(c)) {
+      value.type = MqttSetValue::Number;
+      return MqttSetCommandDetail::parseNumber(p_, end_, &p_, &value.number);
+    }
+    return MqttSetError::InvalidInput;
+  }
+
+  MqttSetError::Code readValue(MqttSetValue& value, uint8_t depth) {
+    skipSpace();
+    if (p_ >= end_) {
+      return MqttSetError::IncompleteInput;
+    }
+    if (*p_ == '{' || *p_ == '[') {
+      value.type = MqttSetValue::Compound;
+      return skipCompound(depth);
+    }
+    return readScalar(value);
+  }
+};
+
+/*
+ * Perfect hash over a constexpr table of MqttSetCommand rows. The seed is searched at compile time
+ * for one that gives every key its own slot; a table with a duplicate key fails the static_assert.
+ */
+template <size_t N, const MqttSetCommand (&Commands)[N]>
+class MqttSetTable {
+ public:
+  static constexpr size_t SLOT_COUNT = MqttSetCommandDetail::slotCountFor(N);
+  static constexpr uint32_t SEED = MqttSetCommandDetail::findSeed(Commands);
+  static_assert(N > 0 && N < MqttSetCommandDetail::NO_COMMAND, "MqttSetTable needs 1 to 254 commands");
+  static_assert(SEED < MqttSetCommandDetail::SEED_LIMIT, "MqttSetTable: no collision-free seed, is a key in the table twice?");
+  static_assert(MqttSetCommandDetail::keysFit(Commands), "MqttSetTable: a key is longer than MQTT_SET_KEY_LEN - 1");
+
+  // The row for a key hashed with SEED, or nullptr
+  static const MqttSetCommand* find(uint32_t hash, const char* key, size_t keyLength) {
+    const uint8_t index = owner(MqttSetCommandDetail::slotOf(hash, SLOT_COUNT),
+                                typename MqttSetCommandDetail::MakeIndices<SLOT_COUNT>::type());
+    if (index == MqttSetCommandDetail::NO_COMMAND || keyLength >= MQTT_SET_KEY_LEN || strcmp(Commands[index].key, key) != 0) {
+      return nullptr;
+    }
+    return &Commands[index];
+  }
+
+  static const MqttSetCommand* find(const char* key) {
+    return find(MqttSetCommandDetail::hashOf(key, MqttSetCommandDetail::hashStart(SEED)), key, strlen(key));
+  }
+
+  // Checks the payload, then runs the handler of every known key in payload order
+  static MqttSetError dispatch(const char* json, size_t length) {
+    MqttSetParser parser;
+    MqttSetError error = parser.parse(json, length, SEED, [](uint32_t, const char*, size_t, const MqttSetValue&) {});
+    if (error) {
+      return error;
+    }
+    return parser.parse(json, length, SEED, [](uint32_t hash, const char* key, size_t keyLength, const MqttSetValue& value) {
+      const MqttSetCommand* command = find(hash, key, keyLength);
+      if (command != nullptr) {
+        command->handler(value);
+      }
+    });
+  }
+
+ private:
+  template <size_t... Slot>
+  static uint8_t owner(size_t slot, MqttSetCommandDetail::Indices<Slot...>) {
+    static const uint8_t owners[SLOT_COUNT] = {MqttSetCommandDetail::ownerOf(Commands, SEED, Slot)...};
+    return owners[slot];
+  }
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Allocation-free serializer for flat JSON objects of numbers, such as the energy state
+ * {"Forbrug":3.452,"Momentan":3.46,"Total":12345.678,"Subtotal":42.1}.
+ *
+ * The keys are template arguments, so the key text and the size bound are fixed at compile time
+ * and write() only formats the numbers, straight into the caller's buffer (the MQTT outbound ring
+ * slot). The output is byte-identical to ArduinoJson 7's serializeJson() of a JsonDocument holding
+ * the same doubles: numbers are formatted like TextFormatter::writeFloat(), with 9 significant
+ * decimals for a double and 6 for a value ArduinoJson stores as float (one that converts to float
+ * without loss), the decimals reduced by the number of integral digits, rounded half up and
+ * trailing zeros removed.
+ *
+ * ArduinoJson switches to exponent notation at or above 1e7 and at or below 1e-5. Those values,
+ * NaN and infinity are not handled here: fits() returns false and the caller uses ArduinoJson.
+ */
+
+namespace MqttStateJsonDetail {
+
+constexpr uint32_t POWERS_OF_TEN[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+constexpr size_t MAX_NUMBER_LENGTH = 1 + 7 + 1 + 9; // Sign, integral digits below 1e7, dot, decimals
+
+inline bool fits(double value) {
+  double magnitude = value < 0 ? -value : value;
+  return magnitude == 0.0 || (magnitude > 1e-5 && magnitude < 1e7);
+}
+
+inline char* writeUnsigned(char* out, uint32_t value) {
+  char digits[10];
+  uint8_t count = 0;
+  do {
+    digits[count++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+  while (count > 0) {
+    *out++ = digits[--count];
+  }
+  return out;
+}
+
+// One number as ArduinoJson writes it (see above). 'value' must satisfy fits().
+inline char* writeNumber(char* out, double value) {
+  if (value < 0) {
+    *out++ = '-';
+    value = -value;
+  }
+  int8_t decimalPlaces = (double)(float)value == value ? 6 : 9;
+  uint32_t maxDecimalPart = POWERS_OF_TEN[decimalPlaces];
+  uint32_t integral = (uint32_t)value;
+  for (uint32_t tmp = integral; tmp >= 10; tmp /= 10) {
+    maxDecimalPart /= 10;
+    decimalPlaces--;
+  }
+  double remainder = (value - (double)integral) * (double)maxDecimalPart;
+  uint32_t decimal = (uint32_t)remainder;
+  remainder = remainder - (double)decimal;
+  decimal += (uint32_t)(remainder * 2); // Round half up
+  if (decimal >= maxDecimalPart) {
+    decimal = 0;
+    integral++;
+  }
+  while (decimal % 10 == 0 && decimalPlaces > 0) {
+    decimal /= 10;
+    decimalPlaces--;
+  }
+
+  out = writeUnsigned(out, integral);
+  if (decimalPlaces > 0) {
+    *out++ = '.';
+    for (int8_t digit = decimalPlaces - 1; digit >= 0; digit--) {
+      *out++ = (char)('0' + (decimal / POWERS_OF_TEN[digit]) % 10);
+    }
+  }
+  return out;
+}
+
+constexpr size_t keysLength() { return 0; }
+
+template <typename... Rest>
+constexpr size_t keysLength(const char* key, Rest... rest) {
+  return (key[0] == '\0' ? 0 : 1 + keysLength(key + 1)) + keysLength(rest...);
+}
+
+}  // namespace MqttStateJsonDetail
+
+template <const char*... Keys>
+class MqttStateJson {
+ public:
+  static constexpr size_t KEY_COUNT = sizeof...(Keys);
+  static_assert(KEY_COUNT > 0, "MqttStateJson needs at least one key");
+
+  // Longest possible output, without a terminating NUL: {"key":number,...}
+  static constexpr size_t MAX_LENGTH =
+      2 + MqttStateJsonDetail::keysLength(Keys...) + KEY_COUNT * (3 + MqttStateJsonDetail::MAX_NUMBER_LENGTH) + (KEY_COUNT - 1);
+
+  static bool fits(const double (&values)[KEY_COUNT]) {
+    for (double value : values) {
+      if (!MqttStateJsonDetail::fits(value)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Writes the object into 'out' (at least MAX_LENGTH + 1 bytes) and returns its length.
+  // The values must pass fits().
+  static size_t write(char* out, const double (&values)[KEY_COUNT]) {
+    static const char* const keys[KEY_COUNT] = {Keys...};
+    char* p = out;
+    *p++ = '{';
+    for (size_t i = 0; i < KEY_COUNT; i++) {
+      if (i > 0) {
+        *p++ = ',';
+      }
+      *p++ = '"';
+      size_t keyLength = strlen(keys[i]);
+      memcpy(p, keys[i], keyLength);
+      p += keyLength;
+      *p++ = '"';
+      *p++ = ':';
+      p = MqttStateJsonDetail::writeNumber(p, values[i]);
+    }
+    *p++ = '}';
+    *p = '\0';
+    return (size_t)(p - out);
+  }
+};
@@ -0,0 +1,208 @@
+#include "MqttTransport.h"
+
+#include <errno.h>
+#include <lwip/sockets.h>
+
+namespace {
+// Handed to PubSubClient::connect() in place of the broker's answer: CONNACK, remaining length 2,
+// no session present, connection accepted
+constexpr uint8_t SYNTHETIC_CONNACK[4] = {0x20, 0x02, 0x00, 0x00};
+}  // namespace
+
+/* ###################################################################################################
+ *               C O N N E C T
+ * ###################################################################################################
+ */
+bool MqttTransport::beginConnect(const char* host, uint16_t port) {
+  stop();
+  lastError_ = 0;
+
+  IPAddress ip;
+  if (!ip.fromString(host) && WiFi.hostByName(host, ip) != 1) { // Only a host name costs a (blocking) DNS lookup
+    lastError_ = EHOSTUNREACH;
+    return false;
+  }
+  int fd = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd < 0) {
+    lastError_ = errno;
+    return false;
+  }
+  lwip_fcntl(fd, F_SETFL, lwip_fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+  struct sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = (uint32_t)ip;
+  if (lwip_connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0 && errno != EINPROGRESS) {
+    lastError_ = errno;
+    lwip_close(fd);
+    return false;
+  }
+  fd_ = fd;
+  phase_ = PHASE_TCP;
+  return true;
+}
+
+MqttTransport::Poll MqttTransport::pollConnect() {
+  if (phase_ != PHASE_TCP) {
+    return phase_ == PHASE_CLOSED ? POLL_FAILED : POLL_DONE;
+  }
+
+  fd_set writeSet;
+  FD_ZERO(&writeSet);
+  FD_SET(fd_, &writeSet);
+  struct timeval noWait = {0, 0};
+  int ready = lwip_select(fd_ + 1, nullptr, &writeSet, nullptr, &noWait);
+  if (ready == 0) {
+    return POLL_PENDING;
+  }
+  int error = 0;
+  socklen_t length = sizeof(error);
+  if (ready < 0 || lwip_getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+    error = errno;
+  }
+  if (error != 0) {
+    lastError_ = error;
+    stop();
+    return POLL_FAILED;
+  }
+
+  // Leave the socket as WiFiClient::connect() would: blocking, no Nagle, keep-alive on
+  lwip_fcntl(fd_, F_SETFL, lwip_fcntl(fd_, F_GETFL, 0) & ~O_NONBLOCK);
+  int enable = 1;
+  lwip_setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  lwip_setsockopt(fd_, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable));
+
+  client_ = WiFiClient(fd_); // Closes the socket when stopped
+  fd_ = -1;
+  phase_ = PHASE_HANDSHAKE;
+  syntheticRead_ = 0;
+  connackLength_ = 0;
+  return POLL_DONE;
+}
+
+MqttTransport::Poll MqttTransport::pollConnack() {
+  if (phase_ == PHASE_OPEN) {
+    return POLL_DONE;
+  }
+  if (phase_ != PHASE_CONNACK) {
+    return POLL_FAILED; // PubSubClient::connect() did not run, or failed
+  }
+
+  while (connackLength_ < sizeof(connack_) && client_.available() > 0) {
+    connack_[connackLength_++] = (uint8_t)client_.read();
+  }
+  if (connackLength_ < sizeof(connack_)) {
+    if (!client_.connected()) {
+      lastError_ = ECONNRESET;
+      stop();
+      return POLL_FAILED;
+    }
+    return POLL_PENDING;
+  }
+  if (connack_[0] != SYNTHETIC_CONNACK[0] || connack_[1] != SYNTHETIC_CONNACK[1]) {
+    lastError_ = EPROTO;
+    stop();
+    return POLL_FAILED;
+  }
+  if (connack_[3] != 0) {
+    lastError_ = connack_[3]; // 1..5, same as PubSubClient's state()
+    stop();
+    return POLL_FAILED;
+  }
+  phase_ = PHASE_OPEN;
+  return POLL_DONE;
+}
+
+/* ###################################################################################################
+ *               C L I E N T
+ * ###################################################################################################
+ */
+int MqttTransport::connect(IPAddress ip, uint16_t port) {
+  (void)ip;
+  (void)port;
+  return connected() ? 1 : 0;
+}
+
+int MqttTransport::connect(const char* host, uint16_t port) {
+  (void)host;
+  (void)port;
+  return connected() ? 1 : 0;
+}
+
+int MqttTransport::connect(IPAddress ip, uint16_t port, int32_t timeout) {
+  (void)timeout;
+  return connect(ip, port);
+}
+
+int MqttTransport::connect(const char* host, uint16_t port, int32_t timeout) {
+  (void)timeout;
+  return connect(host, port);
+}
+
+size_t MqttTransport::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t MqttTransport::write(const uint8_t* buffer, size_t size) {
+  return phase_ >= PHASE_HANDSHAKE ? client_.write(buffer, size) : 0;
+}
+
+int MqttTransport::available() {
+  switch (phase_) {
+    case PHASE_HANDSHAKE:
+      return sizeof(SYNTHETIC_CONNACK) - syntheticRead_;
+    case PHASE_OPEN:
+      return client_.available();
+    default:
+      return 0;
+  }
+}
+
+int MqttTransport::read() {
+  if (phase_ == PHASE_HANDSHAKE) {
+    uint8_t value = SYNTHETIC_CONNACK[syntheticRead_++];
+    if (syntheticRead_ == sizeof(SYNTHETIC_CONNACK)) {
+      phase_ = PHASE_CONNACK;
+    }
+    return value;
+  }
+  return phase_ == PHASE_OPEN ? client_.read() : -1;
+}
+
+int MqttTransport::read(uint8_t* buffer, size_t size) {
+  if (phase_ == PHASE_HANDSHAKE) {
+    size_t count = 0;
+    while (count < size && phase_ == PHASE_HANDSHAKE) {
+      buffer[count++] = (uint8_t)read();
+    }
+    return (int)count;
+  }
+  return phase_ == PHASE_OPEN ? client_.read(buffer, size) : -1;
+}
+
+int MqttTransport::peek() {
+  if (phase_ == PHASE_HANDSHAKE) {
+    return SYNTHETIC_CONNACK[syntheticRead_];
+  }
+  return phase_ == PHASE_OPEN ? client_.peek() : -1;
+}
+
+void MqttTransport::flush() {
+  if (phase_ >= PHASE_HANDSHAKE) {
+    client_.flush();
+  }
+}
+
+void MqttTransport::stop() {
+  client_.stop();
+  if (fd_ >= 0) {
+    lwip_close(fd_);
+    fd_ = -1;
+  }
+  phase_ = PHASE_CLOSED;
+}
+
+uint8_t MqttTransport::connected() {
+  return phase_ >= PHASE_HANDSHAKE && client_.connected() ? 1 : 0;
+}
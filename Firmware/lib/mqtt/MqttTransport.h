@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include <WiFi.h>
+
+/*
+ * Non-blocking connection underneath PubSubClient.
+ *
+ * PubSubClient::connect() blocks twice: in WiFiClient::connect() for the TCP handshake and in a
+ * busy loop waiting for the CONNACK, each for up to the socket timeout. MqttTransport splits both
+ * out so the network task can drive a connect one poll at a time:
+ *
+ *   beginConnect()           opens a non-blocking lwIP socket and starts the TCP handshake
+ *   pollConnect()            select()s it with a zero timeout until the handshake has finished
+ *   PubSubClient::connect()  finds the transport connected, writes CONNECT and is answered at once
+ *                            with a synthetic "accepted" CONNACK, so it returns without waiting
+ *   pollConnack()            reads the broker's real CONNACK, which PubSubClient never sees
+ *
+ * Until pollConnack() has returned POLL_DONE the session must not be used: nothing but CONNECT has
+ * been sent and nothing the broker sends is passed on to PubSubClient.
+ */
+class MqttTransport : public Client {
+ public:
+  enum Poll : uint8_t { POLL_PENDING, POLL_DONE, POLL_FAILED };
+
+  bool beginConnect(const char* host, uint16_t port); // false: name not resolved or no free socket
+  Poll pollConnect();
+  Poll pollConnack();
+  int lastError() const { return lastError_; }         // errno of a failed TCP connect, else the CONNACK return code
+
+  // Client, as used by PubSubClient. connect() never opens a connection, it only reports one
+  // opened by beginConnect()/pollConnect().
+  int connect(IPAddress ip, uint16_t port);
+  int connect(const char* host, uint16_t port);
+  int connect(IPAddress ip, uint16_t port, int32_t timeout);
+  int connect(const char* host, uint16_t port, int32_t timeout);
+  size_t write(uint8_t c);
+  size_t write(const uint8_t* buffer, size_t size);
+  int available();
+  int read();
+  int read(uint8_t* buffer, size_t size);
+  int peek();
+  void flush();
+  void stop();
+  uint8_t connected();
+  operator bool() { return connected() != 0; }
+
+ private:
+  enum Phase : uint8_t {
+    PHASE_CLOSED,
+    PHASE_TCP,          // Non-blocking connect in progress on fd_
+    PHASE_HANDSHAKE,    // TCP up; PubSubClient reads the synthetic CONNACK
+    PHASE_CONNACK,      // Waiting for the broker's CONNACK
+    PHASE_OPEN
+  };
+
+  WiFiClient client_;
+  int fd_ = -1;                    // Socket while PHASE_TCP; then owned by client_
+  Phase phase_ = PHASE_CLOSED;
+  uint8_t syntheticRead_ = 0;      // Bytes of the synthetic CONNACK handed to PubSubClient
+  uint8_t connack_[4] = {};
+  uint8_t connackLength_ = 0;
+  int lastError_ = 0;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Fixed-point energy and power on the pulse path.
+ *
+ * Pulse counters are 64-bit and everything derived from them is integer:
+ *
+ *  energy  milliwatt-hours (uint64_t). Exact for every meter constant that divides 1,000,000
+ *          (100, 1000, 10000 imp/kWh ...), otherwise truncated to the mWh below.
+ *  power   watts (uint32_t), rounded to nearest.
+ *
+ * Conversion to float/double happens only where the values leave the firmware: the MQTT state
+ * JSON, the OLED display and the charging session log. A float kWh value stops resolving single
+ * pulses above 2^24 pulses (~1,677 kWh on a 10000 imp/kWh meter); a uint64_t mWh value does not
+ * overflow below 1.8e13 kWh.
+ */
+
+constexpr uint64_t MILLI_WH_PER_KWH = 1000000ULL;
+constexpr uint64_t MICROSECOND_WATTS_PER_KWH = 3600000000000ULL; // 1 kWh = 3.6e12 W * us
+
+// Energy of 'pulses'. Split into whole kWh and remainder so 'pulses * 1e6' cannot overflow.
+constexpr uint64_t pulsesToMilliWh(uint64_t pulses, uint16_t pulsePerKWh) {
+  return pulsePerKWh == 0 ? 0
+                          : (pulses / pulsePerKWh) * MILLI_WH_PER_KWH +
+                                (pulses % pulsePerKWh) * MILLI_WH_PER_KWH / pulsePerKWh;
+}
+
+// Pulses closest to 'milliWh' (MQTT "Total" set command).
+constexpr uint64_t milliWhToPulses(uint64_t milliWh, uint16_t pulsePerKWh) {
+  return (milliWh / MILLI_WH_PER_KWH) * pulsePerKWh +
+         ((milliWh % MILLI_WH_PER_KWH) * pulsePerKWh + MILLI_WH_PER_KWH / 2) / MILLI_WH_PER_KWH;
+}
+
+constexpr uint32_t saturateToUint32(uint64_t value) {
+  return value > UINT32_MAX ? UINT32_MAX : (uint32_t)value;
+}
+
+// Power of 'pulses' pulses in 'spanUs', each interval lengthened by the pulse time correction
+// (TaskParams_t::ptCorrection), exactly as calculatePower() applied it to a single interval.
+// Saturates at UINT32_MAX W, which spans of a few microseconds (bounce) on slow meters exceed.
+constexpr uint32_t pulseSpanToWatts(uint64_t spanUs, uint32_t pulses, uint16_t pulsePerKWh, uint32_t ptCorrectionUs) {
+  return (pulses == 0 || pulsePerKWh == 0 || spanUs + (uint64_t)ptCorrectionUs * pulses == 0)
+             ? 0
+             : saturateToUint32((MICROSECOND_WATTS_PER_KWH * pulses +
+                                 (pulsePerKWh * (spanUs + (uint64_t)ptCorrectionUs * pulses)) / 2) /
+                                (pulsePerKWh * (spanUs + (uint64_t)ptCorrectionUs * pulses)));
+}
+
+// JSON / display edge
+inline double milliWhToKwh(uint64_t milliWh) {
+  return (double)(milliWh / MILLI_WH_PER_KWH) + (double)(milliWh % MILLI_WH_PER_KWH) / (double)MILLI_WH_PER_KWH;
+}
+
+inline double wattsToKw(uint32_t watts) {
+  return (double)watts / 1000.0;
+}
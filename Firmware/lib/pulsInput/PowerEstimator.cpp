@@ -0,0 +1,124 @@
+#include "PowerEstimator.h"
+#include "EnergyMath.h"
+
+const char* powerEstimatorModeName(PowerEstimatorMode mode) {
+  switch (mode) {
+    case POWER_MODE_SINGLE:       return "single";
+    case POWER_MODE_PULSE_WINDOW: return "pulses";
+    case POWER_MODE_TIME_WINDOW:  return "time";
+    case POWER_MODE_EWMA:         return "ewma";
+  }
+  return "?";
+}
+
+PowerEstimator::PowerEstimator(PowerEstimatorMode mode, uint16_t windowPulses, uint32_t windowMs, uint32_t ewmaTauMs)
+    : mode_(mode),
+      windowPulses_(windowPulses > 0 ? windowPulses : 1),
+      windowUs_(windowMs * 1000UL),
+      ewmaTauUs_(ewmaTauMs > 0 ? ewmaTauMs * 1000UL : 1) {}
+
+void PowerEstimator::setCalibration(uint16_t pulsePerKWh, uint32_t ptCorrectionUs) {
+  pulsePerKWh_ = pulsePerKWh;
+  ptCorrectionUs_ = ptCorrectionUs;
+}
+
+void PowerEstimator::reset() {
+  head_ = 0;
+  size_ = 0;
+  pendingPulses_ = 0;
+  instantW_ = 0;
+  smoothedQ8_ = 0;
+}
+
+const PowerEstimator::Sample& PowerEstimator::sample(uint8_t age) const {
+  return history_[(head_ + POWER_HISTORY_CAPACITY - 1 - age) % POWER_HISTORY_CAPACITY];
+}
+
+uint32_t PowerEstimator::spanPower(uint32_t spanUs, uint32_t pulses) const {
+  return pulseSpanToWatts(spanUs, pulses, pulsePerKWh_, ptCorrectionUs_);
+}
+
+/* ###################################################################################################
+ *               A D D   P U L S E S
+ * ###################################################################################################
+ */
+void PowerEstimator::addPulses(uint32_t count, uint32_t timestampUs) {
+  if (count == 0) {
+    return;
+  }
+  if (size_ > 0 && timestampUs == sample(0).timestampUs) {
+    pendingPulses_ += count;
+    return;
+  }
+
+  uint32_t pulses = count + pendingPulses_;
+  pendingPulses_ = 0;
+  bool hadInterval = hasInterval();
+  uint32_t intervalUs = size_ > 0 ? timestampUs - sample(0).timestampUs : 0;
+
+  history_[head_] = {timestampUs, pulses};
+  head_ = (head_ + 1) % POWER_HISTORY_CAPACITY;
+  if (size_ < POWER_HISTORY_CAPACITY) {
+    size_++;
+  }
+  if (!hasInterval()) {
+    return; // First event: nothing to measure yet
+  }
+
+  instantW_ = spanPower(intervalUs, pulses);
+
+  switch (mode_) {
+    case POWER_MODE_SINGLE:
+      smoothedQ8_ = (uint64_t)instantW_ << 8;
+      break;
+    case POWER_MODE_PULSE_WINDOW:
+    case POWER_MODE_TIME_WINDOW:
+      smoothedQ8_ = (uint64_t)windowPower() << 8;
+      break;
+    case POWER_MODE_EWMA:
+      if (!hadInterval) {
+        smoothedQ8_ = (uint64_t)instantW_ << 8;
+      } else {
+        // smoothed += alpha * (instant - smoothed), alpha = dt / (tau + dt) in Q16
+        uint64_t alphaQ16 = ((uint64_t)intervalUs << 16) / ((uint64_t)ewmaTauUs_ + intervalUs);
+        int64_t deltaQ8 = (int64_t)((uint64_t)instantW_ << 8) - (int64_t)smoothedQ8_;
+        smoothedQ8_ = (uint64_t)((int64_t)smoothedQ8_ + deltaQ8 * (int64_t)alphaQ16 / 65536);
+      }
+      break;
+  }
+}
+
+// Mean interval from the newest sample back until the window is filled or the history ends
+uint32_t PowerEstimator::windowPower() const {
+  uint32_t pulses = 0;
+  uint32_t spanUs = 0;
+  for (uint8_t age = 1; age < size_; age++) {
+    pulses += sample(age - 1).pulses;
+    spanUs = sample(0).timestampUs - sample(age).timestampUs;
+    if (mode_ == POWER_MODE_PULSE_WINDOW ? pulses >= windowPulses_ : spanUs >= windowUs_) {
+      break;
+    }
+  }
+  return pulses > 0 ? spanPower(spanUs, pulses) : instantW_;
+}
+
+/* ###################################################################################################
+ *               D E C A Y
+ * ###################################################################################################
+ */
+bool PowerEstimator::decay(uint32_t nowUs) {
+  if (size_ == 0) {
+    return false;
+  }
+  uint32_t boundW = spanPower(nowUs - sample(0).timestampUs, 1);
+  bool lowered = false;
+  if (instantW_ > boundW) {
+    instantW_ = boundW;
+    lowered = true;
+  }
+  if (smoothedW() > boundW) {
+    smoothedQ8_ = (uint64_t)boundW << 8;
+    lowered = true;
+  }
+  return lowered;
+}
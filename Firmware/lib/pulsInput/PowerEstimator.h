@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "PulseInputModes.h"
+
+/*
+ * Power estimation from S0 pulse timestamps.
+ *
+ * Every pulse is 1/pulse_per_kWh kWh, so power is the pulse rate scaled by the meter constant.
+ * PowerEstimator keeps the timestamps of the last POWER_HISTORY_CAPACITY pulse events in a fixed
+ * ring and derives two readings from them:
+ *
+ *  instantW()   power from the last interval alone (what calculatePower() used to return).
+ *  smoothedW()  power according to the selected mode:
+ *
+ *    POWER_MODE_SINGLE        same as instantW().
+ *    POWER_MODE_PULSE_WINDOW  mean interval over the last 'windowPulses' pulses.
+ *    POWER_MODE_TIME_WINDOW   mean interval over the pulses of the last 'windowMs' milliseconds
+ *                             (at least one interval).
+ *    POWER_MODE_EWMA          exponentially weighted moving average of instantW() with time
+ *                             constant 'ewmaTauMs'. The weight of each interval grows with its
+ *                             length (dt / (tau + dt)), so slow and fast pulse rates settle in
+ *                             the same time.
+ *
+ * All arithmetic is integer (see EnergyMath.h); readings are whole watts.
+ *
+ * When pulses stop, decay() caps both readings at the power of one pulse in the time since the
+ * last one: a higher power would already have produced the next pulse.
+ *
+ * The class has no Arduino or FreeRTOS dependencies and is not thread safe; PulseInputTask owns
+ * the instance, and the native harness replays recorded pulse traces through it.
+ */
+
+constexpr uint8_t POWER_HISTORY_CAPACITY = 32; // Pulse events kept for the window modes
+
+const char* powerEstimatorModeName(PowerEstimatorMode mode);
+
+class PowerEstimator {
+ public:
+  PowerEstimator(PowerEstimatorMode mode, uint16_t windowPulses, uint32_t windowMs, uint32_t ewmaTauMs);
+
+  // Meter constant and pulse time correction (TaskParams_t::pulse_per_kWh / ptCorrection).
+  void setCalibration(uint16_t pulsePerKWh, uint32_t ptCorrectionUs);
+
+  // 'count' pulses, the last of them at 'timestampUs'. Pulses under a repeated timestamp (PCNT
+  // backend polled before the edge time moved) are carried into the next interval.
+  void addPulses(uint32_t count, uint32_t timestampUs);
+
+  // No pulse since the last event at 'nowUs'. Returns true when a reading was lowered.
+  bool decay(uint32_t nowUs);
+
+  void reset();
+
+  uint32_t instantW() const { return instantW_; }
+  uint32_t smoothedW() const { return (uint32_t)((smoothedQ8_ + 128) >> 8); }
+  PowerEstimatorMode mode() const { return mode_; }
+  bool hasInterval() const { return size_ >= 2; }
+
+ private:
+  struct Sample {
+    uint32_t timestampUs;
+    uint32_t pulses; // Pulses between the previous sample and this one
+  };
+
+  const Sample& sample(uint8_t age) const; // 0 = newest
+  uint32_t spanPower(uint32_t spanUs, uint32_t pulses) const;
+  uint32_t windowPower() const;
+
+  PowerEstimatorMode mode_;
+  uint16_t windowPulses_;
+  uint32_t windowUs_;
+  uint32_t ewmaTauUs_;
+  uint16_t pulsePerKWh_ = 0;
+  uint32_t ptCorrectionUs_ = 0;
+
+  Sample history_[POWER_HISTORY_CAPACITY] = {};
+  uint8_t head_ = 0; // Next slot to write
+  uint8_t size_ = 0;
+  uint32_t pendingPulses_ = 0; // Counted under a repeated timestamp, belong to the next interval
+
+  uint32_t instantW_ = 0;
+  uint64_t smoothedQ8_ = 0; // Watts with 8 fractional bits, so the EWMA does not stall on rounding
+};
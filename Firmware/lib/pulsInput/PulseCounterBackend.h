@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "PulseInputModes.h"
+
+/*
+ * Pulse counting backends for PulseInputTask.
+ *
+ * A backend turns S0 edges on the pulse GPIO into PulseEvents, which PulseInputTask drains with
+ * poll(). Two backends exist, selected with PULSE_COUNTER_BACKEND in config.h:
+ *
+ *  PULSE_BACKEND_ISR   one interrupt per pulse. PulseInputISR() pushes micros() into a lock-free
+ *                      ring and notifies the task, so every event is one pulse with its own
+ *                      timestamp.
+ *  PULSE_BACKEND_PCNT  the ESP32 pulse counter peripheral counts edges in hardware behind its
+ *                      glitch filter. The task reads the counter every PULSE_PCNT_POLL_MS and gets
+ *                      one event per poll: the number of new pulses and the timestamp of the last
+ *                      edge. A minimal edge-capture interrupt records that timestamp and is used
+ *                      for power estimation only. Every edge that passes the glitch filter is
+ *                      counted, bounce included (see PulsePcntBackend.cpp).
+ */
+
+struct PulseEvent {
+  uint32_t count;        // Pulses represented by this event (always 1 for the ISR backend)
+  uint32_t timestampUs;  // micros() of the last of those pulses
+};
+
+class PulseCounterBackend {
+ public:
+  virtual ~PulseCounterBackend() = default;
+
+  virtual const char* name() const = 0;
+
+  // Start counting on 'gpio'. 'consumer' is the task draining events; it may be notified when
+  // new events are ready.
+  virtual bool attach(int gpio, int mode, TaskHandle_t consumer) = 0;
+  virtual void suspend() = 0; // Stop counting (OTA)
+  virtual void resume() = 0;
+
+  // Next pending event. Returns false when nothing is pending.
+  virtual bool poll(PulseEvent* event) = 0;
+
+  // Longest time the consumer may block before calling poll() again.
+  virtual TickType_t pollIntervalTicks() const = 0;
+
+  virtual uint32_t overflowCount() const = 0; // Pulses lost before the task could read them
+  virtual uint32_t capacity() const = 0;      // Pulses the backend can hold between two polls
+  virtual uint32_t peakFill() const = 0;      // Most pulses seen pending at once
+};
+
+PulseCounterBackend* getPulseCounterBackend(PulseCounterBackendType type);
+PulseCounterBackend* getPulseIsrBackend();
+PulseCounterBackend* getPulsePcntBackend();
@@ -3,6 +3,12 @@
 #define STACK_WATERMARK
 
 #include "PulseInputTask.h"
+#include "PulseLatency.h"
+#include "PulseCounterBackend.h"
+#include "PowerEstimator.h"
+#include "EnergyMath.h"
+#include "PulseJournal.h"
+#include "PulseRtcShadow.h"
 #include "MqttClient.h"
 #include "TeslaSheets.h"
 #include "config.h"
@@ -13,18 +19,18 @@
 #include <Preferences.h>
 #include <esp_system.h>
 
-#define SAVE_INTERVAL_MS 60000  // Save to NVS every 60 seconds
-
 static TaskHandle_t PulseInputTaskHandle = nullptr;
-static QueueHandle_t PulseInputQueue = nullptr;
+static PulseCounterBackend* sPulseBackend = nullptr;
+static uint32_t sPulseBatchWindowMs = PULSE_BATCH_WINDOW_MS; // selectPulseBatchWindow() may override it before the task starts
 static volatile bool PulseInputTaskReady = false;
 static portMUX_TYPE PulseCounterMux = portMUX_INITIALIZER_UNLOCKED;
 static volatile bool PulseCounterUpdatePending = false;
-static volatile uint32_t PendingPulseCounter = 0;
+static volatile uint64_t PendingPulseCounter = 0;
 static portMUX_TYPE EnergyKwhMux = portMUX_INITIALIZER_UNLOCKED;
-static volatile float LatestEnergyKwh = 0.0f;
-static volatile float LatestPowerW = 0.0f;
-static volatile float LatestSubtotalKwh = 0.0f;
+static volatile uint64_t LatestEnergyMilliWh = 0;
+static volatile uint32_t LatestPowerW = 0;
+static volatile uint32_t LatestInstantPowerW = 0;
+static volatile uint64_t LatestSubtotalMilliWh = 0;
 static portMUX_TYPE SubtotalResetMux = portMUX_INITIALIZER_UNLOCKED;
 static volatile bool SubtotalResetPending = false;
 
@@ -33,27 +39,47 @@ static volatile ResetType_t gResetType = RESET_SOFT;
 static volatile bool gResetRequested = false;
 
 static portMUX_TYPE EmergencyCounterMux = portMUX_INITIALIZER_UNLOCKED;
-static volatile uint32_t gEmergencyPulseCounter = 0;
-static volatile uint16_t gEmergencySubtotalPulseCounter = 0;
+static volatile uint64_t gEmergencyPulseCounter = 0;
+static volatile uint64_t gEmergencySubtotalPulseCounter = 0;
 
 static SemaphoreHandle_t sDirectResetSemaphore = nullptr;
 
-static inline void updateLatestEnergySnapshot(float powerW, float energyKwh, float subtotalKwh) {
+static PulseJournal sPulseJournal;
+static SemaphoreHandle_t sCounterStoreMutex = nullptr; // PulseInputTask and directResetTask both save counters
+
+static portMUX_TYPE PulseCpuMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t sPulseBusyUs = 0;       // Time PulseInputTask spent counting, calculating and publishing pulses
+static uint32_t sPulsesProcessed = 0;
+static uint32_t sPulseSnapshots = 0;    // Energy snapshots (and state publishes) emitted for those pulses
+
+static PowerEstimator sPowerEstimator(POWER_ESTIMATOR_MODE, POWER_WINDOW_PULSES, POWER_WINDOW_MS, POWER_EWMA_TAU_MS);
+
+static inline void updateLatestEnergySnapshot(uint32_t powerW, uint32_t instantPowerW, uint64_t energyMilliWh, uint64_t subtotalMilliWh) {
   portENTER_CRITICAL(&EnergyKwhMux);
   LatestPowerW = powerW;
-  LatestEnergyKwh = energyKwh;
-  LatestSubtotalKwh = subtotalKwh;
+  LatestInstantPowerW = instantPowerW;
+  LatestEnergyMilliWh = energyMilliWh;
+  LatestSubtotalMilliWh = subtotalMilliWh;
   portEXIT_CRITICAL(&EnergyKwhMux);
 }
 
-static inline void updateEmergencyCounters(uint32_t pulseCounter, uint16_t subtotalPulseCounter) {
+static inline void addPulseCpuCost(uint32_t busyUs, uint32_t pulses, uint32_t snapshots) {
+  portENTER_CRITICAL(&PulseCpuMux);
+  sPulseBusyUs += busyUs;
+  sPulsesProcessed += pulses;
+  sPulseSnapshots += snapshots;
+  portEXIT_CRITICAL(&PulseCpuMux);
+}
+
+static inline void updateEmergencyCounters(uint64_t pulseCounter, uint64_t subtotalPulseCounter) {
   portENTER_CRITICAL(&EmergencyCounterMux);
   gEmergencyPulseCounter = pulseCounter;
   gEmergencySubtotalPulseCounter = subtotalPulseCounter;
   portEXIT_CRITICAL(&EmergencyCounterMux);
+  pulseRtcShadowUpdate(pulseCounter, subtotalPulseCounter);
 }
 
-void setPulseCounterFromMqtt(uint32_t newPulseCounter) {
+void setPulseCounterFromMqtt(uint64_t newPulseCounter) {
   portENTER_CRITICAL(&PulseCounterMux);
   PendingPulseCounter = newPulseCounter;
   PulseCounterUpdatePending = true;
@@ -68,26 +94,95 @@ void requestSubtotalReset() {
   publishMqttLog(MQTT_LOG_SUFFIX, "Subtotal reset requested", false);
 }
 
-bool getLatestEnergyKwh(float* energyKwh) {
-  if (!energyKwh) {
+bool getLatestEnergyMilliWh(uint64_t* energyMilliWh) {
+  if (!energyMilliWh) {
     return false;
   }
 
   portENTER_CRITICAL(&EnergyKwhMux);
-  *energyKwh = LatestEnergyKwh;
+  *energyMilliWh = LatestEnergyMilliWh;
   portEXIT_CRITICAL(&EnergyKwhMux);
   return true;
 }
 
-bool getLatestEnergySnapshot(float* powerW, float* energyKwh, float* subtotalKwh) {
-  if (!powerW || !energyKwh || !subtotalKwh) {
+bool getLatestEnergyKwh(float* energyKwh) {
+  uint64_t energyMilliWh = 0;
+  if (!energyKwh || !getLatestEnergyMilliWh(&energyMilliWh)) {
+    return false;
+  }
+  *energyKwh = (float)milliWhToKwh(energyMilliWh);
+  return true;
+}
+
+void getPulseTaskCpuCost(uint32_t* busyUs, uint32_t* pulses, uint32_t* snapshots) {
+  portENTER_CRITICAL(&PulseCpuMux);
+  if (busyUs) {
+    *busyUs = sPulseBusyUs;
+  }
+  if (pulses) {
+    *pulses = sPulsesProcessed;
+  }
+  if (snapshots) {
+    *snapshots = sPulseSnapshots;
+  }
+  portEXIT_CRITICAL(&PulseCpuMux);
+}
+
+bool publishPulseTaskCpuCost() {
+  static uint32_t lastBusyUs = 0;
+  static uint32_t lastPulses = 0;
+  static uint32_t lastSnapshots = 0;
+  static uint32_t lastPublishMs = 0;
+
+  uint32_t busyUs = 0;
+  uint32_t pulses = 0;
+  uint32_t snapshots = 0;
+  getPulseTaskCpuCost(&busyUs, &pulses, &snapshots);
+
+  if (pulses == lastPulses) {
+    return false; // No pulses since the last report
+  }
+
+  uint32_t nowMs = millis();
+  uint32_t periodMs = nowMs - lastPublishMs;
+  uint32_t periodBusyUs = busyUs - lastBusyUs;
+  // Busy time in thousandths of a percent of the reporting period
+  uint32_t loadMilliPercent = periodMs > 0 ? (uint32_t)(((uint64_t)periodBusyUs * 100ULL) / periodMs) : 0;
+
+  char logMsg[128] = {0};
+  snprintf(logMsg,
+           sizeof(logMsg),
+           "mode:%s window_ms:%lu pulses:%lu snapshots:%lu busy_us:%lu load:%lu.%03lu%%",
+           sPulseBatchWindowMs > 0 ? "batch" : "pulse",
+           (unsigned long)sPulseBatchWindowMs,
+           (unsigned long)(pulses - lastPulses),
+           (unsigned long)(snapshots - lastSnapshots),
+           (unsigned long)periodBusyUs,
+           (unsigned long)(loadMilliPercent / 1000),
+           (unsigned long)(loadMilliPercent % 1000));
+  if (!publishMqttLog(MQTT_TOPIC_LOG_PULSE_CPU, logMsg, RETAINED)) {
+    return false;
+  }
+
+  lastBusyUs = busyUs;
+  lastPulses = pulses;
+  lastSnapshots = snapshots;
+  lastPublishMs = nowMs;
+  return true;
+}
+
+bool getLatestEnergySnapshot(uint32_t* powerW, uint64_t* energyMilliWh, uint64_t* subtotalMilliWh, uint32_t* instantPowerW) {
+  if (!powerW || !energyMilliWh || !subtotalMilliWh) {
     return false;
   }
 
   portENTER_CRITICAL(&EnergyKwhMux);
   *powerW = LatestPowerW;
-  *energyKwh = LatestEnergyKwh;
-  *subtotalKwh = LatestSubtotalKwh;
+  if (instantPowerW) {
+    *instantPowerW = LatestInstantPowerW;
+  }
+  *energyMilliWh = LatestEnergyMilliWh;
+  *subtotalMilliWh = LatestSubtotalMilliWh;
   portEXIT_CRITICAL(&EnergyKwhMux);
   return true;
 }
@@ -95,15 +190,43 @@ bool getLatestEnergySnapshot(float* powerW, float* energyKwh, float* subtotalKwh
 /* ###################################################################################################
 *               N V S   H A N D L I N G    L O A D  F R O M
  * ###################################################################################################
+ *  Counters live in the pulse journal (PulseJournal.h). Preferences is read only until the journal
+ *  holds a checkpoint, and is the fallback when the partition table has no journal partition.
  */
-uint32_t loadFromNVS(uint16_t* subtotalPulseCounter) {
+static uint64_t loadStoredCounters(uint64_t* subtotalPulseCounter) {
+  if (sPulseJournal.recovered()) {
+    xSemaphoreTake(sCounterStoreMutex, portMAX_DELAY);
+    PulseJournalState state = sPulseJournal.state();
+    xSemaphoreGive(sCounterStoreMutex);
+    if (subtotalPulseCounter != nullptr) {
+      *subtotalPulseCounter = state.subtotalPulseCounter;
+    }
+    return state.pulseCounter;
+  }
+
   Preferences pref;
   pref.begin(COUNT_NVS_NAMESPACE, true); // true = read-only
-  uint32_t pulseCounter = pref.getUInt("pulse_count", 0);
-  uint32_t subtotalStored = pref.getUInt("subtotal_count", 0);
+  // 64-bit keys since the counters went 64-bit; fall back to the 32-bit keys written by older firmware
+  uint64_t pulseCounter = pref.isKey("pulse_count64") ? pref.getULong64("pulse_count64", 0)
+                                                      : pref.getUInt("pulse_count", 0);
+  uint64_t subtotalStored = pref.isKey("subtotal_cnt64") ? pref.getULong64("subtotal_cnt64", 0)
+                                                         : pref.getUInt("subtotal_count", 0);
   pref.end();
   if (subtotalPulseCounter != nullptr) {
-    *subtotalPulseCounter = (uint16_t)subtotalStored;
+    *subtotalPulseCounter = subtotalStored;
+  }
+  return pulseCounter;
+}
+
+// Stored counters, or the RTC shadow (PulseRtcShadow.h) when a soft reset left it ahead of them
+uint64_t loadFromNVS(uint64_t* subtotalPulseCounter) {
+  uint64_t storedSubtotalPulseCounter = 0;
+  uint64_t storedPulseCounter = loadStoredCounters(&storedSubtotalPulseCounter);
+  uint64_t pulseCounter = storedPulseCounter;
+  uint64_t subtotal = storedSubtotalPulseCounter;
+  pulseRtcShadowLoad(storedPulseCounter, storedSubtotalPulseCounter, &pulseCounter, &subtotal);
+  if (subtotalPulseCounter != nullptr) {
+    *subtotalPulseCounter = subtotal;
   }
   return pulseCounter;
 }
@@ -112,11 +235,11 @@ uint32_t loadFromNVS(uint16_t* subtotalPulseCounter) {
  *               N V S   H A N D L I N G    S A V E    T O
  * ###################################################################################################
  */
-void saveToNVS(uint32_t pulseCounter, uint16_t subtotalPulseCounter) {
+static void saveToPreferences(uint64_t pulseCounter, uint64_t subtotalPulseCounter) {
   Preferences pref;
   pref.begin(COUNT_NVS_NAMESPACE, false); // false = read/write
-  pref.putUInt("pulse_count", pulseCounter);
-  pref.putUInt("subtotal_count", (uint32_t)subtotalPulseCounter);
+  pref.putULong64("pulse_count64", pulseCounter);
+  pref.putULong64("subtotal_cnt64", subtotalPulseCounter);
   pref.end();
 }
 
@@ -127,10 +250,75 @@ static void saveControlledPowerCycleToNVS(bool controlledPowerCycle) {
   pref.end();
 }
 
-static bool trySaveToNVS(uint32_t pulseCounter,
-                         uint16_t subtotalPulseCounter,
-                         uint32_t& lastSavedPulseCounter,
-                         uint16_t& lastSavedSubtotalPulseCounter,
+void saveToNVS(uint64_t pulseCounter, uint64_t subtotalPulseCounter) {
+  xSemaphoreTake(sCounterStoreMutex, portMAX_DELAY);
+  bool journaled = sPulseJournal.save(pulseCounter, subtotalPulseCounter);
+  xSemaphoreGive(sCounterStoreMutex);
+  if (!journaled) {
+    saveToPreferences(pulseCounter, subtotalPulseCounter);
+  }
+  pulseRtcShadowStored(pulseCounter, subtotalPulseCounter);
+}
+
+// Periodic save and boot: erases the journal sector the next rollover needs, so that the save
+// crossing a sector boundary, possibly the emergency save, only programs.
+static void prepareCounterStore() {
+  xSemaphoreTake(sCounterStoreMutex, portMAX_DELAY);
+  sPulseJournal.prepareNextSector();
+  xSemaphoreGive(sCounterStoreMutex);
+}
+
+// directResetTask: with the journal this is a single 16-byte flash write that also carries the
+// controlled power cycle flag, instead of two Preferences sessions.
+static void saveEmergencyToNVS(uint64_t pulseCounter, uint64_t subtotalPulseCounter) {
+  xSemaphoreTake(sCounterStoreMutex, portMAX_DELAY);
+  bool journaled = sPulseJournal.save(pulseCounter, subtotalPulseCounter, true);
+  xSemaphoreGive(sCounterStoreMutex);
+  if (!journaled) {
+    saveToPreferences(pulseCounter, subtotalPulseCounter);
+    saveControlledPowerCycleToNVS(true);
+  }
+}
+
+// Opens the journal once at boot. The first boot with a journal partition copies the Preferences
+// counters into it; a journaled emergency save marks the boot as a controlled power cycle.
+static void initCounterStore() {
+  sCounterStoreMutex = xSemaphoreCreateMutex();
+  if (sPulseJournal.begin(PULSE_JOURNAL_PARTITION_LABEL)) {
+    if (!sPulseJournal.recovered()) {
+      uint64_t subtotalPulseCounter = 0;
+      uint64_t pulseCounter = loadStoredCounters(&subtotalPulseCounter);
+      sPulseJournal.save(pulseCounter, subtotalPulseCounter);
+    } else if (sPulseJournal.state().controlledPowerCycle) {
+      gControlledPowerCycle = true;
+      // Consume the flag so an uncontrolled reset before the next save is not mistaken for one
+      sPulseJournal.save(sPulseJournal.state().pulseCounter, sPulseJournal.state().subtotalPulseCounter);
+    }
+    sPulseJournal.prepareNextSector();
+  } // else no journal partition: Preferences only
+
+  uint64_t storedSubtotalPulseCounter = 0;
+  uint64_t storedPulseCounter = loadStoredCounters(&storedSubtotalPulseCounter);
+  pulseRtcShadowStored(storedPulseCounter, storedSubtotalPulseCounter);
+
+  uint64_t subtotalPulseCounter = 0;
+  uint64_t pulseCounter = loadFromNVS(&subtotalPulseCounter);
+  if (pulseCounter != storedPulseCounter || subtotalPulseCounter != storedSubtotalPulseCounter) {
+    // Pulses counted after the last save survived a soft reset in RTC memory; store them now so
+    // the periodic save only has to track new pulses.
+    saveToNVS(pulseCounter, subtotalPulseCounter);
+
+                                                    #ifdef DEBUG
+                                                    Serial.println("Pulse counters restored from RTC memory (generation " + String(pulseRtcShadowGeneration()) + "): " +
+                                                                   String(pulseCounter) + "/" + String(subtotalPulseCounter));
+                                                    #endif
+  }
+}
+
+static bool trySaveToNVS(uint64_t pulseCounter,
+                         uint64_t subtotalPulseCounter,
+                         uint64_t& lastSavedPulseCounter,
+                         uint64_t& lastSavedSubtotalPulseCounter,
                          uint32_t& lastSaveMs,
                          bool& saveDeferredDuringOta) {
   if (isOtaInProgress()) {
@@ -142,6 +330,7 @@ static bool trySaveToNVS(uint32_t pulseCounter,
   }
 
   saveToNVS(pulseCounter, subtotalPulseCounter);
+  prepareCounterStore();
   lastSavedPulseCounter = pulseCounter;
   lastSavedSubtotalPulseCounter = subtotalPulseCounter;
   lastSaveMs = millis();
@@ -172,11 +361,10 @@ static void directResetTask(void* pvParameters) {
       continue;
     }
     portENTER_CRITICAL(&EmergencyCounterMux);
-    uint32_t pc = gEmergencyPulseCounter;
-    uint16_t sc = gEmergencySubtotalPulseCounter;
+    uint64_t pc = gEmergencyPulseCounter;
+    uint64_t sc = gEmergencySubtotalPulseCounter;
     portEXIT_CRITICAL(&EmergencyCounterMux);
-    saveToNVS(pc, sc);
-    saveControlledPowerCycleToNVS(true);
+    saveEmergencyToNVS(pc, sc);
   }
 }
 
@@ -222,33 +410,67 @@ void initResetGpioPins() {
 }
 
 /* ###################################################################################################
- *               P O W E R    C A L C U L A T I O N
+ *               P U L S E    C O U N T E R    B A C K E N D
  * ###################################################################################################
+ *  See PulseCounterBackend.h. The backend is chosen by PULSE_COUNTER_BACKEND unless
+ *  selectPulseCounterBackend() picked another one before the task started.
  */
-float calculatePower( TaskParams_t* params,uint32_t deltaUs) {
-  // Power calculation logic here
-  float powerW = 0.0f;
-  if (deltaUs > 0) {
-    //  powerW = (3600.0f * 1000000.0f) / deltaUs; // Example calculation
-    powerW = round(((float)(60*60*1000) / 
-                    (float)(deltaUs +  params->ptCorrection)) / 
-                    (float)params->pulse_per_kWh * 1000);
+PulseCounterBackend* getPulseCounterBackend(PulseCounterBackendType type) {
+  return type == PULSE_BACKEND_PCNT ? getPulsePcntBackend() : getPulseIsrBackend();
+}
+
+static PulseCounterBackend* pulseBackend() {
+  if (sPulseBackend == nullptr) {
+    sPulseBackend = getPulseCounterBackend(PULSE_COUNTER_BACKEND);
   }
-  return powerW;
+  return sPulseBackend;
 }
 
-/* ###################################################################################################
- *               P U L S E    I N P U T    I S R
- * ###################################################################################################
- */
-void IRAM_ATTR PulseInputISR() {
-  if (PulseInputQueue == nullptr) {
-    return;
+bool selectPulseCounterBackend(PulseCounterBackendType type) {
+  if (PulseInputTaskHandle != nullptr) {
+    return false; // The running task keeps the backend it started with
   }
-  unsigned long ts = micros();
-  BaseType_t higherPriorityTaskWoken = pdFALSE;
-  xQueueSendFromISR(PulseInputQueue, &ts, &higherPriorityTaskWoken);
-  portYIELD_FROM_ISR(higherPriorityTaskWoken);
+  sPulseBackend = getPulseCounterBackend(type);
+  return true;
+}
+
+bool selectPulseBatchWindow(uint32_t windowMs) {
+  if (PulseInputTaskHandle != nullptr) {
+    return false; // The running task keeps the window it started with
+  }
+  sPulseBatchWindowMs = windowMs;
+  return true;
+}
+
+const char* getPulseCounterBackendName() {
+  return pulseBackend()->name();
+}
+
+uint32_t getPulseInputOverflowCount() {
+  return pulseBackend()->overflowCount();
+}
+
+bool publishPulseInputOverflow() {
+  static uint32_t publishedOverflowCount = 0;
+  PulseCounterBackend* backend = pulseBackend();
+  uint32_t overflowCount = backend->overflowCount();
+  if (overflowCount == publishedOverflowCount) {
+    return false;
+  }
+
+  char logMsg[112] = {0};
+  snprintf(logMsg,
+           sizeof(logMsg),
+           "Pulse input overflow (%s): %lu pulses dropped (capacity %lu, peak fill %lu)",
+           backend->name(),
+           (unsigned long)overflowCount,
+           (unsigned long)backend->capacity(),
+           (unsigned long)backend->peakFill());
+  if (!publishMqttLog(MQTT_TOPIC_LOG_PULSE_OVERFLOW, logMsg, RETAINED)) {
+    return false;
+  }
+  publishedOverflowCount = overflowCount;
+  return true;
 }
 
 /* ###################################################################################################
@@ -256,7 +478,7 @@ void IRAM_ATTR PulseInputISR() {
  * ###################################################################################################
  */
 bool isPulseInputReady() {
-  return PulseInputQueue != nullptr && PulseInputTaskReady;
+  return PulseInputTaskHandle != nullptr && PulseInputTaskReady;
 }
 
 bool waitForPulseInputReady(uint32_t timeoutMs) {
@@ -270,15 +492,10 @@ bool waitForPulseInputReady(uint32_t timeoutMs) {
   return true;
 }
 
-static int sPulseInputGpio = -1;
-static int sPulseInputMode = -1;
-
 bool attachPulseInputInterrupt(int gpio, int mode) {
-  if (gpio < 0 || PulseInputQueue == nullptr) {
+  if (gpio < 0 || PulseInputTaskHandle == nullptr) {
     return false;
   }
-  sPulseInputGpio = gpio;
-  sPulseInputMode = mode;
   // Bias input according to edge/level trigger so the idle state is stable.
   int pinInputMode = INPUT;
   if (mode == FALLING || mode == LOW) {
@@ -287,20 +504,15 @@ bool attachPulseInputInterrupt(int gpio, int mode) {
     pinInputMode = INPUT_PULLDOWN;
   }
   pinMode(gpio, pinInputMode);
-  attachInterrupt(digitalPinToInterrupt(gpio), PulseInputISR, mode);
-  return true;
+  return pulseBackend()->attach(gpio, mode, PulseInputTaskHandle);
 }
 
 void suspendPulseInputISR() {
-  if (sPulseInputGpio >= 0) {
-    detachInterrupt(digitalPinToInterrupt(sPulseInputGpio));
-  }
+  pulseBackend()->suspend();
 }
 
 void resumePulseInputISR() {
-  if (sPulseInputGpio >= 0 && sPulseInputMode >= 0) {
-    attachInterrupt(digitalPinToInterrupt(sPulseInputGpio), PulseInputISR, sPulseInputMode);
-  }
+  pulseBackend()->resume();
 }
 
 /* ###################################################################################################
@@ -313,20 +525,34 @@ void resumePulseInputISR() {
  */
 static void PulseInputTask( void* pvParameters) {
   // Task initialization
+  PulseCounterBackend* backend = pulseBackend();
+  PulseEvent event;
   uint32_t ts;
   uint32_t lastTs = 0;
-  uint16_t subtotalPulseCounter = 0;
-  uint32_t pulseCounter = loadFromNVS(&subtotalPulseCounter);
+  const uint16_t pulsePerKWh = ((TaskParams_t*)pvParameters)->pulse_per_kWh;
+  uint64_t subtotalPulseCounter = 0;
+  uint64_t pulseCounter = loadFromNVS(&subtotalPulseCounter);
   updateEmergencyCounters(pulseCounter, subtotalPulseCounter);
-  float powerW = 0.0f;
-  float energyKwh = (float)pulseCounter / (float)((TaskParams_t*)pvParameters)->pulse_per_kWh;
-  float subtotalKwh = (float)subtotalPulseCounter / (float)((TaskParams_t*)pvParameters)->pulse_per_kWh;
-
-  updateLatestEnergySnapshot(powerW, energyKwh, subtotalKwh);
+  uint32_t powerW = 0;         // Smoothed according to POWER_ESTIMATOR_MODE
+  uint32_t instantPowerW = 0;  // Last pulse interval only
+  sPowerEstimator.setCalibration(pulsePerKWh, ((TaskParams_t*)pvParameters)->ptCorrection);
+  uint64_t energyMilliWh = pulsesToMilliWh(pulseCounter, pulsePerKWh);
+  uint64_t subtotalMilliWh = pulsesToMilliWh(subtotalPulseCounter, pulsePerKWh);
+
+  updateLatestEnergySnapshot(powerW, instantPowerW, energyMilliWh, subtotalMilliWh);
+
+  // Pulses drained from the ring but not yet counted (PULSE_BATCH_WINDOW_MS > 0). The counter
+  // saves add them, so none of them is lost while the window is open.
+  const uint32_t batchWindowMs = sPulseBatchWindowMs;
+  uint32_t batchPulses = 0;
+  uint32_t batchStartMs = 0;
+  uint32_t batchFirstTs = 0;
+  uint32_t batchLastTs = 0;
+  uint32_t batchDequeueUs = 0;
 
   uint32_t lastSaveMs = millis();
-  uint32_t lastSavedPulseCounter = pulseCounter;
-  uint16_t lastSavedSubtotalPulseCounter = subtotalPulseCounter;
+  uint64_t lastSavedPulseCounter = pulseCounter;
+  uint64_t lastSavedSubtotalPulseCounter = subtotalPulseCounter;
   bool saveDeferredDuringOta = false;
 
                                                     #ifdef HEADLESS_DEBUG
@@ -337,21 +563,6 @@ static void PulseInputTask( void* pvParameters) {
                                                     Serial.println("Pulse Input Task initializing...\n");
                                                     #endif
 
-  if (PulseInputQueue == nullptr) {
-
-                                                    #ifdef HEADLESS_DEBUG
-                                                      OledEnergyDisplay::showMonitorLine("Pulse q not init");
-                                                    #endif
-
-                                                    #ifdef DEBUG
-                                                    Serial.println("Pulse count queue not initialized!");
-                                                    #endif
-    
-    PulseInputTaskHandle = nullptr;
-    vTaskDelete(nullptr);
-    return;
-  }
-
   PulseInputTaskReady = true;
 
                                                     #ifdef HEADLESS_DEBUG
@@ -386,7 +597,7 @@ static void PulseInputTask( void* pvParameters) {
     portEXIT_CRITICAL(&ResetMux);
 
     if (shouldReset) {
-      saveToNVS(pulseCounter, subtotalPulseCounter);
+      saveToNVS(pulseCounter + batchPulses, subtotalPulseCounter + batchPulses);
       if (resetType == RESET_HARD) {
         if (HARD_RESET_GPIO >= 0) {
           digitalWrite(HARD_RESET_GPIO, HIGH); // Trigger external power-cycle hardware
@@ -399,22 +610,22 @@ static void PulseInputTask( void* pvParameters) {
 
     if (PulseCounterUpdatePending) {
       portENTER_CRITICAL(&PulseCounterMux);
-      uint32_t previousPulseCounter = pulseCounter;
+      uint64_t previousPulseCounter = pulseCounter;
       pulseCounter = PendingPulseCounter;
       PulseCounterUpdatePending = false;
       portEXIT_CRITICAL(&PulseCounterMux);
 
-      updateEmergencyCounters(pulseCounter, subtotalPulseCounter);
+      updateEmergencyCounters(pulseCounter + batchPulses, subtotalPulseCounter + batchPulses);
 
-      float energyKwh = (float)pulseCounter / (float)((TaskParams_t*)pvParameters)->pulse_per_kWh;
-      float subtotalKwh = (float)subtotalPulseCounter / (float)((TaskParams_t*)pvParameters)->pulse_per_kWh;
+      energyMilliWh = pulsesToMilliWh(pulseCounter, pulsePerKWh);
+      subtotalMilliWh = pulsesToMilliWh(subtotalPulseCounter, pulsePerKWh);
 
-      updateLatestEnergySnapshot(powerW, energyKwh, subtotalKwh);
-      publishMqttEnergy(0.0f, energyKwh, subtotalKwh);
+      updateLatestEnergySnapshot(powerW, instantPowerW, energyMilliWh, subtotalMilliWh);
+      publishMqttEnergy(0, 0, energyMilliWh, subtotalMilliWh);
 
       if (pulseCounter != previousPulseCounter) {
-        trySaveToNVS(pulseCounter,
-                     subtotalPulseCounter,
+        trySaveToNVS(pulseCounter + batchPulses,
+                     subtotalPulseCounter + batchPulses,
                      lastSavedPulseCounter,
                      lastSavedSubtotalPulseCounter,
                      lastSaveMs,
@@ -436,24 +647,44 @@ static void PulseInputTask( void* pvParameters) {
 
       bool subtotalChanged = subtotalPulseCounter != 0;
       subtotalPulseCounter = 0;
-      updateEmergencyCounters(pulseCounter, subtotalPulseCounter);
+      updateEmergencyCounters(pulseCounter + batchPulses, subtotalPulseCounter + batchPulses);
       if (subtotalChanged) {
-        trySaveToNVS(pulseCounter,
-                     subtotalPulseCounter,
+        trySaveToNVS(pulseCounter + batchPulses,
+                     subtotalPulseCounter + batchPulses,
                      lastSavedPulseCounter,
                      lastSavedSubtotalPulseCounter,
                      lastSaveMs,
                      saveDeferredDuringOta);
       }
 
-      float energyKwh = (float)pulseCounter / (float)((TaskParams_t*)pvParameters)->pulse_per_kWh;
-      float subtotalKwh = 0.0f;
-      updateLatestEnergySnapshot(powerW, energyKwh, subtotalKwh);
-      publishMqttEnergy(0.0f, energyKwh, subtotalKwh);
+      energyMilliWh = pulsesToMilliWh(pulseCounter, pulsePerKWh);
+      subtotalMilliWh = 0;
+      updateLatestEnergySnapshot(powerW, instantPowerW, energyMilliWh, subtotalMilliWh);
+      publishMqttEnergy(0, 0, energyMilliWh, subtotalMilliWh);
+    }
+
+    // Wait for the ISR backend to signal new pulse timestamps, or for the next poll of a polled
+    // backend, then drain its events. With a pending batch, wake up no later than when its window closes.
+    TickType_t waitTicks = pdMS_TO_TICKS(1000);
+    if (backend->pollIntervalTicks() < waitTicks) {
+      waitTicks = backend->pollIntervalTicks();
+    }
+    if (batchPulses > 0) {
+      uint32_t batchAgeMs = millis() - batchStartMs;
+      TickType_t batchTicks = batchAgeMs < batchWindowMs ? pdMS_TO_TICKS(batchWindowMs - batchAgeMs) : 0;
+      if (batchTicks < waitTicks) {
+        waitTicks = batchTicks;
+      }
     }
+    ulTaskNotifyTake(pdTRUE, waitTicks);
+    uint32_t busyStartUs = micros();
+    uint32_t pulsesProcessed = 0;
+    uint32_t snapshotsEmitted = 0;
 
-    // Wait for pulse timestamp from ISR
-    if (xQueueReceive(PulseInputQueue, &ts, pdMS_TO_TICKS(1000))) {
+    while (batchWindowMs == 0 && backend->poll(&event)) {
+      ts = event.timestampUs;
+      uint32_t dequeueUs = micros();
+      recordPulseLatency(PULSE_LATENCY_ISR_TO_DEQUEUE, dequeueUs - ts);
 
       sendLedCommand("Blink");
 
@@ -466,8 +697,8 @@ static void PulseInputTask( void* pvParameters) {
                                           #endif
 
       // ---- 1. Pulse counting ----
-      pulseCounter++;
-      subtotalPulseCounter++;
+      pulseCounter += event.count;
+      subtotalPulseCounter += event.count;
       updateEmergencyCounters(pulseCounter, subtotalPulseCounter);
 
                                           #ifdef HEADLESS_DEBUG
@@ -479,42 +710,114 @@ static void PulseInputTask( void* pvParameters) {
                                           #endif
 
       // ---- 2. Power calculation ----
-      if (lastTs > 0) {
-          uint32_t deltaUs = ts - lastTs;
-          powerW = calculatePower( (TaskParams_t*)pvParameters, deltaUs);
+      sPowerEstimator.addPulses(event.count, ts);
+      if (sPowerEstimator.hasInterval()) {
+          powerW = sPowerEstimator.smoothedW();
+          instantPowerW = sPowerEstimator.instantW();
 
                                                           #ifdef HEADLESS_DEBUG
-                                                            OledEnergyDisplay::showMonitorLine("Pwr: " + String(powerW, 0) + "W");
+                                                            OledEnergyDisplay::showMonitorLine("Pwr: " + String(powerW) + "W");
                                                           #endif
 
                                                           #ifdef DEBUG
-                                                            Serial.println("\nDelta U sec: " + String(deltaUs) + " Pulse Count: " + String(pulseCounter) + " Power: " + String(powerW) + " W");
+                                                            Serial.println("\nDelta U sec: " + String(ts - lastTs) + " Pulse Count: " + String(pulseCounter) + " Power: " + String(powerW) + " W (instant " + String(instantPowerW) + " W)");
                                                           #endif
 
       }
       lastTs = ts;
 
-      float energyKwh = (float)pulseCounter / (float)((TaskParams_t*)pvParameters)->pulse_per_kWh;
-      float subtotalKwh = (float)subtotalPulseCounter / (float)((TaskParams_t*)pvParameters)->pulse_per_kWh;
+      energyMilliWh = pulsesToMilliWh(pulseCounter, pulsePerKWh);
+      subtotalMilliWh = pulsesToMilliWh(subtotalPulseCounter, pulsePerKWh);
       
-      updateLatestEnergySnapshot(powerW, energyKwh, subtotalKwh);
-      publishMqttEnergy(powerW, energyKwh, subtotalKwh);
+      updateLatestEnergySnapshot(powerW, instantPowerW, energyMilliWh, subtotalMilliWh);
+      uint32_t snapshotUs = micros();
+      recordPulseLatency(PULSE_LATENCY_DEQUEUE_TO_SNAPSHOT, snapshotUs - dequeueUs);
+
+      if (publishMqttEnergy(powerW, instantPowerW, energyMilliWh, subtotalMilliWh)) {
+        recordPulseLatency(PULSE_LATENCY_SNAPSHOT_TO_ENQUEUE, micros() - snapshotUs);
+      }
+      pulsesProcessed += event.count;
+      snapshotsEmitted++;
     }
 
-    // ---- 3. Power calculation even if no new pulse (to update power to 0 if pulses stop) ----
-    if (lastTs > 0 && powerW > 0.5f && micros() > lastTs) { // If micros < lastTs, micros has overrrun. In that case we keep the last power until next pulse to avoid incorrect 0 reading.
-        uint32_t deltaUs = micros() - lastTs; // Time since last pulse in microseconds
-        float possiblePowerW = calculatePower( (TaskParams_t*)pvParameters, deltaUs);
+    // ---- 1b. Batched pulse counting: collect timestamps, count and publish once per window ----
+    if (batchWindowMs > 0) {
+      while (backend->poll(&event)) {
+        ts = event.timestampUs;
+        uint32_t dequeueUs = micros();
+        recordPulseLatency(PULSE_LATENCY_ISR_TO_DEQUEUE, dequeueUs - ts);
+        if (batchPulses == 0) {
+          batchStartMs = millis();
+          batchFirstTs = ts;
+          batchDequeueUs = dequeueUs;
+        }
+        batchLastTs = ts;
+        batchPulses += event.count;
+        pulsesProcessed += event.count;
+      }
+      if (pulsesProcessed > 0) {
+        // Keep the emergency save current even while the batch window is open
+        updateEmergencyCounters(pulseCounter + batchPulses, subtotalPulseCounter + batchPulses);
+      }
+
+      if (batchPulses > 0 && millis() - batchStartMs >= batchWindowMs) {
+        sendLedCommand("Blink");
+
+        pulseCounter += batchPulses;
+        subtotalPulseCounter += batchPulses;
+
+        // ---- 2b. Power from the batch span: previous batch's last pulse (or this batch's first) to this batch's last ----
+        if (lastTs > 0) {
+          sPowerEstimator.addPulses(batchPulses, batchLastTs);
+        } else {
+          sPowerEstimator.addPulses(1, batchFirstTs);
+          sPowerEstimator.addPulses(batchPulses - 1, batchLastTs);
+        }
+        if (sPowerEstimator.hasInterval()) {
+          powerW = sPowerEstimator.smoothedW();
+          instantPowerW = sPowerEstimator.instantW();
+        }
 
-        // If power has dropped significantly (e.g. more than 50%), update it to reflect possible stop of consumption
-        if ((2 * possiblePowerW) < powerW) { 
-          powerW = possiblePowerW;
+                                                          #ifdef DEBUG
+                                                            Serial.println("\nBatch: " + String(batchPulses) + " pulses over " + String(batchLastTs - (lastTs > 0 ? lastTs : batchFirstTs)) + " us, Pulse Count: " + String(pulseCounter) + " Power: " + String(powerW) + " W");
+                                                          #endif
+        lastTs = batchLastTs;
+
+        energyMilliWh = pulsesToMilliWh(pulseCounter, pulsePerKWh);
+        subtotalMilliWh = pulsesToMilliWh(subtotalPulseCounter, pulsePerKWh);
+
+        updateLatestEnergySnapshot(powerW, instantPowerW, energyMilliWh, subtotalMilliWh);
+        uint32_t snapshotUs = micros();
+        // Measured from the first pulse of the batch, so the window itself counts as staleness
+        recordPulseLatency(PULSE_LATENCY_DEQUEUE_TO_SNAPSHOT, snapshotUs - batchDequeueUs);
+
+        if (publishMqttEnergy(powerW, instantPowerW, energyMilliWh, subtotalMilliWh)) {
+          recordPulseLatency(PULSE_LATENCY_SNAPSHOT_TO_ENQUEUE, micros() - snapshotUs);
+        }
+        batchPulses = 0;
+        snapshotsEmitted++;
+      }
+    }
 
-          updateLatestEnergySnapshot(powerW, energyKwh, subtotalKwh);
-          publishMqttEnergy(powerW, energyKwh, subtotalKwh);
+    if (pulsesProcessed > 0 || snapshotsEmitted > 0) {
+      addPulseCpuCost(micros() - busyStartUs, pulsesProcessed, snapshotsEmitted);
+    }
+
+    // ---- 3. Power calculation even if no new pulse (to update power to 0 if pulses stop) ----
+    // Skipped while a batch is open: its pulses are newer than lastTs.
+    if (batchPulses == 0 && lastTs > 0 && powerW > 0 && micros() > lastTs) { // If micros < lastTs, micros has overrrun. In that case we keep the last power until next pulse to avoid incorrect 0 reading.
+        // No reading may exceed one pulse in the time since the last pulse. Publish the lowered
+        // reading once it has fallen below POWER_DECAY_PUBLISH_RATIO of the published one.
+        sPowerEstimator.decay(micros());
+        if (sPowerEstimator.smoothedW() < POWER_DECAY_PUBLISH_RATIO * powerW) {
+          powerW = sPowerEstimator.smoothedW();
+          instantPowerW = sPowerEstimator.instantW();
+
+          updateLatestEnergySnapshot(powerW, instantPowerW, energyMilliWh, subtotalMilliWh);
+          publishMqttEnergy(powerW, instantPowerW, energyMilliWh, subtotalMilliWh);
 
                                                           #ifdef HEADLESS_DEBUG
-                                                            OledEnergyDisplay::showMonitorLine("Pwr upd: " + String(powerW, 0) + "W");
+                                                            OledEnergyDisplay::showMonitorLine("Pwr upd: " + String(powerW) + "W");
                                                           #endif
 
                                                           #ifdef DEBUG
@@ -527,19 +830,19 @@ static void PulseInputTask( void* pvParameters) {
                                                             Serial.print (".");
                                                           #endif  
 
-    // ---- 4. Periodic NVS save ----
-    if (millis() - lastSaveMs >= SAVE_INTERVAL_MS) {
-      bool hasCounterChanges = (pulseCounter != lastSavedPulseCounter) ||
-                               (subtotalPulseCounter != lastSavedSubtotalPulseCounter);
+    // ---- 4. Periodic NVS save, including the pulses of an open batch ----
+    if (millis() - lastSaveMs >= PULSE_NVS_SAVE_INTERVAL_MS) {
+      bool hasCounterChanges = (pulseCounter + batchPulses != lastSavedPulseCounter) ||
+                               (subtotalPulseCounter + batchPulses != lastSavedSubtotalPulseCounter);
 
       if (hasCounterChanges) {
 
                                           #ifdef DEBUG
-                                          Serial.println("\nSaving pulse count to NVS: " + String(pulseCounter) + "\n");
+                                          Serial.println("\nSaving pulse count to NVS: " + String(pulseCounter + batchPulses) + "\n");
                                           #endif
 
-        trySaveToNVS(pulseCounter,
-                     subtotalPulseCounter,
+        trySaveToNVS(pulseCounter + batchPulses,
+                     subtotalPulseCounter + batchPulses,
                      lastSavedPulseCounter,
                      lastSavedSubtotalPulseCounter,
                      lastSaveMs,
@@ -577,26 +880,16 @@ void startPulseInputTask(TaskParams_t* params) {
     digitalWrite(HARD_RESET_GPIO, LOW); // Ensure reset line remains inactive
   }
 
+  initCounterStore();
+
   // Seed emergency counters before enabling the direct-reset ISR so an
   // early direct-reset event persists the latest stored values, not zeros.
-  uint16_t bootSubtotalPulseCounter = 0;
-  uint32_t bootPulseCounter = loadFromNVS(&bootSubtotalPulseCounter);
+  uint64_t bootSubtotalPulseCounter = 0;
+  uint64_t bootPulseCounter = loadFromNVS(&bootSubtotalPulseCounter);
   updateEmergencyCounters(bootPulseCounter, bootSubtotalPulseCounter);
 
   startDirectResetISR(DIRECT_RESET_GPIO);
 
-  if (PulseInputQueue == nullptr) {
-    PulseInputQueue = xQueueCreate(10, sizeof(unsigned long));
-    if (!PulseInputQueue) {
-
-                                                #ifdef DEBUG
-                                                Serial.println("Pulse count queue creation failed!");
-                                                #endif
-
-      return;
-    }
-  }
-  
   xTaskCreate(
     PulseInputTask,
     "PulseInputTask",
@@ -1,5 +1,6 @@
 #pragma once
 #include "globals.h"
+#include "PulseCounterBackend.h"
 #include <Arduino.h>
 
 void startPulseInputTask(TaskParams_t* params);
@@ -14,17 +15,26 @@ bool waitForPulseInputReady(uint32_t timeoutMs);
 
 bool attachPulseInputInterrupt(int gpio, int mode);
 
+bool selectPulseCounterBackend(PulseCounterBackendType type); // Override PULSE_COUNTER_BACKEND; only before startPulseInputTask()
+bool selectPulseBatchWindow(uint32_t windowMs);               // Override PULSE_BATCH_WINDOW_MS; only before startPulseInputTask()
+const char* getPulseCounterBackendName();
+uint32_t getPulseInputOverflowCount(); // Pulses dropped because the backend could not hold them
+bool publishPulseInputOverflow();      // Publish retained to <device>/log/pulse/overflow when the count changed
+void getPulseTaskCpuCost(uint32_t* busyUs, uint32_t* pulses, uint32_t* snapshots); // Cumulative since boot
+bool publishPulseTaskCpuCost();       // Publish retained to <device>/log/pulse/cpu: pulses, snapshots and busy time since the last report
+
 void suspendPulseInputISR(); // Detach pulse interrupt (call during OTA)
 void resumePulseInputISR();  // Re-attach pulse interrupt (call after OTA)
 
 void suspendDirectResetISR(); // Detach direct-reset interrupt (call during OTA)
 void resumeDirectResetISR();  // Re-attach direct-reset interrupt (call after OTA)
 
-void setPulseCounterFromMqtt(uint32_t newPulseCounter);
+void setPulseCounterFromMqtt(uint64_t newPulseCounter);
 
-bool getLatestEnergyKwh(float* energyKwh);
+bool getLatestEnergyMilliWh(uint64_t* energyMilliWh);
+bool getLatestEnergyKwh(float* energyKwh); // Display / charging session edge, see EnergyMath.h
 
-bool getLatestEnergySnapshot(float* powerW, float* energyKwh, float* subtotalKwh);
+bool getLatestEnergySnapshot(uint32_t* powerW, uint64_t* energyMilliWh, uint64_t* subtotalMilliWh, uint32_t* instantPowerW = nullptr); // powerW is smoothed per POWER_ESTIMATOR_MODE
 
 void requestSubtotalReset();
 
@@ -0,0 +1,91 @@
+#include "PulseCounterBackend.h"
+#include "PulseInputTask.h"
+#include "PulseRing.h"
+#include "config.h"
+
+/* ###################################################################################################
+ *               I S R   P U L S E   C O U N T E R   B A C K E N D
+ * ###################################################################################################
+ *  One interrupt per pulse. PulseInputISR() is the single producer of the ring and the pulse task
+ *  the single consumer, see PulseRing.h.
+ */
+static PulseRing<PULSE_RING_CAPACITY> PulseInputRing;
+static TaskHandle_t sPulseConsumerTask = nullptr;
+
+void IRAM_ATTR PulseInputISR() {
+  TaskHandle_t taskHandle = sPulseConsumerTask;
+  if (taskHandle == nullptr) {
+    return;
+  }
+  // A full ring drops the pulse and counts it in PulseInputRing.overflowCount().
+  // The task is notified either way so it drains what is already queued.
+  PulseInputRing.push(micros());
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(taskHandle, &higherPriorityTaskWoken);
+  portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+
+class PulseIsrBackend : public PulseCounterBackend {
+ public:
+  const char* name() const override {
+    return "isr";
+  }
+
+  bool attach(int gpio, int mode, TaskHandle_t consumer) override {
+    if (gpio < 0 || consumer == nullptr) {
+      return false;
+    }
+    gpio_ = gpio;
+    mode_ = mode;
+    sPulseConsumerTask = consumer;
+    attachInterrupt(digitalPinToInterrupt(gpio_), PulseInputISR, mode_);
+    return true;
+  }
+
+  void suspend() override {
+    if (gpio_ >= 0) {
+      detachInterrupt(digitalPinToInterrupt(gpio_));
+    }
+  }
+
+  void resume() override {
+    if (gpio_ >= 0 && mode_ >= 0) {
+      attachInterrupt(digitalPinToInterrupt(gpio_), PulseInputISR, mode_);
+    }
+  }
+
+  bool poll(PulseEvent* event) override {
+    uint32_t ts;
+    if (!PulseInputRing.pop(&ts)) {
+      return false;
+    }
+    event->count = 1;
+    event->timestampUs = ts;
+    return true;
+  }
+
+  TickType_t pollIntervalTicks() const override {
+    return portMAX_DELAY; // The ISR notifies the task for every pulse
+  }
+
+  uint32_t overflowCount() const override {
+    return PulseInputRing.overflowCount();
+  }
+
+  uint32_t capacity() const override {
+    return PulseInputRing.capacity();
+  }
+
+  uint32_t peakFill() const override {
+    return PulseInputRing.peakFill();
+  }
+
+ private:
+  int gpio_ = -1;
+  int mode_ = -1;
+};
+
+PulseCounterBackend* getPulseIsrBackend() {
+  static PulseIsrBackend backend;
+  return &backend;
+}
@@ -0,0 +1,298 @@
+#include "PulseJournal.h"
+
+#include <string.h>
+
+namespace {
+constexpr uint32_t SECTOR_SIZE = SPI_FLASH_SEC_SIZE;
+
+constexpr uint8_t RECORD_MAGIC = 0xA7;
+constexpr uint8_t RECORD_DELTA = 0x01;
+constexpr uint8_t RECORD_CHECKPOINT = 0x02;
+constexpr uint8_t FLAG_CONTROLLED_POWER_CYCLE = 0x01;
+
+/*
+ * Record layout (little endian, erased flash reads 0xFF):
+ *
+ *   0     magic        RECORD_MAGIC
+ *   1     type         RECORD_DELTA | RECORD_CHECKPOINT
+ *   2     flags        FLAG_CONTROLLED_POWER_CYCLE
+ *   3     reserved     0xFF
+ *   4..7  sequence
+ *
+ *   delta (16 bytes)        8..11  pulses added to both counters
+ *                           12..15 CRC-32 of bytes 0..11
+ *   checkpoint (32 bytes)   8..15  pulse counter
+ *                           16..23 subtotal pulse counter
+ *                           24..27 reserved 0xFFFFFFFF
+ *                           28..31 CRC-32 of bytes 0..27
+ */
+constexpr size_t DELTA_SIZE = 16;
+constexpr size_t CHECKPOINT_SIZE = 32;
+
+uint32_t crc32(const uint8_t* data, size_t size) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < size; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0U - (crc & 1U)));
+    }
+  }
+  return ~crc;
+}
+
+void put32(uint8_t* p, uint32_t value) {
+  for (uint8_t i = 0; i < 4; i++) {
+    p[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+uint32_t get32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void put64(uint8_t* p, uint64_t value) {
+  put32(p, (uint32_t)value);
+  put32(p + 4, (uint32_t)(value >> 32));
+}
+
+uint64_t get64(const uint8_t* p) {
+  return (uint64_t)get32(p) | ((uint64_t)get32(p + 4) << 32);
+}
+
+bool isErased(const uint8_t* data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    if (data[i] != 0xFF) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void encodeHeader(uint8_t* record, uint8_t type, uint8_t flags, uint32_t sequence) {
+  record[0] = RECORD_MAGIC;
+  record[1] = type;
+  record[2] = flags;
+  record[3] = 0xFF;
+  put32(record + 4, sequence);
+}
+
+void encodeDelta(uint8_t* record, uint32_t sequence, uint8_t flags, uint32_t pulses) {
+  encodeHeader(record, RECORD_DELTA, flags, sequence);
+  put32(record + 8, pulses);
+  put32(record + 12, crc32(record, 12));
+}
+
+void encodeCheckpoint(uint8_t* record, uint32_t sequence, uint8_t flags, uint64_t pulseCounter, uint64_t subtotalPulseCounter) {
+  encodeHeader(record, RECORD_CHECKPOINT, flags, sequence);
+  put64(record + 8, pulseCounter);
+  put64(record + 16, subtotalPulseCounter);
+  put32(record + 24, 0xFFFFFFFF);
+  put32(record + 28, crc32(record, 28));
+}
+
+bool isValid(const uint8_t* record, uint8_t type) {
+  if (record[0] != RECORD_MAGIC || record[1] != type) {
+    return false;
+  }
+  size_t crcOffset = type == RECORD_DELTA ? DELTA_SIZE - 4 : CHECKPOINT_SIZE - 4;
+  return get32(record + crcOffset) == crc32(record, crcOffset);
+}
+}  // namespace
+
+/* ###################################################################################################
+ *               R E C O V E R Y
+ * ###################################################################################################
+ */
+bool PulseJournal::begin(const char* label) {
+  partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  sectorCount_ = partition_ ? partition_->size / SECTOR_SIZE : 0;
+  if (sectorCount_ < 2) {
+    partition_ = nullptr;
+    return false;
+  }
+  recovered_ = false;
+  sectorClosed_ = true;
+  sectorErases_ = 0;
+  erasedSector_ = UINT32_MAX;
+  sequence_ = 0;
+  sector_ = sectorCount_ - 1; // Without a checkpoint the first save starts sector 0
+  offset_ = 0;
+  state_ = {};
+
+  // The current sector is the one whose checkpoint has the highest sequence
+  uint8_t record[CHECKPOINT_SIZE];
+  bool found = false;
+  uint32_t newestSector = 0;
+  uint32_t newestSequence = 0;
+  for (uint32_t sector = 0; sector < sectorCount_; sector++) {
+    if (esp_partition_read(partition_, sector * SECTOR_SIZE, record, CHECKPOINT_SIZE) != ESP_OK ||
+        !isValid(record, RECORD_CHECKPOINT)) {
+      continue;
+    }
+    uint32_t sequence = get32(record + 4);
+    if (!found || (int32_t)(sequence - newestSequence) > 0) {
+      found = true;
+      newestSector = sector;
+      newestSequence = sequence;
+    }
+  }
+  if (found) {
+    recovered_ = recoverSector(newestSector, newestSequence);
+  }
+  return true;
+}
+
+// Replays the sector from its checkpoint up to the first slot that is erased, torn or corrupt
+bool PulseJournal::recoverSector(uint32_t sector, uint32_t checkpointSequence) {
+  uint8_t record[CHECKPOINT_SIZE];
+  uint32_t base = sector * SECTOR_SIZE;
+  if (esp_partition_read(partition_, base, record, CHECKPOINT_SIZE) != ESP_OK) {
+    return false;
+  }
+  state_.pulseCounter = get64(record + 8);
+  state_.subtotalPulseCounter = get64(record + 16);
+  state_.controlledPowerCycle = (record[2] & FLAG_CONTROLLED_POWER_CYCLE) != 0;
+  sequence_ = checkpointSequence;
+  sector_ = sector;
+  offset_ = CHECKPOINT_SIZE;
+  sectorClosed_ = true; // Until an erased slot proves there is room to append
+
+  while (offset_ + DELTA_SIZE <= SECTOR_SIZE) {
+    if (esp_partition_read(partition_, base + offset_, record, DELTA_SIZE) != ESP_OK) {
+      break;
+    }
+    if (isErased(record, DELTA_SIZE)) {
+      sectorClosed_ = false;
+      break;
+    }
+    if (get32(record + 4) != sequence_ + 1) {
+      break;
+    }
+    if (isValid(record, RECORD_DELTA)) {
+      uint32_t pulses = get32(record + 8);
+      state_.pulseCounter += pulses;
+      state_.subtotalPulseCounter += pulses;
+      offset_ += DELTA_SIZE;
+    } else if (offset_ + CHECKPOINT_SIZE <= SECTOR_SIZE &&
+               esp_partition_read(partition_, base + offset_, record, CHECKPOINT_SIZE) == ESP_OK &&
+               isValid(record, RECORD_CHECKPOINT)) {
+      state_.pulseCounter = get64(record + 8);
+      state_.subtotalPulseCounter = get64(record + 16);
+      offset_ += CHECKPOINT_SIZE;
+    } else {
+      break; // Torn or corrupt: stop here and never append behind it
+    }
+    state_.controlledPowerCycle = (record[2] & FLAG_CONTROLLED_POWER_CYCLE) != 0;
+    sequence_++;
+  }
+  return true;
+}
+
+/* ###################################################################################################
+ *               A P P E N D
+ * ###################################################################################################
+ */
+bool PulseJournal::save(uint64_t pulseCounter, uint64_t subtotalPulseCounter, bool controlledPowerCycle) {
+  if (partition_ == nullptr) {
+    return false;
+  }
+
+  uint8_t flags = controlledPowerCycle ? FLAG_CONTROLLED_POWER_CYCLE : 0;
+  uint64_t delta = pulseCounter - state_.pulseCounter;
+  bool isDelta = (recovered_ || sequence_ != 0) &&
+                 pulseCounter >= state_.pulseCounter &&
+                 subtotalPulseCounter >= state_.subtotalPulseCounter &&
+                 subtotalPulseCounter - state_.subtotalPulseCounter == delta &&
+                 delta <= UINT32_MAX;
+
+  uint8_t record[CHECKPOINT_SIZE];
+  size_t size = 0;
+  if (isDelta) {
+    encodeDelta(record, sequence_ + 1, flags, (uint32_t)delta);
+    size = DELTA_SIZE;
+  } else {
+    encodeCheckpoint(record, sequence_ + 1, flags, pulseCounter, subtotalPulseCounter);
+    size = CHECKPOINT_SIZE;
+  }
+
+  bool written = false;
+  if (!sectorClosed_ && offset_ + size <= SECTOR_SIZE) {
+    written = appendRecord(record, size);
+  }
+  if (!written) {
+    // Sector full or its tail unusable: compact into the next sector
+    encodeCheckpoint(record, sequence_ + 1, flags, pulseCounter, subtotalPulseCounter);
+    if (!startSector((sector_ + 1) % sectorCount_) || !appendRecord(record, CHECKPOINT_SIZE)) {
+      return false;
+    }
+  }
+
+  sequence_++;
+  state_.pulseCounter = pulseCounter;
+  state_.subtotalPulseCounter = subtotalPulseCounter;
+  state_.controlledPowerCycle = controlledPowerCycle;
+  return true;
+}
+
+// Programs one record at the append position and reads it back
+bool PulseJournal::appendRecord(const uint8_t* record, size_t size) {
+  uint8_t readBack[CHECKPOINT_SIZE];
+  uint32_t address = sector_ * SECTOR_SIZE + offset_;
+  if (esp_partition_write(partition_, address, record, size) != ESP_OK ||
+      esp_partition_read(partition_, address, readBack, size) != ESP_OK ||
+      memcmp(record, readBack, size) != 0) {
+    sectorClosed_ = true;
+    return false;
+  }
+  offset_ += size;
+  return true;
+}
+
+bool PulseJournal::startSector(uint32_t sector) {
+  sectorClosed_ = true;
+  bool erased = sector == erasedSector_;
+  erasedSector_ = UINT32_MAX;
+  if (!erased) {
+    if (esp_partition_erase_range(partition_, sector * SECTOR_SIZE, SECTOR_SIZE) != ESP_OK) {
+      return false;
+    }
+    sectorErases_++;
+  }
+  sector_ = sector;
+  offset_ = 0;
+  sectorClosed_ = false;
+  return true;
+}
+
+// The next sector only holds records older than the current checkpoint, so a power cut part way
+// through this erase loses nothing recovery would use.
+bool PulseJournal::prepareNextSector() {
+  if (partition_ == nullptr) {
+    return false;
+  }
+  uint32_t next = (sector_ + 1) % sectorCount_;
+  if (erasedSector_ == next) {
+    return true;
+  }
+  erasedSector_ = UINT32_MAX;
+  if (!isSectorErased(next)) {
+    if (esp_partition_erase_range(partition_, next * SECTOR_SIZE, SECTOR_SIZE) != ESP_OK) {
+      return false;
+    }
+    sectorErases_++;
+  }
+  erasedSector_ = next;
+  return true;
+}
+
+// After boot nothing is known about the next sector; reading it back saves an erase per boot
+bool PulseJournal::isSectorErased(uint32_t sector) const {
+  uint8_t block[8 * CHECKPOINT_SIZE];
+  for (uint32_t offset = 0; offset < SECTOR_SIZE; offset += sizeof(block)) {
+    if (esp_partition_read(partition_, sector * SECTOR_SIZE + offset, block, sizeof(block)) != ESP_OK ||
+        !isErased(block, sizeof(block))) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_partition.h>
+
+/*
+ * Append-only pulse counter journal in a raw flash partition ("pulsejrnl" in partitions.csv).
+ *
+ * The partition is used as a ring of 4 KB sectors. Every sector starts with a checkpoint record
+ * holding both counters; after it come 16-byte delta records that add the same number of pulses
+ * to both counters. A save is therefore one 16-byte program operation. A change that is not a
+ * plain increase (subtotal reset, counter set over MQTT) is written as an inline checkpoint.
+ * When a sector is full the next one starts with a checkpoint of the current counters, which
+ * compacts everything before it. prepareNextSector() erases that sector ahead of time, so the save
+ * that crosses the sector boundary only programs; without it the rollover erases inline. Either
+ * way that is the only erase, spread over all sectors.
+ *
+ * Every record carries a sequence number, one higher than the record before it, and a CRC-32.
+ * Recovery picks the sector whose checkpoint has the highest sequence and replays records until
+ * the first erased, torn or corrupt slot, so a write cut by power loss costs at most that save.
+ *
+ * Not thread safe; PulseInputTask serialises access.
+ */
+
+struct PulseJournalState {
+  uint64_t pulseCounter;
+  uint64_t subtotalPulseCounter;
+  bool controlledPowerCycle; // Last record was the direct-reset emergency save
+};
+
+class PulseJournal {
+ public:
+  // Opens the data partition 'label' and recovers the latest state. Returns false when the
+  // partition does not exist (partition table without it, e.g. after an OTA-only update).
+  bool begin(const char* label);
+
+  bool available() const { return partition_ != nullptr; }
+  bool recovered() const { return recovered_; } // A valid checkpoint was found
+  const PulseJournalState& state() const { return state_; }
+
+  // Appends the counters. Returns false when the journal is unavailable or the flash write failed.
+  bool save(uint64_t pulseCounter, uint64_t subtotalPulseCounter, bool controlledPowerCycle = false);
+
+  // Erases the sector the next rollover starts in, unless it is known or read back to be erased.
+  // Called after the periodic save; the emergency save then never waits for an erase.
+  bool prepareNextSector();
+
+  uint32_t sequence() const { return sequence_; }
+  uint32_t sectorErases() const { return sectorErases_; } // Since begin()
+
+ private:
+  bool recoverSector(uint32_t sector, uint32_t checkpointSequence);
+  bool appendRecord(const uint8_t* record, size_t size);
+  bool startSector(uint32_t sector);
+  bool isSectorErased(uint32_t sector) const;
+
+  const esp_partition_t* partition_ = nullptr;
+  uint32_t sectorCount_ = 0;
+  uint32_t sector_ = 0;        // Sector being appended to
+  uint32_t offset_ = 0;        // Next free slot in that sector
+  bool sectorClosed_ = true;   // Next save must start a new sector (torn slot, or nothing written yet)
+  bool recovered_ = false;
+  uint32_t sequence_ = 0;      // Sequence of the last record written or recovered
+  uint32_t sectorErases_ = 0;
+  uint32_t erasedSector_ = UINT32_MAX; // Sector prepareNextSector() erased, UINT32_MAX for none
+  PulseJournalState state_ = {};
+};
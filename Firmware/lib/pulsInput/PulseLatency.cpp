@@ -0,0 +1,119 @@
+#include "PulseLatency.h"
+#include "MqttClient.h"
+
+#include <stdarg.h>
+#include <string.h>
+
+static portMUX_TYPE PulseLatencyMux = portMUX_INITIALIZER_UNLOCKED;
+static PulseLatencyStats sPulseLatencyStats = {};
+static uint32_t sPublishedSampleCount = 0;
+
+static const char* const PULSE_LATENCY_STAGE_NAMES[PULSE_LATENCY_STAGE_COUNT] = {
+  "isr>deq",
+  "deq>snap",
+  "snap>enq",
+};
+
+static uint8_t pulseLatencyBucket(uint32_t latencyUs) {
+  uint8_t bucket = 0;
+  while (bucket < PULSE_LATENCY_BUCKET_COUNT - 1 && latencyUs > PULSE_LATENCY_BUCKET_LIMITS_US[bucket]) {
+    bucket++;
+  }
+  return bucket;
+}
+
+void recordPulseLatency(PulseLatencyStage stage, uint32_t latencyUs) {
+  if (stage >= PULSE_LATENCY_STAGE_COUNT) {
+    return;
+  }
+  uint8_t bucket = pulseLatencyBucket(latencyUs);
+
+  portENTER_CRITICAL(&PulseLatencyMux);
+  sPulseLatencyStats.buckets[stage][bucket]++;
+  sPulseLatencyStats.samples[stage]++;
+  if (latencyUs > sPulseLatencyStats.maxUs[stage]) {
+    sPulseLatencyStats.maxUs[stage] = latencyUs;
+  }
+  portEXIT_CRITICAL(&PulseLatencyMux);
+}
+
+bool getPulseLatencyStats(PulseLatencyStats* stats) {
+  if (!stats) {
+    return false;
+  }
+
+  portENTER_CRITICAL(&PulseLatencyMux);
+  memcpy(stats, &sPulseLatencyStats, sizeof(PulseLatencyStats));
+  portEXIT_CRITICAL(&PulseLatencyMux);
+  return true;
+}
+
+void resetPulseLatencyStats() {
+  portENTER_CRITICAL(&PulseLatencyMux);
+  memset(&sPulseLatencyStats, 0, sizeof(PulseLatencyStats));
+  sPublishedSampleCount = 0;
+  portEXIT_CRITICAL(&PulseLatencyMux);
+}
+
+/* ###################################################################################################
+ *               F O R M A T   A N D   P U B L I S H
+ * ###################################################################################################
+ */
+static void appendFormat(char* buffer, size_t bufferSize, size_t& used, const char* format, ...) {
+  if (used >= bufferSize) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  int written = vsnprintf(buffer + used, bufferSize - used, format, args);
+  va_end(args);
+  if (written > 0) {
+    used += (size_t)written;
+  }
+}
+
+size_t formatPulseLatencyHistogram(char* buffer, size_t bufferSize) {
+  if (!buffer || bufferSize == 0) {
+    return 0;
+  }
+
+  PulseLatencyStats stats;
+  getPulseLatencyStats(&stats);
+
+  size_t used = 0;
+  appendFormat(buffer, bufferSize, used, "le_us:");
+  for (uint8_t bucket = 0; bucket < PULSE_LATENCY_BUCKET_COUNT - 1; bucket++) {
+    appendFormat(buffer, bufferSize, used, "%lu/", (unsigned long)PULSE_LATENCY_BUCKET_LIMITS_US[bucket]);
+  }
+  appendFormat(buffer, bufferSize, used, "inf");
+
+  for (uint8_t stage = 0; stage < PULSE_LATENCY_STAGE_COUNT; stage++) {
+    appendFormat(buffer, bufferSize, used, "\n%s n:%lu max:%lu b:",
+                 PULSE_LATENCY_STAGE_NAMES[stage],
+                 (unsigned long)stats.samples[stage],
+                 (unsigned long)stats.maxUs[stage]);
+    for (uint8_t bucket = 0; bucket < PULSE_LATENCY_BUCKET_COUNT; bucket++) {
+      appendFormat(buffer, bufferSize, used, bucket == 0 ? "%lu" : "/%lu", (unsigned long)stats.buckets[stage][bucket]);
+    }
+  }
+
+  return used < bufferSize ? used : bufferSize - 1;
+}
+
+bool publishPulseLatencyHistogram() {
+  portENTER_CRITICAL(&PulseLatencyMux);
+  uint32_t sampleCount = sPulseLatencyStats.samples[PULSE_LATENCY_ISR_TO_DEQUEUE];
+  portEXIT_CRITICAL(&PulseLatencyMux);
+
+  if (sampleCount == sPublishedSampleCount) {
+    return false; // Nothing new since the last retained histogram
+  }
+
+  char payload[384] = {0};
+  formatPulseLatencyHistogram(payload, sizeof(payload));
+  if (!publishMqttLog(MQTT_TOPIC_LOG_LATENCY_PULSE, payload, RETAINED)) {
+    return false;
+  }
+  sPublishedSampleCount = sampleCount;
+  return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Per-pulse latency histogram for EV-ESP32-energimonitor.
+ *
+ * PulseInputISR() stamps every S0 pulse with micros(). PulseInputTask records how long that pulse
+ * took to travel through each stage of the pipeline, so the staleness of every "Forbrug" reading
+ * can be charted:
+ *
+ *  ISR -> dequeue      time spent in the PulseRing (PulseRing.h) before PulseInputTask picked the pulse up
+ *  dequeue -> snapshot pulse counting, power calculation and updateLatestEnergySnapshot()
+ *  snapshot -> enqueue building the state JSON and handing it to mqttEnqueuePublish()
+ *
+ * Each stage has a fixed set of buckets (upper bounds in PULSE_LATENCY_BUCKET_LIMITS_US, the last
+ * bucket catches everything above). Recording is a handful of increments inside a critical
+ * section, cheap enough to stay enabled in production builds.
+ */
+
+enum PulseLatencyStage : uint8_t {
+  PULSE_LATENCY_ISR_TO_DEQUEUE = 0,
+  PULSE_LATENCY_DEQUEUE_TO_SNAPSHOT,
+  PULSE_LATENCY_SNAPSHOT_TO_ENQUEUE,
+  PULSE_LATENCY_STAGE_COUNT
+};
+
+constexpr uint8_t PULSE_LATENCY_BUCKET_COUNT = 11;
+constexpr uint32_t PULSE_LATENCY_BUCKET_LIMITS_US[PULSE_LATENCY_BUCKET_COUNT - 1] = {
+  50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000
+};
+
+struct PulseLatencyStats {
+  uint32_t buckets[PULSE_LATENCY_STAGE_COUNT][PULSE_LATENCY_BUCKET_COUNT];
+  uint32_t samples[PULSE_LATENCY_STAGE_COUNT];
+  uint32_t maxUs[PULSE_LATENCY_STAGE_COUNT];
+};
+
+// Add one measurement (in microseconds) to the histogram of 'stage'.
+void recordPulseLatency(PulseLatencyStage stage, uint32_t latencyUs);
+
+// Copy the current histograms. Returns false if 'stats' is null.
+bool getPulseLatencyStats(PulseLatencyStats* stats);
+
+void resetPulseLatencyStats();
+
+// Render the histograms as compact text: a line with the bucket upper bounds followed by one line
+// per stage, e.g.
+//   le_us:50/100/200/500/1000/2000/5000/10000/20000/50000/inf
+//   isr>deq n:812 max:164 b:790/12/10/0/0/0/0/0/0/0/0
+// Returns the number of characters written (excluding the terminator).
+size_t formatPulseLatencyHistogram(char* buffer, size_t bufferSize);
+
+// Publish the histogram retained to <prefix><device>/log/latency/pulse. Skipped when no pulse
+// has been recorded since the previous publish.
+bool publishPulseLatencyHistogram();
@@ -0,0 +1,174 @@
+#include "PulseCounterBackend.h"
+#include "config.h"
+
+#include <atomic>
+#include <driver/pcnt.h>
+
+/* ###################################################################################################
+ *               P C N T   P U L S E   C O U N T E R   B A C K E N D
+ * ###################################################################################################
+ *  Pulses are counted by the ESP32 PCNT peripheral, behind its glitch filter, and read by the pulse
+ *  task every PULSE_PCNT_POLL_MS. The 16-bit hardware counter wraps to 0 at PCNT_COUNTER_LIMIT; the
+ *  high-limit event counts every wrap, so a poll gets the exact number of pulses however late it
+ *  comes and nothing is dropped between polls.
+ *
+ *  The edge-capture ISR only stores micros() of the latest edge. It does not queue anything or
+ *  wake the task, and its timestamp is used for power estimation, never for counting. The ISR sees
+ *  the raw pin, so an edge closer to the last stored one than EDGE_MIN_INTERVAL_US is taken as
+ *  bounce and keeps the earlier time: neither the counter's glitch filter nor a real meter produce
+ *  pulses that close together.
+ *
+ *  Bounce that outlasts the glitch filter is still counted. The ISR cannot tell which of the raw
+ *  edges it rejects the filter has already dropped, so taking them off the count would lose a real
+ *  pulse after every short glitch. S0 outputs are transistors, which do not bounce; a noisy line
+ *  needs an RC filter in front of the pin.
+ */
+static constexpr pcnt_unit_t PCNT_PULSE_UNIT = PCNT_UNIT_0;
+static constexpr int16_t PCNT_COUNTER_LIMIT = 32767;
+static constexpr uint32_t PCNT_FILTER_US = (PULSE_PCNT_FILTER_APB_CYCLES + 79) / 80; // Rounded up
+static constexpr uint32_t EDGE_MIN_INTERVAL_US =
+    PULSE_MIN_INTERVAL_US > PCNT_FILTER_US ? PULSE_MIN_INTERVAL_US : PCNT_FILTER_US;
+
+static std::atomic<uint32_t> sLastEdgeUs{0};
+static std::atomic<bool> sEdgeCaptured{false};
+
+static void IRAM_ATTR PulseEdgeCaptureISR() {
+  uint32_t nowUs = micros();
+  if (sEdgeCaptured.load(std::memory_order_relaxed) &&
+      nowUs - sLastEdgeUs.load(std::memory_order_relaxed) < EDGE_MIN_INTERVAL_US) {
+    return;
+  }
+  sLastEdgeUs.store(nowUs, std::memory_order_relaxed);
+  sEdgeCaptured.store(true, std::memory_order_relaxed);
+}
+
+static std::atomic<uint32_t> sCounterWraps{0};
+
+static void IRAM_ATTR PulseCounterWrapISR(void* arg) {
+  (void)arg;
+  sCounterWraps.fetch_add(1, std::memory_order_release);
+}
+
+class PulsePcntBackend : public PulseCounterBackend {
+ public:
+  const char* name() const override {
+    return "pcnt";
+  }
+
+  bool attach(int gpio, int mode, TaskHandle_t consumer) override {
+    (void)consumer; // Polled, never notified
+    if (gpio < 0) {
+      return false;
+    }
+    gpio_ = gpio;
+    mode_ = mode;
+
+    pcnt_config_t config = {};
+    config.pulse_gpio_num = gpio;
+    config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    config.lctrl_mode = PCNT_MODE_KEEP;
+    config.hctrl_mode = PCNT_MODE_KEEP;
+    // Count the same edge the ISR backend triggers on
+    config.pos_mode = (mode == RISING || mode == CHANGE) ? PCNT_COUNT_INC : PCNT_COUNT_DIS;
+    config.neg_mode = (mode == FALLING || mode == CHANGE) ? PCNT_COUNT_INC : PCNT_COUNT_DIS;
+    config.counter_h_lim = PCNT_COUNTER_LIMIT;
+    config.counter_l_lim = -1;
+    config.unit = PCNT_PULSE_UNIT;
+    config.channel = PCNT_CHANNEL_0;
+
+    if (pcnt_unit_config(&config) != ESP_OK) {
+      return false;
+    }
+    pcnt_set_filter_value(PCNT_PULSE_UNIT, PULSE_PCNT_FILTER_APB_CYCLES);
+    pcnt_filter_enable(PCNT_PULSE_UNIT);
+    pcnt_event_enable(PCNT_PULSE_UNIT, PCNT_EVT_H_LIM);
+    esp_err_t serviceResult = pcnt_isr_service_install(0);
+    if (serviceResult != ESP_OK && serviceResult != ESP_ERR_INVALID_STATE) { // INVALID_STATE: already installed
+      return false;
+    }
+    pcnt_isr_handler_remove(PCNT_PULSE_UNIT);
+    if (pcnt_isr_handler_add(PCNT_PULSE_UNIT, PulseCounterWrapISR, nullptr) != ESP_OK) {
+      return false;
+    }
+    pcnt_counter_pause(PCNT_PULSE_UNIT);
+    pcnt_counter_clear(PCNT_PULSE_UNIT);
+    lastCount_ = 0;
+    lastWraps_ = sCounterWraps.load(std::memory_order_acquire);
+    pcnt_counter_resume(PCNT_PULSE_UNIT);
+
+    attachInterrupt(digitalPinToInterrupt(gpio_), PulseEdgeCaptureISR, mode_);
+    return true;
+  }
+
+  void suspend() override {
+    if (gpio_ >= 0) {
+      pcnt_counter_pause(PCNT_PULSE_UNIT);
+      detachInterrupt(digitalPinToInterrupt(gpio_));
+    }
+  }
+
+  void resume() override {
+    if (gpio_ >= 0 && mode_ >= 0) {
+      pcnt_counter_resume(PCNT_PULSE_UNIT);
+      attachInterrupt(digitalPinToInterrupt(gpio_), PulseEdgeCaptureISR, mode_);
+    }
+  }
+
+  bool poll(PulseEvent* event) override {
+    // Read the counter first, then the edge time. A pulse landing between the two reads is left
+    // for the next poll to count, but its edge time is already used here: this poll reads low and
+    // the next one catches up. The other order would stamp a counted pulse with the previous edge.
+    int16_t count = 0;
+    uint32_t wraps = 0;
+    do { // A wrap between the two reads would pair the new count with the old wrap count
+      wraps = sCounterWraps.load(std::memory_order_acquire);
+      if (pcnt_get_counter_value(PCNT_PULSE_UNIT, &count) != ESP_OK) {
+        return false;
+      }
+    } while (wraps != sCounterWraps.load(std::memory_order_acquire));
+    uint32_t lastEdgeUs = sLastEdgeUs.load(std::memory_order_relaxed);
+
+    int64_t pulses = (int64_t)(wraps - lastWraps_) * PCNT_COUNTER_LIMIT + count - lastCount_;
+    if (pulses <= 0) {
+      return false; // < 0: the counter has wrapped and its event has not run yet
+    }
+    uint32_t newPulses = pulses > UINT32_MAX ? UINT32_MAX : (uint32_t)pulses;
+    lastCount_ = count;
+    lastWraps_ = wraps;
+    if (newPulses > peakFill_) {
+      peakFill_ = newPulses;
+    }
+
+    event->count = newPulses;
+    event->timestampUs = lastEdgeUs;
+    return true;
+  }
+
+  TickType_t pollIntervalTicks() const override {
+    return pdMS_TO_TICKS(PULSE_PCNT_POLL_MS);
+  }
+
+  uint32_t overflowCount() const override {
+    return 0; // Every counter wrap is counted (PulseCounterWrapISR), so no pulse is dropped
+  }
+
+  uint32_t capacity() const override {
+    return UINT32_MAX; // One event carries the pulses of any number of counter wraps
+  }
+
+  uint32_t peakFill() const override {
+    return peakFill_;
+  }
+
+ private:
+  int gpio_ = -1;
+  int mode_ = -1;
+  int16_t lastCount_ = 0;
+  uint32_t lastWraps_ = 0;
+  uint32_t peakFill_ = 0;
+};
+
+PulseCounterBackend* getPulsePcntBackend() {
+  static PulsePcntBackend backend;
+  return &backend;
+}
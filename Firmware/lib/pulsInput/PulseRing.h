@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+/*
+ * Lock-free single-producer / single-consumer ring of pulse timestamps.
+ *
+ * PulseInputISR() is the only producer and PulseInputTask the only consumer, so head and tail
+ * each have exactly one writer and no critical section is needed: the producer publishes a slot
+ * with a release store of 'head', the consumer frees it with a release store of 'tail'.
+ * Capacity must be a power of two; one index wraps with a mask instead of a modulo.
+ *
+ * When the ring is full the new timestamp is dropped and counted in overflowCount(), so lost
+ * pulses are visible instead of silent. peakFill() is the highest fill level seen by the
+ * producer and tells how close the ring has come to overflowing.
+ */
+template <uint32_t Capacity>
+class PulseRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "PulseRing capacity must be a power of two");
+
+ public:
+  // Producer side (ISR). Returns false when the ring is full and the timestamp was dropped.
+  bool IRAM_ATTR push(uint32_t timestampUs) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t fill = head - tail_.load(std::memory_order_acquire);
+    if (fill >= Capacity) {
+      overflowCount_.store(overflowCount_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+    slots_[head & (Capacity - 1)] = timestampUs;
+    head_.store(head + 1, std::memory_order_release);
+    if (fill + 1 > peakFill_.load(std::memory_order_relaxed)) {
+      peakFill_.store(fill + 1, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  // Consumer side (task). Returns false when the ring is empty.
+  bool pop(uint32_t* timestampUs) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *timestampUs = slots_[tail & (Capacity - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  uint32_t size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  static constexpr uint32_t capacity() { return Capacity; }
+  uint32_t overflowCount() const { return overflowCount_.load(std::memory_order_relaxed); }
+  uint32_t peakFill() const { return peakFill_.load(std::memory_order_relaxed); }
+
+ private:
+  volatile uint32_t slots_[Capacity] = {};
+  std::atomic<uint32_t> head_{0};          // Written by the producer only
+  std::atomic<uint32_t> tail_{0};          // Written by the consumer only
+  std::atomic<uint32_t> overflowCount_{0}; // Written by the producer only
+  std::atomic<uint32_t> peakFill_{0};      // Written by the producer only
+};
@@ -0,0 +1,118 @@
+#include "PulseRtcShadow.h"
+
+#include <Arduino.h>
+#include <esp_system.h>
+#include <stddef.h>
+
+namespace {
+constexpr uint32_t SHADOW_MAGIC = 0x50524331; // "PRC1"; change with the slot layout
+
+struct ShadowSlot {
+  uint32_t magic;
+  uint32_t generation;
+  uint64_t pulseCounter;
+  uint64_t subtotalPulseCounter;
+  uint64_t storedPulseCounter;         // Last persistent save
+  uint64_t storedSubtotalPulseCounter;
+  uint32_t checksum;                   // FNV-1a over every field above
+};
+
+RTC_NOINIT_ATTR ShadowSlot sSlots[2];
+
+// Latest values, kept in RAM so an update does not have to read the old slot
+uint64_t sPulseCounter = 0;
+uint64_t sSubtotalPulseCounter = 0;
+bool sLiveKnown = false;
+uint64_t sStoredPulseCounter = 0;
+uint64_t sStoredSubtotalPulseCounter = 0;
+bool sStoredKnown = false;
+
+uint32_t checksum(const ShadowSlot& slot) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&slot);
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < offsetof(ShadowSlot, checksum); i++) {
+    hash = (hash ^ bytes[i]) * 16777619UL;
+  }
+  return hash;
+}
+
+bool isValid(const ShadowSlot& slot) {
+  return slot.magic == SHADOW_MAGIC && slot.checksum == checksum(slot);
+}
+
+// Newest valid slot, or -1
+int newestSlot() {
+  bool valid0 = isValid(sSlots[0]);
+  bool valid1 = isValid(sSlots[1]);
+  if (valid0 && valid1) {
+    return (int32_t)(sSlots[1].generation - sSlots[0].generation) > 0 ? 1 : 0;
+  }
+  return valid0 ? 0 : (valid1 ? 1 : -1);
+}
+
+// Only these resets keep RTC slow memory
+bool resetKeepsRtcMemory() {
+  switch (esp_reset_reason()) {
+    case ESP_RST_SW:
+    case ESP_RST_PANIC:
+    case ESP_RST_INT_WDT:
+    case ESP_RST_TASK_WDT:
+    case ESP_RST_WDT:
+    case ESP_RST_DEEPSLEEP:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Overwrites the older slot, so the newer one survives a reset in the middle of the update
+void writeSlot() {
+  int newest = newestSlot();
+  ShadowSlot& slot = sSlots[newest == 0 ? 1 : 0];
+  slot.magic = SHADOW_MAGIC;
+  slot.generation = newest < 0 ? 1 : sSlots[newest].generation + 1;
+  slot.pulseCounter = sPulseCounter;
+  slot.subtotalPulseCounter = sSubtotalPulseCounter;
+  slot.storedPulseCounter = sStoredPulseCounter;
+  slot.storedSubtotalPulseCounter = sStoredSubtotalPulseCounter;
+  slot.checksum = checksum(slot);
+}
+}  // namespace
+
+void pulseRtcShadowUpdate(uint64_t pulseCounter, uint64_t subtotalPulseCounter) {
+  sPulseCounter = pulseCounter;
+  sSubtotalPulseCounter = subtotalPulseCounter;
+  sLiveKnown = true;
+  if (sStoredKnown) { // Nothing to anchor the copy to before the first load
+    writeSlot();
+  }
+}
+
+void pulseRtcShadowStored(uint64_t pulseCounter, uint64_t subtotalPulseCounter) {
+  sStoredPulseCounter = pulseCounter;
+  sStoredSubtotalPulseCounter = subtotalPulseCounter;
+  sStoredKnown = true;
+  if (sLiveKnown) {
+    writeSlot();
+  }
+}
+
+bool pulseRtcShadowLoad(uint64_t storedPulseCounter, uint64_t storedSubtotalPulseCounter,
+                        uint64_t* pulseCounter, uint64_t* subtotalPulseCounter) {
+  int newest = newestSlot();
+  if (newest < 0 || !resetKeepsRtcMemory()) {
+    return false;
+  }
+  const ShadowSlot& slot = sSlots[newest];
+  if (slot.storedPulseCounter != storedPulseCounter || slot.storedSubtotalPulseCounter != storedSubtotalPulseCounter) {
+    return false; // The store was written behind the shadow's back
+  }
+  *pulseCounter = slot.pulseCounter;
+  *subtotalPulseCounter = slot.subtotalPulseCounter;
+  return true;
+}
+
+uint32_t pulseRtcShadowGeneration() {
+  int newest = newestSlot();
+  return newest < 0 ? 0 : sSlots[newest].generation;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Copy of the live pulse counters in RTC slow memory.
+ *
+ * RTC_NOINIT memory keeps its contents across esp_restart(), panics and watchdog resets, but not
+ * across power loss or brownout. PulseInputTask mirrors its counters here on every change, so a
+ * soft reset between two persistent saves (journal or Preferences) loses no pulses; a power cut
+ * still loses up to PULSE_NVS_SAVE_INTERVAL_MS.
+ *
+ * There are two slots, written alternately. Each carries a generation number, one higher than the
+ * other slot's, and a checksum, so a reset in the middle of an update leaves the previous slot
+ * usable. Every slot also records the counters of the last persistent save it knows of: the copy
+ * is only used on boot when those match what the persistent store holds, i.e. when the store has
+ * not been written since (by other firmware, a USB flash erase, the direct-reset emergency save).
+ *
+ * Not thread safe; only PulseInputTask (and startPulseInputTask before it) writes the shadow.
+ */
+
+// Live counters changed.
+void pulseRtcShadowUpdate(uint64_t pulseCounter, uint64_t subtotalPulseCounter);
+
+// The persistent store now holds these counters.
+void pulseRtcShadowStored(uint64_t pulseCounter, uint64_t subtotalPulseCounter);
+
+// Counters from the newest valid slot, if it continues the persistent store's 'stored*' counters
+// and the last reset kept RTC memory. Returns false when the persistent values are the newest.
+bool pulseRtcShadowLoad(uint64_t storedPulseCounter, uint64_t storedSubtotalPulseCounter,
+                        uint64_t* pulseCounter, uint64_t* subtotalPulseCounter);
+
+uint32_t pulseRtcShadowGeneration(); // Generation of the newest valid slot, 0 when none
@@ -1,5 +1,3 @@
-#define STACK_WATERMARK
-
 #include "PushButtonTask.h"
 
 #include <freertos/FreeRTOS.h>
@@ -11,6 +9,7 @@
 #include "ChargingSession.h"
 #include "MqttClient.h"
 #include "OtaService.h"
+#include "WorkerPool.h"
 
 // ---------------------------------------------------------------------------
 //  Command enum – one value per physical button action.
@@ -75,13 +74,12 @@ static void IRAM_ATTR onPriceLimitDecreaseButton() {
 }
 
 // ---------------------------------------------------------------------------
-//  One-shot publish task.
-//  Receives the ButtonCommand as a void* (uintptr_t cast).
-//  Reads current global state, builds the JSON payload, publishes, and
-//  deletes itself.
+//  Publish job (WORKER_JOB_BUTTON_PUBLISH), run by the MQTT worker.
+//  The payload is the ButtonCommand. Reads current global state when the
+//  job runs, builds the JSON payload and publishes it.
 // ---------------------------------------------------------------------------
-static void publishButtonCommandTask(void* param) {
-  ButtonCommand cmd = (ButtonCommand)(uintptr_t)param;
+static void publishButtonCommandJob(const void* param) {
+  ButtonCommand cmd = *static_cast<const ButtonCommand*>(param);
   char payload[64];
 
   switch (cmd) {
@@ -114,17 +112,10 @@ static void publishButtonCommandTask(void* param) {
     }
 
     default:
-      vTaskDelete(nullptr);
       return;
   }
 
   publishMqttSetCommand(payload, false);
-
-  #ifdef STACK_WATERMARK
-  gButtonPublishTaskStackHighWater = uxTaskGetStackHighWaterMark(nullptr);
-  #endif
-
-  vTaskDelete(nullptr);
 }
 
 // ---------------------------------------------------------------------------
@@ -161,13 +152,10 @@ void initPushButtons() {
 void processPushButtonCommands() {
   if (!sButtonQueue || isOtaInProgress()) return;
 
+  // A press the MQTT worker cannot take now stays in sButtonQueue for the next call
   ButtonCommand cmd;
-  while (xQueueReceive(sButtonQueue, &cmd, 0) == pdTRUE) {
-    xTaskCreate(publishButtonCommandTask,
-                "btnPublish",
-                BUTTON_PUBLISH_TASK_STACK_SIZE,
-                (void*)(uintptr_t)cmd,
-                1,
-                nullptr);
+  while (xQueuePeek(sButtonQueue, &cmd, 0) == pdTRUE &&
+         submitWorkerJob(WORKER_JOB_BUTTON_PUBLISH, publishButtonCommandJob, cmd)) {
+    xQueueReceive(sButtonQueue, &cmd, 0);
   }
 }
@@ -14,13 +14,14 @@ constexpr char BUTTON_PRICE_LIMIT[] = "price_limit";
  * queue with ISR-level hardware debounce via esp_timer_get_time().
  *
  * processPushButtonCommands() is intended to be called from networkTask().
- * It drains the queue and spawns a one-shot FreeRTOS task per command that
- * reads the current global state, builds the JSON payload, and publishes it
- * via publishMqttSetCommand().
+ * It drains the queue into publish jobs for the MQTT worker (WorkerPool.h);
+ * each job reads the current global state, builds the JSON payload, and
+ * publishes it via publishMqttSetCommand(). Commands the worker's queue
+ * cannot take yet stay queued for the next call.
  */
 
 // Call once from setup() after Serial and GPIO subsystems are ready.
 void initPushButtons();
 
-// Call from networkTask() to drain the button command queue and spawn publish tasks.
+// Call from networkTask() to drain the button command queue into publish jobs.
 void processPushButtonCommands();
@@ -13,14 +13,21 @@
 #include "oled_energy_display.h"
 #include "config.h"
 #include "LedTask.h"
+#include "OtaService.h"
+#include "AcEnergy.h"
+#include "AcRms.h"
+#include "AcSampler.h"
+#include "WorkerPool.h"
 
 
 namespace {
 enum class ChargingState {
   Idle,
   StartCandidate,
+  Starting,        // Start confirmed, waiting for the StartTelemetry job
   Charging,
-  EndCandidate
+  EndCandidate,
+  Ending           // End confirmed, waiting for the EndTelemetry job
 };
 
 struct ChargingSnapshot {
@@ -43,6 +50,53 @@ static uint32_t gLastSampleMs = 0;
 static bool gPendingTeslaDataUpload = false;
 static String gPendingTeslaDataPayload;
 
+// CT energy versus meter energy of the running session. RAM only: after a reboot a restored
+// session is compared from the reboot on, both counters from the same moment.
+struct SessionEnergyCheck {
+  bool active = false;
+  uint64_t startCtMilliWh = 0;
+  uint64_t startMeterMilliWh = 0;
+  uint32_t lastReportMs = 0;
+  bool mismatchReported = false;
+};
+static SessionEnergyCheck gEnergyCheck;
+
+// Tesla Owner API and Google Sheets calls take up to tens of seconds (vehicle wake-up retries,
+// 20 s HTTP timeouts). They run as jobs on the network worker (WorkerPool.h), one at a time and
+// never together with a TeslaLog upload, and each result comes back to the ChargingSession task
+// as an event, so the state machine never waits for them.
+enum class ChargingJobType : uint8_t {
+  StartTelemetry,   // Battery level and odometer for the start snapshot
+  EndTelemetry,     // Vehicle state for the TeslaData row
+  TeslaDataUpload   // TeslaData row to Google Sheets
+};
+
+constexpr size_t CHARGING_TESLA_DATA_PAYLOAD_LEN = 192;
+constexpr size_t CHARGING_JOB_ERROR_LEN = 64;
+constexpr UBaseType_t CHARGING_SESSION_TASK_PRIORITY = 1;
+
+struct ChargingJob {
+  ChargingJobType type;
+  char payload[CHARGING_TESLA_DATA_PAYLOAD_LEN]; // TeslaDataUpload
+};
+
+struct ChargingJobResult {
+  ChargingJobType type;
+  bool ok;
+  TeslaTelemetry telemetry;            // StartTelemetry, EndTelemetry
+  char error[CHARGING_JOB_ERROR_LEN];
+};
+
+static QueueHandle_t gJobResultQueue = nullptr;  // Holds the result of the one job in flight
+static TaskParams_t* gSessionParams = nullptr;
+static TaskHandle_t gChargingSessionTaskHandle = nullptr;
+static bool gJobInFlight = false;
+static ChargingSnapshot gStartingSnapshot;        // Start time and energy, taken when the start was confirmed
+static float gEndEnergyKwh = 0.0f;                // Taken when the end was confirmed
+static uint32_t gTeslaDataUploadAttempts = 0;
+static uint32_t gLastTeslaDataUploadMs = 0;
+static volatile bool gCharging = false;           // gState == Charging, read by other tasks
+
 static void formatDateTimeFromEpoch(uint64_t epochSeconds,
                                     char* dateBuf,
                                     size_t dateBufLen,
@@ -111,21 +165,122 @@ static bool candidateDurationReached(uint32_t candidateSinceMs, uint32_t require
   return (millis() - candidateSinceMs) >= (requiredSeconds * 1000UL);
 }
 
-static bool createStartSnapshot() {
-  TeslaTelemetry telemetry;
-  String telemetryError;
-  if (!teslaGetTelemetry(&telemetry, &telemetryError)) {
+/* ###################################################################################################
+ *               C T   /   M E T E R   E N E R G Y   C H E C K
+ * ###################################################################################################
+ */
+// Needs the AC sampler: the analogRead() fallback only samples once per second, too seldom to
+// integrate.
+static void startSessionEnergyCheck(uint32_t nowMs) {
+  if (!acSamplerRunning()) {
+    return;
+  }
+  uint32_t meterPowerW = 0;
+  uint64_t meterMilliWh = 0;
+  uint64_t subtotalMilliWh = 0;
+  if (!getLatestEnergySnapshot(&meterPowerW, &meterMilliWh, &subtotalMilliWh)) {
+    return;
+  }
+  AcSamplerReading reading;
+  acSamplerLatest(&reading, UINT32_MAX); // The energy counter is valid before the first window
+
+  gEnergyCheck.active = true;
+  gEnergyCheck.startCtMilliWh = reading.energyMilliWh;
+  gEnergyCheck.startMeterMilliWh = meterMilliWh;
+  gEnergyCheck.lastReportMs = nowMs;
+  gEnergyCheck.mismatchReported = false;
+}
 
-                                                                  #ifdef DEBUG_CHARGING_SESSION
-                                                                    char logMsg[128] = {0};
-                                                                    snprintf(logMsg, sizeof(logMsg), "Charging start telemetry failed: %s", telemetryError.c_str());
-                                                                    Serial.println(logMsg);
-                                                                  #endif
+// Publishes the CT and meter energy of the session so far (retained), and a log line the first
+// time they disagree. 'sessionEnd' publishes the final figures and stops the check.
+static void reportSessionEnergy(uint32_t nowMs, bool sessionEnd) {
+  if (!gEnergyCheck.active) {
+    return;
+  }
+  uint32_t meterPowerW = 0;
+  uint64_t meterMilliWh = 0;
+  uint64_t subtotalMilliWh = 0;
+  if (!getLatestEnergySnapshot(&meterPowerW, &meterMilliWh, &subtotalMilliWh)) {
+    return;
+  }
+  AcSamplerReading reading;
+  acSamplerLatest(&reading, UINT32_MAX);
+  gEnergyCheck.lastReportMs = nowMs;
+
+  const uint64_t ctMilliWh = reading.energyMilliWh - gEnergyCheck.startCtMilliWh;
+  // The meter counter can be set back through /set during a session
+  const uint64_t sessionMeterMilliWh =
+      meterMilliWh > gEnergyCheck.startMeterMilliWh ? meterMilliWh - gEnergyCheck.startMeterMilliWh : 0;
+  const AcEnergyCheck check = acEnergyCheck(ctMilliWh, sessionMeterMilliWh, CHARGING_ENERGY_CHECK_MIN_WH * 1000ULL,
+                                            CHARGING_ENERGY_CHECK_TOLERANCE_PERCENT);
+  const uint32_t ratioMilli = ctMilliWh > 0 ? (uint32_t)(sessionMeterMilliWh * 1000 / ctMilliWh) : 0; // meter / CT
+
+  char logMsg[192] = {0};
+  snprintf(logMsg,
+           sizeof(logMsg),
+           "session:%s ct_a:%lu.%02lu ct_w:%lu meter_w:%lu ct_wh:%lu.%lu meter_wh:%lu.%lu ratio:%lu.%03lu check:%s",
+           sessionEnd ? "end" : "charging",
+           (unsigned long)(reading.currentMilliAmps / 1000),
+           (unsigned long)(reading.currentMilliAmps % 1000 / 10),
+           (unsigned long)reading.powerW,
+           (unsigned long)meterPowerW,
+           (unsigned long)(ctMilliWh / 1000),
+           (unsigned long)(ctMilliWh % 1000 / 100),
+           (unsigned long)(sessionMeterMilliWh / 1000),
+           (unsigned long)(sessionMeterMilliWh % 1000 / 100),
+           (unsigned long)(ratioMilli / 1000),
+           (unsigned long)(ratioMilli % 1000),
+           acEnergyCheckName(check));
+  publishMqttLog(MQTT_TOPIC_LOG_CHARGING_ENERGY, logMsg, RETAINED);
+
+                                                                #ifdef DEBUG_CHARGING_SESSION
+                                                                  Serial.print("Chargingsession.cpp: ");
+                                                                  Serial.println(logMsg);
+                                                                #endif
 
-    publishMqttLogStatus((String("Charging start telemetry failed: ") + telemetryError).c_str(), false);
+  if (check == AcEnergyCheck::Mismatch && !gEnergyCheck.mismatchReported) {
+    snprintf(logMsg,
+             sizeof(logMsg),
+             "Charging energy mismatch: CT %lu Wh, meter %lu Wh. Check the CT clamp and the meter pulses",
+             (unsigned long)(ctMilliWh / 1000),
+             (unsigned long)(sessionMeterMilliWh / 1000));
+    publishMqttLog(MQTT_LOG_SUFFIX, logMsg, false);
+    gEnergyCheck.mismatchReported = true;
+  }
+
+  if (sessionEnd) {
+    gEnergyCheck.active = false;
+  }
+}
+
+// WORKER_JOB_CHARGING_TESLA, on the network worker
+static void runChargingJob(const void* payload) {
+  const ChargingJob* job = static_cast<const ChargingJob*>(payload);
+  static ChargingJobResult result;
+
+  result = ChargingJobResult();
+  result.type = job->type;
+  if (job->type == ChargingJobType::TeslaDataUpload) {
+    result.ok = sendTeslaPayloadToGoogleSheets(gSessionParams, TeslaSheetTarget::TeslaData, job->payload);
+  } else {
+    String telemetryError;
+    result.ok = teslaGetTelemetry(&result.telemetry, &telemetryError);
+    snprintf(result.error, sizeof(result.error), "%s", telemetryError.c_str());
+  }
+  xQueueSend(gJobResultQueue, &result, portMAX_DELAY);
+}
+
+static bool postChargingJob(const ChargingJob& job) {
+  if (gJobInFlight || !submitWorkerJob(WORKER_JOB_CHARGING_TESLA, runChargingJob, job)) {
     return false;
   }
+  gJobInFlight = true;
+  return true;
+}
 
+// Start confirmed: the start time and energy are taken now, the vehicle state when the
+// StartTelemetry job completes (completeStartSnapshot()).
+static bool requestStartSnapshot() {
   float latestEnergyKwh = 0.0f;
   if (!getLatestEnergyKwh(&latestEnergyKwh)) {
 
@@ -137,13 +292,38 @@ static bool createStartSnapshot() {
     return false;
   }
 
+  ChargingJob job = {};
+  job.type = ChargingJobType::StartTelemetry;
+  if (!postChargingJob(job)) {
+    publishMqttLogStatus("Charging start telemetry not requested: Tesla job running or network worker queue full", false);
+    return false;
+  }
+
+  time_t now = time(nullptr);
+  gStartingSnapshot = ChargingSnapshot();
+  gStartingSnapshot.startEpoch = now > 0 ? (uint64_t)now : 0;
+  gStartingSnapshot.startEnergyKwh = latestEnergyKwh;
+  return true;
+}
+
+static bool completeStartSnapshot(const ChargingJobResult& result) {
+  if (!result.ok) {
+
+                                                                  #ifdef DEBUG_CHARGING_SESSION
+                                                                    char logMsg[128] = {0};
+                                                                    snprintf(logMsg, sizeof(logMsg), "Charging start telemetry failed: %s", result.error);
+                                                                    Serial.println(logMsg);
+                                                                  #endif
+
+    publishMqttLogStatus((String("Charging start telemetry failed: ") + result.error).c_str(), false);
+    return false;
+  }
+
   const float milesToKm = 1.609344f;
+  gSnapshot = gStartingSnapshot;
   gSnapshot.active = true;
-  time_t now = time(nullptr);
-  gSnapshot.startEpoch = now > 0 ? (uint64_t)now : 0;
-  gSnapshot.startEnergyKwh = latestEnergyKwh;
-  gSnapshot.startBatteryLevelPercent = telemetry.batteryLevelPercent;
-  gSnapshot.startOdometerKm = telemetry.odometerMiles * milesToKm;
+  gSnapshot.startBatteryLevelPercent = result.telemetry.batteryLevelPercent;
+  gSnapshot.startOdometerKm = result.telemetry.odometerMiles * milesToKm;
 
   saveSessionToNvs();
 
@@ -215,41 +395,80 @@ static String buildTeslaDataPayload(const TeslaTelemetry& endTelemetry, float en
   return payload;
 }
 
-static bool finalizeChargingSession(TaskParams_t* params) {
-  TeslaTelemetry endTelemetry;
-  String telemetryError;
-  if (!teslaGetTelemetry(&endTelemetry, &telemetryError)) {
-    publishMqttLogStatus((String("Charging end telemetry failed: ") + telemetryError).c_str(), false);
-    return false;
+// Queues the pending TeslaData row for upload; retried every CHARGING_TESLA_DATA_RETRY_INTERVAL_MS
+// until Google Sheets accepts it.
+static void requestTeslaDataUpload() {
+  if (!gPendingTeslaDataUpload || gPendingTeslaDataPayload.isEmpty()) {
+    return;
   }
-
-  float endEnergyKwh = 0.0f;
-  if (!getLatestEnergyKwh(&endEnergyKwh)) {
-    publishMqttLogStatus("Charging end energy snapshot failed", false);
-    return false;
+  ChargingJob job = {};
+  job.type = ChargingJobType::TeslaDataUpload;
+  snprintf(job.payload, sizeof(job.payload), "%s", gPendingTeslaDataPayload.c_str());
+  if (postChargingJob(job)) {
+    gTeslaDataUploadAttempts++;
+    gLastTeslaDataUploadMs = millis();
   }
+}
 
-  String payload = buildTeslaDataPayload(endTelemetry, endEnergyKwh);
+static void completeTeslaDataUpload(bool sent) {
+  if (sent) {
 
-  if (!sendTeslaPayloadToGoogleSheets(params, TeslaSheetTarget::TeslaData, payload.c_str())) {
-    gPendingTeslaDataPayload = payload;
-    gPendingTeslaDataUpload = true;
+                                                                #ifdef DEBUG_CHARGING_SESSION
+                                                                  Serial.println("Chargingsession.cpp: TeslaData upload sent");  
+                                                                #endif
+
+    publishMqttLog(MQTT_LOG_SUFFIX, gTeslaDataUploadAttempts > 1 ? "Pending TeslaData upload sent" : "TeslaData upload sent", false);
+    gPendingTeslaDataUpload = false;
+    gPendingTeslaDataPayload = "";
+    gTeslaDataUploadAttempts = 0;
+  } else if (gTeslaDataUploadAttempts == 1) {
 
                                                                 #ifdef DEBUG_CHARGING_SESSION
                                                                   Serial.println("Chargingsession.cpp: TeslaData upload pending (WiFi/API)");
                                                                 #endif
 
     publishMqttLog(MQTT_LOG_SUFFIX, "TeslaData upload pending (WiFi/API)", false);
-  } else {
+  }
+}
 
-                                                                #ifdef DEBUG_CHARGING_SESSION
-                                                                  Serial.println("Chargingsession.cpp: TeslaData upload sent");  
-                                                                #endif
+// End confirmed: the end energy is taken now, the vehicle state when the EndTelemetry job
+// completes (completeEndSnapshot()).
+static bool requestEndSnapshot() {
+  float endEnergyKwh = 0.0f;
+  if (!getLatestEnergyKwh(&endEnergyKwh)) {
+    publishMqttLogStatus("Charging end energy snapshot failed", false);
+    return false;
+  }
 
-    publishMqttLog(MQTT_LOG_SUFFIX, "TeslaData upload sent", false);
+  ChargingJob job = {};
+  job.type = ChargingJobType::EndTelemetry;
+  if (!postChargingJob(job)) {
+    return false;
   }
+  gEndEnergyKwh = endEnergyKwh;
+  return true;
+}
 
-  gLastEndEnergyKwh = endEnergyKwh;
+static bool completeEndSnapshot(const ChargingJobResult& result) {
+  if (!result.ok) {
+    publishMqttLogStatus((String("Charging end telemetry failed: ") + result.error).c_str(), false);
+    return false;
+  }
+
+  String payload = buildTeslaDataPayload(result.telemetry, gEndEnergyKwh);
+  if (payload.length() >= CHARGING_TESLA_DATA_PAYLOAD_LEN) {
+    publishMqttLogStatus("TeslaData row too long; truncated", false);
+  }
+
+  // A row that has not been uploaded yet is replaced by the newer session
+  gPendingTeslaDataPayload = payload;
+  gPendingTeslaDataUpload = true;
+  gTeslaDataUploadAttempts = 0;
+  requestTeslaDataUpload();
+
+  reportSessionEnergy(millis(), true);
+
+  gLastEndEnergyKwh = gEndEnergyKwh;
   gHasLastEndEnergy = true;
 
   gSnapshot.active = false;
@@ -262,20 +481,9 @@ static bool finalizeChargingSession(TaskParams_t* params) {
   return true;
 }
 
-static void trySendPendingTeslaData(TaskParams_t* params) {
-  if (!gPendingTeslaDataUpload || gPendingTeslaDataPayload.isEmpty()) {
-    return;
-  }
-
-  if (sendTeslaPayloadToGoogleSheets(params, TeslaSheetTarget::TeslaData, gPendingTeslaDataPayload.c_str())) {
-    gPendingTeslaDataUpload = false;
-    gPendingTeslaDataPayload = "";
-    publishMqttLog(MQTT_LOG_SUFFIX, "Pending TeslaData upload sent", false);
-  }
-}
 } // namespace
 
-void initChargingSession() {
+static void initChargingSession() {
   if (gSessionInitialized) {
     return;
   }
@@ -283,8 +491,11 @@ void initChargingSession() {
   loadSessionFromNvs();
 
   if (CHARGING_ANALOG_GPIO >= 0) {
-    pinMode(CHARGING_ANALOG_GPIO, INPUT);
-    analogReadResolution(12); // 0-4095 range for 12-bit ADC
+    if (!startAcSampler(CHARGING_ANALOG_GPIO)) {
+      pinMode(CHARGING_ANALOG_GPIO, INPUT);
+      analogReadResolution(12); // 0-4095 range for 12-bit ADC
+      publishMqttLog(MQTT_LOG_SUFFIX, "AC sampler unavailable; sampling with analogRead()", false);
+    }
   }
 
   if (gSnapshot.active) {
@@ -306,50 +517,87 @@ void initChargingSession() {
 
   }
 
+  gCharging = gState == ChargingState::Charging;
   gSessionInitialized = true;
 }
 
-// Reads the SCT01-T10/50A AC current sensor connected to `gpio` and returns the
-// RMS amplitude of the AC component as a 12-bit ADC count.
-// The input waveform is expected to be biased near the ADC mid-point, but the
-// function estimates the actual DC offset for each sample window so resistor
-// tolerance and ADC offset do not skew the result.
+// Fallback when the AC sampler cannot run: reads the SCT01-T10/50A AC current sensor
+// connected to `gpio` and returns the RMS amplitude of the AC component as a 12-bit ADC count.
+// Blocks for CHARGING_AC_SAMPLE_COUNT ms. The DC offset of the window is removed exactly in
+// integer arithmetic (acRmsMilliCountsOfSums()), so resistor tolerance and ADC offset do not
+// skew the result.
 static int readAcRms(int gpio) {
-  double mean = 0.0;
-  double sumSquares = 0.0;
+  uint64_t sum = 0;
+  uint64_t sumSquares = 0;
 
   for (int i = 0; i < CHARGING_AC_SAMPLE_COUNT; ++i) {
-    const double sample = analogRead(gpio);
-    const double delta = sample - mean;
-    mean += delta / (i + 1);
-    const double centered = sample - mean;
-    sumSquares += delta * centered;
+    const uint32_t sample = analogRead(gpio);
+    sum += sample;
+    sumSquares += sample * sample;
     delay(1); // 1 ms per sample → CHARGING_AC_SAMPLE_COUNT ms total window
   }
 
-  return CHARGING_AC_SAMPLE_COUNT > 0
-           ? (int)lround(sqrt(sumSquares / CHARGING_AC_SAMPLE_COUNT))
-           : 0;
+  return (int)((acRmsMilliCountsOfSums(sum, sumSquares, CHARGING_AC_SAMPLE_COUNT) + 500) / 1000);
 }
 
-void handleChargingSession(TaskParams_t* params) {
-  if (CHARGING_ANALOG_GPIO < 0) {
-    return;
-  }
+// The end could not be finalized: confirm it again for CHARGING_END_CONFIRM_SECONDS, then retry
+static void retryChargingEnd(uint32_t nowMs) {
+  gState = ChargingState::EndCandidate;
+  gCandidateSinceMs = nowMs;
 
-  if (!gSessionInitialized) {
-    initChargingSession();
-  }
+                                                                #ifdef DEBUG_CHARGING_SESSION
+                                                                  Serial.println("Chargingsession.cpp: Charging end finalization failed; remaining in EndCandidate");
+                                                                #endif
 
-  trySendPendingTeslaData(params);
+  publishMqttLog(MQTT_LOG_SUFFIX, "Charging end finalization failed; retry pending", false);
+}
 
-  uint32_t nowMs = millis();
-  if ((nowMs - gLastSampleMs) < CHARGING_ANALOG_SAMPLE_INTERVAL_MS) {
-    return;
+static void handleChargingJobResult(const ChargingJobResult& result) {
+  gJobInFlight = false;
+  switch (result.type) {
+    case ChargingJobType::StartTelemetry:
+      gState = completeStartSnapshot(result) ? ChargingState::Charging : ChargingState::Idle;
+      break;
+
+    case ChargingJobType::EndTelemetry:
+      if (completeEndSnapshot(result)) {
+        gState = ChargingState::Idle;
+      } else {
+        retryChargingEnd(millis());
+      }
+      break;
+
+    case ChargingJobType::TeslaDataUpload:
+      completeTeslaDataUpload(result.ok);
+      break;
   }
+  gCharging = gState == ChargingState::Charging;
+}
+
+// One step of the state machine, every CHARGING_ANALOG_SAMPLE_INTERVAL_MS
+static void handleChargingSession() {
+  uint32_t nowMs = millis();
   gLastSampleMs = nowMs;
 
-  int analogValue = readAcRms(CHARGING_ANALOG_GPIO);
+  if (gPendingTeslaDataUpload && !gJobInFlight &&
+      (nowMs - gLastTeslaDataUploadMs) >= CHARGING_TESLA_DATA_RETRY_INTERVAL_MS) {
+    requestTeslaDataUpload();
+  }
+
+  int analogValue = 0;
+  if (acSamplerRunning()) {
+    // The sampler completes a frame every AC_SAMPLER_FRAME_SAMPLES samples (10 ms) and an RMS window
+    // every mains cycle. Without a window during a whole sample interval it has stalled (or only just
+    // started): keep the state rather than act on an old value. analogRead() is no fallback here,
+    // ADC1 belongs to the DMA.
+    AcSamplerReading reading;
+    if (!acSamplerLatest(&reading, CHARGING_ANALOG_SAMPLE_INTERVAL_MS)) {
+      return;
+    }
+    analogValue = reading.rmsCounts;
+  } else {
+    analogValue = readAcRms(CHARGING_ANALOG_GPIO);
+  }
 
                                                             #ifdef DEBUG_CHARGING_SESSION
                                                             static int lastSerialLoggedAnalogValue = -1;
@@ -362,12 +610,18 @@ void handleChargingSession(TaskParams_t* params) {
                                                                 case ChargingState::StartCandidate:
                                                                   Serial.print("StartCandidate");
                                                                   break;
+                                                                case ChargingState::Starting:
+                                                                  Serial.print("Starting");
+                                                                  break;
                                                                 case ChargingState::Charging:
                                                                   Serial.print("Charging");
                                                                   break;
                                                                 case ChargingState::EndCandidate:
                                                                   Serial.print("EndCandidate");
                                                                   break;
+                                                                case ChargingState::Ending:
+                                                                  Serial.print("Ending");
+                                                                  break;
                                                               }
                                                               Serial.println();
                                                               Serial.print("ChargingSession.cpp: Charging threshold: ");
@@ -393,15 +647,15 @@ void handleChargingSession(TaskParams_t* params) {
         break;
       }
       if (candidateDurationReached(gCandidateSinceMs, CHARGING_START_CONFIRM_SECONDS)) {
-        if (createStartSnapshot()) {
-          gState = ChargingState::Charging;
-        } else {
-          gState = ChargingState::Idle;
-        }
+        gState = requestStartSnapshot() ? ChargingState::Starting : ChargingState::Idle;
         gCandidateSinceMs = 0;
       }
       break;
 
+    case ChargingState::Starting:
+    case ChargingState::Ending:
+      break;  // handleChargingJobResult() moves on when the job completes
+
     case ChargingState::Charging:
       if (isEndCondition(analogValue)) {
         gState = ChargingState::EndCandidate;
@@ -416,24 +670,24 @@ void handleChargingSession(TaskParams_t* params) {
         break;
       }
       if (candidateDurationReached(gCandidateSinceMs, CHARGING_END_CONFIRM_SECONDS)) {
-        if (finalizeChargingSession(params)) {
-          gState = ChargingState::Idle;
+        if (requestEndSnapshot()) {
+          gState = ChargingState::Ending;
+          gCandidateSinceMs = 0;
         } else {
-          gState = ChargingState::EndCandidate;
-          gCandidateSinceMs = nowMs;
-
-                                                                #ifdef DEBUG_CHARGING_SESSION
-                                                                  Serial.println("Chargingsession.cpp: Charging end finalization failed; remaining in EndCandidate");
-                                                                #endif
-
-          publishMqttLog(MQTT_LOG_SUFFIX, "Charging end finalization failed; retry pending", false);
-          break;
+          retryChargingEnd(nowMs);
         }
-        gCandidateSinceMs = 0;
       }
       break;
   }
 
+  if (gState == ChargingState::Charging || gState == ChargingState::EndCandidate) {
+    if (!gEnergyCheck.active) {
+      startSessionEnergyCheck(nowMs);
+    } else if ((nowMs - gEnergyCheck.lastReportMs) >= CHARGING_ENERGY_REPORT_INTERVAL_MS) {
+      reportSessionEnergy(nowMs, false);
+    }
+  }
+
                                                                 #ifdef  HEADLESS_DEBUG
                                                                 static int lastHeadlessLoggedAnalogValue = -1;
                                                                 static ChargingState lastHeadlessLoggedState = ChargingState::Idle;
@@ -451,12 +705,18 @@ void handleChargingSession(TaskParams_t* params) {
                                                                     case ChargingState::StartCandidate:
                                                                       snprintf(stateStr, sizeof(stateStr), "StartCandidate");
                                                                       break;
+                                                                    case ChargingState::Starting:
+                                                                      snprintf(stateStr, sizeof(stateStr), "Starting");
+                                                                      break;
                                                                     case ChargingState::Charging:
                                                                       snprintf(stateStr, sizeof(stateStr), "Charging");
                                                                       break;
                                                                     case ChargingState::EndCandidate:
                                                                       snprintf(stateStr, sizeof(stateStr), "EndCandidate");
                                                                       break;
+                                                                    case ChargingState::Ending:
+                                                                      snprintf(stateStr, sizeof(stateStr), "Ending");
+                                                                      break;
                                                                   }
                                                                   char logMsg[128] = {0};
                                                                   snprintf(logMsg, sizeof(logMsg), "Chg state: %s, %d", stateStr, analogValue);
@@ -469,6 +729,8 @@ void handleChargingSession(TaskParams_t* params) {
 
 
 
+  gCharging = gState == ChargingState::Charging;
+
   if (gMqttConnected) {
     if (gState == ChargingState::Charging) {
       sendLedCommand("TurnOn");
@@ -479,6 +741,45 @@ void handleChargingSession(TaskParams_t* params) {
 
 }
 
+/* ###################################################################################################
+ *               T A S K S
+ * ###################################################################################################
+ */
+// Steps the state machine every CHARGING_ANALOG_SAMPLE_INTERVAL_MS and handles job results as
+// they arrive. Paused during OTA, as loop() used to skip it.
+static void ChargingSessionTask(void* pvParameters) {
+  (void)pvParameters;
+  static ChargingJobResult result;
+
+  for (;;) {
+    const uint32_t sinceSampleMs = millis() - gLastSampleMs;
+    const TickType_t waitTicks = sinceSampleMs >= CHARGING_ANALOG_SAMPLE_INTERVAL_MS
+                                     ? 0
+                                     : pdMS_TO_TICKS(CHARGING_ANALOG_SAMPLE_INTERVAL_MS - sinceSampleMs);
+    if (xQueueReceive(gJobResultQueue, &result, waitTicks) == pdTRUE) {
+      handleChargingJobResult(result);
+      continue;
+    }
+    if (isOtaInProgress()) {
+      gLastSampleMs = millis();
+      continue;
+    }
+    handleChargingSession();
+  }
+}
+
+void startChargingSessionTask(TaskParams_t* params) {
+  initChargingSession();
+  if (CHARGING_ANALOG_GPIO < 0 || gChargingSessionTaskHandle != nullptr) {
+    return;
+  }
+
+  gSessionParams = params;
+  gJobResultQueue = xQueueCreate(1, sizeof(ChargingJobResult));
+  xTaskCreate(ChargingSessionTask, "ChargingSession", CHARGING_SESSION_TASK_STACK_SIZE, params,
+              CHARGING_SESSION_TASK_PRIORITY, &gChargingSessionTaskHandle);
+}
+
 bool isChargingSessionCharging() {
-  return gState == ChargingState::Charging;
+  return gCharging;
 }
@@ -2,8 +2,19 @@
 
 #include "../globals/globals.h"
 
-void initChargingSession();
-void handleChargingSession(TaskParams_t* params);
+/*
+ * Charging session state machine, in its own task instead of loop().
+ *
+ * The ChargingSession task samples the AC current every CHARGING_ANALOG_SAMPLE_INTERVAL_MS and
+ * steps Idle -> StartCandidate -> Starting -> Charging -> EndCandidate -> Ending -> Idle. The Tesla
+ * telemetry of the start and end snapshots and the TeslaData upload run as jobs on the network
+ * worker (WorkerPool.h); Starting and Ending wait for their results, which come back to the
+ * ChargingSession task as events. Nothing of it blocks loop().
+ */
+
+// Restores a session saved in NVS, starts the AC sampler and, with a CHARGING_ANALOG_GPIO, the
+// ChargingSession task. Needs startWorkerPool(). Calling it again is a no-op.
+void startChargingSessionTask(TaskParams_t* params);
 
 /* ============================================================================
  * ===============  To be used to display charging status ===========================*/
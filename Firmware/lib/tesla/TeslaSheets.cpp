@@ -1,5 +1,4 @@
 //#define DEBUG
-#define STACK_WATERMARK
 
 #include <Arduino.h>
 #include <HTTPClient.h>
@@ -12,39 +11,24 @@
 #include "oled_energy_display.h"
 #include "OtaService.h"
 #include "privateConfig.h"
+#include "WorkerPool.h"
 
 namespace {
 constexpr size_t TESLA_COMMENT_BUFFER_SIZE = 48;
 
-struct TeslaTelemetryQueueItem {
-  TaskParams_t* params = nullptr;
-  float energyKwh = 0.0f;
-  char comment[TESLA_COMMENT_BUFFER_SIZE] = {0};
+struct TeslaTelemetryJob {
+  TaskParams_t* params;
+  float energyKwh;
+  char comment[TESLA_COMMENT_BUFFER_SIZE];
 };
 
-// constexpr uint32_t TESLA_TELEMETRY_TASK_STACK_SIZE = 8192; // '//'TOBE REMOVED after testing TESLA_TELEMETRY_TASK_STACK_SIZE
-constexpr UBaseType_t TESLA_TELEMETRY_TASK_PRIORITY = 1;
-static portMUX_TYPE teslaTelemetryTaskStateMux = portMUX_INITIALIZER_UNLOCKED;
-static TaskHandle_t teslaTelemetryTaskHandle = nullptr;
 constexpr size_t TESLA_PAYLOAD_BUFFER_SIZE = 224;
 constexpr size_t TESLA_URL_BUFFER_SIZE = 640;
 
-static void sendTeslaTelemetryToGoogleSheetsTask(void* pvParameters) {
-  TeslaTelemetryQueueItem* item = static_cast<TeslaTelemetryQueueItem*>(pvParameters);
-  if (item != nullptr) {
-    sendTeslaTelemetryToGoogleSheets(item->params, item->energyKwh, item->comment);
-    delete item;
-  }
-
-                                                            #ifdef STACK_WATERMARK
-                                                            gTeslaTaskStackHighWater = uxTaskGetStackHighWaterMark(nullptr);
-                                                            #endif
-
-  portENTER_CRITICAL(&teslaTelemetryTaskStateMux);
-  teslaTelemetryTaskHandle = nullptr;
-  portEXIT_CRITICAL(&teslaTelemetryTaskStateMux);
-
-  vTaskDelete(nullptr);
+// WORKER_JOB_TESLA_TELEMETRY, on the network worker
+static void runTeslaTelemetryJob(const void* payload) {
+  const TeslaTelemetryJob* job = static_cast<const TeslaTelemetryJob*>(payload);
+  sendTeslaTelemetryToGoogleSheets(job->params, job->energyKwh, job->comment);
 }
 }
 
@@ -288,55 +272,9 @@ bool passTeslaTelemetryToGoogleSheets(TaskParams_t* params, float energyKwh, con
     return false;
   }
 
-  portENTER_CRITICAL(&teslaTelemetryTaskStateMux);
-  if (teslaTelemetryTaskHandle != nullptr) {
-    portEXIT_CRITICAL(&teslaTelemetryTaskStateMux);
-    return false;
-  }
-  portEXIT_CRITICAL(&teslaTelemetryTaskStateMux);
-
-  TeslaTelemetryQueueItem* item = new TeslaTelemetryQueueItem;
-  /* Note: If the allocation fails, it returns nullptr. We should check for that before proceeding.
-   * item can be nullptr only if allocation fails (or a custom allocator returns null).
-   * 
-   * Most likely causes on ESP32/Arduino:
-   * 
-   * Heap exhausted: not enough free RAM when new runs.
-   * Heap fragmentation: total free heap exists, but no contiguous block large enough.
-   * Transient memory pressure: other tasks/allocations briefly consume heap at that moment.
-   * Allocator/heap corruption: prior out-of-bounds write or double-free breaks allocator state.
-   * Custom operator new behavior: in many embedded builds, new is non-throwing and may return nullptr on OOM.
-   * 
-   * It might be rare to hit this in practice unless the system is under heavy memory pressure or fragmentation, 
-   * but it's good to check to avoid dereferencing a null pointer and crashing. 
-   * If allocation fails, we return false to indicate we couldn't enqueue the telemetry.
-   * 
-   * It might be worth adding logging here in debug builds to help identify if/when this happens, 
-   * as it could indicate memory issues that need to be addressed.
-   */
-  if (item == nullptr) {
-    return false;
-  }
-
-  item->params = params;
-  item->energyKwh = energyKwh;
-  snprintf(item->comment, sizeof(item->comment), "%s", (comment != nullptr) ? comment : "");
-
-  BaseType_t result = xTaskCreate(
-      sendTeslaTelemetryToGoogleSheetsTask,
-      "TeslaSheetsTask",
-      TESLA_TELEMETRY_TASK_STACK_SIZE,
-      item,
-      TESLA_TELEMETRY_TASK_PRIORITY,
-      &teslaTelemetryTaskHandle);
-
-  if (result != pdPASS) {
-    delete item;
-    portENTER_CRITICAL(&teslaTelemetryTaskStateMux);
-    teslaTelemetryTaskHandle = nullptr;
-    portEXIT_CRITICAL(&teslaTelemetryTaskStateMux);
-    return false;
-  }
-
-  return true;
-}
\ No newline at end of file
+  TeslaTelemetryJob job = {};
+  job.params = params;
+  job.energyKwh = energyKwh;
+  snprintf(job.comment, sizeof(job.comment), "%s", (comment != nullptr) ? comment : "");
+  return submitWorkerJob(WORKER_JOB_TESLA_TELEMETRY, runTeslaTelemetryJob, job);
+}
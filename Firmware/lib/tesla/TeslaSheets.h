@@ -18,6 +18,6 @@ inline bool sendTeslaPayloadToGoogleSheets(TaskParams_t* params, TeslaSheetTarge
 // Returns true on success.
 bool sendTeslaTelemetryToGoogleSheets(TaskParams_t* params, float energyKwh, const char* comment = nullptr);
 
-// Starts a one-shot task for asynchronous telemetry upload.
-// Returns false if task creation failed.
+// Queues the telemetry upload as a job for the network worker (WorkerPool.h).
+// Returns false during OTA or when the worker's queue is full.
 bool passTeslaTelemetryToGoogleSheets(TaskParams_t* params, float energyKwh, const char* comment = nullptr);
\ No newline at end of file
@@ -0,0 +1,296 @@
+//#define DEBUG
+
+#include "WorkerPool.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <string.h>
+
+#include "config.h"
+#include "globals.h"
+#include "MqttClient.h"
+
+/* ###################################################################################################
+ *                  J O B   T Y P E S
+ * ###################################################################################################
+ *  One row per WorkerJobType, in the same order. A new job type is one enum value and one row; the
+ *  stacks of the lane workers follow from the budgets.
+ */
+namespace {
+
+struct WorkerJobSpec {
+  const char* name;
+  WorkerLane lane;
+  uint32_t stackBudgetWords;  // globals.h
+  const char* budgetName;     // In the stack advice
+  MqttTopicId stackTopic;     // Where the stack advice goes
+};
+
+#define WORKER_STACK_BUDGET(budget) budget, #budget
+
+constexpr WorkerJobSpec workerJobSpecs[] = {
+  // name                lane                 stack budget                                          advice topic
+  {"tesla_telemetry",    WORKER_LANE_NETWORK, WORKER_STACK_BUDGET(TESLA_TELEMETRY_JOB_STACK_BUDGET), MQTT_TOPIC_LOG_STACK_TESLA_TELEMETRY},
+  {"charging_tesla",     WORKER_LANE_NETWORK, WORKER_STACK_BUDGET(TESLA_TELEMETRY_JOB_STACK_BUDGET), MQTT_TOPIC_LOG_STACK_TESLA_TELEMETRY},
+  {"discovery_publish",  WORKER_LANE_MQTT,    WORKER_STACK_BUDGET(CONFIGURATION_JOB_STACK_BUDGET),   MQTT_TOPIC_LOG_STACK_CONFIGURATION},
+  {"button_publish",     WORKER_LANE_MQTT,    WORKER_STACK_BUDGET(BUTTON_PUBLISH_JOB_STACK_BUDGET),  MQTT_TOPIC_LOG_STACK_BUTTON_PUBLISH},
+};
+static_assert(sizeof(workerJobSpecs) / sizeof(workerJobSpecs[0]) == WORKER_JOB_TYPE_COUNT,
+              "workerJobSpecs needs one row per WorkerJobType");
+
+constexpr uint32_t laneStackWords(WorkerLane lane, size_t i = 0) {
+  return i == WORKER_JOB_TYPE_COUNT ? 0
+         : (workerJobSpecs[i].lane == lane && workerJobSpecs[i].stackBudgetWords > laneStackWords(lane, i + 1)
+                ? workerJobSpecs[i].stackBudgetWords
+                : laneStackWords(lane, i + 1));
+}
+
+constexpr uint32_t WORKER_LANE_STACK_WORDS[WORKER_LANE_COUNT] = {
+  laneStackWords(WORKER_LANE_NETWORK),
+  laneStackWords(WORKER_LANE_MQTT),
+};
+constexpr uint8_t WORKER_LANE_QUEUE_LENGTH[WORKER_LANE_COUNT] = {
+  WORKER_NETWORK_QUEUE_LENGTH,
+  WORKER_MQTT_QUEUE_LENGTH,
+};
+constexpr const char* WORKER_LANE_TASK_NAME[WORKER_LANE_COUNT] = {"workerNet", "workerMqtt"};
+constexpr const char* WORKER_LANE_NAME[WORKER_LANE_COUNT] = {"network", "mqtt"};
+static_assert(laneStackWords(WORKER_LANE_NETWORK) > 0 && laneStackWords(WORKER_LANE_MQTT) > 0,
+              "Every worker lane needs at least one job type");
+
+constexpr UBaseType_t WORKER_TASK_PRIORITY = 1;  // As the one-shot tasks it replaces
+constexpr uint8_t WORKER_STACK_FILL_BYTE = 0xa5; // FreeRTOS' unused stack pattern (tskSTACK_FILL_BYTE)
+constexpr size_t WORKER_STACK_REFILL_MARGIN = 256; // Bytes below the worker's own frame left alone when refilling
+
+struct WorkerJob {
+  WorkerJobType type;
+  WorkerJobHandler handler;
+  alignas(8) uint8_t payload[WORKER_JOB_PAYLOAD_BYTES];
+};
+
+struct WorkerLaneState {
+  QueueHandle_t queue;
+  TaskHandle_t task;
+  WorkerLaneStats stats;
+};
+
+WorkerLaneState workerLanes[WORKER_LANE_COUNT] = {};
+volatile uint32_t workerJobStackPeak[WORKER_JOB_TYPE_COUNT] = {};
+portMUX_TYPE workerStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+}  // namespace
+
+/* ###################################################################################################
+ *                  W O R K E R S
+ * ###################################################################################################
+ *  The high water mark of a task only ever goes down, so on its own it tells the deepest job since
+ *  boot, not the depth of this one. After every job the worker refills its unused stack with the
+ *  fill pattern; the high water mark after the next job is then that job's own peak.
+ */
+static void refillUnusedStack() {
+  uint8_t* stackStart = pxTaskGetStackStart(nullptr);
+  if (stackStart == nullptr) {
+    return;  // Not known (native build): no per-job accounting
+  }
+  volatile uint8_t frameMarker = 0;
+  uint8_t* limit = (uint8_t*)&frameMarker - WORKER_STACK_REFILL_MARGIN;
+  for (volatile uint8_t* p = stackStart; p < limit; ++p) {
+    *p = WORKER_STACK_FILL_BYTE;
+  }
+}
+
+static void WorkerTask(void* pvParameters) {
+  const WorkerLane lane = (WorkerLane)(uintptr_t)pvParameters;
+  WorkerLaneState& state = workerLanes[lane];
+  static WorkerJob jobs[WORKER_LANE_COUNT];  // One per worker, off its stack
+  WorkerJob& job = jobs[lane];
+
+  refillUnusedStack();
+  for (;;) {
+    xQueueReceive(state.queue, &job, portMAX_DELAY);
+    const uint32_t startMs = millis();
+    job.handler(job.payload);
+    const uint32_t elapsedMs = millis() - startMs;
+
+    const UBaseType_t highWater = uxTaskGetStackHighWaterMark(nullptr);
+    if (highWater > 0) {
+      const uint32_t usedWords = WORKER_LANE_STACK_WORDS[lane] - highWater;
+      if (usedWords > workerJobStackPeak[job.type]) {
+        workerJobStackPeak[job.type] = usedWords;
+      }
+      refillUnusedStack();
+    }
+
+    portENTER_CRITICAL(&workerStatsMux);
+    state.stats.completed++;
+    state.stats.busyMs += elapsedMs;
+    portEXIT_CRITICAL(&workerStatsMux);
+
+                                                            #ifdef DEBUG
+                                                            char debugMsg[96] = {0};
+                                                            snprintf(debugMsg, sizeof(debugMsg), "WorkerPool: %s done in %lu ms, stack peak %lu words",
+                                                                     workerJobSpecs[job.type].name,
+                                                                     (unsigned long)elapsedMs,
+                                                                     (unsigned long)workerJobStackPeak[job.type]);
+                                                            Serial.println(debugMsg);
+                                                            #endif
+  }
+}
+
+/* ###################################################################################################
+ *                  P U B L I C   A P I
+ * ###################################################################################################
+ */
+void startWorkerPool() {
+  for (uint8_t lane = 0; lane < WORKER_LANE_COUNT; lane++) {
+    WorkerLaneState& state = workerLanes[lane];
+    if (state.task != nullptr) {
+      continue;
+    }
+    if (state.queue == nullptr) {
+      state.queue = xQueueCreate(WORKER_LANE_QUEUE_LENGTH[lane], sizeof(WorkerJob));
+    }
+    if (state.queue != nullptr) {
+      xTaskCreate(WorkerTask, WORKER_LANE_TASK_NAME[lane], WORKER_LANE_STACK_WORDS[lane],
+                  (void*)(uintptr_t)lane, WORKER_TASK_PRIORITY, &state.task);
+    }
+  }
+}
+
+bool submitWorkerJob(WorkerJobType type, WorkerJobHandler handler, const void* payload, size_t payloadSize) {
+  if (type >= WORKER_JOB_TYPE_COUNT || handler == nullptr || payloadSize > WORKER_JOB_PAYLOAD_BYTES) {
+    return false;
+  }
+  WorkerLaneState& state = workerLanes[workerJobSpecs[type].lane];
+  if (state.task == nullptr) {
+    return false;
+  }
+
+  WorkerJob local;
+  local.type = type;
+  local.handler = handler;
+  memset(local.payload, 0, sizeof(local.payload));
+  if (payloadSize > 0) {
+    memcpy(local.payload, payload, payloadSize);
+  }
+
+  const bool queued = xQueueSend(state.queue, &local, 0) == pdTRUE;
+  const uint32_t waiting = uxQueueMessagesWaiting(state.queue);
+  portENTER_CRITICAL(&workerStatsMux);
+  if (queued) {
+    state.stats.submitted++;
+  } else {
+    state.stats.rejected++;
+  }
+  if (waiting > state.stats.peakQueued) {
+    state.stats.peakQueued = waiting;
+  }
+  portEXIT_CRITICAL(&workerStatsMux);
+
+                                                            #ifdef DEBUG
+                                                            if (!queued) {
+                                                              Serial.print("WorkerPool: job rejected, queue full: ");
+                                                              Serial.println(workerJobSpecs[type].name);
+                                                            }
+                                                            #endif
+
+  return queued;
+}
+
+const char* workerJobTypeName(WorkerJobType type) {
+  return type < WORKER_JOB_TYPE_COUNT ? workerJobSpecs[type].name : "";
+}
+
+WorkerLane workerJobLane(WorkerJobType type) {
+  return type < WORKER_JOB_TYPE_COUNT ? workerJobSpecs[type].lane : WORKER_LANE_COUNT;
+}
+
+uint32_t workerJobStackBudget(WorkerJobType type) {
+  return type < WORKER_JOB_TYPE_COUNT ? workerJobSpecs[type].stackBudgetWords : 0;
+}
+
+uint32_t workerLaneStackSize(WorkerLane lane) {
+  return lane < WORKER_LANE_COUNT ? WORKER_LANE_STACK_WORDS[lane] : 0;
+}
+
+uint32_t getWorkerJobStackPeak(WorkerJobType type) {
+  return type < WORKER_JOB_TYPE_COUNT ? workerJobStackPeak[type] : 0;
+}
+
+void getWorkerLaneStats(WorkerLane lane, WorkerLaneStats* stats) {
+  if (lane >= WORKER_LANE_COUNT || stats == nullptr) {
+    return;
+  }
+  portENTER_CRITICAL(&workerStatsMux);
+  *stats = workerLanes[lane].stats;
+  portEXIT_CRITICAL(&workerStatsMux);
+}
+
+bool publishWorkerPoolStats() {
+  static uint32_t lastSubmitted = 0;
+  static uint32_t lastRejected = 0;
+
+  WorkerLaneStats stats[WORKER_LANE_COUNT];
+  uint32_t submitted = 0;
+  uint32_t rejected = 0;
+  for (uint8_t lane = 0; lane < WORKER_LANE_COUNT; lane++) {
+    getWorkerLaneStats((WorkerLane)lane, &stats[lane]);
+    submitted += stats[lane].submitted;
+    rejected += stats[lane].rejected;
+  }
+  if (submitted == lastSubmitted && rejected == lastRejected) {
+    return false;  // No jobs since the last report
+  }
+
+  char logMsg[256] = {0};
+  size_t length = 0;
+  for (uint8_t lane = 0; lane < WORKER_LANE_COUNT && length < sizeof(logMsg); lane++) {
+    length += snprintf(logMsg + length,
+                       sizeof(logMsg) - length,
+                       "%s%s:%lu/%lu/%lu peak:%lu/%u busy_ms:%lu",
+                       lane > 0 ? " " : "",
+                       WORKER_LANE_NAME[lane],
+                       (unsigned long)stats[lane].submitted,
+                       (unsigned long)stats[lane].rejected,
+                       (unsigned long)stats[lane].completed,
+                       (unsigned long)stats[lane].peakQueued,
+                       (unsigned)WORKER_LANE_QUEUE_LENGTH[lane],
+                       (unsigned long)stats[lane].busyMs);
+  }
+  if (!publishMqttLog(MQTT_TOPIC_LOG_WORKER, logMsg, RETAINED)) {
+    return false;
+  }
+
+  lastSubmitted = submitted;
+  lastRejected = rejected;
+  return true;
+}
+
+bool publishWorkerJobStackAdvice() {
+  static uint32_t maxOptimalStackBudget[WORKER_JOB_TYPE_COUNT] = {0};
+  bool published = false;
+
+  for (uint8_t type = 0; type < WORKER_JOB_TYPE_COUNT; type++) {
+    const WorkerJobSpec& spec = workerJobSpecs[type];
+    const uint32_t usedStack = workerJobStackPeak[type];
+    if (usedStack == 0) {
+      continue;
+    }
+    uint32_t optimalStackBudget = (usedStack * 5 + 3) / 4; // Multiply by 1.25
+    bool significantDiff = abs((int)spec.stackBudgetWords - (int)optimalStackBudget) > 100;
+    if (significantDiff && optimalStackBudget > maxOptimalStackBudget[type]) {
+      maxOptimalStackBudget[type] = optimalStackBudget;
+      char logMsg[160] = {0};
+      snprintf(logMsg,
+               sizeof(logMsg),
+               "Change %s from: %u to: %u words (%s job)",
+               spec.budgetName,
+               (unsigned)spec.stackBudgetWords,
+               (unsigned)optimalStackBudget,
+               spec.name);
+      published = publishMqttLog(spec.stackTopic, logMsg, false) || published;
+    }
+  }
+  return published;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Persistent workers for the network side effects that used to get a one-shot task each
+ * (TeslaSheetsTask per upload, btnPublish per button press, mqtt_cfg_pub per discovery publish).
+ *
+ * A job is a type, a handler and a payload of at most WORKER_JOB_PAYLOAD_BYTES, copied into the
+ * queue of the lane its type belongs to. Each lane has one worker, created once at boot:
+ *
+ *  network  Tesla Owner API and Google Sheets HTTPS calls, one at a time, so a daily TeslaLog
+ *           upload and a charging session's telemetry never talk to the API together
+ *  mqtt     discovery and push-button publishes, which must not wait behind a 20 s HTTPS call
+ *
+ * A worker's stack is the largest stack budget of its lane's job types (WorkerPool.cpp, budgets in
+ * globals.h). After every job the worker's high water mark is attributed to that job type, so the
+ * peak stack of each type can be checked against its budget (getWorkerJobStackPeak()).
+ *
+ * Back-pressure: submitWorkerJob() never blocks. When the lane's queue is full the job is rejected
+ * and counted, and the caller keeps its work pending, as it does while WiFi is down.
+ *
+ *   struct Upload { float energyKwh; };
+ *   static void runUpload(const void* payload) { const Upload* upload = static_cast<const Upload*>(payload); ... }
+ *   Upload upload = {energyKwh};
+ *   if (!submitWorkerJob(WORKER_JOB_TESLA_TELEMETRY, runUpload, upload)) { ...keep it pending... }
+ */
+
+enum WorkerJobType : uint8_t {
+  WORKER_JOB_TESLA_TELEMETRY = 0,   // TeslaLog row: telemetry + upload (TeslaSheets.cpp)
+  WORKER_JOB_CHARGING_TESLA,        // Charging start/end telemetry and TeslaData upload (ChargingSession.cpp)
+  WORKER_JOB_DISCOVERY_PUBLISH,     // Queue the Home Assistant discovery configurations (MqttClient.cpp)
+  WORKER_JOB_BUTTON_PUBLISH,        // Set command for a push-button press (PushButtonTask.cpp)
+  WORKER_JOB_TYPE_COUNT
+};
+
+enum WorkerLane : uint8_t {
+  WORKER_LANE_NETWORK = 0,
+  WORKER_LANE_MQTT,
+  WORKER_LANE_COUNT
+};
+
+constexpr size_t WORKER_JOB_PAYLOAD_BYTES = 200; // Largest payload: a charging job with its TeslaData row
+
+typedef void (*WorkerJobHandler)(const void* payload);
+
+struct WorkerLaneStats {
+  uint32_t submitted;
+  uint32_t rejected;       // Queue full
+  uint32_t completed;
+  uint32_t peakQueued;     // Jobs waiting, at most the lane's queue length
+  uint32_t busyMs;         // Time spent in handlers
+};
+
+// Creates the lane queues and workers. Calling it again is a no-op.
+void startWorkerPool();
+
+// Copies the job into its lane's queue. false when the pool is not started or the queue is full.
+bool submitWorkerJob(WorkerJobType type, WorkerJobHandler handler, const void* payload, size_t payloadSize);
+
+template <typename Payload>
+inline bool submitWorkerJob(WorkerJobType type, WorkerJobHandler handler, const Payload& payload) {
+  static_assert(sizeof(Payload) <= WORKER_JOB_PAYLOAD_BYTES, "Worker job payload larger than WORKER_JOB_PAYLOAD_BYTES");
+  return submitWorkerJob(type, handler, &payload, sizeof(Payload));
+}
+
+const char* workerJobTypeName(WorkerJobType type);
+WorkerLane workerJobLane(WorkerJobType type);
+uint32_t workerJobStackBudget(WorkerJobType type);    // Words
+uint32_t workerLaneStackSize(WorkerLane lane);        // Words: the largest budget of the lane's job types
+uint32_t getWorkerJobStackPeak(WorkerJobType type);   // Words used by the deepest job of this type so far; 0 = not measured
+void getWorkerLaneStats(WorkerLane lane, WorkerLaneStats* stats);
+
+bool publishWorkerPoolStats(); // Publish retained to <device>/log/worker when jobs were submitted since the last report
+bool publishWorkerJobStackAdvice(); // Per job type: "Change <budget> from: .. to: .. words" to <device>/log/stack/<job> when the measured peak * 1.25 differs by over 100 words
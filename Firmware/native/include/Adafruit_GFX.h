@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Host (env:native) replacement for the Adafruit GFX base class.
+ * Text output is measured (6x8 px per character and text size) but not rasterised, so layout code
+ * such as getTextBounds() behaves like on the device while rendering itself costs nothing.
+ */
+class Adafruit_GFX : public Print {
+public:
+  Adafruit_GFX(int16_t width, int16_t height) : width_(width), height_(height) {}
+
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+  void setCursor(int16_t x, int16_t y) {
+    cursorX_ = x;
+    cursorY_ = y;
+  }
+  void setTextSize(uint8_t size) { textSize_ = size > 0 ? size : 1; }
+  void setTextColor(uint16_t color) { (void)color; }
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+  void getTextBounds(const String& text, int16_t x, int16_t y,
+                     int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h);
+  void getTextBounds(const char* text, int16_t x, int16_t y,
+                     int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h);
+
+  int16_t width() const { return width_; }
+  int16_t height() const { return height_; }
+
+protected:
+  int16_t width_;
+  int16_t height_;
+  int16_t cursorX_ = 0;
+  int16_t cursorY_ = 0;
+  uint8_t textSize_ = 1;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Adafruit_GFX.h>
+#include <Wire.h>
+
+// Host (env:native) replacement for the Adafruit SSD1306 driver. Frames are counted, not drawn.
+
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+#define SSD1306_SWITCHCAPVCC 0x02
+#define SSD1306_DISPLAYOFF 0xAE
+#define SSD1306_DISPLAYON 0xAF
+
+class Adafruit_SSD1306 : public Adafruit_GFX {
+public:
+  Adafruit_SSD1306(uint8_t width, uint8_t height, TwoWire* wire, int8_t resetPin = -1)
+      : Adafruit_GFX(width, height) {
+    (void)wire;
+    (void)resetPin;
+  }
+
+  bool begin(uint8_t switchVcc = SSD1306_SWITCHCAPVCC, uint8_t i2cAddress = 0, bool reset = true,
+             bool periphBegin = true);
+  void clearDisplay();
+  void display();
+  void ssd1306_command(uint8_t command);
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+/*
+ * Host (env:native) replacement for the ESP32 Arduino core.
+ *
+ * Timing is taken from the host monotonic clock and truncated to 32 bits exactly like the ESP32
+ * core, so millis()/micros() wrap at the same points. GPIO, interrupts and analog inputs are
+ * simulated; see HalSim.h for the functions a host harness uses to drive them.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "Print.h"
+#include "WString.h"
+
+#include <freertos/FreeRTOS.h>
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR __attribute__((section("rtc_noinit")))  // One block, see HalSim::rtcNoinitMemory()
+#define DRAM_ATTR
+
+constexpr uint8_t LOW = 0x0;
+constexpr uint8_t HIGH = 0x1;
+
+constexpr uint8_t INPUT = 0x01;
+constexpr uint8_t OUTPUT = 0x03;
+constexpr uint8_t PULLUP = 0x04;
+constexpr uint8_t INPUT_PULLUP = 0x05;
+constexpr uint8_t PULLDOWN = 0x08;
+constexpr uint8_t INPUT_PULLDOWN = 0x09;
+
+constexpr int RISING = 0x01;
+constexpr int FALLING = 0x02;
+constexpr int CHANGE = 0x03;
+constexpr int ONLOW = 0x04;
+constexpr int ONHIGH = 0x05;
+
+#ifndef LED_BUILTIN
+#define LED_BUILTIN 2
+#endif
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+void analogReadResolution(uint8_t bits);
+uint16_t touchRead(uint8_t pin);
+
+inline int digitalPinToInterrupt(int pin) { return pin; }
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void detachInterrupt(uint8_t pin);
+
+bool getLocalTime(struct tm* info, uint32_t ms = 5000);
+void configTzTime(const char* tz, const char* server1, const char* server2 = nullptr, const char* server3 = nullptr);
+
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
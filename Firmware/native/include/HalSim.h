@@ -0,0 +1,108 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_system.h>
+
+/*
+ * Host hardware simulation for env:native.
+ *
+ * The shim headers in native/include (Arduino.h, WiFi.h, Preferences.h, PubSubClient.h,
+ * freertos/ ...) let the firmware modules compile unchanged on Linux. This header is the other
+ * side of that boundary: the functions a host harness calls to drive the simulated hardware and to
+ * read back what the firmware did.
+ */
+namespace HalSim {
+
+// ---- Time --------------------------------------------------------------------------------------
+// Moves millis(), micros() and esp_timer_get_time() ahead, so a test reaches a save interval or
+// a window end without waiting for it. FreeRTOS ticks, delays and timeouts keep real time.
+void advanceClock(uint32_t ms);
+
+// ---- GPIO / interrupts -------------------------------------------------------------------------
+// Generates one edge on `gpio`: pulse counter (PCNT) units on the pin count it, then the attached
+// ISR runs on the calling thread. The edge follows the ISR's mode; without an ISR the pin toggles.
+// Returns false for an invalid pin.
+bool triggerInterrupt(int gpio);
+// Called by pcnt_get_counter_value() after it has read the count, outside the counter lock, so a
+// test can land an edge between the firmware's counter read and what it reads next.
+typedef void (*PcntReadHook)(int unit);
+void setPcntReadHook(PcntReadHook hook);
+void setDigitalInput(int gpio, int level);
+int getDigitalOutput(int gpio);
+
+// Analog inputs return source(gpio, micros()) on every analogRead(); default is mid-scale (2048).
+typedef uint16_t (*AnalogSource)(int gpio, uint32_t nowUs);
+void setAnalogSource(int gpio, AnalogSource source);
+void setTouchValue(int gpio, uint16_t value);
+
+// ---- Network -----------------------------------------------------------------------------------
+void setWiFiConnected(bool connected);
+void setMqttBrokerOnline(bool online);
+// A TCP connect to the broker completes `tcpMs` after connect() (refused while the broker is
+// offline), and a CONNECT is answered `connackMs` later. Both default to 0.
+void setMqttConnectLatency(uint32_t tcpMs, uint32_t connackMs);
+// Return code of the following CONNACKs: 0 = accepted (default), 5 = not authorized, ...;
+// -1 = the broker never answers CONNECT.
+void setMqttConnackCode(int code);
+bool injectMqttMessage(const char* topic, const char* payload);
+
+struct MqttBrokerStats {
+  uint32_t connectAttempts;   // TCP connects to the broker, successful or not
+  uint32_t connects;
+  uint32_t publishes;
+  uint64_t publishedBytes;
+  uint32_t delivered;
+};
+MqttBrokerStats mqttBrokerStats();
+
+// Copies the last retained/non-retained payload published to `topic`; returns false if none.
+bool lastPublished(const char* topic, char* payload, size_t payloadSize);
+
+typedef void (*PublishObserver)(const char* topic, const uint8_t* payload, unsigned int length, bool retained);
+void setPublishObserver(PublishObserver observer);
+
+// ---- Tesla Owner API / Google Sheets (HostStubs.cpp) -------------------------------------------
+// teslaGetTelemetry() takes `latencyMs` and then succeeds or fails with "simulated failure".
+// Defaults: 0 ms, succeeds. Uploads always succeed immediately.
+void setTeslaTelemetry(uint32_t latencyMs, bool succeeds);
+
+struct TeslaStats {
+  uint32_t telemetryRequests;
+  uint32_t teslaLogUploads;    // Rows sent to the TeslaLog sheet
+  uint32_t teslaDataUploads;   // Rows sent to the TeslaData sheet
+};
+TeslaStats teslaStats();
+
+// ---- Persistence / reset -----------------------------------------------------------------------
+void clearNvs();
+typedef void (*RestartHandler)();
+// Called by esp_restart() before the process exits; lets a harness report state on reset.
+void setRestartHandler(RestartHandler handler);
+// What esp_reset_reason() reports for this boot; ESP_RST_POWERON by default.
+void setResetReason(esp_reset_reason_t reason);
+// The bytes of every RTC_NOINIT_ATTR variable, which a test overwrites to model what a reset leaves
+// in RTC slow memory: an update torn halfway, a flipped bit, garbage after power-on.
+uint8_t* rtcNoinitMemory(size_t* size);
+
+// Raw flash partitions (esp_partition.h). After flashPowerFailAfter(n) the next n bytes are
+// programmed normally; the write that crosses the limit is torn and every later write or erase
+// fails until power is restored with a negative value (the default, no power cut).
+void flashPowerFailAfter(int64_t bytes);
+void eraseFlashPartition(const char* label);
+bool corruptFlash(const char* label, uint32_t offset, uint8_t xorMask);
+
+// ---- Heap accounting ---------------------------------------------------------------------------
+// Process-wide operator new/delete counters. Use deltas around the code under measurement.
+struct AllocationStats {
+  uint64_t allocations;
+  uint64_t frees;
+  uint64_t bytesAllocated;
+};
+AllocationStats allocationStats();
+
+// ---- Tasks -------------------------------------------------------------------------------------
+// xTaskCreate() / xTaskCreatePinnedToCore() calls since start. Use deltas around the code under
+// measurement.
+uint32_t tasksCreated();
+
+}  // namespace HalSim
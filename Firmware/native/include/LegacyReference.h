@@ -0,0 +1,117 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "MqttClient.h"
+#include "MqttDiscoveryJson.h"
+#include "MqttMessage.h"
+#include "MqttSetCommand.h"
+#include "config.h"
+
+/*
+ * The code the firmware replaced, kept on the host as the reference the pio test suites compare the
+ * replacements against and the harness benchmarks time them against: JsonDocument serialization of
+ * the energy state and discovery configurations, the JsonDocument + strcmp() /set decoder and the
+ * Welford RMS loop of readAcRms().
+ */
+namespace LegacyReference {
+
+// The energy state as publishMqttEnergy() serialized it with JsonDocument before MqttStateJson.h
+size_t stateJson(const double values[4], char* payload, size_t payloadSize);
+
+// The same rows as mqttDiscoveryEntities in MqttClient.cpp
+constexpr char kTotalCommandRange[] = "\"max\":99999.99,\"min\":0,\"step\":0.01";
+constexpr MqttDiscoveryEntity kDiscoveryEntities[] = {
+  {MQTT_SENSOR_COMPONENT, MQTT_ENERGY_DEVICECLASS, MQTT_SENSOR_ENERGY_ENTITYNAME, MQTT_ENERGY_DEVICECLASS, "kWh", MQTT_DISCOVERY_ROUND_2, nullptr},
+  {MQTT_SENSOR_COMPONENT, MQTT_POWER_DEVICECLASS, MQTT_SENSOR_POWER_ENTITYNAME, MQTT_POWER_DEVICECLASS, "kW", MQTT_DISCOVERY_RAW, nullptr},
+  {MQTT_SENSOR_COMPONENT, MQTT_INSTANT_POWER_OBJECT_ID, MQTT_SENSOR_INSTANT_POWER_ENTITYNAME, MQTT_POWER_DEVICECLASS, "kW", MQTT_DISCOVERY_RAW, nullptr},
+  {MQTT_NUMBER_COMPONENT, MQTT_ENERGY_DEVICECLASS, MQTT_NUMBER_ENERGY_ENTITYNAME, MQTT_ENERGY_DEVICECLASS, "kWh", MQTT_DISCOVERY_ROUND_2, kTotalCommandRange},
+};
+typedef MqttDiscoveryTable<MQTT_DISCOVERY_ENTITY_COUNT(kDiscoveryEntities), kDiscoveryEntities, MQTT_DISCOVERY_PREFIX,
+                           sizeof(MQTT_DEVICE_NAME) - 1 + 12> DiscoveryTable;
+
+// Topics of a device named like the firmware's (MQTT_DEVICE_NAME and a MAC)
+struct DiscoveryDeviceTopics {
+  char name[32];
+  char stateTopic[MQTT_TOPIC_LEN];
+  char availabilityTopic[MQTT_TOPIC_LEN];
+  char commandTopic[MQTT_TOPIC_LEN];
+};
+MqttDiscoveryDevice discoveryDevice(uint64_t mac, DiscoveryDeviceTopics* topics);
+
+// What publishMqttEnergyConfigJson() built with JsonDocument and String before MqttDiscoveryJson.h
+size_t discoveryConfig(const MqttDiscoveryEntity& entity, const MqttDiscoveryDevice& device, String* topic,
+                       char* payload, size_t payloadSize);
+
+// What a /set payload made the device do, recorded by both decoders
+struct SetOutcome {
+  bool rejected = false;
+  uint32_t handlerCalls = 0;
+  uint32_t totals = 0;
+  uint64_t totalMilliWh = 0;
+  uint32_t subtotalResets = 0;
+  int smartCharging = -1;        // -1 not set
+  uint32_t smartChargingInvalid = 0;
+  std::string chargingStartTime;
+  bool maxPriceSet = false;
+  float maxPrice = 0;
+  bool priceLimitSet = false;
+  float priceLimit = 0;
+  int reset = 0;                 // 1 soft, 2 hard
+
+  bool operator==(const SetOutcome& other) const;
+};
+
+std::string describeSetOutcome(const SetOutcome& outcome);
+
+// The JsonDocument + strcmp() chain mqttProcessRxQueue() used before MqttSetCommand.h
+SetOutcome legacySetDecode(const char* payload, size_t length);
+
+// The same commands through MqttSetTable, with handlers that record instead of act
+void recordSetTotal(const MqttSetValue& value);
+void recordSetSubtotal(const MqttSetValue& value);
+void recordSetSmartCharging(const MqttSetValue& value);
+void recordSetStartTime(const MqttSetValue& value);
+void recordSetMaxPrice(const MqttSetValue& value);
+void recordSetPriceLimit(const MqttSetValue& value);
+void recordSetReset(const MqttSetValue& value);
+
+constexpr MqttSetCommand kRecordingSetCommands[] = {
+  {MQTT_NUMBER_ENERGY_ENTITYNAME, recordSetTotal},
+  {MQTT_SENSOR_ENERGY_ENTITYNAME, recordSetSubtotal},
+  {MQTT_SMART_CHG,                recordSetSmartCharging},
+  {MQTT_CHG_START_TIME,           recordSetStartTime},
+  {MQTT_MAX_E_PRICE,              recordSetMaxPrice},
+  {MQTT_E_PRICE_LIMIT,            recordSetPriceLimit},
+  {MQTT_RESET_CMD,                recordSetReset},
+};
+typedef MqttSetTable<MQTT_SET_COMMAND_COUNT(kRecordingSetCommands), kRecordingSetCommands> RecordingSetTable;
+
+// Dispatches through RecordingSetTable and returns what its handlers recorded
+SetOutcome streamingSetDecode(const char* payload, size_t length, MqttSetError* error = nullptr);
+
+// What Home Assistant sends (automations_charging_monitor.yaml and the number/button entities)
+const std::vector<std::string>& homeAssistantSetPayloads();
+
+// The Welford loop of readAcRms() over consecutive CHARGING_AC_SAMPLE_COUNT-sample frames
+template <typename Visit>
+void welfordFrames(const std::vector<uint16_t>& samples, Visit visit) {
+  for (size_t start = 0; start + CHARGING_AC_SAMPLE_COUNT <= samples.size(); start += CHARGING_AC_SAMPLE_COUNT) {
+    double mean = 0.0;
+    double sumSquares = 0.0;
+    for (int i = 0; i < CHARGING_AC_SAMPLE_COUNT; ++i) {
+      const double sample = samples[start + i];
+      const double delta = sample - mean;
+      mean += delta / (i + 1);
+      sumSquares += delta * (sample - mean);
+    }
+    visit(sqrt(sumSquares / CHARGING_AC_SAMPLE_COUNT));
+  }
+}
+
+}  // namespace LegacyReference
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "globals.h"
+
+/*
+ * What the host harness (native/src/main.cpp) and the pio test suites in test/ share: the firmware
+ * tasks as setup() starts them on the device, the waits that drive them, and the synthetic CT
+ * signals. Every test suite and harness mode is its own process, so the tasks are started at most
+ * once per process and never stopped.
+ */
+namespace NativeHarness {
+
+constexpr uint32_t SETTLE_MS = 500;
+constexpr uint32_t MQTT_CONNECT_TIMEOUT_MS = 10000;  // First connect to the simulated broker
+constexpr uint32_t NETWORK_TICK_MS = 10;             // networkTask's delay between loops, as on the device
+
+// Task parameters of every firmware module the process starts
+extern TaskParams_t params;
+
+// networkTask() and loop() of the device; the charging session runs in its own task
+void networkTask(void* pvParameters);
+void loopTask(void* pvParameters);
+// Longest mqttLoop() call in networkTask() so far, in us
+uint32_t mqttLoopMaxUs();
+
+// Starts the worker pool and the network task; true once MQTT is connected
+bool startNetwork();
+
+// Polls `condition` every millisecond; false if it did not hold within `timeoutMs`
+template <typename Condition>
+bool waitUntil(Condition condition, uint32_t timeoutMs) {
+  const uint32_t startMs = millis();
+  while (!condition()) {
+    if (millis() - startMs > timeoutMs) {
+      return false;
+    }
+    delay(1);
+  }
+  return true;
+}
+
+// ---- Simulated broker --------------------------------------------------------------------------
+// The counters of the retained <device>/log/mqtt/connect published after every connect
+struct ConnectStats {
+  unsigned long attempts;
+  unsigned long connects;
+  unsigned long tcpFailures;
+  unsigned long connackFailures;
+  unsigned long timeouts;
+  unsigned long latencyMs;
+};
+
+bool readConnectStats(ConnectStats* stats);
+// Waits for connect number `connects` and leaves its counters in `stats`
+bool waitForConnect(unsigned long connects, uint32_t timeoutMs, ConnectStats* stats);
+// Drops the current session the way a broker restart does
+void dropMqttSession();
+// Injects the messages and waits until the network task has passed them all to mqttCallback()
+bool deliverInbound(const std::vector<std::pair<std::string, std::string>>& messages);
+
+uint64_t nextRandom(uint64_t& state);
+// Uniform in [0, 1)
+double uniformRandom(uint64_t& state);
+
+// The four values publishMqttEnergy() serializes (power and instant power in kW, total and subtotal
+// in kWh) for state number `index`: mostly realistic readings, plus zero, whole kWh and the top of
+// the counter range every few states
+void randomEnergyState(uint64_t& randomState, uint32_t index, double values[4]);
+
+// ---- CT input ----------------------------------------------------------------------------------
+constexpr double AC_PI = 3.14159265358979323846;
+constexpr double AC_MAINS_HZ = 50.0;
+constexpr double AC_AMPLITUDE_COUNTS = 400.0;
+
+// A 50 Hz sine of `amplitudeCounts` peak around mid-scale on CHARGING_ANALOG_GPIO; 0 is no current
+void setAcSine(double amplitudeCounts);
+
+// A recorded CT signal at the sampler's output rate: random mains frequency (49.5-50.5 or
+// 59.5-60.5 Hz), phase and bias, with Gaussian noise and 12-bit rounding
+struct CtRecording {
+  double mainsHz;
+  double amplitude;  // Counts, peak
+  double noise;      // Counts, standard deviation
+  std::vector<uint16_t> samples;
+};
+
+constexpr uint32_t CT_RECORDING_SAMPLES = 3000;  // 3 s
+constexpr uint32_t CT_RECORDING_SETTLE = 1000;   // Samples before AcRmsKernel's windows count (running DC)
+
+CtRecording makeCtRecording(uint64_t& randomState, double amplitude, double noise);
+
+// Relative error of RMS windows against the true RMS, in percent
+struct RmsErrors {
+  uint64_t windows = 0;
+  double sumAbs = 0.0;
+  double maxAbs = 0.0;
+
+  void add(double rms, double expected) {
+    const double error = fabs(rms - expected) / expected * 100.0;
+    windows++;
+    sumAbs += error;
+    maxAbs = error > maxAbs ? error : maxAbs;
+  }
+  double mean() const {
+    return windows > 0 ? sumAbs / windows : 0.0;
+  }
+};
+
+}  // namespace NativeHarness
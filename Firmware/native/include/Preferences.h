@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Host (env:native) replacement for the ESP32 Preferences (NVS) library.
+ * All namespaces live in one process-wide in-memory store, so values survive Preferences
+ * instances being destroyed but not the process; HalSim::clearNvs() resets the store.
+ */
+class Preferences {
+public:
+  bool begin(const char* name, bool readOnly = false, const char* partitionLabel = nullptr);
+  void end();
+
+  bool clear();
+  bool remove(const char* key);
+  bool isKey(const char* key);
+
+  size_t putBool(const char* key, bool value);
+  size_t putUChar(const char* key, uint8_t value);
+  size_t putUShort(const char* key, uint16_t value);
+  size_t putInt(const char* key, int32_t value);
+  size_t putUInt(const char* key, uint32_t value);
+  size_t putLong(const char* key, int32_t value);
+  size_t putULong(const char* key, uint32_t value);
+  size_t putLong64(const char* key, int64_t value);
+  size_t putULong64(const char* key, uint64_t value);
+  size_t putFloat(const char* key, float value);
+  size_t putString(const char* key, const char* value);
+  size_t putString(const char* key, const String& value);
+  size_t putBytes(const char* key, const void* value, size_t length);
+
+  bool getBool(const char* key, bool defaultValue = false);
+  uint8_t getUChar(const char* key, uint8_t defaultValue = 0);
+  uint16_t getUShort(const char* key, uint16_t defaultValue = 0);
+  int32_t getInt(const char* key, int32_t defaultValue = 0);
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+  int32_t getLong(const char* key, int32_t defaultValue = 0);
+  uint32_t getULong(const char* key, uint32_t defaultValue = 0);
+  int64_t getLong64(const char* key, int64_t defaultValue = 0);
+  uint64_t getULong64(const char* key, uint64_t defaultValue = 0);
+  float getFloat(const char* key, float defaultValue = 0.0f);
+  String getString(const char* key, const String& defaultValue = String());
+  size_t getBytesLength(const char* key);
+  size_t getBytes(const char* key, void* buffer, size_t maxLength);
+
+private:
+  size_t putRaw(const char* key, const void* value, size_t length);
+  bool getRaw(const char* key, void* buffer, size_t length);
+
+  char namespace_[16] = {0};
+  bool started_ = false;
+  bool readOnly_ = true;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "WString.h"
+
+/*
+ * Host (env:native) replacement for the Arduino Print base class.
+ * Derived classes implement write(uint8_t); the formatting overloads mirror Arduino's output.
+ */
+class Print {
+public:
+  virtual ~Print() = default;
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t written = 0;
+    while (size-- > 0) {
+      written += write(*buffer++);
+    }
+    return written;
+  }
+  size_t write(const char* text) {
+    return text != nullptr ? write(reinterpret_cast<const uint8_t*>(text), strlen(text)) : 0;
+  }
+
+  size_t print(const char* text) { return write(text); }
+  size_t print(const String& text) { return write(text.c_str()); }
+  size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+  size_t print(int value, int base = 10) { return print(String(value, static_cast<unsigned char>(base))); }
+  size_t print(unsigned int value, int base = 10) { return print(String(value, static_cast<unsigned char>(base))); }
+  size_t print(long value, int base = 10) { return print(String(value, static_cast<unsigned char>(base))); }
+  size_t print(unsigned long value, int base = 10) { return print(String(value, static_cast<unsigned char>(base))); }
+  size_t print(long long value, int base = 10) { return print(String(value, static_cast<unsigned char>(base))); }
+  size_t print(unsigned long long value, int base = 10) { return print(String(value, static_cast<unsigned char>(base))); }
+  size_t print(double value, int digits = 2) { return print(String(value, static_cast<unsigned char>(digits))); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(const T& value) {
+    return print(value) + println();
+  }
+  template <typename T>
+  size_t println(const T& value, int format) {
+    return print(value, format) + println();
+  }
+  size_t println(const char* text) { return print(text) + println(); }
+
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
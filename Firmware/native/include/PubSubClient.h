@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include <functional>
+#include <string>
+
+/*
+ * Host (env:native) replacement for knolleary/PubSubClient.
+ *
+ * connect() behaves like the library on the Client it was given: it opens the connection unless
+ * the client is already connected, writes a CONNECT packet and busy-waits up to the socket timeout
+ * for the CONNACK. Everything after that skips the wire and talks to the in-process broker simulated
+ * by HalSim: publish() is recorded in the broker statistics, and loop() delivers messages injected
+ * with HalSim::injectMqttMessage() to the registered callback for subscribed topics.
+ */
+
+#ifndef MQTT_MAX_PACKET_SIZE
+#define MQTT_MAX_PACKET_SIZE 256
+#endif
+
+#define MQTT_CONNECTION_TIMEOUT     -4
+#define MQTT_CONNECTION_LOST        -3
+#define MQTT_CONNECT_FAILED         -2
+#define MQTT_DISCONNECTED           -1
+#define MQTT_CONNECTED               0
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+class PubSubClient {
+public:
+  explicit PubSubClient(Client& client) : client_(&client) {}
+
+  PubSubClient& setServer(const char* domain, uint16_t port);
+  PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
+  PubSubClient& setSocketTimeout(uint16_t timeoutSeconds);
+  PubSubClient& setKeepAlive(uint16_t keepAliveSeconds);
+  bool setBufferSize(uint16_t size);
+  uint16_t getBufferSize() const { return bufferSize_; }
+
+  bool connect(const char* id);
+  bool connect(const char* id, const char* user, const char* pass);
+  bool connect(const char* id, const char* user, const char* pass,
+               const char* willTopic, uint8_t willQos, bool willRetain, const char* willMessage);
+  void disconnect();
+  bool connected();
+  int state() const { return state_; }
+
+  bool publish(const char* topic, const char* payload);
+  bool publish(const char* topic, const char* payload, bool retained);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained);
+  bool subscribe(const char* topic, uint8_t qos = 0);
+  bool unsubscribe(const char* topic);
+  bool loop();
+
+private:
+  Client* client_;
+  std::string domain_;
+  uint16_t port_ = 0;
+  uint16_t socketTimeoutSeconds_ = 15;
+  std::function<void(char*, uint8_t*, unsigned int)> callback_;
+  uint16_t bufferSize_ = MQTT_MAX_PACKET_SIZE;
+  int state_ = MQTT_DISCONNECTED;
+  uint32_t sessionId_ = 0;
+};
@@ -0,0 +1,154 @@
+#pragma once
+
+/*
+ * Host (env:native) replacement for the Arduino String class.
+ *
+ * Only the subset of the Arduino API used by the firmware sources is provided. The storage is a
+ * std::string, so every construction and concatenation performs a heap allocation exactly like the
+ * Arduino implementation does - which is what makes the allocation counters in HalSim meaningful.
+ */
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+
+class StringSumHelper;
+
+class String {
+public:
+  String() = default;
+  String(const char* text) : value_(text != nullptr ? text : "") {}
+  String(const String& other) = default;
+  String(String&& other) noexcept = default;
+  explicit String(char c) : value_(1, c) {}
+
+  template <typename T,
+            typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, char>::value, int>::type = 0>
+  explicit String(T value, unsigned char base = 10) : value_(formatInteger(value, base)) {}
+
+  explicit String(float value, unsigned char decimalPlaces = 2) : value_(formatFloat(value, decimalPlaces)) {}
+  explicit String(double value, unsigned char decimalPlaces = 2) : value_(formatFloat(value, decimalPlaces)) {}
+
+  String& operator=(const String& other) = default;
+  String& operator=(String&& other) noexcept = default;
+  String& operator=(const char* text) {
+    value_ = text != nullptr ? text : "";
+    return *this;
+  }
+
+  const char* c_str() const { return value_.c_str(); }
+  unsigned int length() const { return static_cast<unsigned int>(value_.size()); }
+  bool isEmpty() const { return value_.empty(); }
+  bool reserve(unsigned int size) {
+    value_.reserve(size);
+    return true;
+  }
+
+  bool concat(const String& other) {
+    value_ += other.value_;
+    return true;
+  }
+  bool concat(const char* text) {
+    if (text != nullptr) {
+      value_ += text;
+    }
+    return true;
+  }
+  bool concat(char c) {
+    value_ += c;
+    return true;
+  }
+  bool concat(const char* text, unsigned int length) {
+    if (text != nullptr) {
+      value_.append(text, length);
+    }
+    return true;
+  }
+
+  String& operator+=(const String& other) { concat(other); return *this; }
+  String& operator+=(const char* text) { concat(text); return *this; }
+  String& operator+=(char c) { concat(c); return *this; }
+
+  char charAt(unsigned int index) const { return index < value_.size() ? value_[index] : '\0'; }
+  char operator[](unsigned int index) const { return charAt(index); }
+
+  bool equals(const String& other) const { return value_ == other.value_; }
+  bool equals(const char* text) const { return value_ == (text != nullptr ? text : ""); }
+  bool equalsIgnoreCase(const String& other) const;
+  bool operator==(const String& other) const { return equals(other); }
+  bool operator==(const char* text) const { return equals(text); }
+  bool operator!=(const String& other) const { return !equals(other); }
+  bool operator!=(const char* text) const { return !equals(text); }
+
+  bool startsWith(const String& prefix) const;
+  bool endsWith(const String& suffix) const;
+  int indexOf(char c, unsigned int fromIndex = 0) const;
+  int indexOf(const String& text, unsigned int fromIndex = 0) const;
+  String substring(unsigned int beginIndex) const;
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+  void trim();
+
+  long toInt() const;
+  float toFloat() const;
+
+  // Needed by ArduinoJson when serializing into a String.
+  size_t write(unsigned char c) {
+    value_ += static_cast<char>(c);
+    return 1;
+  }
+
+private:
+  static std::string formatInteger(long long value, unsigned char base);
+  static std::string formatInteger(unsigned long long value, unsigned char base);
+  template <typename T>
+  static std::string formatInteger(T value, unsigned char base) {
+    if (std::is_signed<T>::value) {
+      return formatInteger(static_cast<long long>(value), base);
+    }
+    return formatInteger(static_cast<unsigned long long>(value), base);
+  }
+  static std::string formatFloat(double value, unsigned char decimalPlaces);
+
+  std::string value_;
+};
+
+// Arduino returns a StringSumHelper from operator+; ArduinoJson checks for the type by name.
+class StringSumHelper : public String {
+public:
+  StringSumHelper(const String& s) : String(s) {}
+  StringSumHelper(const char* p) : String(p) {}
+};
+
+inline StringSumHelper operator+(const String& lhs, const String& rhs) {
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+inline StringSumHelper operator+(const String& lhs, const char* rhs) {
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+inline StringSumHelper operator+(const char* lhs, const String& rhs) {
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+inline StringSumHelper operator+(const String& lhs, char rhs) {
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+template <typename T,
+          typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, char>::value, int>::type = 0>
+inline StringSumHelper operator+(const String& lhs, T rhs) {
+  StringSumHelper result(lhs);
+  result.concat(String(rhs));
+  return result;
+}
+
+inline bool operator==(const char* lhs, const String& rhs) { return rhs.equals(lhs); }
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+
+#include <memory>
+
+/*
+ * Host (env:native) replacement for the ESP32 WiFi library.
+ * The station state is driven by HalSim::setWiFiConnected(). WiFiClient runs on the simulated lwIP
+ * sockets (lwip/sockets.h), so no real sockets are opened.
+ */
+
+typedef enum {
+  WL_NO_SHIELD = 255,
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+  WIFI_AP = 2,
+  WIFI_AP_STA = 3
+} wifi_mode_t;
+
+class IPAddress {
+public:
+  IPAddress() = default;
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets_{a, b, c, d} {}
+
+  uint8_t operator[](int index) const { return octets_[index & 3]; }
+  uint8_t& operator[](int index) { return octets_[index & 3]; }
+  bool operator==(const IPAddress& other) const { return memcmp(octets_, other.octets_, sizeof(octets_)) == 0; }
+  bool operator!=(const IPAddress& other) const { return !(*this == other); }
+  operator uint32_t() const { uint32_t address; memcpy(&address, octets_, sizeof(address)); return address; } // Network byte order
+  bool fromString(const char* address);
+  String toString() const;
+
+private:
+  uint8_t octets_[4] = {0, 0, 0, 0};
+};
+
+// Like the ESP32 core, copies share the socket and it is closed when the last copy lets go of it.
+class WiFiClient : public Client {
+public:
+  WiFiClient() = default;
+  explicit WiFiClient(int fd);
+
+  int connect(IPAddress ip, uint16_t port);     // Blocks for the simulated TCP handshake
+  int connect(const char* host, uint16_t port);
+  int connect(IPAddress ip, uint16_t port, int32_t timeout) { (void)timeout; return connect(ip, port); }
+  int connect(const char* host, uint16_t port, int32_t timeout) { (void)timeout; return connect(host, port); }
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t* buffer, size_t size);
+  int available();
+  int read();
+  int read(uint8_t* buffer, size_t size);
+  int peek();
+  void flush() {}
+  void stop();
+  uint8_t connected();
+  operator bool() { return connected() != 0; }
+  int fd() const { return socket_ ? *socket_ : -1; }
+  void setTimeout(uint32_t seconds) { (void)seconds; }
+
+private:
+  std::shared_ptr<int> socket_;
+};
+
+class WiFiClass {
+public:
+  wl_status_t status();
+  bool mode(wifi_mode_t mode);
+  wl_status_t begin(const char* ssid, const char* passphrase = nullptr);
+  bool disconnect(bool wifiOff = false);
+  bool setSleep(bool enabled);
+  bool setAutoReconnect(bool autoReconnect);
+  uint8_t waitForConnectResult(unsigned long timeoutLength = 60000);
+  IPAddress localIP();
+  int hostByName(const char* host, IPAddress& result); // Every name resolves to the simulated broker
+  uint8_t* macAddress(uint8_t* mac);
+  String macAddress();
+  int8_t RSSI();
+};
+
+extern WiFiClass WiFi;
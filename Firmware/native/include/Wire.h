@@ -0,0 +1,16 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Host (env:native) replacement for the Arduino Wire (I2C) library. No bus is simulated.
+class TwoWire {
+public:
+  bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) {
+    (void)sda;
+    (void)scl;
+    (void)frequency;
+    return true;
+  }
+};
+
+extern TwoWire Wire;
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/*
+ * Host model of the ESP32 ADC continuous (DMA) mode of the IDF 4.4 legacy driver (driver/adc.h,
+ * adc_digi_*), ADC1 only.
+ *
+ * After adc_digi_start() conversions are due at sample_freq_hz on the simulated clock; each one
+ * is the HalSim analog source of the pattern's GPIO at its exact due time, in the TYPE1 output
+ * format (2 bytes each). adc_digi_read_bytes() waits (up to its timeout) until conv_num_each_intr
+ * bytes of them are due, like the driver waits for a DMA interrupt, and returns whole interrupts'
+ * worth. Conversions not read within max_store_buf_size bytes are lost and that read returns
+ * ESP_ERR_INVALID_STATE with the newest data, as when the driver's ring buffer overflows.
+ */
+typedef enum {
+  ADC_UNIT_1 = 1,
+  ADC_UNIT_2 = 2,
+  ADC_UNIT_BOTH = 3,
+  ADC_UNIT_ALTER = 7,
+} adc_unit_t;
+
+typedef enum {
+  ADC1_CHANNEL_0 = 0, // GPIO36
+  ADC1_CHANNEL_1,     // GPIO37
+  ADC1_CHANNEL_2,     // GPIO38
+  ADC1_CHANNEL_3,     // GPIO39
+  ADC1_CHANNEL_4,     // GPIO32
+  ADC1_CHANNEL_5,     // GPIO33
+  ADC1_CHANNEL_6,     // GPIO34
+  ADC1_CHANNEL_7,     // GPIO35
+  ADC1_CHANNEL_MAX,
+} adc1_channel_t;
+
+typedef enum {
+  ADC_ATTEN_DB_0 = 0,
+  ADC_ATTEN_DB_2_5 = 1,
+  ADC_ATTEN_DB_6 = 2,
+  ADC_ATTEN_DB_11 = 3,
+} adc_atten_t;
+
+typedef enum {
+  ADC_CONV_SINGLE_UNIT_1 = 1,
+  ADC_CONV_SINGLE_UNIT_2 = 2,
+  ADC_CONV_BOTH_UNIT = 3,
+  ADC_CONV_ALTER_UNIT = 7,
+} adc_digi_convert_mode_t;
+
+typedef enum {
+  ADC_DIGI_OUTPUT_FORMAT_TYPE1,
+  ADC_DIGI_OUTPUT_FORMAT_TYPE2,
+} adc_digi_output_format_t;
+
+#define SOC_ADC_DIGI_MAX_BITWIDTH 12
+#define SOC_ADC_SAMPLE_FREQ_THRES_HIGH (2 * 1000 * 1000)
+#define SOC_ADC_SAMPLE_FREQ_THRES_LOW (20 * 1000)
+
+typedef struct {
+  uint8_t atten;
+  uint8_t channel;
+  uint8_t unit;
+  uint8_t bit_width;
+} adc_digi_pattern_config_t;
+
+typedef struct {
+  uint32_t max_store_buf_size;
+  uint32_t conv_num_each_intr; // Bytes per DMA interrupt
+  uint32_t adc1_chan_mask;
+  uint32_t adc2_chan_mask;
+} adc_digi_init_config_t;
+
+typedef struct {
+  bool conv_limit_en;
+  uint32_t conv_limit_num;
+  uint32_t pattern_num;
+  adc_digi_pattern_config_t* adc_pattern;
+  uint32_t sample_freq_hz;
+  adc_digi_convert_mode_t conv_mode;
+  adc_digi_output_format_t format;
+} adc_digi_configuration_t;
+
+typedef struct {
+  union {
+    struct {
+      uint16_t data : 12;
+      uint16_t channel : 4;
+    } type1;
+    uint16_t val;
+  };
+} adc_digi_output_data_t;
+
+esp_err_t adc_digi_initialize(const adc_digi_init_config_t* init_config);
+esp_err_t adc_digi_deinitialize(void);
+esp_err_t adc_digi_controller_configure(const adc_digi_configuration_t* config);
+esp_err_t adc_digi_start(void);
+esp_err_t adc_digi_stop(void);
+esp_err_t adc_digi_read_bytes(uint8_t* buf, uint32_t length_max, uint32_t* out_length, uint32_t timeout_ms);
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstdint>
+
+// Microseconds since process start (64-bit, never wraps), as on ESP32.
+int64_t esp_timer_get_time();
@@ -0,0 +1,56 @@
+#pragma once
+
+/*
+ * Host (env:native) replacement for the ESP-IDF FreeRTOS API.
+ *
+ * Tasks are std::threads, queues and semaphores are mutex/condition-variable backed ring buffers,
+ * and one tick is one millisecond (configTICK_RATE_HZ = 1000). Critical sections map onto a
+ * recursive mutex per portMUX_TYPE, which gives the same mutual exclusion between a task and the
+ * simulated ISR context (HalSim::triggerInterrupt runs the ISR on the calling host thread).
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void (*TaskFunction_t)(void*);
+
+struct HalTask;
+struct HalQueue;
+typedef HalTask* TaskHandle_t;
+typedef HalQueue* QueueHandle_t;
+
+constexpr BaseType_t pdFALSE = 0;
+constexpr BaseType_t pdTRUE = 1;
+constexpr BaseType_t pdPASS = pdTRUE;
+constexpr BaseType_t pdFAIL = pdFALSE;
+constexpr BaseType_t errQUEUE_FULL = 0;
+
+constexpr TickType_t portMAX_DELAY = 0xFFFFFFFFUL;
+constexpr TickType_t configTICK_RATE_HZ = 1000;
+constexpr TickType_t portTICK_PERIOD_MS = 1000 / configTICK_RATE_HZ;
+constexpr UBaseType_t configMAX_PRIORITIES = 25;
+constexpr BaseType_t tskNO_AFFINITY = 0x7FFFFFFF;
+
+#define pdMS_TO_TICKS(xTimeInMs) ((TickType_t)(((TickType_t)(xTimeInMs) * configTICK_RATE_HZ) / 1000U))
+
+struct portMUX_TYPE {
+  std::recursive_mutex mutex;
+};
+
+#define portMUX_INITIALIZER_UNLOCKED {}
+
+#define portENTER_CRITICAL(mux) (mux)->mutex.lock()
+#define portEXIT_CRITICAL(mux) (mux)->mutex.unlock()
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
+#define portYIELD_FROM_ISR(...) ((void)0)
+
+size_t xPortGetFreeHeapSize();
+
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef enum {
+  eRunning = 0,
+  eReady,
+  eBlocked,
+  eSuspended,
+  eDeleted,
+  eInvalid
+} eTaskState;
+
+BaseType_t xTaskCreate(TaskFunction_t taskCode,
+                       const char* name,
+                       uint32_t stackDepth,
+                       void* parameters,
+                       UBaseType_t priority,
+                       TaskHandle_t* createdTask);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t taskCode,
+                                   const char* name,
+                                   uint32_t stackDepth,
+                                   void* parameters,
+                                   UBaseType_t priority,
+                                   TaskHandle_t* createdTask,
+                                   BaseType_t coreId);
+
+// Deleting the calling task ends its thread. Deleting another task only marks it eDeleted; host
+// threads cannot be killed, so harnesses should not rely on a deleted task stopping.
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+eTaskState eTaskGetState(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+TickType_t xTaskGetTickCount();
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+uint8_t* pxTaskGetStackStart(TaskHandle_t task);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken);
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+/*
+ * Host (env:native) replacement for the lwIP socket API (the lwip_* functions).
+ *
+ * The sockets are simulated by HalNetwork.cpp and reach only the simulated MQTT broker, whatever
+ * address they connect to: the TCP handshake completes HalSim::setMqttConnectLatency() after
+ * connect(), and a CONNECT packet is answered with a CONNACK. Types, constants and errno values
+ * are the host's. recv() never blocks; it fails with EAGAIN when nothing has arrived.
+ */
+int lwip_socket(int domain, int type, int protocol);
+int lwip_connect(int s, const struct sockaddr* name, socklen_t namelen);
+int lwip_select(int maxfdp1, fd_set* readset, fd_set* writeset, fd_set* exceptset, struct timeval* timeout);
+int lwip_getsockopt(int s, int level, int optname, void* optval, socklen_t* optlen);
+int lwip_setsockopt(int s, int level, int optname, const void* optval, socklen_t optlen);
+int lwip_fcntl(int s, int cmd, int val);
+int lwip_ioctl(int s, long cmd, void* argp);
+ssize_t lwip_recv(int s, void* mem, size_t len, int flags);
+ssize_t lwip_send(int s, const void* dataptr, size_t size, int flags);
+int lwip_close(int s);
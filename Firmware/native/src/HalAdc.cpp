@@ -0,0 +1,171 @@
+#include <driver/adc.h>
+#include <esp_timer.h>
+
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include "HalInternal.h"
+
+namespace {
+constexpr int ADC1_CHANNEL_GPIO[ADC1_CHANNEL_MAX] = {36, 37, 38, 39, 32, 33, 34, 35};
+constexpr uint32_t BYTES_PER_CONVERSION = sizeof(adc_digi_output_data_t);
+constexpr uint32_t MAX_PATTERNS = 16;
+
+struct AdcDigi {
+  bool initialized = false;
+  bool configured = false;
+  bool running = false;
+  adc_digi_init_config_t init{};
+  adc_digi_pattern_config_t pattern[MAX_PATTERNS]{};
+  uint32_t patternCount = 0;
+  uint32_t sampleFreqHz = 0;
+  int64_t startUs = 0;
+  uint64_t nextConversion = 0;  // Index of the oldest conversion not yet read or dropped
+};
+
+std::mutex sAdcMutex;
+AdcDigi sAdc;
+
+int64_t conversionDueUs(const AdcDigi& adc, uint64_t index) {
+  return adc.startUs + (int64_t)(index * 1000000ULL / adc.sampleFreqHz);
+}
+
+// Conversions due by nowUs and not yet read
+uint64_t conversionsDue(const AdcDigi& adc, int64_t nowUs) {
+  if (nowUs < adc.startUs) {
+    return 0;
+  }
+  uint64_t due = (uint64_t)(nowUs - adc.startUs) * adc.sampleFreqHz / 1000000ULL + 1;
+  return due > adc.nextConversion ? due - adc.nextConversion : 0;
+}
+}  // namespace
+
+esp_err_t adc_digi_initialize(const adc_digi_init_config_t* init_config) {
+  if (init_config == nullptr || init_config->conv_num_each_intr < BYTES_PER_CONVERSION ||
+      init_config->max_store_buf_size < init_config->conv_num_each_intr || init_config->adc2_chan_mask != 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(sAdcMutex);
+  if (sAdc.initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  sAdc = AdcDigi();
+  sAdc.init = *init_config;
+  sAdc.initialized = true;
+  return ESP_OK;
+}
+
+esp_err_t adc_digi_deinitialize(void) {
+  std::lock_guard<std::mutex> lock(sAdcMutex);
+  if (!sAdc.initialized || sAdc.running) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  sAdc = AdcDigi();
+  return ESP_OK;
+}
+
+esp_err_t adc_digi_controller_configure(const adc_digi_configuration_t* config) {
+  if (config == nullptr || config->adc_pattern == nullptr || config->pattern_num == 0 ||
+      config->pattern_num > MAX_PATTERNS || config->conv_mode != ADC_CONV_SINGLE_UNIT_1 ||
+      config->format != ADC_DIGI_OUTPUT_FORMAT_TYPE1 || config->sample_freq_hz < SOC_ADC_SAMPLE_FREQ_THRES_LOW ||
+      config->sample_freq_hz > SOC_ADC_SAMPLE_FREQ_THRES_HIGH) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (uint32_t i = 0; i < config->pattern_num; i++) {
+    if (config->adc_pattern[i].unit != 0 || config->adc_pattern[i].channel >= ADC1_CHANNEL_MAX) {
+      return ESP_ERR_INVALID_ARG;  // Pattern unit 0 is ADC1
+    }
+  }
+  std::lock_guard<std::mutex> lock(sAdcMutex);
+  if (!sAdc.initialized || sAdc.running) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  for (uint32_t i = 0; i < config->pattern_num; i++) {
+    sAdc.pattern[i] = config->adc_pattern[i];
+  }
+  sAdc.patternCount = config->pattern_num;
+  sAdc.sampleFreqHz = config->sample_freq_hz;
+  sAdc.configured = true;
+  return ESP_OK;
+}
+
+esp_err_t adc_digi_start(void) {
+  std::lock_guard<std::mutex> lock(sAdcMutex);
+  if (!sAdc.configured) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  sAdc.running = true;
+  sAdc.startUs = esp_timer_get_time();
+  sAdc.nextConversion = 0;
+  return ESP_OK;
+}
+
+esp_err_t adc_digi_stop(void) {
+  std::lock_guard<std::mutex> lock(sAdcMutex);
+  if (!sAdc.initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  sAdc.running = false;
+  return ESP_OK;
+}
+
+esp_err_t adc_digi_read_bytes(uint8_t* buf, uint32_t length_max, uint32_t* out_length, uint32_t timeout_ms) {
+  if (buf == nullptr || out_length == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *out_length = 0;
+  const int64_t deadlineUs = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+  std::unique_lock<std::mutex> lock(sAdcMutex);
+  if (!sAdc.running) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  const uint64_t perInterrupt = sAdc.init.conv_num_each_intr / BYTES_PER_CONVERSION;
+  const uint64_t maxStored = sAdc.init.max_store_buf_size / BYTES_PER_CONVERSION;
+
+  // Wait for the interrupt that completes the next conversion block
+  int64_t readyUs = conversionDueUs(sAdc, sAdc.nextConversion + perInterrupt - 1);
+  while (esp_timer_get_time() < readyUs) {
+    int64_t nowUs = esp_timer_get_time();
+    if (nowUs >= deadlineUs) {
+      return ESP_ERR_TIMEOUT;
+    }
+    int64_t waitUs = (readyUs < deadlineUs ? readyUs : deadlineUs) - nowUs;
+    lock.unlock();
+    std::this_thread::sleep_for(std::chrono::microseconds(waitUs));
+    lock.lock();
+    if (!sAdc.running) {
+      return ESP_ERR_INVALID_STATE;
+    }
+    readyUs = conversionDueUs(sAdc, sAdc.nextConversion + perInterrupt - 1);
+  }
+
+  uint64_t available = conversionsDue(sAdc, esp_timer_get_time());
+  available -= available % perInterrupt;
+  esp_err_t result = ESP_OK;
+  if (available > maxStored) {
+    // Ring buffer full: the DMA dropped everything older than what still fits
+    uint64_t dropped = available - maxStored;
+    dropped += (perInterrupt - dropped % perInterrupt) % perInterrupt;
+    sAdc.nextConversion += dropped;
+    available -= dropped;
+    result = ESP_ERR_INVALID_STATE;
+  }
+  uint64_t count = length_max / BYTES_PER_CONVERSION;
+  if (count > available) {
+    count = available;
+  }
+  for (uint64_t i = 0; i < count; i++) {
+    uint64_t index = sAdc.nextConversion + i;
+    const adc_digi_pattern_config_t& pattern = sAdc.pattern[index % sAdc.patternCount];
+    uint16_t value = halAnalogSample(ADC1_CHANNEL_GPIO[pattern.channel], (uint32_t)conversionDueUs(sAdc, index));
+    adc_digi_output_data_t data;
+    data.type1.data = value > 4095 ? 4095 : value;
+    data.type1.channel = pattern.channel;
+    memcpy(buf + i * BYTES_PER_CONVERSION, &data, BYTES_PER_CONVERSION);
+  }
+  sAdc.nextConversion += count;
+  *out_length = (uint32_t)(count * BYTES_PER_CONVERSION);
+  return result;
+}
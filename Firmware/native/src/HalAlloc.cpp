@@ -0,0 +1,76 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "HalSim.h"
+
+/*
+ * Counting replacements for the global allocation functions. Every String temporary, JsonDocument
+ * pool and `new` in the firmware goes through here, so a harness can report heap traffic per pulse
+ * or per publish by sampling HalSim::allocationStats() before and after.
+ */
+namespace {
+std::atomic<uint64_t> sAllocations{0};
+std::atomic<uint64_t> sFrees{0};
+std::atomic<uint64_t> sBytesAllocated{0};
+
+void* countedAlloc(std::size_t size) {
+  void* memory = std::malloc(size > 0 ? size : 1);
+  if (memory != nullptr) {
+    sAllocations.fetch_add(1, std::memory_order_relaxed);
+    sBytesAllocated.fetch_add(size, std::memory_order_relaxed);
+  }
+  return memory;
+}
+
+void countedFree(void* memory) {
+  if (memory != nullptr) {
+    sFrees.fetch_add(1, std::memory_order_relaxed);
+    std::free(memory);
+  }
+}
+}  // namespace
+
+void* operator new(std::size_t size) {
+  void* memory = countedAlloc(size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void* operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return countedAlloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return countedAlloc(size);
+}
+
+void operator delete(void* memory) noexcept {
+  countedFree(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+  countedFree(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+  countedFree(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+  countedFree(memory);
+}
+
+namespace HalSim {
+AllocationStats allocationStats() {
+  return AllocationStats{sAllocations.load(std::memory_order_relaxed),
+                         sFrees.load(std::memory_order_relaxed),
+                         sBytesAllocated.load(std::memory_order_relaxed)};
+}
+}  // namespace HalSim
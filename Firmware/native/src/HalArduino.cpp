@@ -0,0 +1,330 @@
+#include <Arduino.h>
+#include <Adafruit_SSD1306.h>
+#include <Wire.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <thread>
+
+#include "HalInternal.h"
+#include "HalSim.h"
+
+// Bounds of the RTC_NOINIT_ATTR section, defined by the linker (weak: no such variable, no section)
+extern "C" uint8_t __start_rtc_noinit[] __attribute__((weak));
+extern "C" uint8_t __stop_rtc_noinit[] __attribute__((weak));
+
+namespace {
+constexpr int GPIO_COUNT = 40;
+
+const std::chrono::steady_clock::time_point sBootTime = std::chrono::steady_clock::now();
+std::atomic<int64_t> sClockOffsetUs{0};  // HalSim::advanceClock()
+
+std::atomic<uint8_t> sPinLevel[GPIO_COUNT];
+std::atomic<void (*)()> sIsr[GPIO_COUNT];
+std::atomic<int> sIsrMode[GPIO_COUNT];
+std::atomic<HalSim::AnalogSource> sAnalogSource[GPIO_COUNT];
+std::atomic<uint16_t> sTouchValue[GPIO_COUNT];
+std::atomic<HalSim::RestartHandler> sRestartHandler{nullptr};
+std::atomic<esp_reset_reason_t> sResetReason{ESP_RST_POWERON};
+
+bool validPin(int pin) {
+  return pin >= 0 && pin < GPIO_COUNT;
+}
+
+int64_t elapsedUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - sBootTime)
+             .count() +
+         sClockOffsetUs.load();
+}
+}  // namespace
+
+HardwareSerial Serial;
+TwoWire Wire;
+
+/* ###################################################################################################
+ *               T I M I N G
+ * ###################################################################################################
+ */
+unsigned long millis() {
+  return static_cast<uint32_t>(elapsedUs() / 1000);
+}
+
+unsigned long micros() {
+  return static_cast<uint32_t>(elapsedUs());
+}
+
+int64_t esp_timer_get_time() {
+  return elapsedUs();
+}
+
+void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+bool getLocalTime(struct tm* info, uint32_t ms) {
+  (void)ms;
+  if (info == nullptr) {
+    return false;
+  }
+  const time_t now = time(nullptr);
+  return localtime_r(&now, info) != nullptr && info->tm_year > (2016 - 1900);
+}
+
+void configTzTime(const char* tz, const char* server1, const char* server2, const char* server3) {
+  (void)server1;
+  (void)server2;
+  (void)server3;
+  if (tz != nullptr) {
+    setenv("TZ", tz, 1);
+    tzset();
+  }
+}
+
+/* ###################################################################################################
+ *               G P I O   A N D   I N T E R R U P T S
+ * ###################################################################################################
+ */
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (!validPin(pin)) {
+    return;
+  }
+  if (mode == INPUT_PULLUP) {
+    sPinLevel[pin] = HIGH;
+  } else if (mode == INPUT_PULLDOWN) {
+    sPinLevel[pin] = LOW;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (validPin(pin)) {
+    sPinLevel[pin] = value ? HIGH : LOW;
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return validPin(pin) ? sPinLevel[pin].load() : LOW;
+}
+
+uint16_t analogRead(uint8_t pin) {
+  if (!validPin(pin)) {
+    return 0;
+  }
+  HalSim::AnalogSource source = sAnalogSource[pin];
+  return source != nullptr ? source(pin, micros()) : 2048;
+}
+
+uint16_t halAnalogSample(int gpio, uint32_t atUs) {
+  if (!validPin(gpio)) {
+    return 0;
+  }
+  HalSim::AnalogSource source = sAnalogSource[gpio];
+  return source != nullptr ? source(gpio, atUs) : 2048;
+}
+
+void analogReadResolution(uint8_t bits) {
+  (void)bits;
+}
+
+uint16_t touchRead(uint8_t pin) {
+  if (!validPin(pin)) {
+    return 0;
+  }
+  const uint16_t value = sTouchValue[pin];
+  return value != 0 ? value : 80;  // Untouched pads read high on ESP32.
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode) {
+  if (validPin(pin)) {
+    sIsrMode[pin] = mode;
+    sIsr[pin] = isr;
+  }
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (validPin(pin)) {
+    sIsr[pin] = nullptr;
+  }
+}
+
+/* ###################################################################################################
+ *               S E R I A L
+ * ###################################################################################################
+ */
+size_t HardwareSerial::write(uint8_t c) {
+  return fwrite(&c, 1, 1, stdout);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  return fwrite(buffer, 1, size, stdout);
+}
+
+size_t Print::printf(const char* format, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  const int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (length <= 0) {
+    return 0;
+  }
+  return write(reinterpret_cast<const uint8_t*>(buffer),
+               std::min(static_cast<size_t>(length), sizeof(buffer) - 1));
+}
+
+/* ###################################################################################################
+ *               D I S P L A Y
+ * ###################################################################################################
+ */
+size_t Adafruit_GFX::write(uint8_t c) {
+  if (c == '\n') {
+    cursorX_ = 0;
+    cursorY_ += 8 * textSize_;
+  } else if (c != '\r') {
+    cursorX_ += 6 * textSize_;
+  }
+  return 1;
+}
+
+void Adafruit_GFX::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+  (void)x0;
+  (void)y0;
+  (void)x1;
+  (void)y1;
+  (void)color;
+}
+
+void Adafruit_GFX::getTextBounds(const char* text, int16_t x, int16_t y,
+                                 int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h) {
+  const size_t length = text != nullptr ? strlen(text) : 0;
+  *x1 = x;
+  *y1 = y;
+  *w = static_cast<uint16_t>(length * 6 * textSize_);
+  *h = static_cast<uint16_t>(length > 0 ? 8 * textSize_ : 0);
+}
+
+void Adafruit_GFX::getTextBounds(const String& text, int16_t x, int16_t y,
+                                 int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h) {
+  getTextBounds(text.c_str(), x, y, x1, y1, w, h);
+}
+
+bool Adafruit_SSD1306::begin(uint8_t switchVcc, uint8_t i2cAddress, bool reset, bool periphBegin) {
+  (void)switchVcc;
+  (void)i2cAddress;
+  (void)reset;
+  (void)periphBegin;
+  return true;
+}
+
+void Adafruit_SSD1306::clearDisplay() {
+  cursorX_ = 0;
+  cursorY_ = 0;
+}
+
+void Adafruit_SSD1306::display() {
+}
+
+void Adafruit_SSD1306::ssd1306_command(uint8_t command) {
+  (void)command;
+}
+
+/* ###################################################################################################
+ *               S Y S T E M
+ * ###################################################################################################
+ */
+void esp_restart() {
+  HalSim::RestartHandler handler = sRestartHandler;
+  if (handler != nullptr) {
+    handler();
+  }
+  fflush(stdout);
+  std::_Exit(0);
+}
+
+esp_reset_reason_t esp_reset_reason() {
+  return sResetReason;
+}
+
+uint32_t esp_get_free_heap_size() {
+  return static_cast<uint32_t>(xPortGetFreeHeapSize());
+}
+
+uint32_t esp_random() {
+  static std::atomic<uint64_t> state{0x9E3779B97F4A7C15ULL};  // Fixed seed: runs are repeatable
+  uint64_t x = state.fetch_add(0x9E3779B97F4A7C15ULL) + 0x9E3779B97F4A7C15ULL;  // splitmix64
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return static_cast<uint32_t>((x ^ (x >> 31)) >> 32);
+}
+
+/* ###################################################################################################
+ *               H A L   S I M   C O N T R O L
+ * ###################################################################################################
+ */
+namespace HalSim {
+void advanceClock(uint32_t ms) {
+  sClockOffsetUs += static_cast<int64_t>(ms) * 1000;
+}
+
+bool triggerInterrupt(int gpio) {
+  if (!validPin(gpio)) {
+    return false;
+  }
+  void (*isr)() = sIsr[gpio];
+  bool rising;
+  if (isr != nullptr) {
+    const int mode = sIsrMode[gpio];
+    rising = mode == RISING || mode == ONHIGH || (mode == CHANGE && sPinLevel[gpio] == LOW);
+  } else {
+    rising = sPinLevel[gpio] == LOW;  // No ISR: toggle the pin so a pulse counter still sees an edge
+  }
+  sPinLevel[gpio] = rising ? HIGH : LOW;
+  halPcntEdge(gpio, rising);
+  if (isr != nullptr) {
+    isr();
+  }
+  return true;
+}
+
+void setDigitalInput(int gpio, int level) {
+  if (validPin(gpio)) {
+    sPinLevel[gpio] = level ? HIGH : LOW;
+  }
+}
+
+int getDigitalOutput(int gpio) {
+  return validPin(gpio) ? sPinLevel[gpio].load() : LOW;
+}
+
+void setAnalogSource(int gpio, AnalogSource source) {
+  if (validPin(gpio)) {
+    sAnalogSource[gpio] = source;
+  }
+}
+
+void setTouchValue(int gpio, uint16_t value) {
+  if (validPin(gpio)) {
+    sTouchValue[gpio] = value;
+  }
+}
+
+void setRestartHandler(RestartHandler handler) {
+  sRestartHandler = handler;
+}
+
+void setResetReason(esp_reset_reason_t reason) {
+  sResetReason = reason;
+}
+
+uint8_t* rtcNoinitMemory(size_t* size) {
+  *size = static_cast<size_t>(__stop_rtc_noinit - __start_rtc_noinit);
+  return __start_rtc_noinit;
+}
+}  // namespace HalSim
@@ -0,0 +1,325 @@
+#include <freertos/FreeRTOS.h>
+
+#include <pthread.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "HalSim.h"
+
+struct HalTask {
+  std::atomic<bool> deleted{false};
+  std::mutex notifyMutex;
+  std::condition_variable notifyCv;
+  uint32_t notifyValue = 0;
+};
+
+struct HalQueue {
+  std::mutex mutex;
+  std::condition_variable notEmpty;
+  std::condition_variable notFull;
+  std::vector<uint8_t> storage;
+  UBaseType_t length = 0;
+  UBaseType_t itemSize = 0;
+  UBaseType_t head = 0;
+  UBaseType_t count = 0;
+};
+
+namespace {
+thread_local HalTask* sCurrentTask = nullptr;
+std::atomic<uint32_t> sTasksCreated{0};
+
+// Roughly the free heap of an ESP32 running this firmware; only used for diagnostics output.
+constexpr size_t HOST_REPORTED_FREE_HEAP = 200 * 1024;
+
+template <typename Predicate>
+bool waitFor(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, TickType_t ticks, Predicate ready) {
+  if (ticks == portMAX_DELAY) {
+    cv.wait(lock, ready);
+    return true;
+  }
+  return cv.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), ready);
+}
+
+BaseType_t queueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait, bool toFront) {
+  if (queue == nullptr) {
+    return pdFAIL;
+  }
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!waitFor(queue->notFull, lock, ticksToWait, [queue] { return queue->count < queue->length; })) {
+    return errQUEUE_FULL;
+  }
+  UBaseType_t slot;
+  if (toFront) {
+    queue->head = (queue->head + queue->length - 1) % queue->length;
+    slot = queue->head;
+  } else {
+    slot = (queue->head + queue->count) % queue->length;
+  }
+  if (queue->itemSize > 0 && item != nullptr) {
+    memcpy(&queue->storage[slot * queue->itemSize], item, queue->itemSize);
+  }
+  queue->count++;
+  lock.unlock();
+  queue->notEmpty.notify_one();
+  return pdPASS;
+}
+
+BaseType_t queueReceive(QueueHandle_t queue, void* buffer, TickType_t ticksToWait, bool remove) {
+  if (queue == nullptr) {
+    return pdFAIL;
+  }
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!waitFor(queue->notEmpty, lock, ticksToWait, [queue] { return queue->count > 0; })) {
+    return pdFAIL;
+  }
+  if (queue->itemSize > 0 && buffer != nullptr) {
+    memcpy(buffer, &queue->storage[queue->head * queue->itemSize], queue->itemSize);
+  }
+  if (remove) {
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    lock.unlock();
+    queue->notFull.notify_one();
+  }
+  return pdPASS;
+}
+}  // namespace
+
+size_t xPortGetFreeHeapSize() {
+  return HOST_REPORTED_FREE_HEAP;
+}
+
+/* ###################################################################################################
+ *               T A S K S
+ * ###################################################################################################
+ */
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t taskCode,
+                                   const char* name,
+                                   uint32_t stackDepth,
+                                   void* parameters,
+                                   UBaseType_t priority,
+                                   TaskHandle_t* createdTask,
+                                   BaseType_t coreId) {
+  (void)name;
+  (void)stackDepth;
+  (void)priority;
+  (void)coreId;
+
+  // Task control blocks are intentionally never freed: handles may be inspected after deletion,
+  // exactly like the firmware does with eTaskGetState().
+  HalTask* task = new HalTask();
+  sTasksCreated++;
+  if (createdTask != nullptr) {
+    *createdTask = task;
+  }
+  std::thread([task, taskCode, parameters] {
+    sCurrentTask = task;
+    taskCode(parameters);
+    task->deleted = true;
+  }).detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t taskCode,
+                       const char* name,
+                       uint32_t stackDepth,
+                       void* parameters,
+                       UBaseType_t priority,
+                       TaskHandle_t* createdTask) {
+  return xTaskCreatePinnedToCore(taskCode, name, stackDepth, parameters, priority, createdTask, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (task == nullptr || task == sCurrentTask) {
+    if (sCurrentTask != nullptr) {
+      sCurrentTask->deleted = true;
+    }
+    pthread_exit(nullptr);
+  }
+  task->deleted = true;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+}
+
+eTaskState eTaskGetState(TaskHandle_t task) {
+  if (task == nullptr) {
+    return eInvalid;
+  }
+  return task->deleted ? eDeleted : eRunning;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return sCurrentTask;
+}
+
+TickType_t xTaskGetTickCount() {
+  using namespace std::chrono;
+  static const steady_clock::time_point start = steady_clock::now();
+  return static_cast<TickType_t>(duration_cast<milliseconds>(steady_clock::now() - start).count() /
+                                 portTICK_PERIOD_MS);
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  (void)task;
+  return 0;  // Unknown on the host; the firmware treats 0 as "not measured".
+}
+
+uint8_t* pxTaskGetStackStart(TaskHandle_t task) {
+  (void)task;
+  return nullptr;  // Host threads have no FreeRTOS stack to inspect.
+}
+
+uint32_t HalSim::tasksCreated() {
+  return sTasksCreated;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  if (task == nullptr) {
+    return pdFAIL;
+  }
+  {
+    std::lock_guard<std::mutex> lock(task->notifyMutex);
+    task->notifyValue++;
+  }
+  task->notifyCv.notify_one();
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken) {
+  xTaskNotifyGive(task);
+  if (higherPriorityTaskWoken != nullptr) {
+    *higherPriorityTaskWoken = pdTRUE;
+  }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+  HalTask* task = sCurrentTask;
+  if (task == nullptr) {
+    return 0;
+  }
+  std::unique_lock<std::mutex> lock(task->notifyMutex);
+  waitFor(task->notifyCv, lock, ticksToWait, [task] { return task->notifyValue > 0; });
+  const uint32_t value = task->notifyValue;
+  if (value > 0) {
+    task->notifyValue = clearCountOnExit ? 0 : value - 1;
+  }
+  return value;
+}
+
+/* ###################################################################################################
+ *               Q U E U E S
+ * ###################################################################################################
+ */
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  if (length == 0) {
+    return nullptr;
+  }
+  HalQueue* queue = new HalQueue();
+  queue->length = length;
+  queue->itemSize = itemSize;
+  queue->storage.resize(static_cast<size_t>(length) * itemSize);
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+  delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+  return queueSend(queue, item, ticksToWait, false);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+  return queueSend(queue, item, ticksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+  return queueSend(queue, item, ticksToWait, true);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* higherPriorityTaskWoken) {
+  const BaseType_t result = queueSend(queue, item, 0, false);
+  if (higherPriorityTaskWoken != nullptr && result == pdPASS) {
+    *higherPriorityTaskWoken = pdTRUE;
+  }
+  return result;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item) {
+  if (queue == nullptr) {
+    return pdFAIL;
+  }
+  {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->head = 0;
+    queue->count = 0;
+  }
+  return queueSend(queue, item, 0, false);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticksToWait) {
+  return queueReceive(queue, buffer, ticksToWait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* buffer, TickType_t ticksToWait) {
+  return queueReceive(queue, buffer, ticksToWait, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+  if (queue == nullptr) {
+    return pdFAIL;
+  }
+  {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->head = 0;
+    queue->count = 0;
+  }
+  queue->notFull.notify_all();
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  if (queue == nullptr) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+  if (queue == nullptr) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  return queue->length - queue->count;
+}
+
+/* ###################################################################################################
+ *               S E M A P H O R E S
+ * ###################################################################################################
+ */
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+  xSemaphoreGive(mutex);
+  return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+  SemaphoreHandle_t semaphore = xQueueCreate(maxCount, 0);
+  for (UBaseType_t i = 0; i < initialCount && i < maxCount; ++i) {
+    xSemaphoreGive(semaphore);
+  }
+  return semaphore;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// Hooks between the HAL translation units; not part of the HalSim harness API.
+
+// Called by HalSim::triggerInterrupt() for every simulated edge on 'gpio', before the ISR runs.
+void halPcntEdge(int gpio, bool rising);
+
+// Value of the HalSim analog source of 'gpio' at micros() == atUs; mid-scale without a source.
+uint16_t halAnalogSample(int gpio, uint32_t atUs);
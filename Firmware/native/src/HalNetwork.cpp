@@ -0,0 +1,759 @@
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <lwip/sockets.h>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "HalSim.h"
+
+namespace {
+struct InboundMessage {
+  std::string topic;
+  std::string payload;
+};
+
+// A simulated lwIP socket; every one of them connects to the broker.
+struct SimSocket {
+  bool used = false;
+  bool nonBlocking = false;
+  bool connecting = false;
+  bool established = false;
+  bool closed = false;          // Reset by the peer after being established: recv() returns 0
+  int error = 0;                // SO_ERROR of the finished connect attempt
+  uint32_t connectDoneMs = 0;   // The handshake's latency is fixed when it starts
+  uint32_t session = 0;
+  bool connackDue = false;
+  uint32_t connackAtMs = 0;
+  uint8_t connackCode = 0;
+  std::deque<uint8_t> rx;
+};
+
+constexpr int SIM_SOCKET_BASE = 48;   // Descriptors of simulated sockets, clear of stdin/out/err
+constexpr int SIM_SOCKET_COUNT = 4;
+
+// The simulated broker serves a single client, which is all the firmware ever creates.
+struct SimBroker {
+  std::mutex mutex;
+  bool online = true;
+  uint32_t session = 1;
+  std::set<std::string> subscriptions;
+  std::deque<InboundMessage> inbound;
+  std::map<std::string, std::string> lastPayload;
+  HalSim::MqttBrokerStats stats{};
+  SimSocket sockets[SIM_SOCKET_COUNT];
+  uint32_t tcpLatencyMs = 0;
+  uint32_t connackLatencyMs = 0;
+  int connackCode = 0;          // -1: CONNECT is never answered
+};
+
+SimBroker sBroker;
+std::atomic<bool> sWiFiConnected{true};
+std::atomic<HalSim::PublishObserver> sPublishObserver{nullptr};
+
+// MQTT topic filter matching with '+' (single level) and '#' (multi level) wildcards.
+bool topicMatches(const std::string& filter, const std::string& topic) {
+  size_t f = 0;
+  size_t t = 0;
+  while (f < filter.size()) {
+    if (filter[f] == '#') {
+      return true;
+    }
+    if (filter[f] == '+') {
+      while (t < topic.size() && topic[t] != '/') {
+        ++t;
+      }
+      ++f;
+      continue;
+    }
+    if (t >= topic.size() || filter[f] != topic[t]) {
+      return false;
+    }
+    ++f;
+    ++t;
+  }
+  return t == topic.size();
+}
+
+bool timeReached(uint32_t nowMs, uint32_t atMs) {
+  return (int32_t)(nowMs - atMs) >= 0;
+}
+
+// Caller holds sBroker.mutex.
+SimSocket* simSocket(int fd) {
+  if (fd < SIM_SOCKET_BASE || fd >= SIM_SOCKET_BASE + SIM_SOCKET_COUNT || !sBroker.sockets[fd - SIM_SOCKET_BASE].used) {
+    return nullptr;
+  }
+  return &sBroker.sockets[fd - SIM_SOCKET_BASE];
+}
+
+// Moves a socket along in time: finishes the handshake, drops it with the broker session or the
+// WiFi link and delivers a due CONNACK. Caller holds sBroker.mutex.
+void advanceSocket(SimSocket& socket) {
+  uint32_t nowMs = millis();
+  if (socket.connecting && timeReached(nowMs, socket.connectDoneMs)) {
+    socket.connecting = false;
+    socket.error = !sWiFiConnected ? EHOSTUNREACH : !sBroker.online ? ECONNREFUSED : 0;
+    socket.established = socket.error == 0;
+    socket.session = sBroker.session;
+  }
+  if (socket.established && (!sWiFiConnected || !sBroker.online || socket.session != sBroker.session)) {
+    socket.established = false;
+    socket.closed = true;
+    socket.connackDue = false;
+  }
+  if (socket.connackDue && timeReached(nowMs, socket.connackAtMs)) {
+    socket.connackDue = false;
+    const uint8_t connack[4] = {0x20, 0x02, 0x00, socket.connackCode};
+    socket.rx.insert(socket.rx.end(), connack, connack + sizeof(connack));
+  }
+}
+}  // namespace
+
+WiFiClass WiFi;
+
+/* ###################################################################################################
+ *               W I F I
+ * ###################################################################################################
+ */
+String IPAddress::toString() const {
+  char buffer[16];
+  snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", octets_[0], octets_[1], octets_[2], octets_[3]);
+  return String(buffer);
+}
+
+bool IPAddress::fromString(const char* address) {
+  unsigned int a, b, c, d;
+  char tail;
+  if (address == nullptr || sscanf(address, "%u.%u.%u.%u%c", &a, &b, &c, &d, &tail) != 4 ||
+      a > 255 || b > 255 || c > 255 || d > 255) {
+    return false;
+  }
+  *this = IPAddress(a, b, c, d);
+  return true;
+}
+
+wl_status_t WiFiClass::status() {
+  return sWiFiConnected ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+bool WiFiClass::mode(wifi_mode_t mode) {
+  (void)mode;
+  return true;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase) {
+  (void)ssid;
+  (void)passphrase;
+  return status();
+}
+
+bool WiFiClass::disconnect(bool wifiOff) {
+  (void)wifiOff;
+  return true;
+}
+
+bool WiFiClass::setSleep(bool enabled) {
+  (void)enabled;
+  return true;
+}
+
+bool WiFiClass::setAutoReconnect(bool autoReconnect) {
+  (void)autoReconnect;
+  return true;
+}
+
+uint8_t WiFiClass::waitForConnectResult(unsigned long timeoutLength) {
+  (void)timeoutLength;
+  return status();
+}
+
+IPAddress WiFiClass::localIP() {
+  return sWiFiConnected ? IPAddress(127, 0, 0, 1) : IPAddress(0, 0, 0, 0);
+}
+
+int WiFiClass::hostByName(const char* host, IPAddress& result) {
+  (void)host;
+  result = IPAddress(127, 0, 0, 1);
+  return sWiFiConnected ? 1 : 0;
+}
+
+uint8_t* WiFiClass::macAddress(uint8_t* mac) {
+  static const uint8_t HOST_MAC[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};  // Locally administered
+  memcpy(mac, HOST_MAC, sizeof(HOST_MAC));
+  return mac;
+}
+
+String WiFiClass::macAddress() {
+  uint8_t mac[6];
+  macAddress(mac);
+  char buffer[18];
+  snprintf(buffer, sizeof(buffer), "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+  return String(buffer);
+}
+
+int8_t WiFiClass::RSSI() {
+  return sWiFiConnected ? -50 : 0;
+}
+
+WiFiClient::WiFiClient(int fd) : socket_(new int(fd), [](int* socket) { lwip_close(*socket); delete socket; }) {}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+  stop();
+  int fd = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd < 0) {
+    return 0;
+  }
+  struct sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = (uint32_t)ip;
+  if (lwip_connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0) {
+    lwip_close(fd);
+    return 0;
+  }
+  *this = WiFiClient(fd);
+  return 1;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+  IPAddress ip;
+  if (!ip.fromString(host) && WiFi.hostByName(host, ip) != 1) {
+    return 0;
+  }
+  return connect(ip, port);
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size) {
+  ssize_t sent = socket_ ? lwip_send(*socket_, buffer, size, 0) : -1;
+  return sent > 0 ? (size_t)sent : 0;
+}
+
+int WiFiClient::available() {
+  int count = 0;
+  if (!socket_ || lwip_ioctl(*socket_, FIONREAD, &count) < 0) {
+    return 0;
+  }
+  return count;
+}
+
+int WiFiClient::read() {
+  uint8_t data;
+  return read(&data, 1) == 1 ? data : -1;
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size) {
+  ssize_t received = socket_ ? lwip_recv(*socket_, buffer, size, MSG_DONTWAIT) : -1;
+  return received > 0 ? (int)received : -1;
+}
+
+int WiFiClient::peek() {
+  uint8_t data;
+  ssize_t received = socket_ ? lwip_recv(*socket_, &data, 1, MSG_PEEK | MSG_DONTWAIT) : -1;
+  return received == 1 ? data : -1;
+}
+
+void WiFiClient::stop() {
+  socket_.reset();
+}
+
+uint8_t WiFiClient::connected() {
+  if (!socket_) {
+    return 0;
+  }
+  uint8_t data;
+  ssize_t received = lwip_recv(*socket_, &data, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (received == 0 || (received < 0 && errno != EAGAIN)) {
+    stop();
+    return 0;
+  }
+  return 1;
+}
+
+/* ###################################################################################################
+ *               L W I P   S O C K E T S
+ * ###################################################################################################
+ */
+int lwip_socket(int domain, int type, int protocol) {
+  (void)domain;
+  (void)type;
+  (void)protocol;
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  for (int i = 0; i < SIM_SOCKET_COUNT; i++) {
+    if (!sBroker.sockets[i].used) {
+      sBroker.sockets[i] = SimSocket();
+      sBroker.sockets[i].used = true;
+      return SIM_SOCKET_BASE + i;
+    }
+  }
+  errno = ENFILE;
+  return -1;
+}
+
+int lwip_connect(int s, const struct sockaddr* name, socklen_t namelen) {
+  (void)name;
+  (void)namelen;
+  {
+    std::lock_guard<std::mutex> lock(sBroker.mutex);
+    SimSocket* socket = simSocket(s);
+    if (socket == nullptr) {
+      errno = EBADF;
+      return -1;
+    }
+    if (socket->connecting || socket->established) {
+      errno = socket->connecting ? EALREADY : EISCONN;
+      return -1;
+    }
+    socket->connecting = true;
+    socket->connectDoneMs = millis() + sBroker.tcpLatencyMs;
+    sBroker.stats.connectAttempts++;
+    if (socket->nonBlocking) {
+      errno = EINPROGRESS;
+      return -1;
+    }
+  }
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> lock(sBroker.mutex);
+      SimSocket* socket = simSocket(s);
+      advanceSocket(*socket);
+      if (!socket->connecting) {
+        if (socket->error != 0) {
+          errno = socket->error;
+          return -1;
+        }
+        return 0;
+      }
+    }
+    delay(1);
+  }
+}
+
+int lwip_select(int maxfdp1, fd_set* readset, fd_set* writeset, fd_set* exceptset, struct timeval* timeout) {
+  uint32_t startMs = millis();
+  uint32_t timeoutMs = timeout != nullptr ? (uint32_t)(timeout->tv_sec * 1000 + timeout->tv_usec / 1000) : UINT32_MAX;
+  fd_set readIn;
+  fd_set writeIn;
+  FD_ZERO(&readIn);
+  FD_ZERO(&writeIn);
+  if (readset != nullptr) {
+    readIn = *readset;
+  }
+  if (writeset != nullptr) {
+    writeIn = *writeset;
+  }
+  if (exceptset != nullptr) {
+    FD_ZERO(exceptset);
+  }
+
+  for (;;) {
+    int ready = 0;
+    {
+      std::lock_guard<std::mutex> lock(sBroker.mutex);
+      for (int fd = SIM_SOCKET_BASE; fd < maxfdp1 && fd < SIM_SOCKET_BASE + SIM_SOCKET_COUNT; fd++) {
+        SimSocket* socket = simSocket(fd);
+        if (socket == nullptr) {
+          continue;
+        }
+        advanceSocket(*socket);
+        bool readable = FD_ISSET(fd, &readIn) && (!socket->rx.empty() || socket->closed);
+        bool writable = FD_ISSET(fd, &writeIn) && !socket->connecting;
+        if (readset != nullptr && !readable) {
+          FD_CLR(fd, readset);
+        }
+        if (writeset != nullptr && !writable) {
+          FD_CLR(fd, writeset);
+        }
+        ready += (readable ? 1 : 0) + (writable ? 1 : 0);
+      }
+    }
+    if (ready > 0 || millis() - startMs >= timeoutMs) {
+      return ready;
+    }
+    if (readset != nullptr) {
+      *readset = readIn;
+    }
+    if (writeset != nullptr) {
+      *writeset = writeIn;
+    }
+    delay(1);
+  }
+}
+
+int lwip_getsockopt(int s, int level, int optname, void* optval, socklen_t* optlen) {
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  SimSocket* socket = simSocket(s);
+  if (socket == nullptr) {
+    errno = EBADF;
+    return -1;
+  }
+  if (level == SOL_SOCKET && optname == SO_ERROR && optval != nullptr && optlen != nullptr && *optlen >= sizeof(int)) {
+    *static_cast<int*>(optval) = socket->error;
+    socket->error = 0;  // Reading SO_ERROR clears it
+    *optlen = sizeof(int);
+    return 0;
+  }
+  errno = ENOPROTOOPT;
+  return -1;
+}
+
+int lwip_setsockopt(int s, int level, int optname, const void* optval, socklen_t optlen) {
+  (void)level;
+  (void)optname;
+  (void)optval;
+  (void)optlen;
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  if (simSocket(s) == nullptr) {
+    errno = EBADF;
+    return -1;
+  }
+  return 0;  // Timeouts, keep-alive and Nagle do not apply to the simulation
+}
+
+int lwip_fcntl(int s, int cmd, int val) {
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  SimSocket* socket = simSocket(s);
+  if (socket == nullptr) {
+    errno = EBADF;
+    return -1;
+  }
+  if (cmd == F_GETFL) {
+    return socket->nonBlocking ? O_NONBLOCK : 0;
+  }
+  if (cmd == F_SETFL) {
+    socket->nonBlocking = (val & O_NONBLOCK) != 0;
+    return 0;
+  }
+  errno = EINVAL;
+  return -1;
+}
+
+int lwip_ioctl(int s, long cmd, void* argp) {
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  SimSocket* socket = simSocket(s);
+  if (socket == nullptr || cmd != FIONREAD || argp == nullptr) {
+    errno = socket == nullptr ? EBADF : EINVAL;
+    return -1;
+  }
+  advanceSocket(*socket);
+  *static_cast<int*>(argp) = (int)socket->rx.size();
+  return 0;
+}
+
+ssize_t lwip_recv(int s, void* mem, size_t len, int flags) {
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  SimSocket* socket = simSocket(s);
+  if (socket == nullptr) {
+    errno = EBADF;
+    return -1;
+  }
+  advanceSocket(*socket);
+  if (socket->rx.empty()) {
+    if (socket->closed) {
+      return 0;
+    }
+    errno = socket->established ? EAGAIN : ENOTCONN;
+    return -1;
+  }
+  size_t count = std::min(len, socket->rx.size());
+  std::copy(socket->rx.begin(), socket->rx.begin() + count, static_cast<uint8_t*>(mem));
+  if ((flags & MSG_PEEK) == 0) {
+    socket->rx.erase(socket->rx.begin(), socket->rx.begin() + count);
+  }
+  return (ssize_t)count;
+}
+
+ssize_t lwip_send(int s, const void* dataptr, size_t size, int flags) {
+  (void)flags;
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  SimSocket* socket = simSocket(s);
+  if (socket == nullptr) {
+    errno = EBADF;
+    return -1;
+  }
+  advanceSocket(*socket);
+  if (!socket->established) {
+    errno = socket->closed ? ECONNRESET : ENOTCONN;
+    return -1;
+  }
+  // The broker only looks at the packet type: a CONNECT is answered after connackLatencyMs
+  const uint8_t* data = static_cast<const uint8_t*>(dataptr);
+  if (size > 0 && (data[0] & 0xF0) == 0x10 && sBroker.connackCode >= 0) {
+    socket->connackDue = true;
+    socket->connackAtMs = millis() + sBroker.connackLatencyMs;
+    socket->connackCode = (uint8_t)sBroker.connackCode;
+  }
+  return (ssize_t)size;
+}
+
+int lwip_close(int s) {
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  SimSocket* socket = simSocket(s);
+  if (socket == nullptr) {
+    errno = EBADF;
+    return -1;
+  }
+  *socket = SimSocket();
+  return 0;
+}
+
+/* ###################################################################################################
+ *               M Q T T   C L I E N T
+ * ###################################################################################################
+ */
+PubSubClient& PubSubClient::setServer(const char* domain, uint16_t port) {
+  domain_ = domain != nullptr ? domain : "";
+  port_ = port;
+  return *this;
+}
+
+PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
+  callback_ = std::move(callback);
+  return *this;
+}
+
+PubSubClient& PubSubClient::setSocketTimeout(uint16_t timeoutSeconds) {
+  socketTimeoutSeconds_ = timeoutSeconds;
+  return *this;
+}
+
+PubSubClient& PubSubClient::setKeepAlive(uint16_t keepAliveSeconds) {
+  (void)keepAliveSeconds;
+  return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size) {
+  if (size == 0) {
+    return false;
+  }
+  bufferSize_ = size;
+  return true;
+}
+
+bool PubSubClient::connect(const char* id) {
+  return connect(id, nullptr, nullptr, nullptr, 0, false, nullptr);
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass) {
+  return connect(id, user, pass, nullptr, 0, false, nullptr);
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass,
+                           const char* willTopic, uint8_t willQos, bool willRetain, const char* willMessage) {
+  (void)id;
+  (void)user;
+  (void)pass;
+  (void)willTopic;
+  (void)willQos;
+  (void)willRetain;
+  (void)willMessage;
+
+  if (connected()) {
+    return true;
+  }
+  if (!client_->connected() && client_->connect(domain_.c_str(), port_) != 1) {
+    state_ = MQTT_CONNECT_FAILED;
+    return false;
+  }
+
+  // Like the library: write CONNECT, then busy-wait for the CONNACK up to the socket timeout
+  static const uint8_t CONNECT_PACKET[] = {0x10, 0x00};  // The simulated broker only reads the packet type
+  client_->write(CONNECT_PACKET, sizeof(CONNECT_PACKET));
+  uint32_t startMs = millis();
+  while (client_->available() < 4) {
+    if (millis() - startMs >= socketTimeoutSeconds_ * 1000UL) {
+      state_ = MQTT_CONNECTION_TIMEOUT;
+      client_->stop();
+      return false;
+    }
+    delay(1);
+  }
+  uint8_t connack[4];
+  for (uint8_t& byte : connack) {
+    byte = (uint8_t)client_->read();
+  }
+  if (connack[0] != 0x20 || connack[3] != 0) {
+    state_ = connack[0] != 0x20 ? MQTT_CONNECT_FAILED : connack[3];
+    client_->stop();
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  if (!sBroker.online) {
+    state_ = MQTT_CONNECTION_TIMEOUT;
+    return false;
+  }
+  sBroker.subscriptions.clear();
+  sBroker.stats.connects++;
+  sessionId_ = sBroker.session;
+  state_ = MQTT_CONNECTED;
+  return true;
+}
+
+void PubSubClient::disconnect() {
+  state_ = MQTT_DISCONNECTED;
+  client_->stop();
+}
+
+bool PubSubClient::connected() {
+  if (state_ != MQTT_CONNECTED) {
+    return false;
+  }
+  bool sessionAlive;
+  {
+    std::lock_guard<std::mutex> lock(sBroker.mutex);
+    sessionAlive = sBroker.online && sessionId_ == sBroker.session;
+  }
+  if (!sessionAlive || !client_->connected()) {
+    state_ = MQTT_CONNECTION_LOST;
+    return false;
+  }
+  return true;
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload) {
+  return publish(topic, payload, false);
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload, bool retained) {
+  const size_t length = payload != nullptr ? strlen(payload) : 0;
+  return publish(topic, reinterpret_cast<const uint8_t*>(payload), static_cast<unsigned int>(length), retained);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+  if (topic == nullptr || !connected()) {
+    return false;
+  }
+  // Same limit as PubSubClient: fixed header (up to 5 bytes) + topic length prefix + topic + payload.
+  if (5 + 2 + strlen(topic) + length > bufferSize_) {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(sBroker.mutex);
+    sBroker.stats.publishes++;
+    sBroker.stats.publishedBytes += length;
+    sBroker.lastPayload[topic].assign(reinterpret_cast<const char*>(payload), length);
+  }
+  HalSim::PublishObserver observer = sPublishObserver;
+  if (observer != nullptr) {
+    observer(topic, payload, length, retained);
+  }
+  return true;
+}
+
+bool PubSubClient::subscribe(const char* topic, uint8_t qos) {
+  (void)qos;
+  if (topic == nullptr || !connected()) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  sBroker.subscriptions.insert(topic);
+  return true;
+}
+
+bool PubSubClient::unsubscribe(const char* topic) {
+  if (topic == nullptr || !connected()) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  sBroker.subscriptions.erase(topic);
+  return true;
+}
+
+bool PubSubClient::loop() {
+  if (!connected()) {
+    return false;
+  }
+  std::vector<InboundMessage> deliveries;
+  {
+    std::lock_guard<std::mutex> lock(sBroker.mutex);
+    while (!sBroker.inbound.empty()) {
+      InboundMessage message = std::move(sBroker.inbound.front());
+      sBroker.inbound.pop_front();
+      for (const std::string& filter : sBroker.subscriptions) {
+        if (topicMatches(filter, message.topic)) {
+          deliveries.push_back(std::move(message));
+          sBroker.stats.delivered++;
+          break;
+        }
+      }
+    }
+  }
+  if (callback_) {
+    for (InboundMessage& message : deliveries) {
+      callback_(&message.topic[0],
+                reinterpret_cast<uint8_t*>(&message.payload[0]),
+                static_cast<unsigned int>(message.payload.size()));
+    }
+  }
+  return true;
+}
+
+/* ###################################################################################################
+ *               H A L   S I M   C O N T R O L
+ * ###################################################################################################
+ */
+namespace HalSim {
+void setWiFiConnected(bool connected) {
+  sWiFiConnected = connected;
+}
+
+void setMqttConnectLatency(uint32_t tcpMs, uint32_t connackMs) {
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  sBroker.tcpLatencyMs = tcpMs;
+  sBroker.connackLatencyMs = connackMs;
+}
+
+void setMqttConnackCode(int code) {
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  sBroker.connackCode = code;
+}
+
+void setMqttBrokerOnline(bool online) {
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  if (sBroker.online && !online) {
+    sBroker.session++;  // Drop the current session so the client sees the connection as lost.
+  }
+  sBroker.online = online;
+}
+
+bool injectMqttMessage(const char* topic, const char* payload) {
+  if (topic == nullptr || payload == nullptr) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  if (!sBroker.online) {
+    return false;
+  }
+  sBroker.inbound.push_back(InboundMessage{topic, payload});
+  return true;
+}
+
+MqttBrokerStats mqttBrokerStats() {
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  return sBroker.stats;
+}
+
+bool lastPublished(const char* topic, char* payload, size_t payloadSize) {
+  if (topic == nullptr || payload == nullptr || payloadSize == 0) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(sBroker.mutex);
+  const auto entry = sBroker.lastPayload.find(topic);
+  if (entry == sBroker.lastPayload.end()) {
+    return false;
+  }
+  snprintf(payload, payloadSize, "%s", entry->second.c_str());
+  return true;
+}
+
+void setPublishObserver(PublishObserver observer) {
+  sPublishObserver = observer;
+}
+}  // namespace HalSim
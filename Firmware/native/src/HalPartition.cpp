@@ -0,0 +1,140 @@
+#include <esp_partition.h>
+
+#include <string.h>
+
+#include <mutex>
+#include <vector>
+
+#include "HalSim.h"
+
+namespace {
+// Raw data partitions of partitions.csv that the firmware opens with esp_partition_find_first()
+esp_partition_t sPartitions[] = {
+    {ESP_PARTITION_TYPE_DATA, 0x41, 0x3D0000, 0x10000, "mqtthist", false},
+    {ESP_PARTITION_TYPE_DATA, 0x40, 0x3E0000, 0x10000, "pulsejrnl", false},
+};
+constexpr size_t PARTITION_COUNT = sizeof(sPartitions) / sizeof(sPartitions[0]);
+
+std::mutex sFlashMutex;
+std::vector<uint8_t> sFlash[PARTITION_COUNT];
+int64_t sPowerBudget = -1;  // Bytes left before the simulated power cut; negative = unlimited
+bool sPowerLost = false;
+
+int partitionIndex(const esp_partition_t* partition) {
+  for (size_t i = 0; i < PARTITION_COUNT; ++i) {
+    if (partition == &sPartitions[i]) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+std::vector<uint8_t>& flash(int index) {
+  if (sFlash[index].empty()) {
+    sFlash[index].assign(sPartitions[index].size, 0xFF);  // Fresh chips come erased
+  }
+  return sFlash[index];
+}
+
+int labelIndex(const char* label) {
+  for (size_t i = 0; i < PARTITION_COUNT; ++i) {
+    if (label != nullptr && strcmp(sPartitions[i].label, label) == 0) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+}  // namespace
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, int subtype, const char* label) {
+  for (esp_partition_t& partition : sPartitions) {
+    if (partition.type == type && (subtype == ESP_PARTITION_SUBTYPE_ANY || partition.subtype == subtype) &&
+        (label == nullptr || strcmp(partition.label, label) == 0)) {
+      return &partition;
+    }
+  }
+  return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t srcOffset, void* dst, size_t size) {
+  const int index = partitionIndex(partition);
+  if (index < 0 || dst == nullptr || srcOffset + size > partition->size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(sFlashMutex);
+  memcpy(dst, flash(index).data() + srcOffset, size);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dstOffset, const void* src, size_t size) {
+  const int index = partitionIndex(partition);
+  if (index < 0 || src == nullptr || dstOffset + size > partition->size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(sFlashMutex);
+  if (sPowerLost) {
+    return ESP_FAIL;
+  }
+  size_t programmed = size;
+  if (sPowerBudget >= 0 && static_cast<uint64_t>(sPowerBudget) < size) {
+    programmed = static_cast<size_t>(sPowerBudget);  // Torn write
+    sPowerLost = true;
+  }
+  if (sPowerBudget >= 0) {
+    sPowerBudget -= static_cast<int64_t>(programmed);
+  }
+  // NOR flash: programming can only clear bits
+  const uint8_t* bytes = static_cast<const uint8_t*>(src);
+  for (size_t i = 0; i < programmed; ++i) {
+    flash(index)[dstOffset + i] &= bytes[i];
+  }
+  return sPowerLost ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+  const int index = partitionIndex(partition);
+  if (index < 0 || offset % SPI_FLASH_SEC_SIZE != 0 || size % SPI_FLASH_SEC_SIZE != 0 || offset + size > partition->size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(sFlashMutex);
+  if (sPowerLost) {
+    return ESP_FAIL;
+  }
+  if (sPowerBudget == 0) {
+    // Power lost during the erase: the first half of the first sector is erased, the rest is not
+    memset(flash(index).data() + offset, 0xFF, SPI_FLASH_SEC_SIZE / 2);
+    sPowerLost = true;
+    return ESP_FAIL;
+  }
+  memset(flash(index).data() + offset, 0xFF, size);
+  return ESP_OK;
+}
+
+namespace HalSim {
+
+void flashPowerFailAfter(int64_t bytes) {
+  std::lock_guard<std::mutex> lock(sFlashMutex);
+  sPowerBudget = bytes;
+  sPowerLost = false;
+}
+
+void eraseFlashPartition(const char* label) {
+  const int index = labelIndex(label);
+  if (index < 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(sFlashMutex);
+  flash(index).assign(sPartitions[index].size, 0xFF);
+}
+
+bool corruptFlash(const char* label, uint32_t offset, uint8_t xorMask) {
+  const int index = labelIndex(label);
+  if (index < 0 || offset >= sPartitions[index].size) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(sFlashMutex);
+  flash(index)[offset] ^= xorMask;
+  return true;
+}
+
+}  // namespace HalSim
@@ -0,0 +1,187 @@
+#include <driver/pcnt.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "HalSim.h"
+
+#include "HalInternal.h"
+
+namespace {
+struct PcntUnit {
+  bool configured = false;
+  bool running = false;
+  pcnt_config_t config{};
+  int16_t count = 0;
+  uint32_t events = 0;  // Enabled pcnt_evt_type_t bits
+  void (*handler)(void*) = nullptr;
+  void* handlerArg = nullptr;
+};
+
+std::mutex sPcntMutex;
+PcntUnit sUnits[PCNT_UNIT_MAX];
+std::atomic<HalSim::PcntReadHook> sReadHook{nullptr};
+bool sIsrServiceInstalled = false;
+
+bool validUnit(pcnt_unit_t unit) {
+  return unit >= PCNT_UNIT_0 && unit < PCNT_UNIT_MAX;
+}
+}  // namespace
+
+esp_err_t pcnt_unit_config(const pcnt_config_t* config) {
+  if (config == nullptr || !validUnit(config->unit) || config->counter_h_lim <= 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(sPcntMutex);
+  PcntUnit& unit = sUnits[config->unit];
+  unit.config = *config;
+  unit.configured = true;
+  unit.running = true;  // The IDF driver leaves a freshly configured unit counting
+  unit.count = 0;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t filterValue) {
+  return validUnit(unit) && filterValue <= 1023 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t pcnt_filter_enable(pcnt_unit_t unit) {
+  return validUnit(unit) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t pcnt_filter_disable(pcnt_unit_t unit) {
+  return validUnit(unit) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t pcnt_counter_pause(pcnt_unit_t unit) {
+  if (!validUnit(unit)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(sPcntMutex);
+  sUnits[unit].running = false;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_counter_resume(pcnt_unit_t unit) {
+  if (!validUnit(unit)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(sPcntMutex);
+  sUnits[unit].running = true;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit) {
+  if (!validUnit(unit)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(sPcntMutex);
+  sUnits[unit].count = 0;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t* count) {
+  if (!validUnit(unit) || count == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  {
+    std::lock_guard<std::mutex> lock(sPcntMutex);
+    *count = sUnits[unit].count;
+  }
+  if (HalSim::PcntReadHook hook = sReadHook.load()) {
+    hook(unit);
+  }
+  return ESP_OK;
+}
+
+void HalSim::setPcntReadHook(PcntReadHook hook) {
+  sReadHook.store(hook);
+}
+
+esp_err_t pcnt_event_enable(pcnt_unit_t unit, pcnt_evt_type_t event) {
+  if (!validUnit(unit)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(sPcntMutex);
+  sUnits[unit].events |= event;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_event_disable(pcnt_unit_t unit, pcnt_evt_type_t event) {
+  if (!validUnit(unit)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(sPcntMutex);
+  sUnits[unit].events &= ~static_cast<uint32_t>(event);
+  return ESP_OK;
+}
+
+esp_err_t pcnt_isr_service_install(int intrAllocFlags) {
+  (void)intrAllocFlags;
+  std::lock_guard<std::mutex> lock(sPcntMutex);
+  if (sIsrServiceInstalled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  sIsrServiceInstalled = true;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_isr_handler_add(pcnt_unit_t unit, void (*handler)(void* arg), void* arg) {
+  if (!validUnit(unit) || handler == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(sPcntMutex);
+  if (!sIsrServiceInstalled) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  sUnits[unit].handler = handler;
+  sUnits[unit].handlerArg = arg;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_isr_handler_remove(pcnt_unit_t unit) {
+  if (!validUnit(unit)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(sPcntMutex);
+  sUnits[unit].handler = nullptr;
+  sUnits[unit].handlerArg = nullptr;
+  return ESP_OK;
+}
+
+void halPcntEdge(int gpio, bool rising) {
+  struct Event {
+    void (*handler)(void*);
+    void* arg;
+  };
+  Event events[PCNT_UNIT_MAX];
+  int eventCount = 0;
+  {
+    std::lock_guard<std::mutex> lock(sPcntMutex);
+    for (PcntUnit& unit : sUnits) {
+      if (!unit.configured || !unit.running || unit.config.pulse_gpio_num != gpio) {
+        continue;
+      }
+      const pcnt_count_mode_t mode = rising ? unit.config.pos_mode : unit.config.neg_mode;
+      if (mode == PCNT_COUNT_INC) {
+        unit.count++;
+      } else if (mode == PCNT_COUNT_DEC) {
+        unit.count--;
+      }
+      // Like the hardware, the counter resets to 0 when it reaches either limit.
+      const bool highLimit = unit.count >= unit.config.counter_h_lim;
+      const bool lowLimit = unit.count <= unit.config.counter_l_lim;
+      if (highLimit || lowLimit) {
+        unit.count = 0;
+        const uint32_t event = highLimit ? PCNT_EVT_H_LIM : PCNT_EVT_L_LIM;
+        if ((unit.events & event) != 0 && unit.handler != nullptr) {
+          events[eventCount++] = {unit.handler, unit.handlerArg};
+        }
+      }
+    }
+  }
+  // The handlers run like ISRs, outside the driver's lock
+  for (int i = 0; i < eventCount; ++i) {
+    events[i].handler(events[i].arg);
+  }
+}
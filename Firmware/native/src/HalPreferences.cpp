@@ -0,0 +1,175 @@
+#include <Preferences.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "HalSim.h"
+
+namespace {
+// NVS keys and namespaces are limited to 15 characters on ESP32; the host enforces the same limit
+// so a key that would be rejected on the device is rejected here too.
+constexpr size_t NVS_KEY_NAME_MAX_SIZE = 16;
+
+std::mutex sNvsMutex;
+std::map<std::string, std::map<std::string, std::vector<uint8_t>>> sNvs;
+
+bool validName(const char* name) {
+  return name != nullptr && name[0] != '\0' && strlen(name) < NVS_KEY_NAME_MAX_SIZE;
+}
+}  // namespace
+
+bool Preferences::begin(const char* name, bool readOnly, const char* partitionLabel) {
+  (void)partitionLabel;
+  if (started_ || !validName(name)) {
+    return false;
+  }
+  strncpy(namespace_, name, sizeof(namespace_) - 1);
+  readOnly_ = readOnly;
+  started_ = true;
+  return true;
+}
+
+void Preferences::end() {
+  started_ = false;
+}
+
+bool Preferences::clear() {
+  if (!started_ || readOnly_) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(sNvsMutex);
+  sNvs[namespace_].clear();
+  return true;
+}
+
+bool Preferences::remove(const char* key) {
+  if (!started_ || readOnly_ || !validName(key)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(sNvsMutex);
+  return sNvs[namespace_].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+  if (!started_ || !validName(key)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(sNvsMutex);
+  const auto ns = sNvs.find(namespace_);
+  return ns != sNvs.end() && ns->second.count(key) > 0;
+}
+
+size_t Preferences::putRaw(const char* key, const void* value, size_t length) {
+  if (!started_ || readOnly_ || !validName(key)) {
+    return 0;
+  }
+  const uint8_t* bytes = static_cast<const uint8_t*>(value);
+  std::lock_guard<std::mutex> lock(sNvsMutex);
+  sNvs[namespace_][key].assign(bytes, bytes + length);
+  return length;
+}
+
+bool Preferences::getRaw(const char* key, void* buffer, size_t length) {
+  if (!started_ || !validName(key)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(sNvsMutex);
+  const auto ns = sNvs.find(namespace_);
+  if (ns == sNvs.end()) {
+    return false;
+  }
+  const auto entry = ns->second.find(key);
+  if (entry == ns->second.end() || entry->second.size() != length) {
+    return false;
+  }
+  memcpy(buffer, entry->second.data(), length);
+  return true;
+}
+
+size_t Preferences::putBool(const char* key, bool value) { return putUChar(key, value ? 1 : 0); }
+size_t Preferences::putUChar(const char* key, uint8_t value) { return putRaw(key, &value, sizeof(value)); }
+size_t Preferences::putUShort(const char* key, uint16_t value) { return putRaw(key, &value, sizeof(value)); }
+size_t Preferences::putInt(const char* key, int32_t value) { return putRaw(key, &value, sizeof(value)); }
+size_t Preferences::putUInt(const char* key, uint32_t value) { return putRaw(key, &value, sizeof(value)); }
+size_t Preferences::putLong(const char* key, int32_t value) { return putRaw(key, &value, sizeof(value)); }
+size_t Preferences::putULong(const char* key, uint32_t value) { return putRaw(key, &value, sizeof(value)); }
+size_t Preferences::putLong64(const char* key, int64_t value) { return putRaw(key, &value, sizeof(value)); }
+size_t Preferences::putULong64(const char* key, uint64_t value) { return putRaw(key, &value, sizeof(value)); }
+size_t Preferences::putFloat(const char* key, float value) { return putRaw(key, &value, sizeof(value)); }
+size_t Preferences::putString(const char* key, const char* value) {
+  return value != nullptr ? putRaw(key, value, strlen(value) + 1) : 0;
+}
+size_t Preferences::putString(const char* key, const String& value) { return putString(key, value.c_str()); }
+size_t Preferences::putBytes(const char* key, const void* value, size_t length) { return putRaw(key, value, length); }
+
+bool Preferences::getBool(const char* key, bool defaultValue) {
+  return getUChar(key, defaultValue ? 1 : 0) != 0;
+}
+
+#define HAL_PREFERENCES_GETTER(Name, Type)                      \
+  Type Preferences::Name(const char* key, Type defaultValue) {  \
+    Type value;                                                 \
+    return getRaw(key, &value, sizeof(value)) ? value : defaultValue; \
+  }
+
+HAL_PREFERENCES_GETTER(getUChar, uint8_t)
+HAL_PREFERENCES_GETTER(getUShort, uint16_t)
+HAL_PREFERENCES_GETTER(getInt, int32_t)
+HAL_PREFERENCES_GETTER(getUInt, uint32_t)
+HAL_PREFERENCES_GETTER(getLong, int32_t)
+HAL_PREFERENCES_GETTER(getULong, uint32_t)
+HAL_PREFERENCES_GETTER(getLong64, int64_t)
+HAL_PREFERENCES_GETTER(getULong64, uint64_t)
+HAL_PREFERENCES_GETTER(getFloat, float)
+
+#undef HAL_PREFERENCES_GETTER
+
+String Preferences::getString(const char* key, const String& defaultValue) {
+  const size_t length = getBytesLength(key);
+  if (length == 0) {
+    return defaultValue;
+  }
+  std::vector<char> buffer(length);
+  getBytes(key, buffer.data(), length);
+  buffer.back() = '\0';
+  return String(buffer.data());
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  if (!started_ || !validName(key)) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(sNvsMutex);
+  const auto ns = sNvs.find(namespace_);
+  if (ns == sNvs.end()) {
+    return 0;
+  }
+  const auto entry = ns->second.find(key);
+  return entry == ns->second.end() ? 0 : entry->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t maxLength) {
+  if (!started_ || !validName(key) || buffer == nullptr) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(sNvsMutex);
+  const auto ns = sNvs.find(namespace_);
+  if (ns == sNvs.end()) {
+    return 0;
+  }
+  const auto entry = ns->second.find(key);
+  if (entry == ns->second.end() || entry->second.size() > maxLength) {
+    return 0;
+  }
+  memcpy(buffer, entry->second.data(), entry->second.size());
+  return entry->second.size();
+}
+
+namespace HalSim {
+void clearNvs() {
+  std::lock_guard<std::mutex> lock(sNvsMutex);
+  sNvs.clear();
+}
+}  // namespace HalSim
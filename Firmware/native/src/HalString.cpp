@@ -0,0 +1,118 @@
+#include <Arduino.h>
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+std::string String::formatInteger(long long value, unsigned char base) {
+  if (base == 10) {
+    return std::to_string(value);
+  }
+  if (value >= 0) {
+    return formatInteger(static_cast<unsigned long long>(value), base);
+  }
+  // Arduino prints negative numbers in other bases as their 32-bit two's complement.
+  return formatInteger(static_cast<unsigned long long>(static_cast<uint32_t>(value)), base);
+}
+
+std::string String::formatInteger(unsigned long long value, unsigned char base) {
+  if (base < 2 || base > 36) {
+    base = 10;
+  }
+  if (value == 0) {
+    return "0";
+  }
+  std::string digits;
+  while (value > 0) {
+    const unsigned digit = static_cast<unsigned>(value % base);
+    digits.insert(digits.begin(), static_cast<char>(digit < 10 ? '0' + digit : 'A' + digit - 10));
+    value /= base;
+  }
+  return digits;
+}
+
+std::string String::formatFloat(double value, unsigned char decimalPlaces) {
+  if (std::isnan(value)) {
+    return "nan";
+  }
+  if (std::isinf(value)) {
+    return "inf";
+  }
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", static_cast<int>(decimalPlaces), value);
+  return buffer;
+}
+
+bool String::equalsIgnoreCase(const String& other) const {
+  if (value_.size() != other.value_.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < value_.size(); ++i) {
+    if (std::tolower(static_cast<unsigned char>(value_[i])) !=
+        std::tolower(static_cast<unsigned char>(other.value_[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool String::startsWith(const String& prefix) const {
+  return value_.compare(0, prefix.value_.size(), prefix.value_) == 0;
+}
+
+bool String::endsWith(const String& suffix) const {
+  if (suffix.value_.size() > value_.size()) {
+    return false;
+  }
+  return value_.compare(value_.size() - suffix.value_.size(), suffix.value_.size(), suffix.value_) == 0;
+}
+
+int String::indexOf(char c, unsigned int fromIndex) const {
+  const size_t pos = value_.find(c, fromIndex);
+  return pos == std::string::npos ? -1 : static_cast<int>(pos);
+}
+
+int String::indexOf(const String& text, unsigned int fromIndex) const {
+  const size_t pos = value_.find(text.value_, fromIndex);
+  return pos == std::string::npos ? -1 : static_cast<int>(pos);
+}
+
+String String::substring(unsigned int beginIndex) const {
+  return substring(beginIndex, length());
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+  if (beginIndex > endIndex) {
+    const unsigned int tmp = beginIndex;
+    beginIndex = endIndex;
+    endIndex = tmp;
+  }
+  if (beginIndex >= value_.size()) {
+    return String();
+  }
+  if (endIndex > value_.size()) {
+    endIndex = static_cast<unsigned int>(value_.size());
+  }
+  return String(value_.substr(beginIndex, endIndex - beginIndex).c_str());
+}
+
+void String::trim() {
+  size_t begin = 0;
+  while (begin < value_.size() && std::isspace(static_cast<unsigned char>(value_[begin]))) {
+    ++begin;
+  }
+  size_t end = value_.size();
+  while (end > begin && std::isspace(static_cast<unsigned char>(value_[end - 1]))) {
+    --end;
+  }
+  value_ = value_.substr(begin, end - begin);
+}
+
+long String::toInt() const {
+  return std::strtol(value_.c_str(), nullptr, 10);
+}
+
+float String::toFloat() const {
+  return std::strtof(value_.c_str(), nullptr);
+}
@@ -0,0 +1,99 @@
+/*
+ * Host stand-ins for the firmware modules that are not built for env:native (OTA, Tesla Owner API
+ * and Google Sheets uploads). They keep the same signatures as the device implementations and
+ * report success, so the charging session state machine and the pulse task can be exercised
+ * without network services. HalSim::setTeslaTelemetry() makes the Tesla Owner API slow or fail.
+ * TeslaLog uploads are queued on the network worker as on the device.
+ */
+#include <Arduino.h>
+
+#include <atomic>
+
+#include "HalSim.h"
+#include "OtaService.h"
+#include "TeslaApi.h"
+#include "TeslaSheets.h"
+#include "WorkerPool.h"
+
+void otaInit() {
+}
+
+void otaHandle() {
+}
+
+bool isOtaInProgress() {
+  return false;
+}
+
+namespace {
+std::atomic<uint32_t> sTeslaLatencyMs{0};
+std::atomic<bool> sTeslaSucceeds{true};
+std::atomic<uint32_t> sTelemetryRequests{0};
+std::atomic<uint32_t> sTeslaLogUploads{0};
+std::atomic<uint32_t> sTeslaDataUploads{0};
+
+struct TeslaTelemetryJob {
+  TaskParams_t* params;
+  float energyKwh;
+};
+
+void runTeslaTelemetryJob(const void* payload) {
+  const TeslaTelemetryJob* job = static_cast<const TeslaTelemetryJob*>(payload);
+  sendTeslaTelemetryToGoogleSheets(job->params, job->energyKwh, "");
+}
+}  // namespace
+
+void HalSim::setTeslaTelemetry(uint32_t latencyMs, bool succeeds) {
+  sTeslaLatencyMs = latencyMs;
+  sTeslaSucceeds = succeeds;
+}
+
+HalSim::TeslaStats HalSim::teslaStats() {
+  return TeslaStats{sTelemetryRequests, sTeslaLogUploads, sTeslaDataUploads};
+}
+
+bool teslaGetTelemetry(TeslaTelemetry* outTelemetry, String* errorMessage) {
+  sTelemetryRequests++;
+  delay(sTeslaLatencyMs);
+  if (outTelemetry == nullptr) {
+    return false;
+  }
+  if (!sTeslaSucceeds) {
+    if (errorMessage != nullptr) {
+      *errorMessage = "simulated failure";
+    }
+    return false;
+  }
+  outTelemetry->estimatedBatteryRangeMiles = 150.0f;
+  outTelemetry->batteryLevelPercent = 60.0f;
+  outTelemetry->odometerMiles = 10000.0f;
+  outTelemetry->latitude = 0.0;
+  outTelemetry->longitude = 0.0;
+  outTelemetry->isValid = true;
+  return true;
+}
+
+bool sendTeslaPayloadToGoogleSheets(TaskParams_t* params, TeslaSheetTarget target, const char* payload) {
+  (void)params;
+  (void)payload;
+  (target == TeslaSheetTarget::TeslaData ? sTeslaDataUploads : sTeslaLogUploads)++;
+  return true;
+}
+
+bool sendTeslaTelemetryToGoogleSheets(TaskParams_t* params, float energyKwh, const char* comment) {
+  (void)params;
+  (void)energyKwh;
+  (void)comment;
+  TeslaTelemetry telemetry;
+  if (!teslaGetTelemetry(&telemetry, nullptr)) {
+    return false;
+  }
+  sTeslaLogUploads++;
+  return true;
+}
+
+bool passTeslaTelemetryToGoogleSheets(TaskParams_t* params, float energyKwh, const char* comment) {
+  (void)comment;
+  TeslaTelemetryJob job = {params, energyKwh};
+  return submitWorkerJob(WORKER_JOB_TESLA_TELEMETRY, runTeslaTelemetryJob, job);
+}
@@ -0,0 +1,238 @@
+#include "LegacyReference.h"
+
+#include <cstring>
+
+#include "EnergyMath.h"
+#include "globals.h"
+
+namespace LegacyReference {
+
+size_t stateJson(const double values[4], char* payload, size_t payloadSize) {
+  JsonDocument doc;
+  doc[MQTT_SENSOR_POWER_ENTITYNAME] = values[0];
+  doc[MQTT_SENSOR_INSTANT_POWER_ENTITYNAME] = values[1];
+  doc[MQTT_NUMBER_ENERGY_ENTITYNAME] = values[2];
+  doc[MQTT_SENSOR_ENERGY_ENTITYNAME] = values[3];
+  return serializeJson(doc, payload, payloadSize);
+}
+
+MqttDiscoveryDevice discoveryDevice(uint64_t mac, DiscoveryDeviceTopics* t) {
+  snprintf(t->name, sizeof(t->name), "%s%012llX", MQTT_DEVICE_NAME, (unsigned long long)(mac & 0xFFFFFFFFFFFFULL));
+  snprintf(t->stateTopic, sizeof(t->stateTopic), "%s%s/%s%s", MQTT_DISCOVERY_PREFIX, t->name, MQTT_PREFIX, MQTT_SUFFIX_STATE);
+  snprintf(t->availabilityTopic, sizeof(t->availabilityTopic), "%s%s%s", MQTT_PREFIX, t->name, MQTT_ONLINE);
+  snprintf(t->commandTopic, sizeof(t->commandTopic), "%s%s%s", MQTT_PREFIX, t->name, MQTT_SUFFIX_SET);
+  return {t->name, MQTT_HA_CARD_NAME, t->stateTopic, t->availabilityTopic, t->commandTopic};
+}
+
+size_t discoveryConfig(const MqttDiscoveryEntity& entity, const MqttDiscoveryDevice& device, String* topic,
+                       char* payload, size_t payloadSize) {
+  const String component = entity.component;
+  const String entityName = entity.name;
+  const String deviceClass = entity.deviceClass;
+  const String objectId = strcmp(entity.objectId, entity.deviceClass) == 0 ? "" : entity.objectId;
+  const String deviceName = device.name;
+  JsonDocument doc;
+  if (component == MQTT_NUMBER_COMPONENT && deviceClass == MQTT_ENERGY_DEVICECLASS) {
+    doc["command_topic"] = device.commandTopic;
+    doc["command_template"] = String("{\"" + entityName + "\": {{ value }} }");
+    doc["max"] = 99999.99;
+    doc["min"] = 0.0;
+    doc["step"] = 0.01;
+  }
+  doc["name"] = entityName;
+  doc["state_topic"] = device.stateTopic;
+  doc["availability_topic"] = device.availabilityTopic;
+  doc["payload_available"] = "True";
+  doc["payload_not_available"] = "False";
+  doc["device_class"] = deviceClass;
+  doc["unit_of_measurement"] = String(entity.unit);
+  doc["unique_id"] = String(entityName + "_" + deviceName);
+  doc["qos"] = 0;
+  if (component == MQTT_SENSOR_COMPONENT && deviceClass == MQTT_POWER_DEVICECLASS)
+    doc["value_template"] = String("{{ value_json." + entityName + "}}");
+  else
+    doc["value_template"] = String("{{ value_json." + entityName + " | round(2)}}");
+  JsonObject deviceObject = doc["device"].to<JsonObject>();
+  deviceObject["identifiers"][0] = deviceName;
+  deviceObject["name"] = device.cardName;
+  *topic = String(MQTT_DISCOVERY_PREFIX) + component + "/" + deviceName + "/" + (objectId.length() > 0 ? objectId : deviceClass) + "/config";
+  return serializeJson(doc, payload, payloadSize);
+}
+
+bool SetOutcome::operator==(const SetOutcome& other) const {
+  return rejected == other.rejected && handlerCalls == other.handlerCalls && totals == other.totals &&
+         totalMilliWh == other.totalMilliWh && subtotalResets == other.subtotalResets &&
+         smartCharging == other.smartCharging && smartChargingInvalid == other.smartChargingInvalid &&
+         chargingStartTime == other.chargingStartTime && maxPriceSet == other.maxPriceSet &&
+         (maxPrice == other.maxPrice || (maxPrice != maxPrice && other.maxPrice != other.maxPrice)) &&
+         priceLimitSet == other.priceLimitSet &&
+         (priceLimit == other.priceLimit || (priceLimit != priceLimit && other.priceLimit != other.priceLimit)) &&
+         reset == other.reset;
+}
+
+std::string describeSetOutcome(const SetOutcome& o) {
+  char text[256];
+  snprintf(text, sizeof(text), "%s calls=%u total=%u/%llu subtotal=%u smart=%d/%u start='%s' max=%d/%g limit=%d/%g reset=%d",
+           o.rejected ? "rejected" : "accepted", (unsigned)o.handlerCalls, (unsigned)o.totals,
+           (unsigned long long)o.totalMilliWh, (unsigned)o.subtotalResets, o.smartCharging, (unsigned)o.smartChargingInvalid,
+           o.chargingStartTime.c_str(), o.maxPriceSet, o.maxPrice, o.priceLimitSet, o.priceLimit, o.reset);
+  return text;
+}
+
+namespace {
+SetOutcome sSetOutcome;
+
+uint64_t setEnergyMilliWh(double kWh) {
+  return kWh > 0.0 ? static_cast<uint64_t>(kWh * static_cast<double>(MILLI_WH_PER_KWH) + 0.5) : 0;
+}
+
+void recordStartTime(SetOutcome& outcome, const char* text) {
+  char startTime[sizeof(gChargingStartTime)];
+  strncpy(startTime, text, sizeof(startTime) - 1);
+  startTime[sizeof(startTime) - 1] = '\0';
+  outcome.chargingStartTime = startTime;
+}
+
+bool legacySetBool(const JsonVariantConst& value, bool& outValue) {
+  if (value.is<bool>()) {
+    outValue = value.as<bool>();
+    return true;
+  }
+  const char* text = value.as<const char*>();
+  if (text == nullptr) {
+    return false;
+  }
+  if (strcmp(text, "true") == 0 || strcmp(text, "True") == 0 ||
+      strcmp(text, "1") == 0 || strcmp(text, "on") == 0 || strcmp(text, "ON") == 0) {
+    outValue = true;
+    return true;
+  }
+  if (strcmp(text, "false") == 0 || strcmp(text, "False") == 0 ||
+      strcmp(text, "0") == 0 || strcmp(text, "off") == 0 || strcmp(text, "OFF") == 0) {
+    outValue = false;
+    return true;
+  }
+  return false;
+}
+}  // namespace
+
+SetOutcome legacySetDecode(const char* payload, size_t length) {
+  SetOutcome outcome;
+  JsonDocument doc;
+  if (deserializeJson(doc, payload, length)) {
+    outcome.rejected = true;
+    return outcome;
+  }
+  for (JsonPair kv : doc.as<JsonObject>()) {
+    const char* key = kv.key().c_str();
+    const char* valueText = kv.value().as<const char*>();
+    bool parsedBoolValue = false;
+    const bool hasBoolValue = legacySetBool(kv.value(), parsedBoolValue);
+    if (strcmp(key, MQTT_NUMBER_ENERGY_ENTITYNAME) == 0) {
+      outcome.handlerCalls++;
+      outcome.totals++;
+      outcome.totalMilliWh = setEnergyMilliWh(kv.value().as<double>());
+    } else if (strcmp(key, MQTT_SENSOR_ENERGY_ENTITYNAME) == 0) {
+      outcome.handlerCalls++;
+      outcome.subtotalResets += hasBoolValue && parsedBoolValue ? 1 : 0;
+    } else if (strcmp(key, MQTT_SMART_CHG) == 0) {
+      outcome.handlerCalls++;
+      if (hasBoolValue) {
+        outcome.smartCharging = parsedBoolValue ? 1 : 0;
+      } else {
+        outcome.smartChargingInvalid++;
+      }
+    } else if (strcmp(key, MQTT_CHG_START_TIME) == 0) {
+      outcome.handlerCalls++;
+      if (valueText) {
+        recordStartTime(outcome, valueText);
+      }
+    } else if (strcmp(key, MQTT_MAX_E_PRICE) == 0) {
+      outcome.handlerCalls++;
+      outcome.maxPriceSet = true;
+      outcome.maxPrice = kv.value().as<float>();
+    } else if (strcmp(key, MQTT_E_PRICE_LIMIT) == 0) {
+      outcome.handlerCalls++;
+      outcome.priceLimitSet = true;
+      outcome.priceLimit = kv.value().as<float>();
+    } else if (strcmp(key, MQTT_RESET_CMD) == 0) {
+      outcome.handlerCalls++;
+      if (valueText && strcmp(valueText, "soft") == 0) {
+        outcome.reset = 1;
+      } else if (valueText && strcmp(valueText, "hard") == 0) {
+        outcome.reset = 2;
+      }
+    }
+  }
+  return outcome;
+}
+
+void recordSetTotal(const MqttSetValue& value) {
+  sSetOutcome.handlerCalls++;
+  sSetOutcome.totals++;
+  sSetOutcome.totalMilliWh = setEnergyMilliWh(value.asDouble());
+}
+
+void recordSetSubtotal(const MqttSetValue& value) {
+  bool reset = false;
+  sSetOutcome.handlerCalls++;
+  sSetOutcome.subtotalResets += value.toBool(reset) && reset ? 1 : 0;
+}
+
+void recordSetSmartCharging(const MqttSetValue& value) {
+  bool activated = false;
+  sSetOutcome.handlerCalls++;
+  if (value.toBool(activated)) {
+    sSetOutcome.smartCharging = activated ? 1 : 0;
+  } else {
+    sSetOutcome.smartChargingInvalid++;
+  }
+}
+
+void recordSetStartTime(const MqttSetValue& value) {
+  sSetOutcome.handlerCalls++;
+  if (value.asText()) {
+    recordStartTime(sSetOutcome, value.asText());
+  }
+}
+
+void recordSetMaxPrice(const MqttSetValue& value) {
+  sSetOutcome.handlerCalls++;
+  sSetOutcome.maxPriceSet = true;
+  sSetOutcome.maxPrice = value.asFloat();
+}
+
+void recordSetPriceLimit(const MqttSetValue& value) {
+  sSetOutcome.handlerCalls++;
+  sSetOutcome.priceLimitSet = true;
+  sSetOutcome.priceLimit = value.asFloat();
+}
+
+void recordSetReset(const MqttSetValue& value) {
+  sSetOutcome.handlerCalls++;
+  sSetOutcome.reset = value.textEquals("soft") ? 1 : value.textEquals("hard") ? 2 : 0;
+}
+
+SetOutcome streamingSetDecode(const char* payload, size_t length, MqttSetError* error) {
+  sSetOutcome = SetOutcome();
+  const MqttSetError result = RecordingSetTable::dispatch(payload, length);
+  sSetOutcome.rejected = static_cast<bool>(result);
+  if (error != nullptr) {
+    *error = result;
+  }
+  return sSetOutcome;
+}
+
+const std::vector<std::string>& homeAssistantSetPayloads() {
+  static const std::vector<std::string> payloads = {
+    "{\"smartChg\": true, \"chgStartTime\": \"02:00\", \"currEPrice\": 1.02, \"ePriceLimit\": 1.5, \"maxEPrice\": 1.25}",
+    "{\"currEPrice\": 0.874}",
+    "{\"smartChg\": false}",
+    "{\"Total\": 12345.67 }",
+    "{\"Subtotal\": \"ON\"}",
+    "{\"reset\": \"soft\"}",
+  };
+  return payloads;
+}
+
+}  // namespace LegacyReference
@@ -0,0 +1,143 @@
+#include "NativeHarness.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "EnergyMath.h"
+#include "HalSim.h"
+#include "MqttClient.h"
+#include "MqttMessage.h"
+#include "WorkerPool.h"
+#include "config.h"
+
+namespace NativeHarness {
+
+TaskParams_t params;
+
+namespace {
+std::atomic<uint32_t> sMqttLoopMaxUs{0};
+std::atomic<double> sAcAmplitude{0.0};
+
+uint16_t acSineSource(int gpio, uint32_t nowUs) {
+  (void)gpio;
+  return static_cast<uint16_t>(lround(2048.0 + sAcAmplitude * sin(2.0 * AC_PI * AC_MAINS_HZ * nowUs * 1e-6)));
+}
+}  // namespace
+
+void networkTask(void* pvParameters) {
+  mqttInit(static_cast<TaskParams_t*>(pvParameters));
+  for (;;) {
+    const uint32_t loopStartUs = micros();
+    mqttLoop(static_cast<TaskParams_t*>(pvParameters));
+    const uint32_t loopUs = micros() - loopStartUs;
+    if (loopUs > sMqttLoopMaxUs) {
+      sMqttLoopMaxUs = loopUs;
+    }
+    vTaskDelay(pdMS_TO_TICKS(NETWORK_TICK_MS));
+  }
+}
+
+void loopTask(void* pvParameters) {
+  (void)pvParameters;
+  for (;;) {
+    mqttProcessRxQueue();
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+uint32_t mqttLoopMaxUs() {
+  return sMqttLoopMaxUs;
+}
+
+bool startNetwork() {
+  startWorkerPool();
+  xTaskCreate(networkTask, "NetworkTask", NETWORK_TASK_STACK_SIZE, &params, 1, nullptr);
+  return waitUntil([] { return gMqttConnected; }, MQTT_CONNECT_TIMEOUT_MS);
+}
+
+bool readConnectStats(ConnectStats* stats) {
+  char payload[MQTT_PAYLOAD_LEN];
+  if (!HalSim::lastPublished(mqttTopic(MQTT_TOPIC_LOG_MQTT_CONNECT), payload, sizeof(payload))) {
+    return false;
+  }
+  const char* text = strstr(payload, "attempts:");
+  return text != nullptr &&
+         sscanf(text, "attempts:%lu connects:%lu tcp_failures:%lu connack_failures:%lu timeouts:%lu last_error:%*d latency_ms:%lu",
+                &stats->attempts, &stats->connects, &stats->tcpFailures, &stats->connackFailures, &stats->timeouts,
+                &stats->latencyMs) == 6;
+}
+
+bool waitForConnect(unsigned long connects, uint32_t timeoutMs, ConnectStats* stats) {
+  return waitUntil([&] { return gMqttConnected && readConnectStats(stats) && stats->connects == connects; }, timeoutMs);
+}
+
+void dropMqttSession() {
+  HalSim::setMqttBrokerOnline(false);
+  HalSim::setMqttBrokerOnline(true);
+}
+
+bool deliverInbound(const std::vector<std::pair<std::string, std::string>>& messages) {
+  const uint32_t deliveredBefore = HalSim::mqttBrokerStats().delivered;
+  for (const std::pair<std::string, std::string>& message : messages) {
+    HalSim::injectMqttMessage(message.first.c_str(), message.second.c_str());
+  }
+  const bool delivered =
+      waitUntil([&] { return HalSim::mqttBrokerStats().delivered - deliveredBefore >= messages.size(); }, 1000);
+  delay(2 * NETWORK_TICK_MS); // Counted before the callbacks run
+  return delivered;
+}
+
+uint64_t nextRandom(uint64_t& state) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+double uniformRandom(uint64_t& state) {
+  return (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void randomEnergyState(uint64_t& randomState, uint32_t index, double values[4]) {
+  const uint32_t powerW = static_cast<uint32_t>(nextRandom(randomState) % (index % 7 == 0 ? 10 : 25000));
+  const uint32_t instantW = static_cast<uint32_t>(nextRandom(randomState) % 25000);
+  uint64_t energyMilliWh = nextRandom(randomState) % (index % 5 == 0 ? 20000000000000ULL : 100000000000ULL);
+  const uint64_t subtotalMilliWh =
+      index % 11 == 0 ? (energyMilliWh / 1000000) * 1000000 : nextRandom(randomState) % 1000000000ULL;
+  if (index % 13 == 0) {
+    energyMilliWh = 0;
+  }
+  values[0] = wattsToKw(powerW);
+  values[1] = wattsToKw(instantW);
+  values[2] = milliWhToKwh(energyMilliWh);
+  values[3] = milliWhToKwh(subtotalMilliWh);
+}
+
+void setAcSine(double amplitudeCounts) {
+  HalSim::setAnalogSource(CHARGING_ANALOG_GPIO, acSineSource);
+  sAcAmplitude = amplitudeCounts;
+}
+
+CtRecording makeCtRecording(uint64_t& randomState, double amplitude, double noise) {
+  CtRecording c;
+  c.mainsHz = (nextRandom(randomState) % 2 ? 60.0 : 50.0) + uniformRandom(randomState) - 0.5;
+  c.amplitude = amplitude;
+  c.noise = noise;
+  const double bias = 1900.0 + 300.0 * uniformRandom(randomState);
+  const double phase = 2.0 * AC_PI * uniformRandom(randomState);
+  c.samples.reserve(CT_RECORDING_SAMPLES);
+  for (uint32_t i = 0; i < CT_RECORDING_SAMPLES; ++i) {
+    // Box-Muller
+    const double gauss =
+        sqrt(-2.0 * log(1.0 - uniformRandom(randomState))) * cos(2.0 * AC_PI * uniformRandom(randomState));
+    const double value = bias + amplitude * sin(phase + 2.0 * AC_PI * c.mainsHz * i / CHARGING_AC_SAMPLE_RATE_HZ) +
+                         noise * gauss;
+    c.samples.push_back(static_cast<uint16_t>(std::min(4095.0, std::max(0.0, std::round(value)))));
+  }
+  return c;
+}
+
+}  // namespace NativeHarness
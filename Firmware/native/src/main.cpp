@@ -0,0 +1,644 @@
+/*
+ * Host harness for env:native: traces and benchmarks. The pass/fail checks of the firmware modules
+ * are the pio test suites in test/ (pio test -e native); the harness only measures and reports.
+ *
+ * Boots the same modules as the device (globals, pulse input task, MQTT client, OLED display and the
+ * charging session state machine) on top of the HAL simulation, fires a train of S0 pulses into
+ * PULSE_INPUT_GPIO and reports what the firmware did with them: ISR cost, pulses counted versus
+ * fired, pulse task CPU cost, energy snapshot, MQTT publishes, heap traffic and the ISR -> MQTT enqueue latency
+ * histogram per pulse. An interval of 0 fires the pulses back to back.
+ *
+ * The third argument selects the pulse counter backend (isr or pcnt) instead of PULSE_COUNTER_BACKEND.
+ *
+ * With --trace the harness instead replays a recorded pulse trace through PowerEstimator in every
+ * mode and prints one CSV row per line of the trace. A trace line is a micros() timestamp,
+ * optionally followed by the number of pulses it closes (PCNT polls); 0 pulses is a poll without a
+ * pulse and decays the readings. '#' starts a comment, and further columns (the readings
+ * test_power_estimator expects) are ignored. The meter constant is the configured one unless given
+ * after the file. native/traces/ holds recorded cases.
+ *
+ * --energy-math times the fixed-point energy and power math (EnergyMath.h) against the float math
+ * it replaced, and reports from which counter on the float path is off by a pulse.
+ *
+ * --mqtt-bench pushes a mix of energy states, log lines and discovery messages through the outbound
+ * ring (MqttRecordRing.h) and through the fixed 1 KB-slot FreeRTOS queue it replaced, and
+ * reports time, bytes copied and buffer memory per message.
+ *
+ * --state-json-bench serializes random energy states with MqttStateJson (MqttStateJson.h) and with
+ * the JsonDocument it replaced and compares time and heap allocations per state.
+ *
+ * --discovery-bench writes the Home Assistant discovery configurations of random device names with
+ * MqttDiscoveryTable (MqttDiscoveryJson.h) and with the JsonDocument and String code it replaced,
+ * and compares time, heap allocations and the longest topic and payload against the compile-time
+ * bounds.
+ *
+ * --set-bench decodes the /set payloads Home Assistant sends with MqttSetTable (MqttSetCommand.h)
+ * and with the JsonDocument and strcmp() chain it replaced, and compares time and heap allocations
+ * per payload.
+ *
+ * --rms-bench runs synthetic CT signals (49.5-50.5 and 59.5-60.5 Hz, random phase, bias and
+ * amplitude, with and without noise) through the integer AcRmsKernel (AcRms.h) and through the
+ * Welford loop over 100-sample windows it replaced, and compares their error against the true RMS,
+ * the mains frequency lock and the cost per sample.
+ *
+ *   pio run -e native && .pio/build/native/program [pulses] [interval_us] [isr|pcnt]
+ *   .pio/build/native/program --trace <file> [imp_per_kwh]
+ *   .pio/build/native/program --energy-math
+ *   .pio/build/native/program --mqtt-bench
+ *   .pio/build/native/program --state-json-bench [states]
+ *   .pio/build/native/program --discovery-bench [devices]
+ *   .pio/build/native/program --set-bench [payloads]
+ *   .pio/build/native/program --rms-bench [signals]
+ */
+#ifndef PIO_UNIT_TESTING  // pio test builds native/src with the test suites, which bring their own main()
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+
+#include "AcRms.h"
+#include "ChargingSession.h"
+#include "EnergyMath.h"
+#include "HalSim.h"
+#include "LegacyReference.h"
+#include "MqttClient.h"
+#include "MqttMessage.h"
+#include "MqttRecordRing.h"
+#include "MqttStateJson.h"
+#include "NativeHarness.h"
+#include "PowerEstimator.h"
+#include "PulseInputTask.h"
+#include "PulseLatency.h"
+#include "WorkerPool.h"
+#include "config.h"
+#include "globals.h"
+#include "oled_energy_display.h"
+
+using namespace NativeHarness;
+
+namespace {
+constexpr uint32_t DEFAULT_PULSE_COUNT = 1000;
+constexpr uint32_t DEFAULT_PULSE_INTERVAL_US = 2000;
+
+struct IsrCost {
+  uint64_t totalNs = 0;
+  uint64_t maxNs = 0;
+};
+
+// Fires the pulses at a fixed rate and times every ISR invocation. An interval of 0 fires them
+// back to back, which is the worst case for the ring between the ISR and PulseInputTask.
+IsrCost firePulses(uint32_t count, uint32_t intervalUs) {
+  IsrCost cost;
+  auto next = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < count; ++i) {
+    const auto isrStart = std::chrono::steady_clock::now();
+    HalSim::triggerInterrupt(PULSE_INPUT_GPIO);
+    const uint64_t isrNs = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - isrStart).count());
+    cost.totalNs += isrNs;
+    cost.maxNs = std::max(cost.maxNs, isrNs);
+    if (intervalUs > 0) {
+      next += std::chrono::microseconds(intervalUs);
+      std::this_thread::sleep_until(next);
+    }
+  }
+  return cost;
+}
+
+// Replays a pulse trace through one PowerEstimator per mode, calibrated like PulseInputTask.
+int replayPowerTrace(const char* path) {
+  FILE* trace = fopen(path, "r");
+  if (!trace) {
+    printf("Cannot open trace %s\n", path);
+    return 1;
+  }
+
+  PowerEstimator estimators[] = {
+      PowerEstimator(POWER_MODE_SINGLE, POWER_WINDOW_PULSES, POWER_WINDOW_MS, POWER_EWMA_TAU_MS),
+      PowerEstimator(POWER_MODE_PULSE_WINDOW, POWER_WINDOW_PULSES, POWER_WINDOW_MS, POWER_EWMA_TAU_MS),
+      PowerEstimator(POWER_MODE_TIME_WINDOW, POWER_WINDOW_PULSES, POWER_WINDOW_MS, POWER_EWMA_TAU_MS),
+      PowerEstimator(POWER_MODE_EWMA, POWER_WINDOW_PULSES, POWER_WINDOW_MS, POWER_EWMA_TAU_MS),
+  };
+  printf("timestamp_us,pulses,instant_w");
+  for (PowerEstimator& estimator : estimators) {
+    estimator.setCalibration(params.pulse_per_kWh, params.ptCorrection);
+    printf(",%s_w", powerEstimatorModeName(estimator.mode()));
+  }
+  printf("\n");
+
+  char line[64];
+  bool lineStart = true;
+  bool comment = false;
+  while (fgets(line, sizeof(line), trace)) {
+    // A comment may be longer than the buffer; its remainder comes back from fgets() in pieces
+    comment = lineStart ? line[0] == '#' : comment;
+    lineStart = strchr(line, '\n') != nullptr;
+    unsigned long timestampUs = 0;
+    unsigned long pulses = 1;
+    if (comment || sscanf(line, "%lu %lu", &timestampUs, &pulses) < 1) {
+      continue;
+    }
+    for (PowerEstimator& estimator : estimators) {
+      if (pulses == 0) {
+        estimator.decay(static_cast<uint32_t>(timestampUs));
+      } else {
+        estimator.addPulses(static_cast<uint32_t>(pulses), static_cast<uint32_t>(timestampUs));
+      }
+    }
+    printf("%lu,%lu,%u", timestampUs, pulses, (unsigned)estimators[0].instantW());
+    for (const PowerEstimator& estimator : estimators) {
+      printf(",%u", (unsigned)estimator.smoothedW());
+    }
+    printf("\n");
+  }
+  fclose(trace);
+  return 0;
+}
+
+void benchmarkEnergyMath() {
+  const uint16_t meterConstants[] = {100, 500, 800, 1000, 1600, 10000};
+  const uint32_t ptCorrectionUs = 0;
+
+  // Old path: float kWh. It is wrong once it is off by half a pulse or more.
+  for (uint16_t pulsePerKWh : meterConstants) {
+    const uint64_t maxPulses = (UINT64_MAX / MILLI_WH_PER_KWH) * pulsePerKWh;
+    uint64_t firstFloatMiss = 0;
+    for (uint64_t power = 1; power != 0 && power <= maxPulses && firstFloatMiss == 0; power <<= 1) {
+      for (uint64_t pulses = power - 1; pulses <= power + 1 && firstFloatMiss == 0; ++pulses) {
+        const double floatKwh = static_cast<float>(pulses) / static_cast<float>(pulsePerKWh);
+        if (std::fabs(floatKwh * pulsePerKWh - static_cast<double>(pulses)) >= 0.5) {
+          firstFloatMiss = pulses;
+        }
+      }
+    }
+    printf("energy %5u imp/kWh : exact up to %llu pulses; float path first off by a pulse at %llu pulses (%.0f kWh)\n",
+           (unsigned)pulsePerKWh, (unsigned long long)maxPulses, (unsigned long long)firstFloatMiss,
+           static_cast<double>(firstFloatMiss) / pulsePerKWh);
+  }
+
+  // Per-pulse cost of the two paths: energy of the counter plus power of the last interval
+  constexpr uint32_t ITERATIONS = 10000000;
+  const uint16_t pulsePerKWh = 10000;
+  volatile uint64_t integerSink = 0;
+  volatile float floatSink = 0.0f;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < ITERATIONS; ++i) {
+    const uint32_t deltaUs = 360000 + (i & 1023);
+    floatSink = floatSink + static_cast<float>(i) / static_cast<float>(pulsePerKWh) +
+                round((static_cast<float>(60 * 60 * 1000) / static_cast<float>(deltaUs + ptCorrectionUs)) /
+                      static_cast<float>(pulsePerKWh) * 1000);
+  }
+  const double floatNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < ITERATIONS; ++i) {
+    const uint32_t deltaUs = 360000 + (i & 1023);
+    integerSink = integerSink + pulsesToMilliWh(i, pulsePerKWh) + pulseSpanToWatts(deltaUs, 1, pulsePerKWh, ptCorrectionUs);
+  }
+  const double integerNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+  printf("cost per pulse      : float %.1f ns, fixed-point %.1f ns (host)\n", floatNs, integerNs);
+}
+
+
+// The outbound message before MqttRecordRing: one fixed slot per queued publish
+struct LegacyMqttMessage {
+  char topic[MQTT_TOPIC_LEN];
+  char payload[MQTT_PAYLOAD_LEN];
+  bool retain;
+};
+constexpr uint32_t LEGACY_MQTT_QUEUE_DEPTH = 10;
+constexpr uint32_t BENCH_RING_BYTES = 8192;
+
+void benchmarkMqttOutbound() {
+  struct BenchMessage {
+    const char* topic;
+    std::string payload;
+  };
+  const BenchMessage messages[] = {
+      {"homeassistant/sensor/esp32-doit_246F28AABBCC/state",
+       "{\"Forbrug\":3.452,\"Momentan\":3.460,\"Total\":12345.678,\"Subtotal\":42.100}"},
+      {"ev-e-monitor/esp32-doit_246F28AABBCC/log/status",
+       "2026-10-17 12:00:00 - Charging session started, price limit 2.10 DKK/kWh"},
+      {"homeassistant/sensor/esp32-doit_246F28AABBCC/power/config", std::string(640, 'd')},
+  };
+  constexpr uint32_t MESSAGES = 300000;
+  constexpr uint32_t BURST = 8;  // Messages queued before the consumer drains them
+  static MqttRecordRing<BENCH_RING_BYTES> ring;
+  uint64_t payloadBytes = 0;
+  volatile uint32_t sink = 0;
+
+  QueueHandle_t queue = xQueueCreate(LEGACY_MQTT_QUEUE_DEPTH, sizeof(LegacyMqttMessage));
+  uint64_t legacyCopied = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < MESSAGES; i += BURST) {
+    for (uint32_t j = 0; j < BURST; ++j) {
+      const BenchMessage& message = messages[(i + j) % 3];
+      LegacyMqttMessage msg{};
+      strncpy(msg.topic, message.topic, MQTT_TOPIC_LEN - 1);
+      strncpy(msg.payload, message.payload.c_str(), MQTT_PAYLOAD_LEN - 1);
+      msg.retain = true;
+      xQueueSend(queue, &msg, 0);
+      legacyCopied += 3 * sizeof(LegacyMqttMessage);  // Zeroed, filled (strncpy pads), copied into the queue
+      payloadBytes += message.payload.size();
+    }
+    LegacyMqttMessage msg;
+    while (xQueueReceive(queue, &msg, 0) == pdTRUE) {
+      legacyCopied += sizeof(LegacyMqttMessage);
+      sink = sink + msg.payload[0];
+    }
+  }
+  const double legacyNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / MESSAGES;
+  vQueueDelete(queue);
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < MESSAGES; i += BURST) {
+    for (uint32_t j = 0; j < BURST; ++j) {
+      const BenchMessage& message = messages[(i + j) % 3];
+      ring.push(message.topic, strnlen(message.topic, MQTT_TOPIC_LEN - 1),
+                message.payload.c_str(), strnlen(message.payload.c_str(), MQTT_PAYLOAD_LEN - 1), true);
+    }
+    MqttRecordRing<BENCH_RING_BYTES>::Record record;
+    while (ring.peek(&record)) {
+      sink = sink + record.payload[0];
+      ring.release();
+    }
+  }
+  const double ringNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / MESSAGES;
+  const MqttRecordRing<BENCH_RING_BYTES>::Stats stats = ring.stats();
+
+  printf("mqtt outbound bench : %u messages in bursts of %u, %.0f payload bytes avg\n",
+         (unsigned)MESSAGES, (unsigned)BURST, static_cast<double>(payloadBytes) / MESSAGES);
+  printf("  queue (legacy)    : %.0f ns/msg, %.0f bytes copied/msg, %u bytes heap for %u messages\n",
+         legacyNs, static_cast<double>(legacyCopied) / MESSAGES,
+         (unsigned)(LEGACY_MQTT_QUEUE_DEPTH * sizeof(LegacyMqttMessage)), (unsigned)LEGACY_MQTT_QUEUE_DEPTH);
+  printf("  outbound ring     : %.0f ns/msg, %.0f bytes copied/msg, %u bytes static, peak %u bytes, %u dropped\n",
+         ringNs, static_cast<double>(stats.copiedBytes) / MESSAGES,
+         (unsigned)ring.capacity(), (unsigned)stats.peakUsedBytes, (unsigned)stats.dropped);
+  for (const BenchMessage& message : messages) {
+    printf("  %4u byte payload : %u bytes in the ring, %u in the queue\n", (unsigned)message.payload.size(),
+           (unsigned)ring.recordSize(strlen(message.topic), message.payload.size()), (unsigned)sizeof(LegacyMqttMessage));
+  }
+}
+
+void benchmarkStateJson(uint32_t states) {
+  typedef MqttStateJson<MQTT_SENSOR_POWER_ENTITYNAME, MQTT_SENSOR_INSTANT_POWER_ENTITYNAME,
+                        MQTT_NUMBER_ENERGY_ENTITYNAME, MQTT_SENSOR_ENERGY_ENTITYNAME> EnergyStateJson;
+  uint64_t randomState = 0x5EEDC0DEULL;
+  std::vector<std::array<double, 4>> values(states);
+  uint32_t fallbacks = 0;
+  for (uint32_t i = 0; i < states; ++i) {
+    randomEnergyState(randomState, i, values[i].data());
+    const double state[EnergyStateJson::KEY_COUNT] = {values[i][0], values[i][1], values[i][2], values[i][3]};
+    fallbacks += EnergyStateJson::fits(state) ? 0 : 1;
+  }
+
+  volatile uint32_t sink = 0;
+  HalSim::AllocationStats heapBefore = HalSim::allocationStats();
+  auto start = std::chrono::steady_clock::now();
+  for (const std::array<double, 4>& v : values) {
+    char payload[256];
+    sink = sink + static_cast<uint32_t>(LegacyReference::stateJson(v.data(), payload, sizeof(payload)));
+  }
+  const double documentNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / states;
+  const uint64_t documentAllocations = HalSim::allocationStats().allocations - heapBefore.allocations;
+
+  heapBefore = HalSim::allocationStats();
+  start = std::chrono::steady_clock::now();
+  for (const std::array<double, 4>& v : values) {
+    const double state[EnergyStateJson::KEY_COUNT] = {v[0], v[1], v[2], v[3]};
+    char payload[EnergyStateJson::MAX_LENGTH + 1];
+    if (EnergyStateJson::fits(state)) {
+      sink = sink + static_cast<uint32_t>(EnergyStateJson::write(payload, state));
+    }
+  }
+  const double writerNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / states;
+  const uint64_t writerAllocations = HalSim::allocationStats().allocations - heapBefore.allocations;
+
+  printf("state json bench    : %u states, %u in exponent range (JsonDocument fallback), max %u bytes\n",
+         (unsigned)states, (unsigned)fallbacks, (unsigned)EnergyStateJson::MAX_LENGTH);
+  printf("  JsonDocument      : %.0f ns/state, %.1f heap allocations/state\n", documentNs,
+         static_cast<double>(documentAllocations) / states);
+  printf("  MqttStateJson     : %.0f ns/state, %.1f heap allocations/state\n", writerNs,
+         static_cast<double>(writerAllocations) / states);
+}
+
+void benchmarkDiscoveryJson(uint32_t devices) {
+  typedef LegacyReference::DiscoveryTable DiscoveryTable;
+  uint64_t randomState = 0xD15C0FE7ULL;
+  std::vector<LegacyReference::DiscoveryDeviceTopics> topics(devices);
+  std::vector<MqttDiscoveryDevice> deviceList(devices);
+  for (uint32_t i = 0; i < devices; ++i) {
+    deviceList[i] = LegacyReference::discoveryDevice(nextRandom(randomState), &topics[i]);
+  }
+
+  volatile uint32_t sink = 0;
+  HalSim::AllocationStats heapBefore = HalSim::allocationStats();
+  auto start = std::chrono::steady_clock::now();
+  for (const MqttDiscoveryDevice& device : deviceList) {
+    for (size_t e = 0; e < DiscoveryTable::COUNT; ++e) {
+      String topic;
+      char payload[MQTT_PAYLOAD_LEN];
+      sink = sink + static_cast<uint32_t>(
+                        LegacyReference::discoveryConfig(LegacyReference::kDiscoveryEntities[e], device, &topic, payload, sizeof(payload)));
+    }
+  }
+  const double documentNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / devices;
+  const uint64_t documentAllocations = HalSim::allocationStats().allocations - heapBefore.allocations;
+
+  size_t longestTopic = 0;
+  size_t longestPayload = 0;
+  heapBefore = HalSim::allocationStats();
+  start = std::chrono::steady_clock::now();
+  for (const MqttDiscoveryDevice& device : deviceList) {
+    for (size_t e = 0; e < DiscoveryTable::COUNT; ++e) {
+      char topic[DiscoveryTable::MAX_TOPIC_LENGTH + 1];
+      char payload[DiscoveryTable::MAX_PAYLOAD_LENGTH + 1];
+      const size_t topicLength = DiscoveryTable::writeTopic(topic, e, device.name);
+      const size_t payloadLength = DiscoveryTable::writePayload(payload, e, device);
+      longestTopic = std::max(longestTopic, topicLength);
+      longestPayload = std::max(longestPayload, payloadLength);
+    }
+  }
+  const double tableNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / devices;
+  const uint64_t tableAllocations = HalSim::allocationStats().allocations - heapBefore.allocations;
+
+  printf("discovery json bench: %u devices x %u entities, longest topic %u (bound %u), payload %u (bound %u), cache %u bytes\n",
+         (unsigned)devices, (unsigned)DiscoveryTable::COUNT, (unsigned)longestTopic, (unsigned)DiscoveryTable::MAX_TOPIC_LENGTH,
+         (unsigned)longestPayload, (unsigned)DiscoveryTable::MAX_PAYLOAD_LENGTH, (unsigned)DiscoveryTable::TOTAL_LENGTH);
+  printf("  JsonDocument      : %.0f ns/device, %.1f heap allocations/device\n", documentNs,
+         static_cast<double>(documentAllocations) / devices);
+  printf("  MqttDiscoveryJson : %.0f ns/device, %.1f heap allocations/device\n", tableNs,
+         static_cast<double>(tableAllocations) / devices);
+}
+
+void benchmarkSetCommands(uint32_t rounds) {
+  typedef LegacyReference::RecordingSetTable RecordingSetTable;
+  const std::vector<std::string>& payloads = LegacyReference::homeAssistantSetPayloads();
+
+  volatile uint32_t sink = 0;
+  size_t payloadBytes = 0;
+  HalSim::AllocationStats heapBefore = HalSim::allocationStats();
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < rounds; ++i) {
+    const std::string& payload = payloads[i % payloads.size()];
+    payloadBytes += payload.size();
+    sink = sink + LegacyReference::legacySetDecode(payload.data(), payload.size()).handlerCalls;
+  }
+  const double documentNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+  const uint64_t documentAllocations = HalSim::allocationStats().allocations - heapBefore.allocations;
+
+  heapBefore = HalSim::allocationStats();
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < rounds; ++i) {
+    const std::string& payload = payloads[i % payloads.size()];
+    sink = sink + RecordingSetTable::dispatch(payload.data(), payload.size()).code();
+  }
+  const double tableNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+  const uint64_t tableAllocations = HalSim::allocationStats().allocations - heapBefore.allocations;
+
+  printf("set command bench   : %u payloads, %.0f bytes avg, %u commands in %u slots (seed %u)\n", (unsigned)rounds,
+         static_cast<double>(payloadBytes) / rounds, (unsigned)MQTT_SET_COMMAND_COUNT(LegacyReference::kRecordingSetCommands),
+         (unsigned)RecordingSetTable::SLOT_COUNT, (unsigned)RecordingSetTable::SEED);
+  printf("  JsonDocument      : %.0f ns/payload, %.1f heap allocations/payload\n", documentNs,
+         static_cast<double>(documentAllocations) / rounds);
+  printf("  MqttSetTable      : %.0f ns/payload, %.1f heap allocations/payload, %u bytes parser state\n", tableNs,
+         static_cast<double>(tableAllocations) / rounds, (unsigned)sizeof(MqttSetParser));
+}
+
+void benchmarkAcRms(uint32_t cases) {
+  uint64_t randomState = 0x5ca1ab1e0ddba11ULL;
+  std::vector<CtRecording> signals;
+  // Even cases: 12-bit rounding only, so the error is the window's alignment to the mains phase.
+  // Odd cases: ADC noise too, whose RMS over a 100 ms window scatters for any estimator.
+  for (uint32_t i = 0; i < cases; ++i) {
+    signals.push_back(makeCtRecording(randomState, 30.0 + 1470.0 * uniformRandom(randomState),
+                                       i % 2 ? 8.0 * uniformRandom(randomState) : 0.0));
+  }
+
+  // Accuracy against the RMS the CT actually delivers (sine, noise and 12-bit rounding)
+  RmsErrors welford[2];
+  RmsErrors kernel[2];
+  uint64_t lockedWindows = 0;
+  uint64_t lockCandidates = 0;
+  double maxFrequencyError = 0.0;
+  for (uint32_t i = 0; i < cases; ++i) {
+    const CtRecording& c = signals[i];
+    const double expected = sqrt(c.amplitude * c.amplitude / 2.0 + c.noise * c.noise + 1.0 / 12.0);
+    LegacyReference::welfordFrames(c.samples, [&](double rms) { welford[i % 2].add(rms, expected); });
+    AcRmsKernel rms(CHARGING_AC_SAMPLE_RATE_HZ, CHARGING_AC_WINDOW_MS, CHARGING_AC_ZERO_CROSS_HYSTERESIS);
+    AcRmsWindow window;
+    for (uint32_t s = 0; s < c.samples.size(); ++s) {
+      if (rms.push(c.samples[s], &window) && s >= CT_RECORDING_SETTLE) {
+        kernel[i % 2].add(window.rmsMilliCounts / 1000.0, expected);
+        lockCandidates++;
+        lockedWindows += window.locked ? 1 : 0;
+        if (window.locked && c.noise == 0.0) {
+          maxFrequencyError = std::max(maxFrequencyError, fabs(window.mainsCentiHz / 100.0 - c.mainsHz));
+        }
+      }
+    }
+  }
+
+  // No current: both should report the noise
+  RmsErrors welfordNoise;
+  RmsErrors kernelNoise;
+  uint64_t noiseLocked = 0;
+  for (uint32_t i = 0; i < 20; ++i) {
+    const CtRecording c = makeCtRecording(randomState, 0.0, 1.0 + 3.0 * uniformRandom(randomState));
+    const double expected = sqrt(c.noise * c.noise + 1.0 / 12.0);
+    LegacyReference::welfordFrames(c.samples, [&](double rms) { welfordNoise.add(rms, expected); });
+    AcRmsKernel rms(CHARGING_AC_SAMPLE_RATE_HZ, CHARGING_AC_WINDOW_MS, CHARGING_AC_ZERO_CROSS_HYSTERESIS);
+    AcRmsWindow window;
+    for (uint32_t s = 0; s < c.samples.size(); ++s) {
+      if (rms.push(c.samples[s], &window) && s >= CT_RECORDING_SETTLE) {
+        kernelNoise.add(window.rmsMilliCounts / 1000.0, expected);
+        noiseLocked += window.locked ? 1 : 0;
+      }
+    }
+  }
+
+  // Cost per sample
+  volatile double welfordSink = 0.0;
+  auto start = std::chrono::steady_clock::now();
+  for (const CtRecording& c : signals) {
+    LegacyReference::welfordFrames(c.samples, [&](double rms) { welfordSink = welfordSink + rms; });
+  }
+  const double welfordNs =
+      std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (cases * CT_RECORDING_SAMPLES);
+  // One kernel for all signals, as on the device: it primes its DC estimate only once
+  volatile uint32_t kernelSink = 0;
+  AcRmsKernel streaming(CHARGING_AC_SAMPLE_RATE_HZ, CHARGING_AC_WINDOW_MS, CHARGING_AC_ZERO_CROSS_HYSTERESIS);
+  AcRmsWindow window;
+  start = std::chrono::steady_clock::now();
+  for (const CtRecording& c : signals) {
+    for (uint16_t sample : c.samples) {
+      if (streaming.push(sample, &window)) {
+        kernelSink = kernelSink + window.rmsMilliCounts;
+      }
+    }
+  }
+  const double kernelNs =
+      std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (cases * CT_RECORDING_SAMPLES);
+
+  printf("ac rms              : %u signals of %u samples at %u Hz, 49.5-50.5 / 59.5-60.5 Hz, 30-1500 counts peak, noise 0-8 counts\n",
+         (unsigned)cases, (unsigned)CT_RECORDING_SAMPLES, (unsigned)CHARGING_AC_SAMPLE_RATE_HZ);
+  const char* const inputNames[2] = {"sine", "sine+noise"};
+  for (int input = 0; input < 2; ++input) {
+    printf("  %-18s: welford (double) %llu windows of %d samples, error mean %.3f%% max %.3f%%\n"
+           "                      AcRmsKernel (int) %llu windows, one per segment, error mean %.3f%% max %.3f%%\n",
+           inputNames[input], (unsigned long long)welford[input].windows, CHARGING_AC_SAMPLE_COUNT,
+           welford[input].sumAbs / welford[input].windows, welford[input].maxAbs,
+           (unsigned long long)kernel[input].windows, kernel[input].sumAbs / kernel[input].windows,
+           kernel[input].maxAbs);
+  }
+  printf("  cost              : welford %.1f ns/sample, AcRmsKernel %.1f ns/sample (host FPU; the ESP32 has no double FPU)\n",
+         welfordNs, kernelNs);
+  printf("  mains lock        : %.2f%% of windows whole cycles, frequency error max %.3f Hz (sine)\n",
+         100.0 * lockedWindows / lockCandidates, maxFrequencyError);
+  printf("  noise only        : welford error mean %.1f%% max %.1f%%, kernel mean %.1f%% max %.1f%%, %llu locked windows\n",
+         welfordNoise.sumAbs / welfordNoise.windows, welfordNoise.maxAbs, kernelNoise.sumAbs / kernelNoise.windows,
+         kernelNoise.maxAbs, (unsigned long long)noiseLocked);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const uint32_t pulseCount = argc > 1 ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : DEFAULT_PULSE_COUNT;
+  const uint32_t intervalUs = argc > 2 ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : DEFAULT_PULSE_INTERVAL_US;
+
+  const uint32_t count = argc > 2 ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 0;
+  if (argc > 1 && strcmp(argv[1], "--energy-math") == 0) {
+    benchmarkEnergyMath();
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "--mqtt-bench") == 0) {
+    benchmarkMqttOutbound();
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "--state-json-bench") == 0) {
+    benchmarkStateJson(count > 0 ? count : 200000);
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "--discovery-bench") == 0) {
+    benchmarkDiscoveryJson(count > 0 ? count : 20000);
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "--set-bench") == 0) {
+    benchmarkSetCommands(count > 0 ? count : 200000);
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "--rms-bench") == 0) {
+    benchmarkAcRms(count > 0 ? count : 200);
+    return 0;
+  }
+  if (argc > 2 && strcmp(argv[1], "--trace") == 0) {
+    initializeGlobals(&params);
+    if (argc > 3) {
+      params.pulse_per_kWh = static_cast<uint16_t>(strtoul(argv[3], nullptr, 10));
+    }
+    return replayPowerTrace(argv[2]);
+  }
+  if (argc > 3) {
+    selectPulseCounterBackend(strcmp(argv[3], "pcnt") == 0 ? PULSE_BACKEND_PCNT : PULSE_BACKEND_ISR);
+  }
+
+  initializeGlobals(&params);
+  OledEnergyDisplay::begin();
+
+  startPulseInputTask(&params);
+  waitForPulseInputReady(0);
+  if (!attachPulseInputInterrupt(PULSE_INPUT_GPIO, PULSE_INPUT_INTERRUPT_MODE)) {
+    printf("Pulse input interrupt could not be attached\n");
+    return 1;
+  }
+
+  startWorkerPool();
+  xTaskCreate(networkTask, "NetworkTask", NETWORK_TASK_STACK_SIZE, &params, 1, nullptr);
+  startChargingSessionTask(&params);
+  xTaskCreate(loopTask, "loopTask", 8192, &params, 1, nullptr);
+
+  // Let the MQTT client connect and publish discovery before measuring.
+  const uint32_t connectStartMs = millis();
+  while (!gMqttConnected && millis() - connectStartMs < MQTT_CONNECT_TIMEOUT_MS) {
+    delay(10);
+  }
+  if (!gMqttConnected) {
+    printf("MQTT did not connect within %u ms, measuring offline\n", (unsigned)MQTT_CONNECT_TIMEOUT_MS);
+  }
+  delay(SETTLE_MS);
+
+  uint64_t energyBeforeMilliWh = 0;
+  getLatestEnergyMilliWh(&energyBeforeMilliWh);
+  const uint32_t overflowBefore = getPulseInputOverflowCount();
+  uint32_t busyBeforeUs = 0;
+  uint32_t snapshotsBefore = 0;
+  getPulseTaskCpuCost(&busyBeforeUs, nullptr, &snapshotsBefore);
+  const HalSim::MqttBrokerStats brokerBefore = HalSim::mqttBrokerStats();
+  const HalSim::AllocationStats heapBefore = HalSim::allocationStats();
+  const uint32_t startUs = micros();
+
+  const IsrCost isrCost = firePulses(pulseCount, intervalUs);
+  delay(SETTLE_MS);
+
+  const uint32_t elapsedUs = micros() - startUs;
+  const HalSim::MqttBrokerStats brokerAfter = HalSim::mqttBrokerStats();
+  const HalSim::AllocationStats heapAfter = HalSim::allocationStats();
+
+  uint32_t powerW = 0;
+  uint32_t instantPowerW = 0;
+  uint64_t energyMilliWh = 0;
+  uint64_t subtotalMilliWh = 0;
+  getLatestEnergySnapshot(&powerW, &energyMilliWh, &subtotalMilliWh, &instantPowerW);
+
+  uint32_t busyAfterUs = 0;
+  uint32_t snapshotsAfter = 0;
+  getPulseTaskCpuCost(&busyAfterUs, nullptr, &snapshotsAfter);
+  const uint32_t pulsesCounted =
+      static_cast<uint32_t>(milliWhToPulses(energyMilliWh - energyBeforeMilliWh, params.pulse_per_kWh));
+  const uint32_t publishes = brokerAfter.publishes - brokerBefore.publishes;
+  const uint64_t allocations = heapAfter.allocations - heapBefore.allocations;
+  const double perPulse = pulseCount > 0 ? 1.0 / pulseCount : 0.0;
+
+  printf("pulses fired        : %u @ %u us\n", (unsigned)pulseCount, (unsigned)intervalUs);
+  printf("elapsed             : %.3f s\n", elapsedUs / 1e6);
+  printf("isr cost            : %.0f ns avg, %llu ns max\n",
+         pulseCount > 0 ? static_cast<double>(isrCost.totalNs) / pulseCount : 0.0,
+         (unsigned long long)isrCost.maxNs);
+  printf("pulses counted      : %u by %s (%u lost, %u overflows)\n",
+         (unsigned)pulsesCounted,
+         getPulseCounterBackendName(),
+         (unsigned)(pulseCount - pulsesCounted),
+         (unsigned)(getPulseInputOverflowCount() - overflowBefore));
+  printf("pulse task          : %s, %u snapshots, %.1f us busy per pulse\n",
+         PULSE_BATCH_WINDOW_MS > 0 ? "batch" : "per pulse",
+         (unsigned)(snapshotsAfter - snapshotsBefore),
+         pulseCount > 0 ? static_cast<double>(busyAfterUs - busyBeforeUs) / pulseCount : 0.0);
+  printf("energy snapshot     : %.3f kWh, subtotal %.3f kWh, %u W %s (%u W instant)\n",
+         milliWhToKwh(energyMilliWh), milliWhToKwh(subtotalMilliWh), (unsigned)powerW,
+         powerEstimatorModeName(POWER_ESTIMATOR_MODE), (unsigned)instantPowerW);
+  printf("mqtt publishes      : %u (%.2f per pulse, %llu payload bytes)\n",
+         (unsigned)publishes,
+         publishes * perPulse,
+         (unsigned long long)(brokerAfter.publishedBytes - brokerBefore.publishedBytes));
+  printf("heap allocations    : %llu (%.2f per pulse, %llu bytes)\n",
+         (unsigned long long)allocations,
+         allocations * perPulse,
+         (unsigned long long)(heapAfter.bytesAllocated - heapBefore.bytesAllocated));
+
+
+  char latency[384] = {0};
+  formatPulseLatencyHistogram(latency, sizeof(latency));
+  printf("pulse latency       :\n%s\n", latency);
+
+  // Firmware tasks never return; leave without running static destructors underneath them.
+  fflush(stdout);
+  std::_Exit(0);
+}
+
+#endif  // PIO_UNIT_TESTING
@@ -16,6 +16,7 @@
 #include "globals.h"
 #include "NetworkTask.h"
 #include "PulseInputTask.h"
+#include "PulseLatency.h"
 #include "TeslaSheets.h"
 #include "ChargingSession.h"
 #include "MqttClient.h"
@@ -23,6 +24,7 @@
 #include "OtaService.h"
 #include "PushButtonTask.h"
 #include "LedTask.h"
+#include "WorkerPool.h"
 
                                                           #ifdef NONE_HEADLESS
                                                           #include <wait_for_any_key.h>
@@ -166,13 +168,14 @@ void setup() {
   * Starting the Network Task after initializing the display allows for any immediate visual feedback (like the splash screen) to be shown without delay, while still ensuring that network connectivity is established as soon as possible for telemetry and remote monitoring.
   * The Network Task will also handle sending telemetry data to Google Sheets and updating the OLED display when new data is available.
   */
+  startWorkerPool();
   startNetworkTask( &networkParams );
   //showBootMonitorMessage("Network start");
 
   initPushButtons();
   //showBootMonitorMessage("Buttons ready");
 
-  initChargingSession();
+  startChargingSessionTask(&networkParams);
   //showBootMonitorMessage("Charge init");
 
                                                             #ifdef BOOT_DIAGNOSTICS_LOGGING
@@ -273,10 +276,6 @@ void loop() {
                          pendingTelemetryToSend,
                          pendingEnergyKwh);
   }
-                       
-  if (!isOtaInProgress()) {
-    handleChargingSession(&networkParams);
-  }
 
   if (!isOtaInProgress() && (gDisplayUpdateAvailable || (isChargingSessionCharging() != lastChargingSessionCharging))) {
     gDisplayUpdateAvailable = false;
@@ -300,9 +299,6 @@ void loop() {
                                                                           static uint32_t maxOptimalNetworkTaskStackSize = 0;
                                                                           static uint32_t maxOptimalWifiConnTaskStackSize = 0;
                                                                           static uint32_t maxOptimalPulseInputTaskStackSize = 0;
-                                                                          static uint32_t maxOptimalTeslaTaskStackSize = 0;
-                                                                          static uint32_t maxOptimalConfigurationTaskStackSize = 0;
-                                                                          static uint32_t maxOptimalButtonPublishTaskStackSize = 0;
                                                                           static UBaseType_t minLoopTaskStackHighWater = 0;
 
                                                                           UBaseType_t loopTaskStackHighWater = uxTaskGetStackHighWaterMark(nullptr);
@@ -314,7 +310,7 @@ void loop() {
                                                                                      sizeof(logMsg),
                                                                                      "loop() min free stack watermark: %u words",
                                                                                      (unsigned)minLoopTaskStackHighWater);
-                                                                            publishMqttLog("log/stack/loop", logMsg, false);
+                                                                            publishMqttLog(MQTT_TOPIC_LOG_STACK_LOOP, logMsg, false);
                                                                           }
 
                                                                           if (gNetworkTaskStackHighWater > 0) {
@@ -329,7 +325,7 @@ void loop() {
                                                                                        "Change NETWORK_TASK_STACK_SIZE from: %u to: %u words",
                                                                                        (unsigned)NETWORK_TASK_STACK_SIZE,
                                                                                        (unsigned)optimalNetworkTaskStackSize);
-                                                                              publishMqttLog("log/stack/network", logMsg, false);
+                                                                              publishMqttLog(MQTT_TOPIC_LOG_STACK_NETWORK, logMsg, false);
                                                                             }
                                                                           }
                                                                           if (gWifiConnTaskStackHighWater > 0) {
@@ -344,7 +340,7 @@ void loop() {
                                                                                        "Change WIFI_CONNECTION_TASK_STACK_SIZE from: %u to: %u words",
                                                                                        (unsigned)WIFI_CONNECTION_TASK_STACK_SIZE,
                                                                                        (unsigned)optimalWifiConnTaskStackSize);
-                                                                              publishMqttLog("log/stack/wifiConnection", logMsg, false);
+                                                                              publishMqttLog(MQTT_TOPIC_LOG_STACK_WIFI_CONNECTION, logMsg, false);
                                                                             }
                                                                           }
                                                                           if (gPulseInputTaskStackHighWater > 0) {
@@ -359,54 +355,10 @@ void loop() {
                                                                                        "Change PULSE_INPUT_TASK_STACK_SIZE from: %u to: %u words",
                                                                                        (unsigned)PULSE_INPUT_TASK_STACK_SIZE,
                                                                                        (unsigned)optimalPulseInputTaskStackSize);
-                                                                              publishMqttLog("log/stack/pulseInput", logMsg, false);
-                                                                            }
-                                                                          }
-                                                                          if (gTeslaTaskStackHighWater > 0) {
-                                                                            uint32_t usedStack = TESLA_TELEMETRY_TASK_STACK_SIZE - gTeslaTaskStackHighWater;
-                                                                            uint32_t optimalTeslaTaskStackSize = (usedStack * 5 + 3) / 4; // Multiply by 1.25
-                                                                            bool significantDiff = abs((int)TESLA_TELEMETRY_TASK_STACK_SIZE - (int)optimalTeslaTaskStackSize) > 100;
-                                                                            if (significantDiff && optimalTeslaTaskStackSize > maxOptimalTeslaTaskStackSize) {
-                                                                              maxOptimalTeslaTaskStackSize = optimalTeslaTaskStackSize;
-                                                                              char logMsg[128] = {0};
-                                                                              snprintf(logMsg,
-                                                                                       sizeof(logMsg),
-                                                                                       "Change TESLA_TELEMETRY_TASK_STACK_SIZE from: %u to: %u words",
-                                                                                       (unsigned)TESLA_TELEMETRY_TASK_STACK_SIZE,
-                                                                                       (unsigned)optimalTeslaTaskStackSize);
-                                                                              publishMqttLog("log/stack/teslaTelemetry", logMsg, false);
-                                                                            }
-                                                                          }
-                                                                          if (gConfigurationTaskStackHighWater > 0) {
-                                                                            uint32_t usedStack = CONFIGURATION_TASK_STACK_SIZE - gConfigurationTaskStackHighWater;
-                                                                            uint32_t optimalConfigurationTaskStackSize = (usedStack * 5 + 3) / 4; // Multiply by 1.25
-                                                                            bool significantDiff = abs((int)CONFIGURATION_TASK_STACK_SIZE - (int)optimalConfigurationTaskStackSize) > 100;
-                                                                            if (significantDiff && optimalConfigurationTaskStackSize > maxOptimalConfigurationTaskStackSize) {
-                                                                              maxOptimalConfigurationTaskStackSize = optimalConfigurationTaskStackSize;
-                                                                              char logMsg[128] = {0};
-                                                                              snprintf(logMsg,
-                                                                                       sizeof(logMsg),
-                                                                                       "Change CONFIGURATION_TASK_STACK_SIZE from: %u to: %u words",
-                                                                                       (unsigned)CONFIGURATION_TASK_STACK_SIZE,
-                                                                                       (unsigned)optimalConfigurationTaskStackSize);
-                                                                              publishMqttLog("log/stack/configuration", logMsg, false);
-                                                                            }
-                                                                          }
-                                                                          if (gButtonPublishTaskStackHighWater > 0) {
-                                                                            uint32_t usedStack = BUTTON_PUBLISH_TASK_STACK_SIZE - gButtonPublishTaskStackHighWater;
-                                                                            uint32_t optimalButtonPublishTaskStackSize = (usedStack * 5 + 3) / 4; // Multiply by 1.25
-                                                                            bool significantDiff = abs((int)BUTTON_PUBLISH_TASK_STACK_SIZE - (int)optimalButtonPublishTaskStackSize) > 100;
-                                                                            if (significantDiff && optimalButtonPublishTaskStackSize > maxOptimalButtonPublishTaskStackSize) {
-                                                                              maxOptimalButtonPublishTaskStackSize = optimalButtonPublishTaskStackSize;
-                                                                              char logMsg[160] = {0};
-                                                                              snprintf(logMsg,
-                                                                                       sizeof(logMsg),
-                                                                                       "Change BUTTON_PUBLISH_TASK_STACK_SIZE from: %u to: %u words",
-                                                                                       (unsigned)BUTTON_PUBLISH_TASK_STACK_SIZE,
-                                                                                       (unsigned)optimalButtonPublishTaskStackSize);
-                                                                              publishMqttLog("log/stack/buttonPublish", logMsg, false);
+                                                                              publishMqttLog(MQTT_TOPIC_LOG_STACK_PULSE_INPUT, logMsg, false);
                                                                             }
                                                                           }
+                                                                          publishWorkerJobStackAdvice();
                                                                           /*
                                                                           
                                                                           {
@@ -429,6 +381,23 @@ void loop() {
                                                                         }
                                                                       #endif
 
+  if (!isOtaInProgress()) {
+    publishPulseInputOverflow();
+  }
+
+  if (PULSE_DIAGNOSTICS_PUBLISH_INTERVAL_MS > 0 && !isOtaInProgress()) {
+    static unsigned long lastPulseDiagnosticsLog = 0;
+    unsigned long diagnosticsNow = millis();
+    if (diagnosticsNow - lastPulseDiagnosticsLog >= PULSE_DIAGNOSTICS_PUBLISH_INTERVAL_MS) {
+      lastPulseDiagnosticsLog = diagnosticsNow;
+      publishPulseLatencyHistogram();
+      publishPulseTaskCpuCost();
+      publishMqttOutboundStats();
+      publishMqttInboundStats();
+      publishWorkerPoolStats();
+    }
+  }
+
 }
 
 /*********************************************************************************************************
@@ -487,18 +456,14 @@ static void handleDailyTelemetry(TaskParams_t *networkParams,
       if (dayChanged && currentDateKey > lastProcessedDailyTelemetryDateKey) {
         float energyKwh = 0.0f;
         if (getLatestEnergyKwh(&energyKwh)) {
-          if (WiFi.status() == WL_CONNECTED) {
-            if (passTeslaTelemetryToGoogleSheets(networkParams, energyKwh, "DailyTelemetry")) {
-              publishMqttLog(MQTT_LOG_SUFFIX, "Daily telemetry queued", false);
-            } else {
-              pendingEnergyKwh = energyKwh;
-              pendingTelemetryToSend = true;
-              publishMqttLog(MQTT_LOG_SUFFIX, "Daily telemetry pending (queue busy)", false);
-            }
+          if (WiFi.status() == WL_CONNECTED &&
+              passTeslaTelemetryToGoogleSheets(networkParams, energyKwh, "DailyTelemetry")) {
+            publishMqttLog(MQTT_LOG_SUFFIX, "Daily telemetry queued", false);
           } else {
+            // Offline, or the network worker's queue is full: sent as PendingTelemetry later
             pendingEnergyKwh = energyKwh;
             pendingTelemetryToSend = true;
-            publishMqttLog(MQTT_LOG_SUFFIX, "Daily telemetry pending (WiFi offline)", false);
+            publishMqttLog(MQTT_LOG_SUFFIX, "Daily telemetry pending", false);
           }
         }
         requestSubtotalReset();
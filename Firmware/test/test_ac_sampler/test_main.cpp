@@ -0,0 +1,186 @@
+/*
+ * The CT input: AcRmsKernel against the Welford loop of the old readAcRms() on recorded signals
+ * (random mains frequency, phase, bias, amplitude and ADC noise), then the AC sampler on the
+ * simulated ADC DMA driven by a 50 Hz sine: frame and window cadence, RMS, offset and how fast a
+ * step to no current is seen.
+ *
+ *   pio test -e native -f test_ac_sampler
+ */
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "AcRms.h"
+#include "AcSampler.h"
+#include "ChargingSession.h"
+#include "LegacyReference.h"
+#include "NativeHarness.h"
+#include "WorkerPool.h"
+#include "config.h"
+
+using namespace NativeHarness;
+
+namespace {
+constexpr uint32_t RECORDINGS = 200;
+constexpr uint32_t NOISE_RECORDINGS = 20;
+
+// Accuracy against the RMS the CT actually delivers (sine, noise and 12-bit rounding)
+struct RecordingAccuracy {
+  RmsErrors welford[2];  // Sine, sine + noise
+  RmsErrors kernel[2];
+  uint64_t lockedWindows = 0;
+  uint64_t lockCandidates = 0;
+  double maxFrequencyError = 0.0;
+  // No current: both should report the noise
+  RmsErrors welfordNoise;
+  RmsErrors kernelNoise;
+  uint64_t noiseLocked = 0;
+};
+
+template <typename Visit>
+void kernelWindows(const CtRecording& c, Visit visit) {
+  AcRmsKernel rms(CHARGING_AC_SAMPLE_RATE_HZ, CHARGING_AC_WINDOW_MS, CHARGING_AC_ZERO_CROSS_HYSTERESIS);
+  AcRmsWindow window;
+  for (uint32_t s = 0; s < c.samples.size(); ++s) {
+    if (rms.push(c.samples[s], &window) && s >= CT_RECORDING_SETTLE) {
+      visit(window);
+    }
+  }
+}
+
+const RecordingAccuracy& recordingAccuracy() {
+  static RecordingAccuracy a;
+  static bool measured = false;
+  if (measured) {
+    return a;
+  }
+  measured = true;
+  uint64_t randomState = 0x5ca1ab1e0ddba11ULL;
+  // Even recordings: 12-bit rounding only, so the error is the window's alignment to the mains phase.
+  // Odd recordings: ADC noise too, whose RMS over a 100 ms window scatters for any estimator.
+  for (uint32_t i = 0; i < RECORDINGS; ++i) {
+    const CtRecording c = makeCtRecording(randomState, 30.0 + 1470.0 * uniformRandom(randomState),
+                                          i % 2 ? 8.0 * uniformRandom(randomState) : 0.0);
+    const double expected = sqrt(c.amplitude * c.amplitude / 2.0 + c.noise * c.noise + 1.0 / 12.0);
+    LegacyReference::welfordFrames(c.samples, [&](double rms) { a.welford[i % 2].add(rms, expected); });
+    kernelWindows(c, [&](const AcRmsWindow& window) {
+      a.kernel[i % 2].add(window.rmsMilliCounts / 1000.0, expected);
+      a.lockCandidates++;
+      a.lockedWindows += window.locked ? 1 : 0;
+      if (window.locked && c.noise == 0.0) {
+        a.maxFrequencyError = std::max(a.maxFrequencyError, fabs(window.mainsCentiHz / 100.0 - c.mainsHz));
+      }
+    });
+  }
+  for (uint32_t i = 0; i < NOISE_RECORDINGS; ++i) {
+    const CtRecording c = makeCtRecording(randomState, 0.0, 1.0 + 3.0 * uniformRandom(randomState));
+    const double expected = sqrt(c.noise * c.noise + 1.0 / 12.0);
+    LegacyReference::welfordFrames(c.samples, [&](double rms) { a.welfordNoise.add(rms, expected); });
+    kernelWindows(c, [&](const AcRmsWindow& window) {
+      a.kernelNoise.add(window.rmsMilliCounts / 1000.0, expected);
+      a.noiseLocked += window.locked ? 1 : 0;
+    });
+  }
+  return a;
+}
+
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+}  // namespace
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_kernel_beats_welford_on_a_clean_sine() {
+  const RecordingAccuracy& a = recordingAccuracy();
+  TEST_ASSERT_TRUE(a.kernel[0].windows > 0);
+  TEST_ASSERT_TRUE_MESSAGE(a.kernel[0].maxAbs < a.welford[0].maxAbs, "kernel max error not below welford's");
+  TEST_ASSERT_TRUE_MESSAGE(a.kernel[0].maxAbs < 0.5, "kernel max error 0.5 % or more");
+}
+
+void test_kernel_matches_welford_with_noise() {
+  const RecordingAccuracy& a = recordingAccuracy();
+  TEST_ASSERT_TRUE(a.kernel[1].mean() <= 1.1 * a.welford[1].mean());
+}
+
+void test_kernel_locks_to_the_mains_frequency() {
+  const RecordingAccuracy& a = recordingAccuracy();
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(a.lockCandidates * 99, a.lockedWindows * 100);
+  TEST_ASSERT_TRUE_MESSAGE(a.maxFrequencyError < 0.05, "frequency error 0.05 Hz or more");
+}
+
+void test_noise_only_is_reported_and_never_locked() {
+  const RecordingAccuracy& a = recordingAccuracy();
+  TEST_ASSERT_TRUE(a.kernelNoise.mean() <= 1.1 * a.welfordNoise.mean());
+  TEST_ASSERT_EQUAL_UINT32(0, a.noiseLocked);
+}
+
+void test_sampler_delivers_frames_windows_and_rms() {
+  setAcSine(AC_AMPLITUDE_COUNTS);
+  // Averaging each sample's DMA conversions attenuates the sine by sinc(pi * f / sample rate)
+  const double dwell = AC_PI * AC_MAINS_HZ / CHARGING_AC_SAMPLE_RATE_HZ;
+  const double expectedRms = AC_AMPLITUDE_COUNTS / sqrt(2.0) * sin(dwell) / dwell;
+
+  const auto start = std::chrono::steady_clock::now();
+  startWorkerPool();
+  startChargingSessionTask(&params);
+  TEST_ASSERT_TRUE_MESSAGE(acSamplerRunning(), "AC sampler did not start");
+
+  // The ChargingSession task reads the sampler once per CHARGING_ANALOG_SAMPLE_INTERVAL_MS meanwhile
+  constexpr uint32_t RUN_MS = 3000;
+  delay(RUN_MS);
+  const double runMs = elapsedMs(start);
+  AcSamplerStats stats = {};
+  getAcSamplerStats(&stats);
+  AcSamplerReading reading = {};
+  const bool fresh = acSamplerLatest(&reading, CHARGING_ANALOG_SAMPLE_INTERVAL_MS);
+  const double expectedFrames = runMs * CHARGING_AC_SAMPLE_RATE_HZ / 1000.0 / AC_SAMPLER_FRAME_SAMPLES;
+  const double expectedWindows = runMs * AC_MAINS_HZ / 1000.0;  // One per mains cycle once locked
+
+  TEST_ASSERT_FLOAT_WITHIN(3.0, expectedFrames, stats.frames);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.overruns);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.dmaOverflows);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.channelErrors);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.readErrors);
+  TEST_ASSERT_TRUE(stats.windows >= expectedWindows - 10);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(stats.windows, stats.lockedWindows + 10);
+  TEST_ASSERT_INT_WITHIN(5, AC_MAINS_HZ * 100, reading.mainsCentiHz);
+  TEST_ASSERT_TRUE_MESSAGE(fresh, "no fresh window");
+  TEST_ASSERT_FLOAT_WITHIN(1.0, expectedRms, reading.rmsMilliCounts / 1000.0);
+  TEST_ASSERT_INT_WITHIN(1, 2048, reading.meanCounts);
+}
+
+// Current stops: the next complete frame reports it, at most two windows later
+void test_step_to_no_current_is_seen_within_two_windows() {
+  setAcSine(0.0);
+  const auto start = std::chrono::steady_clock::now();
+  TEST_ASSERT_TRUE(waitUntil([] {
+    AcSamplerReading latest = {};
+    return acSamplerLatest(&latest, CHARGING_ANALOG_SAMPLE_INTERVAL_MS) && latest.rmsCounts == 0;
+  }, 1000));
+  TEST_ASSERT_TRUE(elapsedMs(start) <= 2.0 * CHARGING_AC_WINDOW_MS);
+}
+
+int main() {
+  initializeGlobals(&params);
+  UNITY_BEGIN();
+  RUN_TEST(test_kernel_beats_welford_on_a_clean_sine);
+  RUN_TEST(test_kernel_matches_welford_with_noise);
+  RUN_TEST(test_kernel_locks_to_the_mains_frequency);
+  RUN_TEST(test_noise_only_is_reported_and_never_locked);
+  RUN_TEST(test_sampler_delivers_frames_windows_and_rms);
+  RUN_TEST(test_step_to_no_current_is_seen_within_two_windows);
+  // The firmware tasks never return; leave without running static destructors underneath them
+  const int failures = UNITY_END();
+  fflush(stdout);
+  std::_Exit(failures);
+}
@@ -0,0 +1,145 @@
+/*
+ * The CT energy of a charging session against the S0 meter: acEnergyCheck() on its own, then a
+ * session driven by the CT sine and pulses at the power it should read, through the periodic
+ * <device>/log/charging/energy report to the final one when the current stops.
+ *
+ *   pio test -e native -f test_charging_energy
+ */
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "AcEnergy.h"
+#include "ChargingSession.h"
+#include "HalSim.h"
+#include "MqttClient.h"
+#include "NativeHarness.h"
+#include "PulseInputTask.h"
+#include "config.h"
+
+using namespace NativeHarness;
+
+namespace {
+constexpr uint16_t CT_ENERGY_PULSES_PER_KWH = 10000;  // 0.1 Wh per pulse: a session long enough to compare in seconds
+constexpr double CT_ENERGY_CURRENT_A = 16.0;
+
+// Value of "<key>:" in a "key:value ..." diagnostics line; NaN if it is missing
+double logValue(const char* line, const char* key) {
+  const std::string search = std::string(key) + ":";
+  const char* found = strstr(line, search.c_str());
+  return found ? atof(found + search.size()) : NAN;
+}
+
+void assertEnergyCheck(AcEnergyCheck expected, uint64_t ctMilliWh, uint64_t meterMilliWh) {
+  const AcEnergyCheck check = acEnergyCheck(ctMilliWh, meterMilliWh, CHARGING_ENERGY_CHECK_MIN_WH * 1000ULL,
+                                            CHARGING_ENERGY_CHECK_TOLERANCE_PERCENT);
+  TEST_ASSERT_EQUAL_STRING(acEnergyCheckName(expected), acEnergyCheckName(check));
+}
+}  // namespace
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// Pending below the minimum, then agree within the tolerance of the larger
+void test_energy_check_outcomes() {
+  const uint64_t minMilliWh = CHARGING_ENERGY_CHECK_MIN_WH * 1000ULL;
+  const uint64_t agreeingMilliWh = 10000000ULL * (100 - CHARGING_ENERGY_CHECK_TOLERANCE_PERCENT) / 100;
+  assertEnergyCheck(AcEnergyCheck::Pending, minMilliWh - 1, 0);        // Too little energy
+  assertEnergyCheck(AcEnergyCheck::Agree, 10000000, agreeingMilliWh);
+  assertEnergyCheck(AcEnergyCheck::Mismatch, 10000000, agreeingMilliWh - 1);  // CT reads high
+  assertEnergyCheck(AcEnergyCheck::Mismatch, minMilliWh, 0);           // Meter stopped
+  assertEnergyCheck(AcEnergyCheck::Mismatch, 0, minMilliWh);           // CT clamp loose
+}
+
+void test_session_energy_agrees_with_the_meter() {
+  // The current the CT should report for the sine, after the sampler's averaging and noise floor
+  const double dwell = AC_PI * AC_MAINS_HZ / CHARGING_AC_SAMPLE_RATE_HZ;
+  const double amplitude = CT_ENERGY_CURRENT_A * 1e6 / CHARGING_CT_MICROAMPS_PER_COUNT * sqrt(2.0) / (sin(dwell) / dwell);
+  const double noiseFloor = CHARGING_CT_NOISE_FLOOR_MILLICOUNTS / 1000.0;
+  const double expectedA = sqrt(CT_ENERGY_CURRENT_A * CT_ENERGY_CURRENT_A -
+                                pow(noiseFloor * CHARGING_CT_MICROAMPS_PER_COUNT / 1e6, 2));
+  const double expectedW = expectedA * CHARGING_CT_MAINS_VOLTAGE * CHARGING_CT_PHASES * CHARGING_CT_POWER_FACTOR_PERCENT / 100.0;
+  const uint32_t pulseIntervalUs = static_cast<uint32_t>(lround(3.6e12 / (expectedW * CT_ENERGY_PULSES_PER_KWH)));
+
+  params.pulse_per_kWh = CT_ENERGY_PULSES_PER_KWH;
+  setAcSine(0.0);
+  startPulseInputTask(&params);
+  waitForPulseInputReady(0);
+  TEST_ASSERT_TRUE_MESSAGE(attachPulseInputInterrupt(PULSE_INPUT_GPIO, PULSE_INPUT_INTERRUPT_MODE),
+                           "pulse input interrupt could not be attached");
+  TEST_ASSERT_TRUE_MESSAGE(startNetwork(), "MQTT did not connect");
+  startChargingSessionTask(&params);
+  xTaskCreate(loopTask, "loopTask", 8192, &params, 1, nullptr);
+  const std::string energyTopic = mqttTopic(MQTT_TOPIC_LOG_CHARGING_ENERGY);
+
+  // Charge: current on the CT and pulses at the same power, until the first periodic report
+  std::atomic<bool> pulsing{true};
+  std::thread pulses([&pulsing, pulseIntervalUs] {
+    auto next = std::chrono::steady_clock::now();
+    while (pulsing) {
+      HalSim::triggerInterrupt(PULSE_INPUT_GPIO);
+      next += std::chrono::microseconds(pulseIntervalUs);
+      std::this_thread::sleep_until(next);
+    }
+  });
+  setAcSine(amplitude);
+
+  char report[256] = {0};
+  const uint32_t reportTimeoutMs =
+      (CHARGING_START_CONFIRM_SECONDS + 2) * 1000 + CHARGING_ENERGY_REPORT_INTERVAL_MS + 2 * CHARGING_ANALOG_SAMPLE_INTERVAL_MS;
+  const bool charging = waitUntil([&] {
+    return HalSim::lastPublished(energyTopic.c_str(), report, sizeof(report)) && strstr(report, "session:charging");
+  }, reportTimeoutMs);
+  const bool sessionCharging = isChargingSessionCharging();
+
+  // Charging stops: the session ends and publishes its final figures
+  char finalReport[256] = {0};
+  setAcSine(0.0);
+  pulsing = false;
+  pulses.join();
+  const bool ended = waitUntil([&] {
+    return HalSim::lastPublished(energyTopic.c_str(), finalReport, sizeof(finalReport)) &&
+           strstr(finalReport, "session:end");
+  }, (CHARGING_END_CONFIRM_SECONDS + 3) * 1000);
+
+  TEST_ASSERT_TRUE_MESSAGE(charging, "no charging report");
+  TEST_MESSAGE(report);
+  TEST_ASSERT_TRUE(sessionCharging);
+  TEST_ASSERT_FLOAT_WITHIN(0.02, expectedA, logValue(report, "ct_a"));
+  TEST_ASSERT_FLOAT_WITHIN(0.005 * expectedW, expectedW, logValue(report, "ct_w"));
+  TEST_ASSERT_FLOAT_WITHIN(0.02 * expectedW, expectedW, logValue(report, "meter_w"));
+  const double ctWh = logValue(report, "ct_wh");
+  TEST_ASSERT_TRUE(ctWh > 5.0);
+  TEST_ASSERT_FLOAT_WITHIN(0.02 * ctWh + 0.2, ctWh, logValue(report, "meter_wh"));
+  TEST_ASSERT_NOT_NULL(strstr(report, "check:pending"));
+
+  TEST_ASSERT_TRUE_MESSAGE(ended, "no final report");
+  TEST_MESSAGE(finalReport);
+  TEST_ASSERT_FALSE(isChargingSessionCharging());
+  const double finalCtWh = logValue(finalReport, "ct_wh");
+  const double finalMeterWh = logValue(finalReport, "meter_wh");
+  TEST_ASSERT_FLOAT_WITHIN(0.02 * finalCtWh + 0.2, finalCtWh, finalMeterWh);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, finalMeterWh / finalCtWh, logValue(finalReport, "ratio"));
+  TEST_ASSERT_TRUE(logValue(finalReport, "ct_w") == 0.0);
+}
+
+int main() {
+  initializeGlobals(&params);
+  UNITY_BEGIN();
+  RUN_TEST(test_energy_check_outcomes);
+  RUN_TEST(test_session_energy_agrees_with_the_meter);
+  // The firmware tasks never return; leave without running static destructors underneath them
+  const int failures = UNITY_END();
+  fflush(stdout);
+  std::_Exit(failures);
+}
@@ -0,0 +1,130 @@
+/*
+ * The charging session state machine in its own task, with Tesla telemetry slower than loop() may
+ * ever block: the start is confirmed and waits for its telemetry, a failed end is retried without
+ * uploading, the retry uploads the TeslaData row once, and loop() (run in the test thread) never
+ * takes longer than CHARGING_TASK_MAX_LOOP_MS per pass meanwhile.
+ *
+ *   pio test -e native -f test_charging_task
+ */
+#include <unity.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+
+#include "ChargingSession.h"
+#include "HalSim.h"
+#include "MqttClient.h"
+#include "NativeHarness.h"
+#include "PulseInputTask.h"
+#include "config.h"
+
+using namespace NativeHarness;
+
+namespace {
+constexpr uint32_t CHARGING_TASK_TELEMETRY_MS = 2000;
+constexpr double CHARGING_TASK_MAX_LOOP_MS = 50.0;
+constexpr uint32_t END_TIMEOUT_MS = (CHARGING_END_CONFIRM_SECONDS + 2) * 1000 + CHARGING_TASK_TELEMETRY_MS;
+
+std::atomic<uint32_t> sEndTelemetryFailures{0};
+std::atomic<uint32_t> sEndRetries{0};
+double sMaxLoopMs = 0.0;
+
+void recordChargingLog(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+  (void)topic;
+  (void)retained;
+  const std::string message(reinterpret_cast<const char*>(payload), length);
+  if (message.find("Charging end telemetry failed") != std::string::npos) {
+    sEndTelemetryFailures++;
+  }
+  if (message.find("Charging end finalization failed; retry pending") != std::string::npos) {
+    sEndRetries++;
+  }
+}
+
+// loop() as on the device, in this thread, timed per pass while the session runs beside it
+bool runLoopUntil(const std::function<bool()>& done, uint32_t timeoutMs) {
+  const auto start = std::chrono::steady_clock::now();
+  while (!done()) {
+    if (std::chrono::steady_clock::now() - start > std::chrono::milliseconds(timeoutMs)) {
+      return false;
+    }
+    const auto passStart = std::chrono::steady_clock::now();
+    mqttProcessRxQueue();
+    (void)isChargingSessionCharging();
+    sMaxLoopMs = std::max(sMaxLoopMs,
+                          std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - passStart).count());
+    delay(10);
+  }
+  return true;
+}
+}  // namespace
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// Start: confirmed after CHARGING_START_CONFIRM_SECONDS, Charging once the start telemetry is back
+void test_start_waits_for_confirmation_and_telemetry() {
+  setAcSine(0.0);
+  startPulseInputTask(&params);
+  waitForPulseInputReady(0);
+  TEST_ASSERT_TRUE_MESSAGE(attachPulseInputInterrupt(PULSE_INPUT_GPIO, PULSE_INPUT_INTERRUPT_MODE),
+                           "pulse input interrupt could not be attached");
+  TEST_ASSERT_TRUE_MESSAGE(startNetwork(), "MQTT did not connect");
+  HalSim::setTeslaTelemetry(CHARGING_TASK_TELEMETRY_MS, true);
+  HalSim::setPublishObserver(recordChargingLog);
+  startChargingSessionTask(&params);
+
+  const auto start = std::chrono::steady_clock::now();
+  setAcSine(AC_AMPLITUDE_COUNTS);
+  TEST_ASSERT_TRUE(runLoopUntil([] { return isChargingSessionCharging(); },
+                                (CHARGING_START_CONFIRM_SECONDS + 2) * 1000 + CHARGING_TASK_TELEMETRY_MS));
+  const double startMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  TEST_ASSERT_TRUE(startMs >= CHARGING_START_CONFIRM_SECONDS * 1000 + CHARGING_TASK_TELEMETRY_MS);
+  TEST_ASSERT_EQUAL_UINT32(1, HalSim::teslaStats().telemetryRequests);
+}
+
+// End with the Tesla API failing: the end is confirmed again and retried, nothing is uploaded
+void test_failed_end_is_retried_without_upload() {
+  HalSim::setTeslaTelemetry(CHARGING_TASK_TELEMETRY_MS, false);
+  setAcSine(0.0);
+  TEST_ASSERT_TRUE(runLoopUntil([] { return sEndRetries > 0; }, END_TIMEOUT_MS));
+  TEST_ASSERT_EQUAL_UINT32(1, sEndTelemetryFailures);
+  TEST_ASSERT_FALSE(isChargingSessionCharging());
+  TEST_ASSERT_EQUAL_UINT32(0, HalSim::teslaStats().teslaDataUploads);
+}
+
+// The API recovers: the retry completes the session and uploads its TeslaData row once
+void test_retried_end_uploads_once() {
+  HalSim::setTeslaTelemetry(CHARGING_TASK_TELEMETRY_MS, true);
+  TEST_ASSERT_TRUE(runLoopUntil([] { return HalSim::teslaStats().teslaDataUploads > 0; }, END_TIMEOUT_MS));
+  delay(CHARGING_ANALOG_SAMPLE_INTERVAL_MS * 2);
+  TEST_ASSERT_EQUAL_UINT32(1, HalSim::teslaStats().teslaDataUploads);
+  TEST_ASSERT_EQUAL_UINT32(3, HalSim::teslaStats().telemetryRequests);
+  HalSim::setPublishObserver(nullptr);
+}
+
+void test_loop_never_blocks_on_telemetry() {
+  TEST_ASSERT_TRUE(sMaxLoopMs > 0.0);
+  TEST_ASSERT_TRUE_MESSAGE(sMaxLoopMs < CHARGING_TASK_MAX_LOOP_MS, "a loop() pass took 50 ms or more");
+}
+
+int main() {
+  initializeGlobals(&params);
+  UNITY_BEGIN();
+  RUN_TEST(test_start_waits_for_confirmation_and_telemetry);
+  RUN_TEST(test_failed_end_is_retried_without_upload);
+  RUN_TEST(test_retried_end_uploads_once);
+  RUN_TEST(test_loop_never_blocks_on_telemetry);
+  // The firmware tasks never return; leave without running static destructors underneath them
+  const int failures = UNITY_END();
+  fflush(stdout);
+  std::_Exit(failures);
+}
@@ -0,0 +1,112 @@
+/*
+ * Fixed-point energy and power math (EnergyMath.h) against exact 128-bit arithmetic over the whole
+ * counter range.
+ *
+ *   pio test -e native -f test_energy_math
+ */
+#include <unity.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "EnergyMath.h"
+#include "NativeHarness.h"
+
+using NativeHarness::nextRandom;
+
+namespace {
+const uint16_t kMeterConstants[] = {100, 500, 800, 1000, 1600, 10000};
+
+// Every power of two (and its neighbours) up to the largest counter whose mWh value fits in
+// 64 bits, plus random counters in the same range.
+std::vector<uint64_t> energyMathCounters(uint16_t pulsePerKWh, uint64_t& randomState) {
+  const uint64_t maxPulses = (UINT64_MAX / MILLI_WH_PER_KWH) * pulsePerKWh;
+  std::vector<uint64_t> counters = {0, maxPulses};
+  for (uint64_t power = 1; power != 0 && power <= maxPulses; power <<= 1) {
+    counters.push_back(power - 1);
+    counters.push_back(power);
+    if (power < maxPulses) {
+      counters.push_back(power + 1);
+    }
+  }
+  for (int i = 0; i < 100000; ++i) {
+    counters.push_back(nextRandom(randomState) % (maxPulses + 1));
+  }
+  return counters;
+}
+
+uint64_t exactWatts(uint64_t spanUs, uint32_t pulses, uint16_t pulsePerKWh, uint32_t ptCorrectionUs) {
+  const unsigned __int128 denominator =
+      static_cast<unsigned __int128>(pulsePerKWh) * (spanUs + static_cast<uint64_t>(ptCorrectionUs) * pulses);
+  const unsigned __int128 exactW =
+      (static_cast<unsigned __int128>(MICROSECOND_WATTS_PER_KWH) * pulses + denominator / 2) / denominator;
+  return exactW > UINT64_MAX ? UINT64_MAX : static_cast<uint64_t>(exactW);
+}
+}  // namespace
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_energy_is_exact_over_the_counter_range() {
+  uint64_t randomState = 0x9E3779B97F4A7C15ULL;
+  for (uint16_t pulsePerKWh : kMeterConstants) {
+    for (uint64_t pulses : energyMathCounters(pulsePerKWh, randomState)) {
+      const uint64_t exactMilliWh =
+          static_cast<uint64_t>((static_cast<unsigned __int128>(pulses) * MILLI_WH_PER_KWH) / pulsePerKWh);
+      const uint64_t milliWh = pulsesToMilliWh(pulses, pulsePerKWh);
+      char message[96];
+      snprintf(message, sizeof(message), "%llu pulses @ %u imp/kWh", (unsigned long long)pulses, (unsigned)pulsePerKWh);
+      TEST_ASSERT_TRUE_MESSAGE(milliWh == exactMilliWh, message);
+      if (MILLI_WH_PER_KWH % pulsePerKWh == 0) {
+        TEST_ASSERT_TRUE_MESSAGE(milliWhToPulses(milliWh, pulsePerKWh) == pulses, message);
+      }
+    }
+  }
+}
+
+void test_power_is_rounded_to_nearest() {
+  // Spans from 1 us to ~71 minutes, 1..4096 pulses; beyond UINT32_MAX W it saturates
+  uint64_t randomState = 0x9E3779B97F4A7C15ULL;
+  for (uint16_t pulsePerKWh : kMeterConstants) {
+    for (int i = 0; i < 200000; ++i) {
+      const uint64_t spanUs = 1 + nextRandom(randomState) % UINT32_MAX;
+      const uint32_t pulses = 1 + static_cast<uint32_t>(nextRandom(randomState) % 4096);
+      const uint64_t exactW = exactWatts(spanUs, pulses, pulsePerKWh, 0);
+      char message[96];
+      snprintf(message, sizeof(message), "%u pulses in %llu us @ %u imp/kWh", (unsigned)pulses,
+               (unsigned long long)spanUs, (unsigned)pulsePerKWh);
+      TEST_ASSERT_EQUAL_UINT32_MESSAGE(exactW > UINT32_MAX ? UINT32_MAX : exactW,
+                                       pulseSpanToWatts(spanUs, pulses, pulsePerKWh, 0), message);
+    }
+  }
+}
+
+void test_power_of_no_pulses_or_no_time_is_zero() {
+  TEST_ASSERT_EQUAL_UINT32(0, pulseSpanToWatts(1000, 0, 1000, 0));
+  TEST_ASSERT_EQUAL_UINT32(0, pulseSpanToWatts(1000, 1, 0, 0));
+  TEST_ASSERT_EQUAL_UINT32(0, pulseSpanToWatts(0, 1, 1000, 0));
+  TEST_ASSERT_EQUAL_UINT32(0, pulsesToMilliWh(1000, 0));
+}
+
+// At 100 imp/kWh a pulse is 10 Wh (36 kJ): one in less than ~8.4 us is more than UINT32_MAX W
+void test_power_saturates_instead_of_wrapping() {
+  for (uint64_t spanUs = 1; spanUs < 9; ++spanUs) {
+    const uint64_t exactW = exactWatts(spanUs, 1, 100, 0);
+    const uint32_t expectedW = exactW > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(exactW);
+    TEST_ASSERT_EQUAL_UINT32(expectedW, pulseSpanToWatts(spanUs, 1, 100, 0));
+  }
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, pulseSpanToWatts(1, 1, 100, 0));
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, pulseSpanToWatts(1, 4096, 100, 0));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_energy_is_exact_over_the_counter_range);
+  RUN_TEST(test_power_is_rounded_to_nearest);
+  RUN_TEST(test_power_saturates_instead_of_wrapping);
+  RUN_TEST(test_power_of_no_pulses_or_no_time_is_zero);
+  return UNITY_END();
+}
@@ -0,0 +1,126 @@
+/*
+ * Non-blocking MQTT connect in mqttLoop(): a slow simulated broker, then the broker down, a
+ * black-holed TCP handshake, a withheld and a refused CONNACK. Checks the reconnect backoff, the
+ * failure counters in <device>/log/mqtt/connect and that no mqttLoop() call took longer than a
+ * network tick.
+ *
+ *   pio test -e native -f test_mqtt_connect
+ */
+#include <unity.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "HalSim.h"
+#include "MqttClient.h"
+#include "NativeHarness.h"
+#include "WorkerPool.h"
+#include "config.h"
+
+using namespace NativeHarness;
+
+namespace {
+constexpr uint32_t TCP_LATENCY_MS = 300;
+constexpr uint32_t CONNACK_LATENCY_MS = 400;
+constexpr uint32_t BACKOFF_ATTEMPTS = 4;
+constexpr uint32_t SLACK_MS = 50;   // Scheduling: a tick plus host jitter
+
+ConnectStats sStats = {};
+
+uint32_t connectAttempts() {
+  return HalSim::mqttBrokerStats().connectAttempts;
+}
+
+// Drops the current session the way a broker restart does, with the next attempts configured by `fault`
+template <typename Fault>
+void dropMqttSessionWith(Fault fault) {
+  const uint32_t seen = connectAttempts();
+  fault();
+  dropMqttSession();
+  waitUntil([seen] { return connectAttempts() > seen; }, 1000);
+  delay(SLACK_MS);
+  HalSim::setMqttConnectLatency(0, 0);
+  HalSim::setMqttConnackCode(0);
+}
+}  // namespace
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_connects_to_a_slow_broker() {
+  HalSim::setMqttConnectLatency(TCP_LATENCY_MS, CONNACK_LATENCY_MS);
+  startWorkerPool();
+  xTaskCreate(networkTask, "NetworkTask", NETWORK_TASK_STACK_SIZE, &params, 1, nullptr);
+  TEST_ASSERT_TRUE_MESSAGE(waitForConnect(1, MQTT_CONNECT_TIMEOUT_MS, &sStats), "MQTT did not connect");
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(TCP_LATENCY_MS + CONNACK_LATENCY_MS, sStats.latencyMs + SLACK_MS);
+  HalSim::setMqttConnectLatency(0, 0);
+}
+
+// Broker down: refused at once, attempts back off MIN, 2 * MIN, ... each shortened by up to half
+void test_backs_off_while_the_broker_is_down() {
+  std::vector<uint32_t> attemptMs;
+  uint32_t seen = connectAttempts();
+  HalSim::setMqttBrokerOnline(false);
+  waitUntil([&] {
+    for (const uint32_t attempts = connectAttempts(); seen < attempts; seen++) {
+      attemptMs.push_back(millis());
+    }
+    return attemptMs.size() >= BACKOFF_ATTEMPTS;
+  }, 2 * (MQTT_RECONNECT_BACKOFF_MIN_MS << BACKOFF_ATTEMPTS));
+  TEST_ASSERT_EQUAL_UINT32(BACKOFF_ATTEMPTS, attemptMs.size());
+  for (size_t i = 1; i < attemptMs.size(); ++i) {
+    const uint32_t gapMs = attemptMs[i] - attemptMs[i - 1];
+    const uint32_t backoffMs = std::min(MQTT_RECONNECT_BACKOFF_MAX_MS, MQTT_RECONNECT_BACKOFF_MIN_MS << (i - 1));
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(backoffMs / 2, gapMs + SLACK_MS);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(backoffMs + SLACK_MS, gapMs);
+  }
+  HalSim::setMqttBrokerOnline(true);
+  TEST_ASSERT_TRUE_MESSAGE(waitForConnect(2, 2 * (MQTT_RECONNECT_BACKOFF_MIN_MS << BACKOFF_ATTEMPTS), &sStats),
+                           "not reconnected");
+  TEST_ASSERT_EQUAL_UINT32(BACKOFF_ATTEMPTS, sStats.tcpFailures);
+}
+
+// Black hole: the handshake never completes, the attempt times out and the next one connects
+void test_times_out_a_black_holed_handshake() {
+  dropMqttSessionWith([] { HalSim::setMqttConnectLatency(60000, 0); });
+  TEST_ASSERT_TRUE_MESSAGE(waitForConnect(3, MQTT_TCP_CONNECT_TIMEOUT_MS + MQTT_RECONNECT_BACKOFF_MIN_MS + 1000, &sStats),
+                           "not reconnected");
+  TEST_ASSERT_EQUAL_UINT32(1, sStats.timeouts);
+}
+
+void test_times_out_a_missing_connack() {
+  dropMqttSessionWith([] { HalSim::setMqttConnackCode(-1); });
+  TEST_ASSERT_TRUE_MESSAGE(waitForConnect(4, MQTT_CONNACK_TIMEOUT_MS + MQTT_RECONNECT_BACKOFF_MIN_MS + 1000, &sStats),
+                           "not reconnected");
+  TEST_ASSERT_EQUAL_UINT32(2, sStats.timeouts);
+}
+
+void test_counts_a_refused_connack() {
+  dropMqttSessionWith([] { HalSim::setMqttConnackCode(5); });  // Not authorized
+  TEST_ASSERT_TRUE_MESSAGE(waitForConnect(5, MQTT_RECONNECT_BACKOFF_MIN_MS + 1000, &sStats), "not reconnected");
+  TEST_ASSERT_EQUAL_UINT32(1, sStats.connackFailures);
+}
+
+void test_mqtt_loop_never_blocks_a_network_tick() {
+  TEST_ASSERT_LESS_THAN_UINT32(NETWORK_TICK_MS * 1000, mqttLoopMaxUs());
+}
+
+int main() {
+  initializeGlobals(&params);
+  UNITY_BEGIN();
+  RUN_TEST(test_connects_to_a_slow_broker);
+  RUN_TEST(test_backs_off_while_the_broker_is_down);
+  RUN_TEST(test_times_out_a_black_holed_handshake);
+  RUN_TEST(test_times_out_a_missing_connack);
+  RUN_TEST(test_counts_a_refused_connack);
+  RUN_TEST(test_mqtt_loop_never_blocks_a_network_tick);
+  // The firmware tasks never return; leave without running static destructors underneath them
+  const int failures = UNITY_END();
+  fflush(stdout);
+  std::_Exit(failures);
+}
@@ -0,0 +1,148 @@
+/*
+ * Home Assistant discovery: published on first boot with its hash stored in NVS, not republished
+ * on reconnects, republished once per homeassistant/status birth and after a boot with another
+ * firmware's hash. No loop task runs: the test thread calls mqttProcessRxQueue() for
+ * homeassistant/status.
+ *
+ *   pio test -e native -f test_mqtt_discovery
+ */
+#include <unity.h>
+
+#include <Preferences.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "HalSim.h"
+#include "MqttClient.h"
+#include "NativeHarness.h"
+#include "WorkerPool.h"
+#include "config.h"
+
+using namespace NativeHarness;
+
+namespace {
+std::atomic<uint32_t> sDiscoveryPublishes{0};
+constexpr uint32_t RECONNECT_TIMEOUT_MS = MQTT_CONNECT_TIMEOUT_MS + MQTT_RECONNECT_BACKOFF_MAX_MS;
+ConnectStats sStats = {};
+uint32_t sFirstBoot = 0;
+uint32_t sHash = 0;
+
+void recordDiscoveryPublish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+  (void)payload;
+  (void)length;
+  const size_t topicLength = strlen(topic);
+  if (retained && strncmp(topic, MQTT_DISCOVERY_PREFIX, strlen(MQTT_DISCOVERY_PREFIX)) == 0 && topicLength > 7 &&
+      strcmp(topic + topicLength - 7, "/config") == 0) {
+    sDiscoveryPublishes++;
+  }
+}
+
+// Waits for the bulk lane to drain, then returns the discovery configurations published since `before`
+uint32_t discoveryPublishedSince(uint32_t before) {
+  waitUntil([&] { return sDiscoveryPublishes - before >= 4; }, 3000);
+  delay(SETTLE_MS);
+  return sDiscoveryPublishes - before;
+}
+
+uint32_t storedDiscoveryHash() {
+  Preferences pref;
+  pref.begin(MQTT_NVS_NAMESPACE, true);
+  const uint32_t hash = pref.getUInt("disc_hash", 0);
+  pref.end();
+  return hash;
+}
+
+// Reboots, simulated by running mqttInit() again while paused
+void reboot() {
+  mqttPause();
+  mqttInit(&params);
+  mqttResume();
+  TEST_ASSERT_TRUE_MESSAGE(waitForConnect(sStats.connects + 1, RECONNECT_TIMEOUT_MS, &sStats),
+                           "MQTT did not reconnect");
+}
+}  // namespace
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// First boot: nothing stored, so the configurations go out and their hash is stored
+void test_first_boot_publishes_and_stores_the_hash() {
+  HalSim::clearNvs();
+  HalSim::setPublishObserver(recordDiscoveryPublish);
+  startWorkerPool();
+  xTaskCreate(networkTask, "NetworkTask", NETWORK_TASK_STACK_SIZE, &params, 1, nullptr);
+  TEST_ASSERT_TRUE_MESSAGE(waitForConnect(1, MQTT_CONNECT_TIMEOUT_MS, &sStats), "MQTT did not connect");
+  sFirstBoot = discoveryPublishedSince(0);
+  sHash = storedDiscoveryHash();
+  TEST_ASSERT_GREATER_THAN_UINT32(0, sFirstBoot);
+  TEST_ASSERT_NOT_EQUAL(0, sHash);
+}
+
+// Reconnect storm: the broker still has them retained, nothing is rebuilt or republished
+void test_reconnects_do_not_republish() {
+  constexpr uint32_t RECONNECTS = 10;
+  const uint32_t before = sDiscoveryPublishes;
+  for (uint32_t i = 0; i < RECONNECTS; ++i) {
+    dropMqttSession();
+    TEST_ASSERT_TRUE_MESSAGE(waitForConnect(sStats.connects + 1, RECONNECT_TIMEOUT_MS, &sStats),
+                             "MQTT did not reconnect");
+  }
+  delay(SETTLE_MS);
+  TEST_ASSERT_EQUAL_UINT32(0, sDiscoveryPublishes - before);
+}
+
+void test_home_assistant_birth_republishes_once() {
+  // Home Assistant comes online (birth message): republished once
+  uint32_t before = sDiscoveryPublishes;
+  TEST_ASSERT_TRUE(deliverInbound({{MQTT_DISCOVERY_STATUS_TOPIC, "online"}}));
+  mqttProcessRxQueue();
+  TEST_ASSERT_EQUAL_UINT32(sFirstBoot, discoveryPublishedSince(before));
+  // The same retained birth again, as after a resubscribe: nothing
+  before = sDiscoveryPublishes;
+  TEST_ASSERT_TRUE(deliverInbound({{MQTT_DISCOVERY_STATUS_TOPIC, "online"}}));
+  mqttProcessRxQueue();
+  delay(SETTLE_MS);
+  TEST_ASSERT_EQUAL_UINT32(0, sDiscoveryPublishes - before);
+  // Home Assistant restarts: last will, then birth
+  before = sDiscoveryPublishes;
+  TEST_ASSERT_TRUE(deliverInbound({{MQTT_DISCOVERY_STATUS_TOPIC, "offline"}, {MQTT_DISCOVERY_STATUS_TOPIC, "online"}}));
+  mqttProcessRxQueue();
+  TEST_ASSERT_EQUAL_UINT32(sFirstBoot, discoveryPublishedSince(before));
+}
+
+// With a stored hash from other firmware the configurations go out after the connect and the hash
+// is updated; with a matching one nothing
+void test_reboot_republishes_only_on_another_hash() {
+  Preferences pref;
+  pref.begin(MQTT_NVS_NAMESPACE, false);
+  pref.putUInt("disc_hash", sHash ^ 1);
+  pref.end();
+  uint32_t before = sDiscoveryPublishes;
+  reboot();
+  TEST_ASSERT_EQUAL_UINT32(sFirstBoot, discoveryPublishedSince(before));
+  TEST_ASSERT_EQUAL_HEX32(sHash, storedDiscoveryHash());
+
+  before = sDiscoveryPublishes;
+  reboot();
+  delay(SETTLE_MS);
+  TEST_ASSERT_EQUAL_UINT32(0, sDiscoveryPublishes - before);
+}
+
+int main() {
+  initializeGlobals(&params);
+  UNITY_BEGIN();
+  RUN_TEST(test_first_boot_publishes_and_stores_the_hash);
+  RUN_TEST(test_reconnects_do_not_republish);
+  RUN_TEST(test_home_assistant_birth_republishes_once);
+  RUN_TEST(test_reboot_republishes_only_on_another_hash);
+  // The firmware tasks never return; leave without running static destructors underneath them
+  const int failures = UNITY_END();
+  fflush(stdout);
+  std::_Exit(failures);
+}
@@ -0,0 +1,189 @@
+/*
+ * Offline energy buffer (MqttHistoryBuffer.h): both drop policies when it overflows, replay position
+ * across reboots and power cuts in the middle of appends and replay marks. Then the simulated broker
+ * goes offline for a day of samples recorded through mqttHistoryTick(), which must be replayed in
+ * order and at the configured rate.
+ *
+ *   pio test -e native -f test_mqtt_history
+ */
+#include <unity.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "HalSim.h"
+#include "MqttClient.h"
+#include "MqttHistoryBuffer.h"
+#include "MqttMessage.h"
+#include "NativeHarness.h"
+#include "config.h"
+
+using namespace NativeHarness;
+
+namespace {
+constexpr uint32_t FUZZ_BOOTS = 500;
+
+std::mutex sPublishesMutex;
+std::vector<std::pair<uint32_t, uint32_t>> sPublishes;  // Sample time, millis() at publish
+
+void recordHistoryPublish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+  (void)retained;
+  if (strcmp(topic, mqttTopic(MQTT_TOPIC_HISTORY)) != 0) {
+    return;
+  }
+  const std::string text(reinterpret_cast<const char*>(payload), length);
+  std::lock_guard<std::mutex> lock(sPublishesMutex);
+  sPublishes.push_back({static_cast<uint32_t>(strtoul(text.c_str() + 6, nullptr, 10)), millis()});
+}
+
+// Fills the buffer past its capacity, reboots and replays what is left under the given drop policy
+void assertOverflow(bool dropOldest) {
+  HalSim::eraseFlashPartition(MQTT_HISTORY_PARTITION_LABEL);
+  MqttHistoryBuffer buffer;
+  buffer.begin(MQTT_HISTORY_PARTITION_LABEL, dropOldest);
+  const uint32_t appended = buffer.capacity() + buffer.capacity() / 2;
+  for (uint32_t i = 1; i <= appended; ++i) {
+    buffer.append({i, i, i});
+  }
+  buffer.begin(MQTT_HISTORY_PARTITION_LABEL, dropOldest);  // Reboot: everything comes back from flash
+  uint32_t replayed = 0;
+  uint32_t last = 0;
+  MqttHistorySample sample;
+  while (buffer.peek(&sample)) {
+    TEST_ASSERT_GREATER_THAN_UINT32(last, sample.timestamp);
+    TEST_ASSERT_TRUE(sample.energyMilliWh == sample.timestamp);
+    last = sample.timestamp;
+    buffer.markReplayed();
+    replayed++;
+  }
+  // Drop oldest keeps the newest samples, drop newest the first ones; a sector is kept free to erase
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(buffer.capacity(), replayed + MqttHistoryBuffer::SLOTS_PER_SECTOR);
+  TEST_ASSERT_EQUAL_UINT32(dropOldest ? appended : replayed, last);
+}
+}  // namespace
+
+void setUp() {
+}
+
+void tearDown() {
+  HalSim::flashPowerFailAfter(-1);
+}
+
+void test_overflow_drops_oldest() {
+  assertOverflow(true);
+}
+
+void test_overflow_drops_newest() {
+  assertOverflow(false);
+}
+
+// Random appends and replays with power cuts: acknowledged samples are replayed exactly once, in
+// order, except the in-flight one (an append may or may not survive, a replay mark may be lost)
+void test_replays_once_in_order_across_power_cuts() {
+  HalSim::eraseFlashPartition(MQTT_HISTORY_PARTITION_LABEL);
+  uint64_t randomState = 0x4157C0DEULL;
+  MqttHistoryBuffer buffer;
+  uint32_t nextTimestamp = 1;
+  uint32_t lastReplayed = 0;
+  std::vector<uint32_t> acknowledged;  // Appended, not replayed yet, oldest first
+  uint32_t replays = 0;
+
+  for (uint32_t round = 0; round < FUZZ_BOOTS; ++round) {
+    buffer.begin(MQTT_HISTORY_PARTITION_LABEL, true);
+    const bool cut = nextRandom(randomState) % 2 == 0;
+    HalSim::flashPowerFailAfter(cut ? static_cast<int64_t>(nextRandom(randomState) % 4000) : -1);
+
+    const uint32_t operations = static_cast<uint32_t>(nextRandom(randomState) % 200);
+    for (uint32_t op = 0; op < operations; ++op) {
+      if (nextRandom(randomState) % 3 != 0 && acknowledged.size() < buffer.capacity() / 2) {
+        const uint32_t timestamp = nextTimestamp++;
+        if (!buffer.append({timestamp, timestamp, timestamp})) {
+          break;  // Power is gone
+        }
+        acknowledged.push_back(timestamp);
+        continue;
+      }
+      MqttHistorySample sample;
+      if (!buffer.peek(&sample)) {
+        TEST_ASSERT_TRUE_MESSAGE(acknowledged.empty(), "acknowledged sample lost");
+        continue;
+      }
+      char message[64];
+      snprintf(message, sizeof(message), "boot %u: replayed %u", (unsigned)round, (unsigned)sample.timestamp);
+      if (sample.timestamp == lastReplayed) {
+        // Replay mark lost in the last power cut
+      } else if (!acknowledged.empty() && sample.timestamp == acknowledged.front()) {
+        acknowledged.erase(acknowledged.begin());
+      } else if (acknowledged.empty() || sample.timestamp > acknowledged.front()) {
+        // Unacknowledged append that made it to flash before the cut: replayed once, in order
+        TEST_ASSERT_TRUE_MESSAGE(sample.timestamp > lastReplayed &&
+                                     (acknowledged.empty() || sample.timestamp < acknowledged.front()),
+                                 message);
+      } else {
+        TEST_FAIL_MESSAGE(message);
+      }
+      lastReplayed = sample.timestamp;
+      replays++;
+      if (!buffer.markReplayed()) {
+        break;  // Power is gone; the sample may be replayed again
+      }
+    }
+    HalSim::flashPowerFailAfter(-1);
+  }
+  TEST_ASSERT_GREATER_THAN_UINT32(FUZZ_BOOTS, replays);
+}
+
+void test_broker_outage_is_replayed_in_order_and_throttled() {
+  HalSim::eraseFlashPartition(MQTT_HISTORY_PARTITION_LABEL);
+  TEST_ASSERT_TRUE_MESSAGE(startNetwork(), "MQTT did not connect");
+  delay(SETTLE_MS);
+
+  mqttPause();  // The network task stops calling mqttHistoryTick(); the test drives it instead
+  HalSim::setMqttBrokerOnline(false);
+  HalSim::setPublishObserver(recordHistoryPublish);
+  constexpr uint32_t START = 1760000000 - 1760000000 % MQTT_HISTORY_SAMPLE_INTERVAL_S;
+  constexpr uint32_t SAMPLES = 86400 / MQTT_HISTORY_SAMPLE_INTERVAL_S;
+  for (uint32_t i = 0; i < SAMPLES; ++i) {
+    mqttHistoryTick(static_cast<time_t>(START + i * MQTT_HISTORY_SAMPLE_INTERVAL_S + 1));
+  }
+  HalSim::setMqttBrokerOnline(true);
+  mqttResume();
+
+  waitUntil([] {
+    std::lock_guard<std::mutex> lock(sPublishesMutex);
+    return sPublishes.size() >= SAMPLES;
+  }, MQTT_CONNECT_TIMEOUT_MS + 60000);
+  HalSim::setPublishObserver(nullptr);
+
+  std::vector<std::pair<uint32_t, uint32_t>> publishes;
+  {
+    std::lock_guard<std::mutex> lock(sPublishesMutex);
+    publishes = sPublishes;
+  }
+  TEST_ASSERT_EQUAL_UINT32(SAMPLES, publishes.size());
+  for (size_t i = 0; i < publishes.size(); ++i) {
+    // The network task has already ticked with the host clock, so the first synthetic tick records
+    TEST_ASSERT_EQUAL_UINT32(START + i * MQTT_HISTORY_SAMPLE_INTERVAL_S, publishes[i].first);
+  }
+  const uint32_t replayMs = publishes.back().second - publishes.front().second;
+  const uint32_t minimumMs = (SAMPLES - 1) / MQTT_HISTORY_REPLAY_BATCH * MQTT_HISTORY_REPLAY_INTERVAL_MS;
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(minimumMs, replayMs + MQTT_HISTORY_REPLAY_INTERVAL_MS);
+}
+
+int main() {
+  initializeGlobals(&params);
+  UNITY_BEGIN();
+  RUN_TEST(test_overflow_drops_oldest);
+  RUN_TEST(test_overflow_drops_newest);
+  RUN_TEST(test_replays_once_in_order_across_power_cuts);
+  RUN_TEST(test_broker_outage_is_replayed_in_order_and_throttled);
+  // The firmware tasks never return; leave without running static destructors underneath them
+  const int failures = UNITY_END();
+  fflush(stdout);
+  std::_Exit(failures);
+}
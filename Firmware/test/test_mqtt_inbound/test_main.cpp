@@ -0,0 +1,133 @@
+/*
+ * The MQTT RX ring between mqttCallback() and mqttProcessRxQueue(): a burst of Home Assistant /set
+ * updates handled in order, a TeslaMate flood larger than the ring (the newest dropped and counted)
+ * and an oversized payload truncated as before, all checked against <device>/log/mqtt/inbound.
+ * No loop task runs: the test thread calls mqttProcessRxQueue(), so messages stay in the ring until
+ * it does.
+ *
+ *   pio test -e native -f test_mqtt_inbound
+ */
+#include <unity.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "HalSim.h"
+#include "MqttClient.h"
+#include "MqttMessage.h"
+#include "MqttRecordRing.h"
+#include "MqttSetCommand.h"
+#include "NativeHarness.h"
+#include "config.h"
+
+using namespace NativeHarness;
+
+namespace {
+struct InboundStats {
+  unsigned long received;
+  unsigned long dropped;
+  unsigned long truncated;
+  unsigned long processed;
+  unsigned long peakBytes;
+};
+InboundStats sStats = {};  // The last report read; nothing is reported before the first message
+
+// Publishes <device>/log/mqtt/inbound, gives the broker up to a second to have it and parses it
+// (unchanged counters publish the same payload again)
+bool readInboundStats(InboundStats* stats) {
+  char previous[MQTT_PAYLOAD_LEN] = {0};
+  char payload[MQTT_PAYLOAD_LEN] = {0};
+  HalSim::lastPublished(mqttTopic(MQTT_TOPIC_LOG_MQTT_INBOUND), previous, sizeof(previous));
+  if (publishMqttInboundStats()) {
+    waitUntil([&] {
+      return HalSim::lastPublished(mqttTopic(MQTT_TOPIC_LOG_MQTT_INBOUND), payload, sizeof(payload)) &&
+             strcmp(payload, previous) != 0;
+    }, 1000);
+  }
+  HalSim::lastPublished(mqttTopic(MQTT_TOPIC_LOG_MQTT_INBOUND), payload, sizeof(payload));
+  const char* text = strstr(payload, "received:");
+  return text != nullptr &&
+         sscanf(text, "received:%lu dropped:%lu truncated:%lu processed:%lu peak_bytes:%lu", &stats->received,
+                &stats->dropped, &stats->truncated, &stats->processed, &stats->peakBytes) == 5;
+}
+}  // namespace
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_connects_to_the_broker() {
+  TEST_ASSERT_TRUE_MESSAGE(startNetwork(), "MQTT did not connect");
+  delay(SETTLE_MS);
+}
+
+// A burst of Home Assistant updates, handled in order once mqttProcessRxQueue() gets to them
+void test_set_burst_is_applied_in_order() {
+  constexpr uint32_t HA_MESSAGES = 8;
+  const InboundStats before = sStats;
+  std::vector<std::pair<std::string, std::string>> burst;
+  for (uint32_t i = 0; i < HA_MESSAGES; ++i) {
+    char payload[160];
+    snprintf(payload, sizeof(payload),
+             "{\"smartChg\": %s, \"chgStartTime\": \"0%u:00\", \"currEPrice\": 1.02, \"ePriceLimit\": %u.5, \"maxEPrice\": 1.25}",
+             i % 2 ? "true" : "false", (unsigned)i, (unsigned)i);
+    burst.emplace_back(mqttTopic(MQTT_TOPIC_SET), payload);
+  }
+  TEST_ASSERT_TRUE(deliverInbound(burst));
+  mqttProcessRxQueue();
+  TEST_ASSERT_TRUE(readInboundStats(&sStats));
+  TEST_ASSERT_EQUAL_UINT32(HA_MESSAGES, sStats.received - before.received);
+  TEST_ASSERT_EQUAL_UINT32(0, sStats.dropped - before.dropped);
+  TEST_ASSERT_TRUE(gSmartChargingActivated);
+  TEST_ASSERT_TRUE(gEnergyPriceLimit == 7.5f);
+  TEST_ASSERT_TRUE(gEnergyPriceRef == 1.25f);
+  TEST_ASSERT_EQUAL_STRING("07:00", gChargingStartTime);
+}
+
+// More TeslaMate updates than fit: the newest are dropped and counted, the rest handled
+void test_flood_drops_and_counts_the_newest() {
+  const char* pluggedTopic = MQTT_TESLAMATE_PLUGGED_IN_TOPIC;
+  const uint32_t fit =
+      MQTT_RX_RING_BYTES / MqttRecordRing<MQTT_RX_RING_BYTES>::recordSize(strlen(pluggedTopic), strlen("false"));
+  const uint32_t flood = fit + 20;
+  const InboundStats before = sStats;
+  TEST_ASSERT_TRUE(deliverInbound(
+      std::vector<std::pair<std::string, std::string>>(flood, std::make_pair(std::string(pluggedTopic), std::string("false")))));
+  TEST_ASSERT_TRUE(readInboundStats(&sStats));
+  TEST_ASSERT_EQUAL_UINT32(fit, sStats.received - before.received);
+  TEST_ASSERT_EQUAL_UINT32(flood - fit, sStats.dropped - before.dropped);
+  mqttProcessRxQueue();
+  TEST_ASSERT_TRUE(readInboundStats(&sStats));
+  TEST_ASSERT_EQUAL_UINT32(sStats.received, sStats.processed);
+}
+
+// An oversized payload is cut to MQTT_PAYLOAD_LEN - 1 bytes, as before, and then fails as JSON
+void test_oversized_payload_is_truncated() {
+  const InboundStats before = sStats;
+  const std::string oversized = "{\"" + std::string(MQTT_SET_KEY_LEN, 'k') + "\": \"" + std::string(1500, 'x') + "\"}";
+  TEST_ASSERT_TRUE(deliverInbound({{mqttTopic(MQTT_TOPIC_SET), oversized}}));
+  mqttProcessRxQueue();
+  TEST_ASSERT_TRUE(readInboundStats(&sStats));
+  TEST_ASSERT_EQUAL_UINT32(1, sStats.truncated - before.truncated);
+  TEST_ASSERT_EQUAL_UINT32(1, sStats.received - before.received);
+  TEST_ASSERT_EQUAL_UINT32(sStats.received, sStats.processed);
+}
+
+int main() {
+  initializeGlobals(&params);
+  UNITY_BEGIN();
+  RUN_TEST(test_connects_to_the_broker);
+  RUN_TEST(test_set_burst_is_applied_in_order);
+  RUN_TEST(test_flood_drops_and_counts_the_newest);
+  RUN_TEST(test_oversized_payload_is_truncated);
+  // The firmware tasks never return; leave without running static destructors underneath them
+  const int failures = UNITY_END();
+  fflush(stdout);
+  std::_Exit(failures);
+}
@@ -0,0 +1,123 @@
+/*
+ * MQTT outbound lanes (MqttClient.h): with the network task paused, flood the bulk and log lanes,
+ * store an energy state and queue a control message last. Once resumed the broker must see control,
+ * state, log and bulk in that order, each lane in FIFO order, and the log lane must have dropped
+ * only what did not fit.
+ *
+ *   pio test -e native -f test_mqtt_lanes
+ */
+#include <unity.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "HalSim.h"
+#include "MqttClient.h"
+#include "MqttMessage.h"
+#include "MqttRecordRing.h"
+#include "NativeHarness.h"
+#include "config.h"
+
+using namespace NativeHarness;
+
+namespace {
+std::mutex sPublishesMutex;
+std::vector<std::string> sPublishes;  // Broker-side publish order
+
+void recordLanePublish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+  (void)retained;
+  static bool stateSeen = false;
+  const bool state = strcmp(topic, mqttTopic(MQTT_TOPIC_STATE)) == 0;
+  if ((strncmp(topic, "lanes/", 6) != 0 && !state) || (state && stateSeen)) {
+    return; // Later states come from the discovery task after reconnecting
+  }
+  std::lock_guard<std::mutex> lock(sPublishesMutex);
+  stateSeen = stateSeen || state;
+  sPublishes.push_back(std::string(topic) + " " + std::string(reinterpret_cast<const char*>(payload), length));
+}
+
+void assertPublish(const std::vector<std::string>& publishes, size_t index, const std::string& prefix) {
+  char message[96];
+  snprintf(message, sizeof(message), "position %u", (unsigned)index);
+  TEST_ASSERT_TRUE_MESSAGE(index < publishes.size(), message);
+  TEST_ASSERT_EQUAL_STRING_MESSAGE(prefix.c_str(), publishes[index].substr(0, prefix.size()).c_str(), message);
+}
+}  // namespace
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_lanes_drain_by_priority() {
+  TEST_ASSERT_TRUE_MESSAGE(startNetwork(), "MQTT did not connect");
+  delay(SETTLE_MS);
+
+  // Nothing is drained while paused
+  mqttPause();
+  HalSim::setPublishObserver(recordLanePublish);
+  const std::string bulkPayload(600, 'c');
+  const uint32_t bulkMessages =
+      MQTT_BULK_LANE_BYTES / MqttRecordRing<MQTT_BULK_LANE_BYTES>::recordSize(strlen("lanes/bulk/00"), bulkPayload.size());
+  uint32_t bulkQueued = 0;
+  for (uint32_t i = 0; i < bulkMessages; ++i) {
+    char topic[32];
+    snprintf(topic, sizeof(topic), "lanes/bulk/%02u", (unsigned)i);
+    bulkQueued += mqttEnqueuePublish(topic, bulkPayload.c_str(), true, MQTT_LANE_BULK) ? 1 : 0;
+  }
+  constexpr uint32_t LOG_MESSAGES = 200;
+  uint32_t logQueued = 0;
+  for (uint32_t i = 0; i < LOG_MESSAGES; ++i) {
+    char payload[96];
+    snprintf(payload, sizeof(payload), "%03u diagnostics line padded to a realistic log length ..........", (unsigned)i);
+    logQueued += mqttEnqueuePublish("lanes/log", payload, true, MQTT_LANE_LOG) ? 1 : 0;
+  }
+  TEST_ASSERT_TRUE_MESSAGE(publishMqttEnergy(11000, 11000, 5000000, 100000), "state dropped");
+  TEST_ASSERT_TRUE_MESSAGE(mqttEnqueuePublish("lanes/control", "True", true, MQTT_LANE_CONTROL), "control dropped");
+  mqttResume();
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(bulkMessages, bulkQueued, "bulk lane dropped a message that fits");
+  TEST_ASSERT_TRUE_MESSAGE(logQueued > 0 && logQueued < LOG_MESSAGES, "log lane did not overflow");
+
+  const size_t expected = 2 + logQueued + bulkQueued;
+  waitUntil([expected] {
+    std::lock_guard<std::mutex> lock(sPublishesMutex);
+    return sPublishes.size() >= expected;
+  }, MQTT_CONNECT_TIMEOUT_MS);
+  HalSim::setPublishObserver(nullptr);
+
+  // Expected: control, state, logs 0..logQueued-1, bulk 0..bulkQueued-1
+  std::vector<std::string> publishes;
+  {
+    std::lock_guard<std::mutex> lock(sPublishesMutex);
+    publishes = sPublishes;
+  }
+  TEST_ASSERT_EQUAL_UINT32(expected, publishes.size());
+  size_t index = 0;
+  assertPublish(publishes, index++, "lanes/control ");
+  assertPublish(publishes, index++, std::string(mqttTopic(MQTT_TOPIC_STATE)) + " ");
+  for (uint32_t i = 0; i < logQueued; ++i) {
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "lanes/log %03u", (unsigned)i);
+    assertPublish(publishes, index++, prefix);
+  }
+  for (uint32_t i = 0; i < bulkQueued; ++i) {
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "lanes/bulk/%02u ", (unsigned)i);
+    assertPublish(publishes, index++, prefix);
+  }
+}
+
+int main() {
+  initializeGlobals(&params);
+  UNITY_BEGIN();
+  RUN_TEST(test_lanes_drain_by_priority);
+  // The firmware tasks never return; leave without running static destructors underneath them
+  const int failures = UNITY_END();
+  fflush(stdout);
+  std::_Exit(failures);
+}
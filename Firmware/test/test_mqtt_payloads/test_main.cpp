@@ -0,0 +1,301 @@
+/*
+ * MQTT payload code without a broker: the outbound record ring (MqttRecordRing.h), the energy state
+ * writer (MqttStateJson.h), the discovery table (MqttDiscoveryJson.h) and the /set decoder
+ * (MqttSetCommand.h), each against the JsonDocument code it replaced (LegacyReference.h).
+ *
+ * The /set fuzz feeds random payloads to both decoders and checks they agree, that every prefix of
+ * a payload is IncompleteInput, and that randomly corrupted payloads are either decoded as the
+ * JsonDocument decodes them or rejected without running a handler. Each payload is parsed from an
+ * exact-size heap copy, so a build with -fsanitize=address also catches reads past its end.
+ *
+ *   pio test -e native -f test_mqtt_payloads
+ */
+#include <unity.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "HalSim.h"
+#include "LegacyReference.h"
+#include "MqttRecordRing.h"
+#include "MqttStateJson.h"
+#include "NativeHarness.h"
+
+using namespace LegacyReference;
+using NativeHarness::nextRandom;
+
+namespace {
+typedef MqttStateJson<MQTT_SENSOR_POWER_ENTITYNAME, MQTT_SENSOR_INSTANT_POWER_ENTITYNAME,
+                      MQTT_NUMBER_ENERGY_ENTITYNAME, MQTT_SENSOR_ENERGY_ENTITYNAME> EnergyStateJson;
+
+constexpr uint32_t SET_FUZZ_PAYLOADS = 20000;
+
+// Random /set payloads: known and unknown keys, values of the right and the wrong type, escapes,
+// long texts and nested values
+std::string randomSetNumber(uint64_t& state) {
+  char text[48];
+  const uint64_t integral = nextRandom(state) % (nextRandom(state) % 2 ? 100000 : 10);
+  switch (nextRandom(state) % 5) {
+    case 0:
+      snprintf(text, sizeof(text), "%llu", (unsigned long long)integral);
+      break;
+    case 1:
+      snprintf(text, sizeof(text), "-%llu.%03u", (unsigned long long)integral, (unsigned)(nextRandom(state) % 1000));
+      break;
+    case 2:
+      snprintf(text, sizeof(text), "%llu.%u", (unsigned long long)integral, (unsigned)(nextRandom(state) % 100000000));
+      break;
+    case 3:
+      snprintf(text, sizeof(text), "%llue%s%u", (unsigned long long)integral, nextRandom(state) % 2 ? "-" : "+",
+               (unsigned)(nextRandom(state) % 12));
+      break;
+    default:
+      snprintf(text, sizeof(text), "0.%06u", (unsigned)(nextRandom(state) % 1000000));
+      break;
+  }
+  return text;
+}
+
+std::string randomSetValue(uint64_t& state, int depth) {
+  static const char* const texts[] = {"\"on\"", "\"OFF\"", "\"True\"", "\"0\"", "\"soft\"", "\"hard\"", "\"02:00\"", "\"\"",
+                                      "\"12.5\"", "\"h\\u00e6rd\"", "\"s\\u006fft\"", "\"a\\\"b\\\\c\\/d\\n\"",
+                                      "\"\\ud83d\\ude00\"", "\"12:3456789\""};
+  switch (nextRandom(state) % (depth < 3 ? 8 : 6)) {
+    case 0:
+    case 1:
+      return randomSetNumber(state);
+    case 2:
+      return nextRandom(state) % 2 ? "true" : "false";
+    case 3:
+      return "null";
+    case 4:
+      return texts[nextRandom(state) % (sizeof(texts) / sizeof(texts[0]))];
+    case 5:
+      return "\"" + std::string(40 + nextRandom(state) % 60, 'x') + "\"";
+    case 6:
+      return "[" + randomSetValue(state, depth + 1) + ", " + randomSetValue(state, depth + 1) + "]";
+    default:
+      return "{\"k\": " + randomSetValue(state, depth + 1) + ", \"\\u006b2\": []}";
+  }
+}
+
+std::string randomSetPayload(uint64_t& state) {
+  static const char* const keys[] = {"\"Total\"", "\"Subtotal\"", "\"smartChg\"", "\"chgStartTime\"", "\"maxEPrice\"",
+                                     "\"ePriceLimit\"", "\"reset\"", "\"currEPrice\"", "\"smart\\u0043hg\"", "\"tota\"",
+                                     "\"resetx\"", "\"\""};
+  const uint32_t keyCount = sizeof(keys) / sizeof(keys[0]);
+  uint32_t used = 0;
+  std::string payload = "{";
+  const uint32_t members = static_cast<uint32_t>(nextRandom(state) % 6);
+  for (uint32_t i = 0; i < members; ++i) {
+    const uint32_t key = static_cast<uint32_t>(nextRandom(state) % keyCount);
+    const uint32_t alias = key == 8 ? 2 : key; // smart\u0043hg is smartChg
+    if (used & (1u << alias)) {
+      continue; // A JsonDocument keeps one value per key, MqttSetTable dispatches both
+    }
+    used |= 1u << alias;
+    payload += (payload.size() > 1 ? (nextRandom(state) % 2 ? ", " : ",") : "");
+    payload += keys[key];
+    payload += nextRandom(state) % 2 ? ": " : ":";
+    payload += randomSetValue(state, 1);
+  }
+  return payload + (nextRandom(state) % 3 ? "}" : " }\n");
+}
+
+std::string mutateSetPayload(std::string payload, uint64_t& state) {
+  static const char significant[] = "{}[]\":,\\ tfnu0123456789.-+eE";
+  const uint32_t edits = 1 + static_cast<uint32_t>(nextRandom(state) % 3);
+  for (uint32_t i = 0; i < edits && !payload.empty(); ++i) {
+    const size_t at = nextRandom(state) % payload.size();
+    const char replacement = nextRandom(state) % 4 == 0 ? static_cast<char>(nextRandom(state) % 256)
+                                                        : significant[nextRandom(state) % (sizeof(significant) - 1)];
+    switch (nextRandom(state) % 4) {
+      case 0:
+        payload[at] = replacement;
+        break;
+      case 1:
+        payload.erase(at, 1 + nextRandom(state) % 3);
+        break;
+      case 2:
+        payload.insert(at, 1, replacement);
+        break;
+      default:
+        payload.resize(at);
+        break;
+    }
+  }
+  return payload;
+}
+
+// Decodes a payload from an exact-size heap copy, so a read past its end is caught by ASan
+SetOutcome streamingSetDecodeExact(const std::string& payload, MqttSetError* error) {
+  std::unique_ptr<char[]> copy(new char[payload.size() ? payload.size() : 1]);
+  memcpy(copy.get(), payload.data(), payload.size());
+  return streamingSetDecode(copy.get(), payload.size(), error);
+}
+
+void assertSameOutcome(const char* what, const std::string& payload, const SetOutcome& expected,
+                       const SetOutcome& actual) {
+  if (!(expected == actual)) {
+    const std::string message = std::string(what) + ": " + payload + "\n  JsonDocument : " +
+                                describeSetOutcome(expected) + "\n  MqttSetTable : " + describeSetOutcome(actual);
+    TEST_FAIL_MESSAGE(message.c_str());
+  }
+}
+}  // namespace
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_record_ring_carries_bursts_in_order_without_drops() {
+  const char* const topics[] = {"homeassistant/sensor/esp32-doit_246F28AABBCC/state",
+                                "ev-e-monitor/esp32-doit_246F28AABBCC/log/status",
+                                "homeassistant/sensor/esp32-doit_246F28AABBCC/power/config"};
+  const std::string payloads[] = {"{\"Forbrug\":3.452,\"Momentan\":3.460,\"Total\":12345.678,\"Subtotal\":42.100}",
+                                  "2026-10-17 12:00:00 - Charging session started", std::string(640, 'd')};
+  constexpr uint32_t MESSAGES = 30000;
+  constexpr uint32_t BURST = 8;  // Messages queued before the consumer drains them
+  static MqttRecordRing<8192> ring;
+  uint32_t received = 0;
+  for (uint32_t i = 0; i < MESSAGES; i += BURST) {
+    for (uint32_t j = 0; j < BURST; ++j) {
+      const uint32_t m = (i + j) % 3;
+      TEST_ASSERT_TRUE(ring.push(topics[m], strlen(topics[m]), payloads[m].c_str(), payloads[m].size(), true));
+    }
+    MqttRecordRing<8192>::Record record;
+    while (ring.peek(&record)) {
+      const uint32_t m = received++ % 3;
+      TEST_ASSERT_EQUAL_UINT32(payloads[m].size(), record.payloadLength);
+      TEST_ASSERT_TRUE(memcmp(record.payload, payloads[m].data(), record.payloadLength) == 0);
+      ring.release();
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(MESSAGES, received);
+  TEST_ASSERT_EQUAL_UINT32(0, ring.stats().dropped);
+}
+
+void test_state_json_matches_json_document() {
+  uint64_t randomState = 0x5EEDC0DEULL;
+  uint32_t written = 0;
+  for (uint32_t i = 0; i < 200000; ++i) {
+    double state[EnergyStateJson::KEY_COUNT];
+    NativeHarness::randomEnergyState(randomState, i, state);
+    if (!EnergyStateJson::fits(state)) {
+      continue;  // The exponent range: publishMqttEnergy() falls back to JsonDocument
+    }
+    char expected[256];
+    stateJson(state, expected, sizeof(expected));
+    char actual[EnergyStateJson::MAX_LENGTH + 1];
+    const size_t length = EnergyStateJson::write(actual, state);
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+    TEST_ASSERT_EQUAL_UINT32(strlen(expected), length);
+    written++;
+  }
+  TEST_ASSERT_GREATER_THAN_UINT32(150000, written);
+}
+
+void test_state_json_does_not_allocate() {
+  const double state[EnergyStateJson::KEY_COUNT] = {3.452, 3.46, 12345.678, 42.1};
+  char payload[EnergyStateJson::MAX_LENGTH + 1];
+  const HalSim::AllocationStats before = HalSim::allocationStats();
+  EnergyStateJson::write(payload, state);
+  TEST_ASSERT_TRUE(HalSim::allocationStats().allocations == before.allocations);
+}
+
+void test_discovery_matches_json_document_within_bounds() {
+  uint64_t randomState = 0xD15C0FE7ULL;
+  for (uint32_t i = 0; i < 20000; ++i) {
+    DiscoveryDeviceTopics topics;
+    const MqttDiscoveryDevice device = discoveryDevice(nextRandom(randomState), &topics);
+    for (size_t e = 0; e < DiscoveryTable::COUNT; ++e) {
+      String expectedTopic;
+      char expected[MQTT_PAYLOAD_LEN];
+      discoveryConfig(kDiscoveryEntities[e], device, &expectedTopic, expected, sizeof(expected));
+      char topic[DiscoveryTable::MAX_TOPIC_LENGTH + 1];
+      char payload[DiscoveryTable::MAX_PAYLOAD_LENGTH + 1];
+      const size_t topicLength = DiscoveryTable::writeTopic(topic, e, device.name);
+      const size_t payloadLength = DiscoveryTable::writePayload(payload, e, device);
+      TEST_ASSERT_EQUAL_STRING(expectedTopic.c_str(), topic);
+      TEST_ASSERT_EQUAL_STRING(expected, payload);
+      TEST_ASSERT_EQUAL_UINT32(strlen(expected), payloadLength);
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(DiscoveryTable::MAX_TOPIC_LENGTH, topicLength);
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(DiscoveryTable::MAX_PAYLOAD_LENGTH, payloadLength);
+    }
+  }
+}
+
+void test_set_commands_from_home_assistant_match_json_document() {
+  for (const std::string& payload : homeAssistantSetPayloads()) {
+    assertSameOutcome("outcome", payload, legacySetDecode(payload.data(), payload.size()),
+                      streamingSetDecode(payload.data(), payload.size()));
+  }
+  const HalSim::AllocationStats before = HalSim::allocationStats();
+  for (const std::string& payload : homeAssistantSetPayloads()) {
+    RecordingSetTable::dispatch(payload.data(), payload.size());
+  }
+  TEST_ASSERT_TRUE_MESSAGE(HalSim::allocationStats().allocations == before.allocations, "MqttSetTable allocated");
+}
+
+void test_set_nesting_up_to_the_limit() {
+  for (uint32_t depth = MQTT_SET_MAX_DEPTH - 2; depth <= MQTT_SET_MAX_DEPTH; ++depth) {
+    const std::string nested = "{\"Total\": 1, \"k\": " + std::string(depth, '[') + std::string(depth, ']') + "}";
+    assertSameOutcome("nesting", nested, legacySetDecode(nested.data(), nested.size()),
+                      streamingSetDecode(nested.data(), nested.size()));
+  }
+}
+
+void test_set_fuzz() {
+  uint64_t randomState = 0x5E7C0DEULL;
+  uint32_t mutatedAccepted = 0;
+  uint32_t mutatedRejected = 0;
+  for (uint32_t round = 0; round < SET_FUZZ_PAYLOADS; ++round) {
+    const std::string payload = randomSetPayload(randomState);
+    MqttSetError error;
+    assertSameOutcome("valid", payload, legacySetDecode(payload.data(), payload.size()),
+                      streamingSetDecodeExact(payload, &error));
+
+    // Every prefix that stops before the closing brace is incomplete, and runs no handler
+    const size_t closingBrace = payload.rfind('}');
+    for (size_t length = 1; length <= closingBrace; length += 1 + nextRandom(randomState) % 4) {
+      const std::string prefix = payload.substr(0, length);
+      const SetOutcome truncated = streamingSetDecodeExact(prefix, &error);
+      TEST_ASSERT_EQUAL_STRING_MESSAGE(MqttSetError(MqttSetError::IncompleteInput).c_str(), error.c_str(),
+                                       prefix.c_str());
+      TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, truncated.handlerCalls, prefix.c_str());
+    }
+
+    // Corrupted: decoded as JsonDocument decodes it, or rejected before any handler runs
+    const std::string mutated = mutateSetPayload(payload, randomState);
+    const SetOutcome expected = legacySetDecode(mutated.data(), mutated.size());
+    const SetOutcome actual = streamingSetDecodeExact(mutated, &error);
+    if (actual.rejected) {
+      mutatedRejected++;
+      TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, actual.handlerCalls, mutated.c_str());
+    } else {
+      mutatedAccepted++;
+      if (!expected.rejected) {
+        assertSameOutcome("mutated", mutated, expected, actual);
+      }
+    }
+  }
+  TEST_ASSERT_GREATER_THAN_UINT32(0, mutatedAccepted);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, mutatedRejected);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_record_ring_carries_bursts_in_order_without_drops);
+  RUN_TEST(test_state_json_matches_json_document);
+  RUN_TEST(test_state_json_does_not_allocate);
+  RUN_TEST(test_discovery_matches_json_document_within_bounds);
+  RUN_TEST(test_set_commands_from_home_assistant_match_json_document);
+  RUN_TEST(test_set_nesting_up_to_the_limit);
+  RUN_TEST(test_set_fuzz);
+  return UNITY_END();
+}
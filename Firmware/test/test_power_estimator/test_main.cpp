@@ -0,0 +1,136 @@
+/*
+ * Power estimation from pulse timestamps (PowerEstimator.h): the recorded traces in native/traces/
+ * replayed through every mode. Each trace line carries the readings expected after it; a line with
+ * 0 pulses is a poll without a pulse and calls decay().
+ *
+ *   pio test -e native -f test_power_estimator
+ */
+#include <unity.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "PowerEstimator.h"
+
+namespace {
+// pio test runs the suites from the project directory
+constexpr char TRACE_DIR[] = "native/traces/";
+
+// The parameters the expected readings in the traces were worked out for
+constexpr uint16_t WINDOW_PULSES = 4;
+constexpr uint32_t WINDOW_MS = 5000;
+constexpr uint32_t EWMA_TAU_MS = 5000;
+
+constexpr PowerEstimatorMode MODES[] = {POWER_MODE_SINGLE, POWER_MODE_PULSE_WINDOW, POWER_MODE_TIME_WINDOW,
+                                        POWER_MODE_EWMA};
+constexpr size_t MODE_COUNT = sizeof(MODES) / sizeof(MODES[0]);
+
+struct TraceTotals {
+  unsigned lines;
+  unsigned decays;
+  unsigned lowered; // decay() calls that lowered a reading
+};
+
+// Replays the trace through one estimator per mode and checks every line's readings
+TraceTotals replayTrace(const char* name, uint16_t pulsePerKWh) {
+  char path[96];
+  snprintf(path, sizeof(path), "%s%s", TRACE_DIR, name);
+  FILE* trace = fopen(path, "r");
+  TEST_ASSERT_NOT_NULL_MESSAGE(trace, path);
+
+  PowerEstimator estimators[] = {
+      PowerEstimator(MODES[0], WINDOW_PULSES, WINDOW_MS, EWMA_TAU_MS),
+      PowerEstimator(MODES[1], WINDOW_PULSES, WINDOW_MS, EWMA_TAU_MS),
+      PowerEstimator(MODES[2], WINDOW_PULSES, WINDOW_MS, EWMA_TAU_MS),
+      PowerEstimator(MODES[3], WINDOW_PULSES, WINDOW_MS, EWMA_TAU_MS),
+  };
+  for (PowerEstimator& estimator : estimators) {
+    estimator.setCalibration(pulsePerKWh, 0);
+  }
+
+  TraceTotals totals = {};
+  unsigned lineNumber = 0;
+  char line[128];
+  bool lineStart = true;
+  bool comment = false;
+  while (fgets(line, sizeof(line), trace)) {
+    // A comment may be longer than the buffer; its remainder comes back from fgets() in pieces
+    lineNumber += lineStart ? 1 : 0;
+    comment = lineStart ? line[0] == '#' : comment;
+    lineStart = strchr(line, '\n') != nullptr;
+    if (comment || line[0] == '\n') {
+      continue;
+    }
+    unsigned long timestampUs = 0;
+    unsigned long pulses = 0;
+    unsigned long expected[1 + MODE_COUNT] = {}; // instantW(), then smoothedW() per mode
+    char message[96];
+    snprintf(message, sizeof(message), "%s line %u", name, lineNumber);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(7, sscanf(line, "%lu %lu %lu %lu %lu %lu %lu", &timestampUs, &pulses, &expected[0],
+                                            &expected[1], &expected[2], &expected[3], &expected[4]),
+                                  message);
+
+    bool lowered = false;
+    bool changed = false;
+    for (PowerEstimator& estimator : estimators) {
+      if (pulses == 0) {
+        const uint32_t instantBefore = estimator.instantW();
+        const uint32_t smoothedBefore = estimator.smoothedW();
+        lowered |= estimator.decay(static_cast<uint32_t>(timestampUs));
+        changed |= estimator.instantW() != instantBefore || estimator.smoothedW() != smoothedBefore;
+      } else {
+        estimator.addPulses(static_cast<uint32_t>(pulses), static_cast<uint32_t>(timestampUs));
+      }
+    }
+    if (pulses == 0) {
+      TEST_ASSERT_TRUE_MESSAGE(changed == lowered, message); // decay() reports exactly what it lowered
+      totals.decays++;
+      totals.lowered += lowered ? 1 : 0;
+    }
+
+    for (const PowerEstimator& estimator : estimators) {
+      TEST_ASSERT_EQUAL_UINT32_MESSAGE(expected[0], estimator.instantW(), message);
+    }
+    for (size_t i = 0; i < MODE_COUNT; ++i) {
+      snprintf(message, sizeof(message), "%s line %u, %s", name, lineNumber, powerEstimatorModeName(MODES[i]));
+      TEST_ASSERT_EQUAL_UINT32_MESSAGE(expected[1 + i], estimators[i].smoothedW(), message);
+    }
+    totals.lines++;
+  }
+  fclose(trace);
+  return totals;
+}
+}  // namespace
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_follows_a_power_step_in_every_mode() {
+  const TraceTotals totals = replayTrace("power_step.txt", 1000);
+  TEST_ASSERT_EQUAL_UINT32(21, totals.lines);
+  TEST_ASSERT_EQUAL_UINT32(0, totals.decays);
+}
+
+// Polls without pulses lower the readings to one pulse in the elapsed time, and only then
+void test_decays_between_sparse_pulses() {
+  const TraceTotals totals = replayTrace("sparse_pulses_decay.txt", 1000);
+  TEST_ASSERT_EQUAL_UINT32(16, totals.lines);
+  TEST_ASSERT_EQUAL_UINT32(7, totals.decays);
+  TEST_ASSERT_EQUAL_UINT32(4, totals.lowered);
+}
+
+void test_averages_out_a_pulse_counted_a_poll_late() {
+  const TraceTotals totals = replayTrace("pcnt_pulse_between_reads.txt", 10000);
+  TEST_ASSERT_EQUAL_UINT32(9, totals.lines);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_follows_a_power_step_in_every_mode);
+  RUN_TEST(test_decays_between_sparse_pulses);
+  RUN_TEST(test_averages_out_a_pulse_counted_a_poll_late);
+  return UNITY_END();
+}
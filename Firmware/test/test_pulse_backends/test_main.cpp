@@ -0,0 +1,178 @@
+/*
+ * Pulse counter backends (PulseCounterBackend.h). The same counting tests run against the ISR and
+ * the PCNT backend; then the PCNT backend alone gets a pulse landing between the counter read and
+ * the edge time read of a poll, bounce right after a counted edge and counter wraps between polls.
+ *
+ *   pio test -e native -f test_pulse_backends
+ */
+#include <unity.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "HalSim.h"
+#include "PulseCounterBackend.h"
+#include "config.h"
+
+namespace {
+constexpr uint32_t EDGE_GAP_MS = 3;  // Further apart than PULSE_MIN_INTERVAL_US
+constexpr uint32_t BURST_EDGES = 50; // Fits the ISR backend's ring
+constexpr uint32_t PCNT_COUNTER_WRAP = 32767;
+
+PulseCounterBackend* sBackend = nullptr;
+TaskHandle_t sConsumer = nullptr;
+uint32_t sRacingEdgeUs = 0;
+
+// Stands in for PulseInputTask: the ISR backend notifies it, the test polls in its place
+void parkedConsumerTask(void* pvParameters) {
+  (void)pvParameters;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+
+uint32_t fireEdge() {
+  const uint32_t nowUs = micros();
+  HalSim::triggerInterrupt(PULSE_INPUT_GPIO);
+  delay(EDGE_GAP_MS);
+  return nowUs;
+}
+
+// Lands one edge between the counter read and the edge time read of the poll in progress
+void fireEdgeAfterCounterRead(int unit) {
+  (void)unit;
+  HalSim::setPcntReadHook(nullptr);
+  sRacingEdgeUs = micros();
+  HalSim::triggerInterrupt(PULSE_INPUT_GPIO);
+}
+
+// Polls until the backend is empty: pulses counted and the timestamp of the last event
+uint32_t pollAll(uint32_t* lastTimestampUs = nullptr) {
+  uint32_t pulses = 0;
+  PulseEvent event;
+  while (sBackend->poll(&event)) {
+    pulses += event.count;
+    if (lastTimestampUs != nullptr) {
+      *lastTimestampUs = event.timestampUs;
+    }
+  }
+  return pulses;
+}
+}  // namespace
+
+void setUp() {
+  pollAll();
+  delay(EDGE_GAP_MS);
+}
+
+void tearDown() {
+  HalSim::setPcntReadHook(nullptr);
+}
+
+void test_attaches_to_the_pulse_gpio() {
+  TEST_ASSERT_TRUE_MESSAGE(sBackend->attach(PULSE_INPUT_GPIO, FALLING, sConsumer), sBackend->name());
+}
+
+void test_counts_edges_with_the_last_edge_time() {
+  fireEdge();
+  fireEdge();
+  const uint32_t lastUs = fireEdge();
+  uint32_t timestampUs = 0;
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(3, pollAll(&timestampUs), sBackend->name());
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32_MESSAGE(lastUs, timestampUs, sBackend->name());
+  TEST_ASSERT_LESS_THAN_UINT32_MESSAGE(lastUs + EDGE_GAP_MS * 1000, timestampUs, sBackend->name());
+  PulseEvent event;
+  TEST_ASSERT_FALSE_MESSAGE(sBackend->poll(&event), sBackend->name());
+}
+
+void test_counts_a_burst_between_polls() {
+  for (uint32_t i = 0; i < BURST_EDGES; ++i) {
+    HalSim::triggerInterrupt(PULSE_INPUT_GPIO);
+  }
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(BURST_EDGES, pollAll(), sBackend->name());
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, sBackend->overflowCount(), sBackend->name());
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32_MESSAGE(BURST_EDGES, sBackend->peakFill(), sBackend->name());
+}
+
+void test_counts_nothing_while_suspended() {
+  sBackend->suspend();
+  fireEdge();
+  fireEdge();
+  sBackend->resume();
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, pollAll(), sBackend->name());
+  fireEdge();
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, pollAll(), sBackend->name());
+}
+
+// The pulse between the reads is left to the next poll, which counts it under the same edge time
+void test_pcnt_pulse_between_reads_is_counted_by_the_next_poll() {
+  fireEdge();
+  fireEdge();
+  HalSim::setPcntReadHook(fireEdgeAfterCounterRead);
+  PulseEvent event;
+  TEST_ASSERT_TRUE(sBackend->poll(&event));
+  TEST_ASSERT_EQUAL_UINT32(2, event.count);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(sRacingEdgeUs, event.timestampUs);
+
+  PulseEvent next;
+  TEST_ASSERT_TRUE(sBackend->poll(&next));
+  TEST_ASSERT_EQUAL_UINT32(1, next.count);
+  TEST_ASSERT_EQUAL_UINT32(event.timestampUs, next.timestampUs);
+}
+
+// An edge within PULSE_MIN_INTERVAL_US of the last one keeps the earlier edge time. The simulated
+// counter has no glitch filter, so the edge is counted, as bounce longer than the filter is on the
+// device (see PulsePcntBackend.cpp)
+void test_pcnt_bounce_keeps_the_edge_time() {
+  const uint32_t edgeUs = micros();
+  HalSim::triggerInterrupt(PULSE_INPUT_GPIO);
+  const uint32_t bounceUs = micros();
+  delayMicroseconds(PULSE_MIN_INTERVAL_US / 4);
+  HalSim::triggerInterrupt(PULSE_INPUT_GPIO);
+  PulseEvent event;
+  TEST_ASSERT_TRUE(sBackend->poll(&event));
+  TEST_ASSERT_EQUAL_UINT32(2, event.count);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(edgeUs, event.timestampUs);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(bounceUs, event.timestampUs);
+
+  delay(EDGE_GAP_MS);
+  const uint32_t nextUs = fireEdge();
+  TEST_ASSERT_TRUE(sBackend->poll(&event));
+  TEST_ASSERT_EQUAL_UINT32(1, event.count);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(nextUs, event.timestampUs);
+}
+
+// The 16-bit counter wraps twice between two polls; the high-limit events keep the count exact
+void test_pcnt_counts_across_counter_wraps() {
+  const uint32_t edges = 2 * PCNT_COUNTER_WRAP + 3;
+  for (uint32_t i = 0; i < edges; ++i) {
+    HalSim::triggerInterrupt(PULSE_INPUT_GPIO);
+  }
+  TEST_ASSERT_EQUAL_UINT32(edges, pollAll());
+  TEST_ASSERT_EQUAL_UINT32(0, sBackend->overflowCount());
+  fireEdge();
+  TEST_ASSERT_EQUAL_UINT32(1, pollAll());
+}
+
+void runBackendTests(PulseCounterBackend* backend) {
+  sBackend = backend;
+  RUN_TEST(test_attaches_to_the_pulse_gpio);
+  RUN_TEST(test_counts_edges_with_the_last_edge_time);
+  RUN_TEST(test_counts_a_burst_between_polls);
+  RUN_TEST(test_counts_nothing_while_suspended);
+}
+
+int main() {
+  xTaskCreate(parkedConsumerTask, "PulseConsumer", 2048, nullptr, 1, &sConsumer);
+  UNITY_BEGIN();
+  runBackendTests(getPulseIsrBackend());
+  sBackend->suspend();
+  runBackendTests(getPulsePcntBackend());
+  RUN_TEST(test_pcnt_pulse_between_reads_is_counted_by_the_next_poll);
+  RUN_TEST(test_pcnt_bounce_keeps_the_edge_time);
+  RUN_TEST(test_pcnt_counts_across_counter_wraps);
+  // The consumer task never returns; leave without running static destructors underneath it
+  const int failures = UNITY_END();
+  fflush(stdout);
+  std::_Exit(failures);
+}
@@ -0,0 +1,197 @@
+/*
+ * Batch mode of PulseInputTask (PULSE_BATCH_WINDOW_MS, here selectPulseBatchWindow()): one snapshot
+ * per batch, power over the span from the previous batch's last pulse to this batch's last, and the
+ * pulses of an open batch in the periodic, the direct-reset emergency and the reset save.
+ *
+ * The task runs once for the whole suite, so the tests build on each other's counters and run in
+ * order; the reset save stops the task and comes last. The simulated clock is moved ahead
+ * (HalSim::advanceClock()) to space the pulses and to reach the window end and the save interval.
+ *
+ *   pio test -e native -f test_pulse_batch
+ */
+#include <unity.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "EnergyMath.h"
+#include "HalSim.h"
+#include "NativeHarness.h"
+#include "PulseInputTask.h"
+#include "PulseJournal.h"
+#include "config.h"
+
+using namespace NativeHarness;
+
+namespace {
+constexpr uint16_t BATCH_PULSES_PER_KWH = 1000;  // 3600 W is a pulse a second
+constexpr uint32_t PULSE_SPACING_MS = 1000;
+constexpr uint32_t BATCH_PULSES = 5;
+// The window closes half a spacing after the last pulse of a batch, before decay() could lower the power
+constexpr uint32_t BATCH_WINDOW_MS = (BATCH_PULSES - 1) * PULSE_SPACING_MS + PULSE_SPACING_MS / 2;
+constexpr uint32_t TASK_TIMEOUT_MS = 3000;
+constexpr uint32_t POWER_TOLERANCE_W = 10;  // The ISR takes its timestamp just after firePulse() reads the clock
+
+uint32_t pulsesDrained() {
+  uint32_t pulses = 0;
+  getPulseTaskCpuCost(nullptr, &pulses, nullptr);
+  return pulses;
+}
+
+uint32_t snapshotsEmitted() {
+  uint32_t snapshots = 0;
+  getPulseTaskCpuCost(nullptr, nullptr, &snapshots);
+  return snapshots;
+}
+
+// Pulses in the published energy snapshot
+uint64_t countedPulses() {
+  uint64_t energyMilliWh = 0;
+  getLatestEnergyMilliWh(&energyMilliWh);
+  return milliWhToPulses(energyMilliWh, BATCH_PULSES_PER_KWH);
+}
+
+uint32_t instantPowerW() {
+  uint32_t powerW = 0;
+  uint32_t instantW = 0;
+  uint64_t energyMilliWh = 0;
+  uint64_t subtotalMilliWh = 0;
+  getLatestEnergySnapshot(&powerW, &energyMilliWh, &subtotalMilliWh, &instantW);
+  return instantW;
+}
+
+// What the firmware's counter store holds now, as a boot would recover it
+PulseJournalState storedCounters() {
+  PulseJournal journal;
+  journal.begin(PULSE_JOURNAL_PARTITION_LABEL);
+  return journal.recovered() ? journal.state() : PulseJournalState{};
+}
+
+bool stored(uint64_t pulses, bool controlledPowerCycle) {
+  const PulseJournalState state = storedCounters();
+  return state.pulseCounter == pulses && state.subtotalPulseCounter == pulses &&
+         state.controlledPowerCycle == controlledPowerCycle;
+}
+
+// One pulse, drained by the task into the open batch (or opening one). Returns its time.
+uint32_t firePulse() {
+  const uint32_t drained = pulsesDrained();
+  const uint32_t nowUs = micros();
+  HalSim::triggerInterrupt(PULSE_INPUT_GPIO);
+  TEST_ASSERT_TRUE_MESSAGE(waitUntil([&] { return pulsesDrained() == drained + 1; }, TASK_TIMEOUT_MS),
+                           "pulse not drained");
+  return nowUs;
+}
+
+// BATCH_PULSES pulses PULSE_SPACING_MS apart, then the window end. The clock also runs in real
+// time, so the spacing is at least PULSE_SPACING_MS; the times of the first and the last pulse are
+// left in 'firstUs' and 'lastUs'. Returns the instant power.
+uint32_t runBatch(uint64_t countedBefore, uint32_t* firstUs, uint32_t* lastUs) {
+  const uint32_t snapshots = snapshotsEmitted();
+  for (uint32_t i = 0; i < BATCH_PULSES; ++i) {
+    if (i > 0) {
+      HalSim::advanceClock(PULSE_SPACING_MS);
+    }
+    *lastUs = firePulse();
+    if (i == 0) {
+      *firstUs = *lastUs;
+    }
+    // Counted only when the window closes
+    TEST_ASSERT_EQUAL_UINT32(snapshots, snapshotsEmitted());
+    TEST_ASSERT_EQUAL_UINT64(countedBefore, countedPulses());
+  }
+  HalSim::advanceClock(BATCH_WINDOW_MS - (BATCH_PULSES - 1) * PULSE_SPACING_MS);
+  TEST_ASSERT_TRUE_MESSAGE(waitUntil([&] { return snapshotsEmitted() != snapshots; }, TASK_TIMEOUT_MS),
+                           "batch not counted");
+  TEST_ASSERT_EQUAL_UINT32(snapshots + 1, snapshotsEmitted());
+  TEST_ASSERT_EQUAL_UINT64(countedBefore + BATCH_PULSES, countedPulses());
+  return instantPowerW();
+}
+}  // namespace
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_counts_a_batch_in_one_snapshot_over_its_span() {
+  params.pulse_per_kWh = BATCH_PULSES_PER_KWH;
+  params.ptCorrection = 0;
+  TEST_ASSERT_TRUE(selectPulseBatchWindow(BATCH_WINDOW_MS));
+  startPulseInputTask(&params);
+  waitForPulseInputReady(0);
+  TEST_ASSERT_FALSE(selectPulseBatchWindow(0));  // The running task keeps its window
+  TEST_ASSERT_TRUE_MESSAGE(attachPulseInputInterrupt(PULSE_INPUT_GPIO, PULSE_INPUT_INTERRUPT_MODE),
+                           "pulse input interrupt could not be attached");
+
+  // First batch: its last 4 pulses over the span from its first pulse to its last, about 3600 W
+  uint32_t firstUs = 0;
+  uint32_t lastUs = 0;
+  uint32_t powerW = runBatch(0, &firstUs, &lastUs);
+  TEST_ASSERT_UINT32_WITHIN(POWER_TOLERANCE_W,
+                            pulseSpanToWatts(lastUs - firstUs, BATCH_PULSES - 1, BATCH_PULSES_PER_KWH, 0), powerW);
+
+  // Next batch two spacings later: all 5 pulses over the span from the previous batch's last
+  // pulse, about 3000 W
+  const uint32_t previousLastUs = lastUs;
+  HalSim::advanceClock(2 * PULSE_SPACING_MS - (BATCH_WINDOW_MS - (BATCH_PULSES - 1) * PULSE_SPACING_MS));
+  powerW = runBatch(BATCH_PULSES, &firstUs, &lastUs);
+  TEST_ASSERT_UINT32_WITHIN(POWER_TOLERANCE_W,
+                            pulseSpanToWatts(lastUs - previousLastUs, BATCH_PULSES, BATCH_PULSES_PER_KWH, 0), powerW);
+  TEST_ASSERT_UINT32_WITHIN(300, 3000, powerW);
+}
+
+void test_the_periodic_save_includes_an_open_batch() {
+  const uint64_t counted = countedPulses();
+  HalSim::advanceClock(PULSE_NVS_SAVE_INTERVAL_MS);
+  TEST_ASSERT_TRUE_MESSAGE(waitUntil([&] { return stored(counted, false); }, TASK_TIMEOUT_MS), "counters not saved");
+
+  // Open a batch shortly before the next save is due; the save comes while it is still open
+  HalSim::advanceClock(PULSE_NVS_SAVE_INTERVAL_MS - 2 * PULSE_SPACING_MS);
+  firePulse();
+  HalSim::advanceClock(2 * PULSE_SPACING_MS);
+  TEST_ASSERT_TRUE_MESSAGE(waitUntil([&] { return stored(counted + 1, false); }, TASK_TIMEOUT_MS),
+                           "open batch not saved");
+  TEST_ASSERT_EQUAL_UINT64(counted, countedPulses());
+
+  HalSim::advanceClock(BATCH_WINDOW_MS);
+  TEST_ASSERT_TRUE(waitUntil([&] { return countedPulses() == counted + 1; }, TASK_TIMEOUT_MS));
+}
+
+void test_the_emergency_save_includes_an_open_batch() {
+  const uint64_t counted = countedPulses();
+  HalSim::advanceClock(2 * PULSE_SPACING_MS);
+  firePulse();
+  HalSim::triggerInterrupt(DIRECT_RESET_GPIO);
+  TEST_ASSERT_TRUE_MESSAGE(waitUntil([&] { return stored(counted + 1, true); }, TASK_TIMEOUT_MS),
+                           "open batch not in the emergency save");
+  TEST_ASSERT_EQUAL_UINT64(counted, countedPulses());
+
+  HalSim::advanceClock(BATCH_WINDOW_MS);
+  TEST_ASSERT_TRUE(waitUntil([&] { return countedPulses() == counted + 1; }, TASK_TIMEOUT_MS));
+}
+
+// Stops the task: runs last
+void test_the_reset_save_includes_an_open_batch() {
+  const uint64_t counted = countedPulses();
+  HalSim::advanceClock(2 * PULSE_SPACING_MS);
+  firePulse();
+  requestReset(RESET_HARD);
+  TEST_ASSERT_TRUE_MESSAGE(waitUntil([&] { return stored(counted + 1, false); }, TASK_TIMEOUT_MS),
+                           "open batch not in the reset save");
+  TEST_ASSERT_TRUE(waitUntil([] { return HalSim::getDigitalOutput(HARD_RESET_GPIO) == HIGH; }, TASK_TIMEOUT_MS));
+  TEST_ASSERT_EQUAL_UINT64(counted, countedPulses());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_counts_a_batch_in_one_snapshot_over_its_span);
+  RUN_TEST(test_the_periodic_save_includes_an_open_batch);
+  RUN_TEST(test_the_emergency_save_includes_an_open_batch);
+  RUN_TEST(test_the_reset_save_includes_an_open_batch);
+  // The firmware tasks never return; leave without running static destructors underneath them
+  const int failures = UNITY_END();
+  fflush(stdout);
+  std::_Exit(failures);
+}
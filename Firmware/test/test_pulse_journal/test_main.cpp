@@ -0,0 +1,170 @@
+/*
+ * Pulse counter journal (PulseJournal.h): random counter updates with power cut at random byte
+ * positions and now and then a bit flipped in flash. After every reboot the recovered counters must
+ * be the last acknowledged save, or the one in flight when power failed. With the next sector
+ * prepared, as the periodic save does, no save erases.
+ *
+ *   pio test -e native -f test_pulse_journal
+ */
+#include <unity.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "HalSim.h"
+#include "NativeHarness.h"
+#include "PulseJournal.h"
+#include "config.h"
+
+using NativeHarness::nextRandom;
+
+namespace {
+constexpr uint32_t FUZZ_BOOTS = 2000;
+constexpr uint32_t PREPARE_EVERY_SAVES = 20;  // Periodic saves among all saves, in the fuzz test
+constexpr uint32_t SAVES_PER_SECTOR = 1 + (SPI_FLASH_SEC_SIZE - 32) / 16;  // Checkpoint, then deltas
+constexpr uint32_t PARTITION_SECTORS = 0x10000 / SPI_FLASH_SEC_SIZE;
+
+bool sameJournalState(const PulseJournalState& a, const PulseJournalState& b) {
+  return a.pulseCounter == b.pulseCounter && a.subtotalPulseCounter == b.subtotalPulseCounter &&
+         a.controlledPowerCycle == b.controlledPowerCycle;
+}
+
+// Next save as PulseInputTask would issue it: mostly new pulses, now and then a subtotal reset,
+// a counter set over MQTT or a direct-reset emergency save.
+PulseJournalState nextJournalState(const PulseJournalState& state, uint64_t& randomState) {
+  PulseJournalState next = state;
+  next.controlledPowerCycle = false;
+  const uint32_t kind = nextRandom(randomState) % 100;
+  if (kind < 4) {
+    next.subtotalPulseCounter = 0;
+  } else if (kind < 6) {
+    next.pulseCounter = nextRandom(randomState) % 100000000000ULL;
+  } else {
+    const uint64_t pulses = 1 + nextRandom(randomState) % 1000;
+    next.pulseCounter += pulses;
+    next.subtotalPulseCounter += pulses;
+    next.controlledPowerCycle = kind >= 96;
+  }
+  return next;
+}
+}  // namespace
+
+void setUp() {
+  HalSim::eraseFlashPartition(PULSE_JOURNAL_PARTITION_LABEL);
+  HalSim::flashPowerFailAfter(-1);
+}
+
+void tearDown() {
+  HalSim::flashPowerFailAfter(-1);
+}
+
+void test_recovers_the_last_acknowledged_save_after_power_cuts() {
+  uint64_t randomState = 0xD1B54A32D192ED03ULL;
+  std::vector<PulseJournalState> history;  // Every acknowledged state
+  PulseJournalState acked = {};
+  uint64_t saves = 0;
+  uint64_t erases = 0;
+  uint32_t powerCuts = 0;
+  bool corrupted = false;
+
+  for (uint32_t round = 0; round < FUZZ_BOOTS; ++round) {
+    PulseJournal journal;
+    TEST_ASSERT_TRUE_MESSAGE(journal.begin(PULSE_JOURNAL_PARTITION_LABEL), "journal partition missing");
+    if (round > 0) {
+      // Recovery after the previous boot ended; after a bit flip an older save may come back
+      const PulseJournalState recovered = journal.recovered() ? journal.state() : PulseJournalState{};
+      bool ok = sameJournalState(recovered, acked);
+      if (!ok && corrupted) {
+        ok = !journal.recovered() ||
+             std::any_of(history.begin(), history.end(),
+                         [&](const PulseJournalState& state) { return sameJournalState(state, recovered); });
+      }
+      char message[128];
+      snprintf(message, sizeof(message), "boot %u: recovered %llu/%llu, expected %llu/%llu", (unsigned)round,
+               (unsigned long long)recovered.pulseCounter, (unsigned long long)recovered.subtotalPulseCounter,
+               (unsigned long long)acked.pulseCounter, (unsigned long long)acked.subtotalPulseCounter);
+      TEST_ASSERT_TRUE_MESSAGE(ok, message);
+      acked = recovered;
+      corrupted = false;
+    }
+
+    const uint32_t saveCount = 1 + nextRandom(randomState) % 600;
+    const bool powerCut = nextRandom(randomState) % 4 != 0;
+    HalSim::flashPowerFailAfter(powerCut ? static_cast<int64_t>(nextRandom(randomState) % (saveCount * 20)) : -1);
+
+    for (uint32_t i = 0; i < saveCount; ++i) {
+      const PulseJournalState next = nextJournalState(acked, randomState);
+      if (!journal.save(next.pulseCounter, next.subtotalPulseCounter, next.controlledPowerCycle)) {
+        // The save in flight may or may not have reached flash
+        HalSim::flashPowerFailAfter(-1);
+        PulseJournal probe;
+        probe.begin(PULSE_JOURNAL_PARTITION_LABEL);
+        if (probe.recovered() && sameJournalState(probe.state(), next)) {
+          acked = next;
+          history.push_back(next);
+        }
+        powerCuts++;
+        break;
+      }
+      acked = next;
+      history.push_back(next);
+      saves++;
+      // Power may also fail part way through erasing the next sector ahead of time
+      if (nextRandom(randomState) % PREPARE_EVERY_SAVES == 0 && !journal.prepareNextSector()) {
+        powerCuts++;
+        break;
+      }
+    }
+    erases += journal.sectorErases();
+
+    if (nextRandom(randomState) % 40 == 0) {
+      HalSim::corruptFlash(PULSE_JOURNAL_PARTITION_LABEL, static_cast<uint32_t>(nextRandom(randomState) % 0x10000),
+                           static_cast<uint8_t>(1U << (nextRandom(randomState) % 8)));
+      corrupted = true;
+    }
+    HalSim::flashPowerFailAfter(-1);
+  }
+  TEST_ASSERT_GREATER_THAN_UINT32(FUZZ_BOOTS / 2, powerCuts);
+  // Wear leveling: a sector is erased only after many saves
+  TEST_ASSERT_TRUE(erases > 0 && saves / erases >= 100);
+}
+
+// Counter saves as the task issues them, every one followed by the periodic preparation, for more
+// sectors than the partition holds: only the preparation erases, never the save itself
+void test_the_save_crossing_a_sector_boundary_never_erases() {
+  PulseJournal journal;
+  TEST_ASSERT_TRUE(journal.begin(PULSE_JOURNAL_PARTITION_LABEL));
+  TEST_ASSERT_TRUE(journal.prepareNextSector());
+  TEST_ASSERT_EQUAL_UINT32(0, journal.sectorErases());  // Blank partition, read back as erased
+
+  const uint32_t sectors = PARTITION_SECTORS + 4;
+  uint64_t pulses = 0;
+  for (uint32_t i = 0; i < sectors * SAVES_PER_SECTOR; ++i) {
+    pulses += 7;
+    const uint32_t erases = journal.sectorErases();
+    TEST_ASSERT_TRUE(journal.save(pulses, pulses));
+    char message[48];
+    snprintf(message, sizeof(message), "save %u erased", (unsigned)i);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(erases, journal.sectorErases(), message);
+    TEST_ASSERT_TRUE(journal.prepareNextSector());
+  }
+  // Sectors from the first lap of the ring were erased ahead of their reuse, the last one after
+  // the final save
+  TEST_ASSERT_EQUAL_UINT32(sectors - PARTITION_SECTORS + 1, journal.sectorErases());
+
+  // After a reboot the prepared sector reads back erased and is not erased again
+  PulseJournal rebooted;
+  TEST_ASSERT_TRUE(rebooted.begin(PULSE_JOURNAL_PARTITION_LABEL));
+  TEST_ASSERT_TRUE(rebooted.recovered());
+  TEST_ASSERT_EQUAL_UINT64(pulses, rebooted.state().pulseCounter);
+  TEST_ASSERT_TRUE(rebooted.prepareNextSector());
+  TEST_ASSERT_EQUAL_UINT32(0, rebooted.sectorErases());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_recovers_the_last_acknowledged_save_after_power_cuts);
+  RUN_TEST(test_the_save_crossing_a_sector_boundary_never_erases);
+  return UNITY_END();
+}
@@ -0,0 +1,142 @@
+/*
+ * Lock-free pulse timestamp ring (PulseRing.h): overflow accounting when it is full, order across
+ * index wrap-around, and a producer and a consumer thread running flat out against a small ring.
+ *
+ *   pio test -e native -f test_pulse_ring
+ */
+#include <unity.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "PulseRing.h"
+
+namespace {
+constexpr uint32_t RING_CAPACITY = 8;
+constexpr uint32_t THREADED_PULSES = 1000000;
+
+typedef PulseRing<RING_CAPACITY> TestRing;
+
+// Producer and consumer on two threads; the consumer starts once the producer has filled the ring.
+// With 'retry' the producer pushes every timestamp until it fits; without it a full ring drops the
+// timestamp. Returns what the consumer received.
+std::vector<uint32_t> runProducerConsumer(TestRing& ring, bool retry, uint32_t* accepted) {
+  std::atomic<bool> done{false};
+  std::vector<uint32_t> received;
+  received.reserve(THREADED_PULSES);
+  std::thread consumer;
+  auto consume = [&] {
+    uint32_t timestampUs = 0;
+    for (;;) {
+      const bool finished = done.load(std::memory_order_acquire);
+      while (ring.pop(&timestampUs)) {
+        received.push_back(timestampUs);
+      }
+      if (finished) {
+        return;
+      }
+      std::this_thread::yield();
+    }
+  };
+  *accepted = 0;
+  for (uint32_t i = 1; i <= THREADED_PULSES; ++i) {
+    if (i == RING_CAPACITY + 1) {
+      consumer = std::thread(consume);
+    }
+    bool pushed = ring.push(i);
+    while (!pushed && retry) {
+      std::this_thread::yield();
+      pushed = ring.push(i);
+    }
+    *accepted += pushed ? 1 : 0;
+  }
+  done.store(true, std::memory_order_release);
+  consumer.join();
+  return received;
+}
+}  // namespace
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_a_full_ring_drops_and_counts_new_pulses() {
+  TestRing ring;
+  for (uint32_t i = 0; i < RING_CAPACITY; ++i) {
+    TEST_ASSERT_TRUE(ring.push(100 + i));
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, ring.overflowCount());
+  for (uint32_t i = 0; i < 3; ++i) {
+    TEST_ASSERT_FALSE(ring.push(200 + i));
+  }
+  TEST_ASSERT_EQUAL_UINT32(3, ring.overflowCount());
+  TEST_ASSERT_EQUAL_UINT32(RING_CAPACITY, ring.size());
+  TEST_ASSERT_EQUAL_UINT32(RING_CAPACITY, ring.peakFill());
+
+  // The pulses already in the ring are kept, oldest first; the dropped ones never appear
+  uint32_t timestampUs = 0;
+  for (uint32_t i = 0; i < RING_CAPACITY; ++i) {
+    TEST_ASSERT_TRUE(ring.pop(&timestampUs));
+    TEST_ASSERT_EQUAL_UINT32(100 + i, timestampUs);
+  }
+  TEST_ASSERT_FALSE(ring.pop(&timestampUs));
+  TEST_ASSERT_TRUE(ring.push(300));
+  TEST_ASSERT_EQUAL_UINT32(3, ring.overflowCount());
+  TEST_ASSERT_EQUAL_UINT32(RING_CAPACITY, ring.peakFill());
+}
+
+void test_keeps_order_across_index_wrap_around() {
+  TestRing ring;
+  uint32_t next = 0;
+  uint32_t expected = 0;
+  for (uint32_t round = 0; round < 10 * RING_CAPACITY; ++round) {
+    const uint32_t pushes = 1 + round % RING_CAPACITY;
+    for (uint32_t i = 0; i < pushes && ring.size() < RING_CAPACITY; ++i) {
+      TEST_ASSERT_TRUE(ring.push(next++));
+    }
+    uint32_t timestampUs = 0;
+    for (uint32_t i = 0; i < (round % 3) + 1 && ring.pop(&timestampUs); ++i) {
+      TEST_ASSERT_EQUAL_UINT32(expected++, timestampUs);
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, ring.overflowCount());
+  TEST_ASSERT_EQUAL_UINT32(next - expected, ring.size());
+}
+
+// A producer that waits for room loses nothing, however often it fills the ring
+void test_loses_nothing_when_the_producer_waits_for_room() {
+  TestRing ring;
+  uint32_t accepted = 0;
+  const std::vector<uint32_t> received = runProducerConsumer(ring, true, &accepted);
+  TEST_ASSERT_EQUAL_UINT32(THREADED_PULSES, received.size());
+  for (uint32_t i = 0; i < THREADED_PULSES; ++i) {
+    TEST_ASSERT_EQUAL_UINT32(i + 1, received[i]);
+  }
+  TEST_ASSERT_EQUAL_UINT32(THREADED_PULSES, accepted);
+  TEST_ASSERT_EQUAL_UINT32(RING_CAPACITY, ring.peakFill());
+}
+
+// A producer that never waits, as the ISR: every pulse is either received, in order, or counted
+void test_accounts_for_every_pulse_when_the_producer_never_waits() {
+  TestRing ring;
+  uint32_t accepted = 0;
+  const std::vector<uint32_t> received = runProducerConsumer(ring, false, &accepted);
+  TEST_ASSERT_EQUAL_UINT32(accepted, received.size());
+  TEST_ASSERT_EQUAL_UINT32(THREADED_PULSES, accepted + ring.overflowCount());
+  for (size_t i = 1; i < received.size(); ++i) {
+    TEST_ASSERT_GREATER_THAN_UINT32(received[i - 1], received[i]);
+  }
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(RING_CAPACITY, ring.peakFill());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_a_full_ring_drops_and_counts_new_pulses);
+  RUN_TEST(test_keeps_order_across_index_wrap_around);
+  RUN_TEST(test_loses_nothing_when_the_producer_waits_for_room);
+  RUN_TEST(test_accounts_for_every_pulse_when_the_producer_never_waits);
+  return UNITY_END();
+}
@@ -0,0 +1,207 @@
+/*
+ * RTC copy of the pulse counters (PulseRtcShadow.h) on the boot path: which resets keep it, a copy
+ * the persistent store has moved past, an update torn at every byte, every single bit flipped, the
+ * slot generation wrapping and garbage in RTC memory after power-on.
+ *
+ *   pio test -e native -f test_pulse_rtc_shadow
+ */
+#include <unity.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "HalSim.h"
+#include "NativeHarness.h"
+#include "PulseRtcShadow.h"
+
+using NativeHarness::nextRandom;
+
+namespace {
+constexpr uint64_t STORED_PULSES = 1000;
+constexpr uint64_t STORED_SUBTOTAL = 10;
+constexpr uint32_t GARBAGE_BOOTS = 10000;
+
+// Mirror of ShadowSlot in PulseRtcShadow.cpp, to set generations the firmware takes 2^32 updates to reach
+struct ShadowSlot {
+  uint32_t magic;
+  uint32_t generation;
+  uint64_t pulseCounter;
+  uint64_t subtotalPulseCounter;
+  uint64_t storedPulseCounter;
+  uint64_t storedSubtotalPulseCounter;
+  uint32_t checksum;
+};
+
+uint32_t slotChecksum(const ShadowSlot& slot) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&slot);
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < offsetof(ShadowSlot, checksum); i++) {
+    hash = (hash ^ bytes[i]) * 16777619UL;
+  }
+  return hash;
+}
+
+std::vector<uint8_t> rtcMemory() {
+  size_t size = 0;
+  const uint8_t* memory = HalSim::rtcNoinitMemory(&size);
+  return std::vector<uint8_t>(memory, memory + size);
+}
+
+void setRtcMemory(const std::vector<uint8_t>& bytes) {
+  size_t size = 0;
+  uint8_t* memory = HalSim::rtcNoinitMemory(&size);
+  TEST_ASSERT_EQUAL_UINT32(size, bytes.size());
+  memcpy(memory, bytes.data(), size);
+}
+
+// Total pulse counter restored on boot against the stored counters, 0 when the shadow is not used
+uint64_t restoredPulses(uint64_t storedPulses = STORED_PULSES, uint64_t storedSubtotal = STORED_SUBTOTAL) {
+  uint64_t pulses = 0;
+  uint64_t subtotal = 0;
+  if (!pulseRtcShadowLoad(storedPulses, storedSubtotal, &pulses, &subtotal)) {
+    return 0;
+  }
+  TEST_ASSERT_TRUE(pulses - subtotal == STORED_PULSES - STORED_SUBTOTAL);
+  return pulses;
+}
+
+// Both slots valid: the older one holds STORED_PULSES + 2, the newer one STORED_PULSES + 3
+void writeTwoSlots() {
+  pulseRtcShadowStored(STORED_PULSES, STORED_SUBTOTAL);
+  for (uint64_t pulses = 1; pulses <= 3; ++pulses) {
+    pulseRtcShadowUpdate(STORED_PULSES + pulses, STORED_SUBTOTAL + pulses);
+  }
+}
+}  // namespace
+
+void setUp() {
+  setRtcMemory(std::vector<uint8_t>(rtcMemory().size(), 0));
+  HalSim::setResetReason(ESP_RST_SW);
+}
+
+void tearDown() {
+  HalSim::setResetReason(ESP_RST_POWERON);
+}
+
+void test_only_resets_that_keep_rtc_memory_restore() {
+  writeTwoSlots();
+  const esp_reset_reason_t kept[] = {ESP_RST_SW, ESP_RST_PANIC, ESP_RST_INT_WDT, ESP_RST_TASK_WDT, ESP_RST_WDT,
+                                     ESP_RST_DEEPSLEEP};
+  for (esp_reset_reason_t reason : kept) {
+    HalSim::setResetReason(reason);
+    TEST_ASSERT_EQUAL_UINT64(STORED_PULSES + 3, restoredPulses());
+  }
+  const esp_reset_reason_t lost[] = {ESP_RST_UNKNOWN, ESP_RST_POWERON, ESP_RST_EXT, ESP_RST_BROWNOUT, ESP_RST_SDIO};
+  for (esp_reset_reason_t reason : lost) {
+    HalSim::setResetReason(reason);
+    TEST_ASSERT_EQUAL_UINT64(0, restoredPulses());
+  }
+}
+
+// The store was written after the copy (the direct-reset emergency save, other firmware): its
+// counters are the newest even when the copy is ahead of them
+void test_rejects_a_copy_the_store_has_moved_past() {
+  writeTwoSlots();
+  TEST_ASSERT_EQUAL_UINT64(0, restoredPulses(STORED_PULSES + 3, STORED_SUBTOTAL + 3));
+  TEST_ASSERT_EQUAL_UINT64(0, restoredPulses(STORED_PULSES + 1, STORED_SUBTOTAL + 1));
+  TEST_ASSERT_EQUAL_UINT64(0, restoredPulses(STORED_PULSES, 0));
+  TEST_ASSERT_EQUAL_UINT64(STORED_PULSES + 3, restoredPulses());
+}
+
+// A reset part way through an update: whatever prefix of the new bytes reached RTC memory, the
+// boot restores either the update or the counters before it
+void test_survives_an_update_torn_at_every_byte() {
+  writeTwoSlots();
+  const std::vector<uint8_t> before = rtcMemory();
+  pulseRtcShadowUpdate(STORED_PULSES + 4, STORED_SUBTOTAL + 4);
+  const std::vector<uint8_t> after = rtcMemory();
+
+  for (size_t written = 0; written <= after.size(); ++written) {
+    std::vector<uint8_t> torn = before;
+    memcpy(torn.data(), after.data(), written);
+    setRtcMemory(torn);
+    const uint64_t pulses = restoredPulses();
+    char message[64];
+    snprintf(message, sizeof(message), "%u bytes written: %llu", (unsigned)written, (unsigned long long)pulses);
+    TEST_ASSERT_TRUE_MESSAGE(pulses == STORED_PULSES + 3 || pulses == STORED_PULSES + 4, message);
+  }
+  TEST_ASSERT_EQUAL_UINT64(STORED_PULSES + 4, restoredPulses());
+}
+
+// A bit flipped anywhere fails that slot's checksum, and the boot falls back to the other slot
+void test_falls_back_when_a_bit_fails_the_checksum() {
+  writeTwoSlots();
+  const std::vector<uint8_t> intact = rtcMemory();
+  uint32_t fallbacks = 0;
+  for (size_t byte = 0; byte < intact.size(); ++byte) {
+    for (int bit = 0; bit < 8; ++bit) {
+      std::vector<uint8_t> flipped = intact;
+      flipped[byte] ^= static_cast<uint8_t>(1U << bit);
+      setRtcMemory(flipped);
+      const uint64_t pulses = restoredPulses();
+      char message[64];
+      snprintf(message, sizeof(message), "byte %u bit %d: %llu", (unsigned)byte, bit, (unsigned long long)pulses);
+      TEST_ASSERT_TRUE_MESSAGE(pulses == STORED_PULSES + 2 || pulses == STORED_PULSES + 3, message);
+      fallbacks += pulses == STORED_PULSES + 2 ? 1 : 0;
+    }
+  }
+  // Every checksummed bit of the newer slot
+  TEST_ASSERT_EQUAL_UINT32(offsetof(ShadowSlot, checksum) * 8 + 32, fallbacks);
+}
+
+void test_orders_slots_across_a_generation_wrap() {
+  writeTwoSlots();
+  std::vector<uint8_t> memory = rtcMemory();
+  TEST_ASSERT_EQUAL_UINT32(2 * sizeof(ShadowSlot), memory.size());
+  ShadowSlot slots[2];
+  memcpy(slots, memory.data(), sizeof(slots));
+  for (ShadowSlot& slot : slots) {
+    slot.generation = slot.pulseCounter == STORED_PULSES + 3 ? UINT32_MAX : UINT32_MAX - 1;
+    slot.checksum = slotChecksum(slot);
+  }
+  memcpy(memory.data(), slots, sizeof(slots));
+  setRtcMemory(memory);
+  TEST_ASSERT_EQUAL_UINT64(STORED_PULSES + 3, restoredPulses());
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, pulseRtcShadowGeneration());
+
+  pulseRtcShadowUpdate(STORED_PULSES + 4, STORED_SUBTOTAL + 4);
+  TEST_ASSERT_EQUAL_UINT32(0, pulseRtcShadowGeneration());
+  TEST_ASSERT_EQUAL_UINT64(STORED_PULSES + 4, restoredPulses());
+  pulseRtcShadowUpdate(STORED_PULSES + 5, STORED_SUBTOTAL + 5);
+  TEST_ASSERT_EQUAL_UINT32(1, pulseRtcShadowGeneration());
+  TEST_ASSERT_EQUAL_UINT64(STORED_PULSES + 5, restoredPulses());
+}
+
+// Power-on leaves RTC memory undefined; even a reset that would keep it (new firmware with another
+// slot layout, say) must not take garbage for counters, and the first update starts generation 1.
+// Runs first, while the module has written nothing, as after a real boot.
+void test_ignores_garbage_in_rtc_memory() {
+  uint64_t randomState = 0x2545F4914F6CDD1DULL;
+  std::vector<uint8_t> garbage = rtcMemory();
+  for (uint32_t boot = 0; boot < GARBAGE_BOOTS; ++boot) {
+    for (uint8_t& byte : garbage) {
+      byte = static_cast<uint8_t>(nextRandom(randomState));
+    }
+    setRtcMemory(garbage);
+    HalSim::setResetReason(boot % 2 == 0 ? ESP_RST_POWERON : ESP_RST_SW);
+    TEST_ASSERT_EQUAL_UINT64(0, restoredPulses());
+    TEST_ASSERT_EQUAL_UINT32(0, pulseRtcShadowGeneration());
+  }
+  pulseRtcShadowStored(STORED_PULSES, STORED_SUBTOTAL);
+  pulseRtcShadowUpdate(STORED_PULSES + 1, STORED_SUBTOTAL + 1);
+  TEST_ASSERT_EQUAL_UINT32(1, pulseRtcShadowGeneration());
+  TEST_ASSERT_EQUAL_UINT64(STORED_PULSES + 1, restoredPulses());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_ignores_garbage_in_rtc_memory);
+  RUN_TEST(test_only_resets_that_keep_rtc_memory_restore);
+  RUN_TEST(test_rejects_a_copy_the_store_has_moved_past);
+  RUN_TEST(test_survives_an_update_torn_at_every_byte);
+  RUN_TEST(test_falls_back_when_a_bit_fails_the_checksum);
+  RUN_TEST(test_orders_slots_across_a_generation_wrap);
+  return UNITY_END();
+}
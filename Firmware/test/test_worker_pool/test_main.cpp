@@ -0,0 +1,139 @@
+/*
+ * The persistent worker pool under TeslaLog uploads slow enough to fill the network worker's
+ * queue: back-pressure rejects at once, the MQTT lane runs while the network worker is busy,
+ * uploads run one at a time, a rejected upload is accepted once the queue drained, the lane
+ * statistics in <device>/log/worker, and no task is created per job.
+ *
+ *   pio test -e native -f test_worker_pool
+ */
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "HalSim.h"
+#include "MqttClient.h"
+#include "NativeHarness.h"
+#include "TeslaSheets.h"
+#include "WorkerPool.h"
+#include "config.h"
+
+using namespace NativeHarness;
+
+namespace {
+constexpr uint32_t WORKER_POOL_TELEMETRY_MS = 300;
+
+std::atomic<uint32_t> sMqttLaneJobsDone{0};
+uint32_t sTasksBefore = 0;
+uint32_t sUploadsBefore = 0;
+uint32_t sAccepted = 0;
+WorkerLaneStats sMqttBefore;
+std::chrono::steady_clock::time_point sStart;
+
+void runMqttLaneJob(const void* payload) {
+  (void)payload;
+  sMqttLaneJobsDone++;
+}
+
+uint32_t uploads() {
+  return HalSim::teslaStats().teslaLogUploads - sUploadsBefore;
+}
+
+double msSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+}  // namespace
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// One upload running and the queue full behind it: the next one is rejected at once
+void test_full_network_queue_rejects_at_once() {
+  TEST_ASSERT_TRUE_MESSAGE(startNetwork(), "MQTT did not connect");
+  HalSim::setTeslaTelemetry(WORKER_POOL_TELEMETRY_MS, true);
+  sTasksBefore = HalSim::tasksCreated();
+  const uint32_t requestsBefore = HalSim::teslaStats().telemetryRequests;
+  sUploadsBefore = HalSim::teslaStats().teslaLogUploads;
+  delay(100);  // The discovery publish queued after connecting runs on the MQTT lane
+  waitUntil([] {
+    getWorkerLaneStats(WORKER_LANE_MQTT, &sMqttBefore);
+    return sMqttBefore.completed == sMqttBefore.submitted;
+  }, 1000);
+  startWorkerPool();  // Already running: no new workers
+
+  sStart = std::chrono::steady_clock::now();
+  sAccepted = passTeslaTelemetryToGoogleSheets(&params, 1.0f, "WorkerPool") ? 1 : 0;
+  waitUntil([requestsBefore] { return HalSim::teslaStats().telemetryRequests > requestsBefore; }, 1000);
+  for (uint32_t i = 0; i < WORKER_NETWORK_QUEUE_LENGTH; i++) {
+    sAccepted += passTeslaTelemetryToGoogleSheets(&params, 1.0f, "WorkerPool") ? 1 : 0;
+  }
+  const auto rejectStart = std::chrono::steady_clock::now();
+  const bool rejected = !passTeslaTelemetryToGoogleSheets(&params, 1.0f, "WorkerPool");
+  const double rejectMs = msSince(rejectStart);
+  TEST_ASSERT_EQUAL_UINT32(WORKER_NETWORK_QUEUE_LENGTH + 1, sAccepted);
+  TEST_ASSERT_TRUE(rejected);
+  TEST_ASSERT_TRUE(rejectMs < 5.0);
+}
+
+// The MQTT lane runs while the network worker is busy
+void test_mqtt_lane_runs_beside_a_busy_network_worker() {
+  const uint8_t noPayload = 0;
+  TEST_ASSERT_TRUE(submitWorkerJob(WORKER_JOB_BUTTON_PUBLISH, runMqttLaneJob, noPayload));
+  TEST_ASSERT_TRUE(waitUntil([] { return sMqttLaneJobsDone > 0; }, WORKER_POOL_TELEMETRY_MS));
+  TEST_ASSERT_LESS_THAN_UINT32(2, uploads());
+}
+
+// One upload at a time: the queue drains in no less than one telemetry request per upload
+void test_uploads_run_one_at_a_time() {
+  TEST_ASSERT_TRUE(waitUntil([] { return uploads() == sAccepted; }, (sAccepted + 2) * WORKER_POOL_TELEMETRY_MS));
+  TEST_ASSERT_TRUE(msSince(sStart) >= sAccepted * WORKER_POOL_TELEMETRY_MS);
+}
+
+// The caller keeps the rejected upload pending; it is accepted once the queue drained
+void test_pending_upload_is_accepted_after_the_drain() {
+  TEST_ASSERT_TRUE(passTeslaTelemetryToGoogleSheets(&params, 1.0f, "PendingTelemetry"));
+  TEST_ASSERT_TRUE(waitUntil([] { return uploads() == sAccepted + 1; }, 2 * WORKER_POOL_TELEMETRY_MS));
+}
+
+// Lane statistics in <device>/log/worker, published only when there were jobs since the last report
+void test_lane_stats_are_published_once() {
+  char expected[64] = {0};
+  snprintf(expected, sizeof(expected), "network:%u/1/%u peak:%u/%u", (unsigned)(sAccepted + 1),
+           (unsigned)(sAccepted + 1), (unsigned)WORKER_NETWORK_QUEUE_LENGTH, (unsigned)WORKER_NETWORK_QUEUE_LENGTH);
+  char report[256] = {0};
+  TEST_ASSERT_TRUE(publishWorkerPoolStats());
+  TEST_ASSERT_TRUE(waitUntil([&report] {
+    return HalSim::lastPublished(mqttTopic(MQTT_TOPIC_LOG_WORKER), report, sizeof(report));
+  }, 1000));
+  TEST_ASSERT_NOT_NULL_MESSAGE(strstr(report, expected), report);
+  WorkerLaneStats mqttAfter;
+  getWorkerLaneStats(WORKER_LANE_MQTT, &mqttAfter);
+  TEST_ASSERT_EQUAL_UINT32(1, mqttAfter.completed - sMqttBefore.completed);
+  TEST_ASSERT_EQUAL_UINT32(0, mqttAfter.rejected);
+  TEST_ASSERT_FALSE(publishWorkerPoolStats());
+}
+
+void test_no_task_is_created_per_job() {
+  TEST_ASSERT_EQUAL_UINT32(0, HalSim::tasksCreated() - sTasksBefore);
+}
+
+int main() {
+  initializeGlobals(&params);
+  UNITY_BEGIN();
+  RUN_TEST(test_full_network_queue_rejects_at_once);
+  RUN_TEST(test_mqtt_lane_runs_beside_a_busy_network_worker);
+  RUN_TEST(test_uploads_run_one_at_a_time);
+  RUN_TEST(test_pending_upload_is_accepted_after_the_drain);
+  RUN_TEST(test_lane_stats_are_published_once);
+  RUN_TEST(test_no_task_is_created_per_job);
+  // The firmware tasks never return; leave without running static destructors underneath them
+  const int failures = UNITY_END();
+  fflush(stdout);
+  std::_Exit(failures);
+}